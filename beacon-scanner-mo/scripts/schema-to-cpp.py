@@ -16,12 +16,88 @@
 
 import argparse
 import json
+import re
 import sys
 
 def load_json_schema(file_path):
     with open(file_path, 'r', encoding='utf-8') as file:
         return json.load(file)
 
+def save_json_schema(json_schema, file_path):
+    with open(file_path, 'w', encoding='utf-8') as file:
+        json.dump(json_schema, file, indent='\t', ensure_ascii=False)
+        file.write('\n')
+
+def insert_after(properties, after_key, new_items):
+    # Rebuild the properties so that new objects land next to the object they follow
+    result = {}
+    for key, value in properties.items():
+        if key not in new_items:
+            result[key] = value
+        if key == after_key:
+            result.update(new_items)
+    if after_key not in properties:
+        result.update(new_items)
+    return result
+
+def expand_objects(json_schema, template, count):
+    """Replicate a numbered top level object such as modbus1 into modbus1..modbusN."""
+    match = re.fullmatch(r'(.*?)(\d+)', template)
+    if not match:
+        raise ValueError(f"Template {template} does not end in a number")
+    stem, number = match.group(1), match.group(2)
+    properties = json_schema['properties']
+    source = json.dumps(properties[template], ensure_ascii=False)
+
+    def renumber(n):
+        text = source.replace(f'"#/properties/{template}', f'"#/properties/{stem}{n}')
+        obj = json.loads(text)
+        obj['title'] = re.sub(rf'\b{number}$', str(n), obj.get('title', ''))
+        return obj
+
+    new_items = {f"{stem}{n}": renumber(n) for n in range(1, count + 1)}
+    new_items[template] = properties[template]
+    for key in [k for k in properties if re.fullmatch(rf'{re.escape(stem)}\d+', k)]:
+        if key not in new_items:
+            del properties[key]
+    json_schema['properties'] = insert_after(properties, template, new_items)
+
+def point_pages(json_schema, prefix, pages, page_size, first, after):
+    """Generate compact point table pages where each point is a single definition string."""
+    functions = 'coil|di|ir|hr'
+    types = ('int16|uint16|int32|uint32|float32_abcd|float32_badc|float32_cdab|float32_dcba|bits|'
+             'int64|uint64|int64_cdab|uint64_cdab|float64_abcd|float64_badc|float64_cdab|float64_dcba|bcd16|bcd32|'
+             '(string|int16_array|uint16_array)\\*\\d{1,2}')
+    new_items = {}
+    for page in range(1, pages + 1):
+        name = f"{prefix}{page}"
+        start = first + (page - 1) * page_size
+        points = {}
+        for point in range(start, start + page_size):
+            points[f"p{point}"] = {
+                "$id": f"#/properties/{name}/p{point}",
+                "type": "string",
+                "title": f"Point {point}",
+                "description": "Polling definition as id,function,address,type,poll[,scale[,offset[,mask[,shift[,priority[,deadband[,percent[,rate[,heartbeat]]]]]]]]]. Function is coil, di, ir or hr. String and array types take their register count as a suffix, as in string*8. Poll is in seconds, or milliseconds with an ms suffix. Giving a deadband reports the point only when it changes by more than the deadband or percent, changes faster than rate per second, or heartbeat seconds pass. Every field given must hold a value, empty fields are rejected. Leave empty to disable the point.",
+                "default": "",
+                "examples": ["1,hr,100,float32_cdab,5,0.1"],
+                "pattern": rf"^$|^\d{{1,3}},({functions}),\d{{1,5}},({types}),\d+(ms)?(,[-+0-9.eExX]*){{0,9}}$",
+                "maxLength": 96
+            }
+        new_items[name] = {
+            "$id": f"#/properties/{name}",
+            "type": "object",
+            "title": f"Modbus Points {start}-{start + page_size - 1}",
+            "description": "Compact configuration for a page of the Modbus point table.",
+            "default": {},
+            "minimumFirmwareVersion": 2,
+            "properties": points
+        }
+    properties = json_schema['properties']
+    for key in [k for k in properties if re.fullmatch(rf'{re.escape(prefix)}\d+', k)]:
+        del properties[key]
+    json_schema['properties'] = insert_after(properties, after, new_items)
+
 def to_camel_case(snake_str):
     components = snake_str.split('_')
     return components[0] + ''.join(x.title() for x in components[1:])
@@ -103,13 +179,29 @@ def generate_cpp_code(json_schema, search_name):
 if __name__ == "__main__":
     parser = argparse.ArgumentParser(description="Convert JSON schema to C++ code")
     parser.add_argument("file_path", help="Path to the JSON schema file")
-    parser.add_argument("search_name", help="Root name for the C++ structs")
+    parser.add_argument("search_name", nargs='?', help="Root name for the C++ structs")
+    parser.add_argument("--expand", nargs=2, metavar=("TEMPLATE", "COUNT"),
+        help="Regenerate numbered objects from a template object, e.g. modbus1 3")
+    parser.add_argument("--pages", nargs=4, metavar=("PREFIX", "PAGES", "SIZE", "FIRST"),
+        help="Regenerate compact point table pages, e.g. modbus_pts 8 16 4")
+    parser.add_argument("--schema-out", help="Write the regenerated schema to this file")
     args = parser.parse_args()
 
     try:
         json_schema = load_json_schema(args.file_path)
-        cpp_code = generate_cpp_code(json_schema, args.search_name)
-        print(cpp_code)
+        if args.expand:
+            expand_objects(json_schema, args.expand[0], int(args.expand[1]))
+        if args.pages:
+            # Pages follow the last expanded object when both are regenerated together
+            after = None
+            if args.expand:
+                after = re.fullmatch(r'(.*?)\d+', args.expand[0]).group(1) + args.expand[1]
+            point_pages(json_schema, args.pages[0], int(args.pages[1]), int(args.pages[2]), int(args.pages[3]), after)
+        if args.schema_out:
+            save_json_schema(json_schema, args.schema_out)
+        if args.search_name:
+            cpp_code = generate_cpp_code(json_schema, args.search_name)
+            print(cpp_code)
     except FileNotFoundError:
         print("Error: The specified file does not exist.", file=sys.stderr)
     except json.JSONDecodeError as e:
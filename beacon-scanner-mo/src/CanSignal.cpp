@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "CanSignal.h"
+
+
+static constexpr uint32_t CAN_LAYOUT_MASK       {0x1fffffff};
+static constexpr uint32_t CAN_STANDARD_SHIFT    {18};   // Standard identifier position in the controller layout
+
+static uint32_t bitCount(uint32_t x) {
+    uint32_t count = 0;
+    for (; x; x &= x - 1) {
+        count++;
+    }
+    return count;
+}
+
+bool canDeriveSignal(CanSignal& signal) {
+    if ((signal.bits < 1) || (signal.bits > 64) || (signal.byte > 7) || (signal.bit > 7)) {
+        return false;
+    }
+
+    int low;
+    if (signal.motorola) {
+        // Position of the most significant bit in the data taken as a big endian number
+        low = (7 - signal.byte) * 8 + signal.bit - signal.bits + 1;
+        if (low < 0) {
+            return false;
+        }
+        signal.length = (uint8_t)(8 - low / 8);
+    }
+    else {
+        low = signal.byte * 8 + signal.bit;
+        if ((low + signal.bits) > 64) {
+            return false;
+        }
+        signal.length = (uint8_t)((low + signal.bits + 7) / 8);
+    }
+    signal.shift = (uint8_t)low;
+    signal.valueMask = (64 == signal.bits) ? UINT64_MAX : ((1ULL << signal.bits) - 1);
+
+    return true;
+}
+
+bool canDecodeSignal(const CanSignal& signal, const CanFrame& frame, double& value) {
+    if (frame.length < signal.length) {
+        return false;
+    }
+
+    uint64_t data = 0;
+    if (signal.motorola) {
+        for (size_t i = 0; i < frame.length; i++) {
+            data |= (uint64_t)frame.data[i] << (56 - 8 * i);
+        }
+    }
+    else {
+        for (size_t i = 0; i < frame.length; i++) {
+            data |= (uint64_t)frame.data[i] << (8 * i);
+        }
+    }
+
+    auto raw = (data >> signal.shift) & signal.valueMask;
+    if (signal.notAvailable && (raw == signal.valueMask)) {
+        return false;
+    }
+    if (signal.isSigned && (signal.bits < 64) && (raw >> (signal.bits - 1))) {
+        raw |= ~signal.valueMask;
+    }
+
+    value = ((signal.isSigned) ? (double)(int64_t)raw : (double)raw) * signal.scale + signal.offset;
+    return true;
+}
+
+/**
+ * @brief Widest filter passing everything either filter passes
+ *
+ */
+static CanFilter mergeFilters(const CanFilter& a, const CanFilter& b) {
+    auto mask = a.mask & b.mask & ~(a.id ^ b.id);
+    return {a.id & mask, mask, a.extended};
+}
+
+void canPlanFilters(const CanFilter* wanted, size_t count, CanFilterPlan& plan) {
+    static constexpr size_t FILTERS = CanFilterPlan::FILTERS;
+
+    // Keep at most one more filter than the controller has, merging the closest pair whenever it fills
+    CanFilter filters[FILTERS + 1];
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++) {
+        auto shift = (wanted[i].extended) ? 0 : CAN_STANDARD_SHIFT;
+        auto mask = (wanted[i].mask << shift) & CAN_LAYOUT_MASK;
+        filters[used++] = {(wanted[i].id << shift) & mask, mask, wanted[i].extended};
+        if (used <= FILTERS) {
+            continue;
+        }
+
+        size_t bestA = 0, bestB = 0;
+        int best = -1;
+        for (size_t a = 0; a < used; a++) {
+            for (size_t b = a + 1; b < used; b++) {
+                if (filters[a].extended != filters[b].extended) {
+                    continue;
+                }
+                auto score = (int)bitCount(mergeFilters(filters[a], filters[b]).mask);
+                if (score > best) {
+                    best = score;
+                    bestA = a;
+                    bestB = b;
+                }
+            }
+        }
+        filters[bestA] = mergeFilters(filters[bestA], filters[bestB]);
+        filters[bestB] = filters[--used];
+    }
+
+    if (0 == used) {
+        // Zero masks with both frame types in each buffer pass every frame
+        for (size_t i = 0; i < CanFilterPlan::BUFFERS; i++) {
+            plan.masks[i] = 0;
+        }
+        for (size_t i = 0; i < FILTERS; i++) {
+            plan.filters[i] = {0, 0, (1 == (i & 1))};
+        }
+        return;
+    }
+
+    // Try every way of giving buffer 0 up to two filters and buffer 1 the rest
+    uint32_t bestSet = 0;
+    int best = -1;
+    for (uint32_t set = 0; set < (1UL << used); set++) {
+        auto first = bitCount(set);
+        if ((first > 2) || ((used - first) > (FILTERS - 2))) {
+            continue;
+        }
+        uint32_t masks[2] = {CAN_LAYOUT_MASK, CAN_LAYOUT_MASK};
+        for (size_t i = 0; i < used; i++) {
+            masks[(set >> i) & 1 ? 0 : 1] &= filters[i].mask;
+        }
+        int score = 0;
+        for (size_t i = 0; i < used; i++) {
+            score += (int)bitCount(masks[(set >> i) & 1 ? 0 : 1]);
+        }
+        if (score > best) {
+            best = score;
+            bestSet = set;
+        }
+    }
+
+    plan.masks[0] = plan.masks[1] = CAN_LAYOUT_MASK;
+    for (size_t i = 0; i < used; i++) {
+        plan.masks[((bestSet >> i) & 1) ? 0 : 1] &= filters[i].mask;
+    }
+    size_t next[2] = {0, 2};
+    for (size_t i = 0; i < used; i++) {
+        auto buffer = ((bestSet >> i) & 1) ? 0 : 1;
+        plan.filters[next[buffer]] = filters[i];
+        plan.filters[next[buffer]++].id &= plan.masks[buffer];
+    }
+
+    // Unused filters repeat the first of their own buffer, or of the other buffer if their own is
+    // empty, which then passes nothing the other buffer does not
+    for (size_t i = 0; i < FILTERS; i++) {
+        auto buffer = (i < 2) ? 0 : 1;
+        auto start = (0 == buffer) ? 0 : 2;
+        if (i < next[buffer]) {
+            continue;
+        }
+        plan.filters[i] = (next[buffer] > (size_t)start) ? plan.filters[start] : plan.filters[2 - start];
+    }
+}
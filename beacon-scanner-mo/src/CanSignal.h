@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief One CAN frame as received or sent
+ *
+ */
+struct CanFrame {
+    uint32_t id;                            ///< 11-bit standard or 29-bit extended identifier
+    bool extended;
+    uint8_t length;                         ///< Data length code, 0 to 8
+    uint8_t data[8];
+};
+
+/**
+ * @brief Acceptance filter passing frames whose identifier matches id in every mask bit
+ *
+ */
+struct CanFilter {
+    uint32_t id;
+    uint32_t mask;
+    bool extended;
+};
+
+/**
+ * @brief One signal carried in the data of matching frames
+ *
+ * @details Intel signals start at their least significant bit and run up through the data
+ *          taken as a little endian number, as used by J1939 and CANopen.  Motorola signals
+ *          start at their most significant bit and run down through the data taken as a big
+ *          endian number.  Bit numbers count from bit zero of each byte.
+ */
+struct CanSignal {
+    bool enabled                    {false};
+    bool extended                   {false};
+    bool motorola                   {false};    ///< Big endian, otherwise little endian
+    bool isSigned                   {false};
+    bool notAvailable               {false};    ///< A raw value of all ones means the value is not available, as in J1939
+    uint8_t byte                    {0};        ///< Byte holding the first bit
+    uint8_t bit                     {0};        ///< First bit within the byte
+    uint8_t bits                    {8};        ///< Signal length, 1 to 64
+    uint32_t id                     {0};
+    uint32_t mask                   {0};
+    double scale                    {1.0};
+    double offset                   {0.0};
+
+    // Derived when the signal is configured
+    uint8_t shift                   {0};        ///< Position of the least significant bit in the 64-bit data
+    uint8_t length                  {0};        ///< Shortest frame holding the whole signal
+    uint64_t valueMask              {0};
+
+    /**
+     * @brief Whether a frame carries this signal
+     *
+     */
+    bool matches(const CanFrame& frame) const {
+        return enabled && (frame.extended == extended) && (0 == ((frame.id ^ id) & mask));
+    }
+};
+
+/**
+ * @brief Receive filters of an MCP2515 family controller
+ *
+ * @details Receive buffer 0 has mask 0 and filters 0 and 1, receive buffer 1 has mask 1 and
+ *          filters 2 to 5.  Masks and filter identifiers are held in the controller layout,
+ *          with the 11 standard identifier bits at the top of the 29 bits and the extended
+ *          identifier bits below them.  Unused filters repeat a used one.
+ */
+struct CanFilterPlan {
+    static constexpr size_t BUFFERS         {2};
+    static constexpr size_t FILTERS         {6};
+
+    uint32_t masks[BUFFERS];
+    CanFilter filters[FILTERS];
+};
+
+/**
+ * @brief Fill in the derived fields of a signal
+ *
+ * @param signal Signal with its position and length filled in
+ * @return true Signal fits in a frame
+ * @return false Signal runs past the frame data
+ */
+bool canDeriveSignal(CanSignal& signal);
+
+/**
+ * @brief Decode one signal from a frame known to match it
+ *
+ * @param signal Signal
+ * @param frame Frame
+ * @param value Scaled value
+ * @return true Value decoded
+ * @return false Frame is too short or the value is not available
+ */
+bool canDecodeSignal(const CanSignal& signal, const CanFrame& frame, double& value);
+
+/**
+ * @brief Plan controller filters that pass every frame any of the wanted filters pass
+ *
+ * @details While there are more wanted filters than controller filters, the pair whose
+ *          merge keeps the most mask bits is merged, keeping only the bits on which both
+ *          agree.  The remaining filters are then split between the two receive buffers so
+ *          that the shared buffer masks keep as many bits as possible.  Frames that get
+ *          through a widened filter must still be matched in software.  With no wanted
+ *          filters every frame is passed.
+ *
+ * @param wanted Wanted filters, identifiers and masks in frame layout
+ * @param count Number of wanted filters
+ * @param plan Controller filters
+ */
+void canPlanFilters(const CanFilter* wanted, size_t count, CanFilterPlan& plan);
+
+/**
+ * @brief Bits on the wire for one frame, without stuff bits
+ *
+ */
+inline uint32_t canFrameBits(const CanFrame& frame) {
+    return ((frame.extended) ? 67 : 47) + 8 * (uint32_t)frame.length;
+}
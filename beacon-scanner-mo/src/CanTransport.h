@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "CanSignal.h"
+
+
+/**
+ * @brief CAN controller the CAN engine receives and sends frames through
+ *
+ */
+class CanTransport {
+public:
+    virtual ~CanTransport() = default;
+
+    /**
+     * @brief Start the controller, or restart it with new settings
+     *
+     * @param bitrate Bits per second
+     * @param listenOnly Never transmit, not even acknowledgements
+     * @param plan Receive filters
+     * @return true Controller running
+     * @return false Controller did not start
+     */
+    virtual bool begin(uint32_t bitrate, bool listenOnly, const CanFilterPlan& plan) = 0;
+
+    /**
+     * @brief Wait until a frame may have arrived
+     *
+     * @param timeoutMs Longest wait in milliseconds
+     */
+    virtual void wait(uint32_t timeoutMs) = 0;
+
+    /**
+     * @brief Take the next received frame
+     *
+     * @param frame Frame to fill in
+     * @return true Frame taken
+     * @return false No frame waiting
+     */
+    virtual bool receive(CanFrame& frame) = 0;
+
+    /**
+     * @brief Queue a frame for sending
+     *
+     * @return true Frame queued
+     * @return false No room in the controller, or the controller is listening only
+     */
+    virtual bool send(const CanFrame& frame) = 0;
+
+    /**
+     * @brief Frames lost to full receive buffers since the last call
+     *
+     */
+    virtual uint32_t takeOverruns() {
+        return 0;
+    }
+};
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+/**
+ * @brief Double buffered, read mostly table shared between writers and a single reader
+ *
+ * @details The reader takes the current table without locking or copying and marks it as
+ *          in use until it is released.  A writer edits a copy of the current table in the
+ *          other buffer and swaps it in with an atomic pointer store.  Before reusing a
+ *          retired buffer the writer waits for the reader to let go of it, which only takes
+ *          as long as the reader holds a table.  Writers must be serialized by the caller
+ *          and T must be trivially copyable.
+ */
+template <typename T>
+class ConfigSnapshot {
+public:
+    /**
+     * @brief Construct a new snapshot over caller supplied buffers
+     *
+     * @param first Buffer holding the initial table
+     * @param second Spare buffer of the same size
+     * @param count Number of elements in each buffer
+     */
+    ConfigSnapshot(T* first, T* second, size_t count)
+        : _buffers{first, second}, _count(count), _active(first) {}
+
+    /**
+     * @brief Take the current table for reading, must be paired with release()
+     *
+     * @return const T* Table that stays unchanged until released
+     */
+    const T* acquire() {
+        const T* table;
+        do {
+            table = _active.load();
+            _reading.store(table);
+        } while (table != _active.load());
+
+        return table;
+    }
+
+    /**
+     * @brief Let go of the table taken by acquire()
+     *
+     */
+    void release() {
+        _reading.store(nullptr);
+    }
+
+    /**
+     * @brief Current table as seen by a writer
+     *
+     */
+    const T* current() const {
+        return _active.load();
+    }
+
+    /**
+     * @brief Start editing a copy of the current table, must be followed by commit()
+     *
+     * @param wait Called while the reader still holds the buffer about to be reused
+     * @return T* Editable copy of the current table
+     */
+    template <typename Wait>
+    T* edit(Wait wait) {
+        auto active = _active.load();
+        _editing = (active == _buffers[0]) ? _buffers[1] : _buffers[0];
+        while (_reading.load() == _editing) {
+            wait();
+        }
+        memcpy(_editing, active, _count * sizeof(T));
+
+        return _editing;
+    }
+
+    /**
+     * @brief Publish the table returned by edit()
+     *
+     */
+    void commit() {
+        _active.store(_editing);
+        _epoch.fetch_add(1);
+    }
+
+    /**
+     * @brief Number of tables published
+     *
+     */
+    uint32_t getEpoch() const {
+        return _epoch.load();
+    }
+
+private:
+    T* _buffers[2];
+    size_t _count;
+    T* _editing {nullptr};
+    std::atomic<const T*> _active;
+    std::atomic<const T*> _reading {nullptr};
+    std::atomic<uint32_t> _epoch {0};
+};
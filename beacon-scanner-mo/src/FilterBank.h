@@ -0,0 +1,421 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief Second order IIR section implemented in transposed direct form II
+ *
+ * @details Low pass coefficients follow the RBJ audio EQ cookbook.  A bypassed section passes
+ *          samples through unmodified at the cost of a single branch.
+ */
+class BiquadFilter {
+public:
+    /**
+     * @brief Disable the section so that samples are passed through
+     *
+     */
+    void setBypass() {
+        _bypass = true;
+        _b0 = 1.0f;
+        _b1 = _b2 = _a1 = _a2 = 0.0f;
+        _z1 = _z2 = 0.0f;
+    }
+
+    /**
+     * @brief Configure a second order low pass section
+     *
+     * @param fs Sample rate in Hertz
+     * @param fc Cutoff frequency in Hertz, clamped below Nyquist
+     * @param q Quality factor, 0.7071 gives a Butterworth response
+     */
+    void setLowPass(float fs, float fc, float q = 0.70710678f) {
+        fc = std::fmin(fc, 0.45f * fs);
+        auto w0 = 2.0f * (float)M_PI * fc / fs;
+        auto cosw0 = std::cos(w0);
+        auto alpha = std::sin(w0) / (2.0f * q);
+        auto a0 = 1.0f + alpha;
+
+        _b0 = ((1.0f - cosw0) / 2.0f) / a0;
+        _b1 = (1.0f - cosw0) / a0;
+        _b2 = _b0;
+        _a1 = (-2.0f * cosw0) / a0;
+        _a2 = (1.0f - alpha) / a0;
+        _z1 = _z2 = 0.0f;
+        _bypass = false;
+    }
+
+    /**
+     * @brief Configure a second order notch section
+     *
+     * @details Pole radius is derived from the notch bandwidth rather than the cookbook
+     *          alpha term, which collapses to zero for a notch placed exactly at Nyquist
+     *          (50 Hz mains sampled at 100 Hz).  Gain is normalized to unity at DC.
+     *
+     * @param fs Sample rate in Hertz
+     * @param f0 Notch frequency in Hertz, must already be folded into the first Nyquist zone
+     * @param q Quality factor, the -3 dB bandwidth is f0 / q
+     */
+    void setNotch(float fs, float f0, float q) {
+        auto w0 = 2.0f * (float)M_PI * f0 / fs;
+        auto cosw0 = std::cos(w0);
+        auto r = std::fmax(0.0f, 1.0f - (float)M_PI * (f0 / q) / fs);
+
+        _a1 = -2.0f * r * cosw0;
+        _a2 = r * r;
+        auto gain = (1.0f + _a1 + _a2) / (2.0f - 2.0f * cosw0);
+        _b0 = gain;
+        _b1 = -2.0f * cosw0 * gain;
+        _b2 = gain;
+        _z1 = _z2 = 0.0f;
+        _bypass = false;
+    }
+
+    /**
+     * @brief Load the filter state so that a constant input produces a constant output
+     *
+     * @param x Value to settle the filter at
+     */
+    void prime(float x) {
+        if (_bypass) {
+            return;
+        }
+        auto y = x * (_b0 + _b1 + _b2) / (1.0f + _a1 + _a2);
+        _z1 = y - _b0 * x;
+        _z2 = _b2 * x - _a2 * y;
+    }
+
+    /**
+     * @brief Filter one sample
+     *
+     * @param x Input sample
+     * @return float Output sample
+     */
+    float process(float x) {
+        if (_bypass) {
+            return x;
+        }
+        auto y = _b0 * x + _z1;
+        _z1 = _b1 * x - _a1 * y + _z2;
+        _z2 = _b2 * x - _a2 * y;
+        return y;
+    }
+
+    /**
+     * @brief Evaluate the magnitude response of the section
+     *
+     * @param fs Sample rate in Hertz
+     * @param f Frequency of interest in Hertz
+     * @return float Linear gain at the given frequency
+     */
+    float magnitude(float fs, float f) const {
+        auto w = 2.0 * M_PI * f / fs;
+        auto c1 = std::cos(w), s1 = std::sin(w);
+        auto c2 = std::cos(2.0 * w), s2 = std::sin(2.0 * w);
+        auto numRe = _b0 + _b1 * c1 + _b2 * c2;
+        auto numIm = -(_b1 * s1 + _b2 * s2);
+        auto denRe = 1.0 + _a1 * c1 + _a2 * c2;
+        auto denIm = -(_a1 * s1 + _a2 * s2);
+        return (float)std::sqrt((numRe * numRe + numIm * numIm) / (denRe * denRe + denIm * denIm));
+    }
+
+    bool isBypassed() const {
+        return _bypass;
+    }
+
+private:
+    float _b0 {1.0f}, _b1 {0.0f}, _b2 {0.0f};
+    float _a1 {0.0f}, _a2 {0.0f};
+    float _z1 {0.0f}, _z2 {0.0f};
+    bool _bypass {true};
+};
+
+
+/**
+ * @brief Running median over a short window to reject single sample spikes
+ *
+ */
+class MedianFilter {
+public:
+    static constexpr size_t MAX_WINDOW {5};
+
+    /**
+     * @brief Set the window length
+     *
+     * @param window Number of samples, forced odd and limited to MAX_WINDOW.  One disables the filter.
+     */
+    void setWindow(size_t window) {
+        window = (window < 1) ? 1 : window;
+        window = (window > MAX_WINDOW) ? MAX_WINDOW : window;
+        _window = window | 1;
+        _count = 0;
+        _index = 0;
+    }
+
+    float process(float x) {
+        if (_window <= 1) {
+            return x;
+        }
+
+        _history[_index] = x;
+        _index = (_index + 1) % _window;
+        if (_count < _window) {
+            _count++;
+        }
+
+        // Insertion sort of at most MAX_WINDOW elements is cheaper than anything clever
+        float sorted[MAX_WINDOW];
+        for (size_t i = 0; i < _count; i++) {
+            auto v = _history[i];
+            auto j = i;
+            while ((j > 0) && (sorted[j - 1] > v)) {
+                sorted[j] = sorted[j - 1];
+                j--;
+            }
+            sorted[j] = v;
+        }
+        return sorted[_count / 2];
+    }
+
+    size_t getWindow() const {
+        return _window;
+    }
+
+private:
+    float _history[MAX_WINDOW] {};
+    size_t _window {1};
+    size_t _count {0};
+    size_t _index {0};
+};
+
+
+/**
+ * @brief Cascaded integrator comb style decimator built from moving sum stages
+ *
+ * @details An order N CIC filter with unity differential delay is equivalent to N cascaded
+ *          boxcar averages of length R followed by decimation by R.  Running sums are kept
+ *          in double precision so that they do not drift over long runtimes.
+ */
+class CicDecimator {
+public:
+    static constexpr size_t MAX_RATIO {16};
+    static constexpr size_t MAX_ORDER {3};
+
+    /**
+     * @brief Configure the decimator
+     *
+     * @param ratio Decimation ratio, one disables decimation
+     * @param order Number of cascaded boxcar stages
+     */
+    void configure(size_t ratio, size_t order) {
+        ratio = (ratio < 1) ? 1 : ratio;
+        _ratio = (ratio > MAX_RATIO) ? MAX_RATIO : ratio;
+        order = (order < 1) ? 1 : order;
+        _order = (order > MAX_ORDER) ? MAX_ORDER : order;
+        _primed = false;
+        _phase = 0;
+        _index = 0;
+    }
+
+    /**
+     * @brief Push one sample
+     *
+     * @param x Input sample
+     * @param y Output sample, only valid when true is returned
+     * @return true An output sample was produced
+     * @return false The sample was absorbed by decimation
+     */
+    bool process(float x, float& y) {
+        if (_ratio <= 1) {
+            y = x;
+            return true;
+        }
+
+        if (!_primed) {
+            for (size_t stage = 0; stage < _order; stage++) {
+                for (size_t i = 0; i < _ratio; i++) {
+                    _history[stage][i] = x;
+                }
+                _sum[stage] = (double)x * _ratio;
+            }
+            _primed = true;
+        }
+
+        double value = x;
+        for (size_t stage = 0; stage < _order; stage++) {
+            _sum[stage] += value - _history[stage][_index];
+            _history[stage][_index] = (float)value;
+            value = _sum[stage] / _ratio;
+        }
+        _index = (_index + 1) % _ratio;
+
+        if (++_phase < _ratio) {
+            return false;
+        }
+        _phase = 0;
+        y = (float)value;
+        return true;
+    }
+
+    /**
+     * @brief Evaluate the magnitude response of the decimator before decimation
+     *
+     * @param fs Input sample rate in Hertz
+     * @param f Frequency of interest in Hertz
+     * @return float Linear gain at the given frequency
+     */
+    float magnitude(float fs, float f) const {
+        if ((_ratio <= 1) || (f <= 0.0f)) {
+            return 1.0f;
+        }
+        auto w = M_PI * f / fs;
+        auto den = _ratio * std::sin(w);
+        auto stage = (std::fabs(den) < 1e-12) ? 1.0 : std::fabs(std::sin(_ratio * w) / den);
+        return (float)std::pow(stage, (double)_order);
+    }
+
+    size_t getRatio() const {
+        return _ratio;
+    }
+
+private:
+    float _history[MAX_ORDER][MAX_RATIO] {};
+    double _sum[MAX_ORDER] {};
+    size_t _ratio {1};
+    size_t _order {1};
+    size_t _phase {0};
+    size_t _index {0};
+    bool _primed {false};
+};
+
+
+/**
+ * @brief Settings for one analog input filter chain
+ *
+ */
+struct FilterBankSettings {
+    int32_t median          {1};        ///< Median window in samples, 1 to disable
+    double notchHz          {0.0};      ///< Mains notch frequency in Hertz, 0 to disable
+    double notchQ           {5.0};      ///< Notch quality factor
+    double lowPassHz        {0.0};      ///< Biquad low pass cutoff in Hertz, 0 to disable
+    int32_t decimate        {1};        ///< CIC decimation ratio, 1 to disable
+    int32_t cicOrder        {1};        ///< Number of CIC stages
+};
+
+
+/**
+ * @brief Multi-stage filter chain for a single analog input
+ *
+ * @details Samples flow through a median spike rejector, a notch section, a low pass section
+ *          and finally a CIC decimator.  The IIR sections run at the input rate so that the
+ *          notch is applied before any aliasing introduced by decimation.
+ */
+class FilterBank {
+public:
+    /**
+     * @brief Apply new settings and reset all filter state
+     *
+     * @param fs Input sample rate in Hertz
+     * @param settings Filter settings
+     */
+    void configure(float fs, const FilterBankSettings& settings) {
+        _fs = fs;
+        _median.setWindow((size_t)settings.median);
+
+        auto notch = foldFrequency((float)settings.notchHz, fs);
+        if ((settings.notchHz > 0.0) && (notch > 0.01f * fs)) {
+            _notch.setNotch(fs, notch, (float)settings.notchQ);
+        }
+        else {
+            _notch.setBypass();
+        }
+
+        if (settings.lowPassHz > 0.0) {
+            _lowPass.setLowPass(fs, (float)settings.lowPassHz);
+        }
+        else {
+            _lowPass.setBypass();
+        }
+
+        _decimator.configure((size_t)settings.decimate, (size_t)settings.cicOrder);
+        _primed = false;
+    }
+
+    /**
+     * @brief Filter one raw sample
+     *
+     * @param x Raw input sample
+     * @param y Filtered output sample, only valid when true is returned
+     * @return true An output sample at the decimated rate is available
+     * @return false No output for this input sample
+     */
+    bool process(float x, float& y) {
+        x = _median.process(x);
+        if (!_primed) {
+            _notch.prime(x);
+            _lowPass.prime(x);
+            _primed = true;
+        }
+        x = _notch.process(x);
+        x = _lowPass.process(x);
+        return _decimator.process(x, y);
+    }
+
+    /**
+     * @brief Sample rate of the filtered output
+     *
+     * @return float Output rate in Hertz
+     */
+    float outputRate() const {
+        return _fs / (float)_decimator.getRatio();
+    }
+
+    /**
+     * @brief Combined magnitude response of the linear stages, ignoring the median filter
+     *
+     * @param f Frequency of interest in Hertz
+     * @return float Linear gain at the given frequency
+     */
+    float magnitude(float f) const {
+        auto folded = foldFrequency(f, _fs);
+        return _notch.magnitude(_fs, folded) * _lowPass.magnitude(_fs, folded) * _decimator.magnitude(_fs, folded);
+    }
+
+    /**
+     * @brief Find the apparent frequency of a tone after sampling
+     *
+     * @param f Tone frequency in Hertz
+     * @param fs Sample rate in Hertz
+     * @return float Aliased frequency between zero and Nyquist
+     */
+    static float foldFrequency(float f, float fs) {
+        auto folded = std::fmod(std::fabs(f), fs);
+        return (folded > fs / 2.0f) ? (fs - folded) : folded;
+    }
+
+private:
+    MedianFilter _median;
+    BiquadFilter _notch;
+    BiquadFilter _lowPass;
+    CicDecimator _decimator;
+    float _fs {1.0f};
+    bool _primed {false};
+};
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief Fixed capacity FIFO over caller supplied storage
+ *
+ * @details Pushing into a full ring drops the oldest entry so that the freshest data is kept,
+ *          and every dropped entry is counted.  Not thread safe, the owner serializes access.
+ */
+template <typename T>
+class FixedRing {
+public:
+    /**
+     * @brief Construct a new ring over caller supplied storage
+     *
+     * @param storage Entry storage
+     * @param capacity Number of entries the storage can hold
+     */
+    FixedRing(T* storage, size_t capacity)
+        : _storage(storage), _capacity(capacity) {}
+
+    void clear() {
+        _head = 0;
+        _size = 0;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    size_t capacity() const {
+        return _capacity;
+    }
+
+    bool empty() const {
+        return (0 == _size);
+    }
+
+    /**
+     * @brief Add an entry, replacing the oldest if the ring is full
+     *
+     * @param entry Entry to add
+     * @return true Entry added
+     * @return false Entry added and the oldest entry dropped
+     */
+    bool push(const T& entry) {
+        auto kept = true;
+        if (_size >= _capacity) {
+            _head = next(_head);
+            _size--;
+            _overflows++;
+            kept = false;
+        }
+        auto tail = _head + _size;
+        _storage[(tail >= _capacity) ? (tail - _capacity) : tail] = entry;
+        _size++;
+
+        return kept;
+    }
+
+    /**
+     * @brief Oldest entry, only valid when not empty
+     *
+     */
+    const T& front() const {
+        return _storage[_head];
+    }
+
+    /**
+     * @brief Entry by age, zero being the oldest, only valid below size()
+     *
+     */
+    T& operator[](size_t i) {
+        auto index = _head + i;
+        return _storage[(index >= _capacity) ? (index - _capacity) : index];
+    }
+
+    /**
+     * @brief Remove the oldest entry, only valid when not empty
+     *
+     */
+    void pop() {
+        _head = next(_head);
+        _size--;
+    }
+
+    /**
+     * @brief Number of entries dropped since the last call
+     *
+     */
+    uint32_t takeOverflows() {
+        auto overflows = _overflows;
+        _overflows = 0;
+        return overflows;
+    }
+
+private:
+    size_t next(size_t i) const {
+        return ((i + 1) >= _capacity) ? 0 : (i + 1);
+    }
+
+    T* _storage;
+    size_t _capacity;
+    size_t _head {0};
+    size_t _size {0};
+    uint32_t _overflows {0};
+};
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "Particle.h"
+#include "mcp_can.h"
+#include "CanTransport.h"
+
+
+/**
+ * @brief Transport over the MCP25625 CAN controller using the mcp_can library
+ *
+ * @details The controller interrupt line wakes the waiting thread, so frames are picked up as
+ *          soon as they arrive without polling the controller over SPI.
+ */
+class McpCanTransport : public CanTransport {
+public:
+    static constexpr uint8_t CLOCK          {MCP_20MHZ};
+
+    McpCanTransport(MCP_CAN& controller, pin_t interruptPin)
+        : _can(controller), _interruptPin(interruptPin) {}
+
+    bool begin(uint32_t bitrate, bool listenOnly, const CanFilterPlan& plan) override {
+        uint8_t speed;
+        switch (bitrate) {
+            case 125000:    speed = CAN_125KBPS;    break;
+            case 250000:    speed = CAN_250KBPS;    break;
+            case 500000:    speed = CAN_500KBPS;    break;
+            case 1000000:   speed = CAN_1000KBPS;   break;
+            default:        return false;
+        }
+
+        if (nullptr == _semaphore) {
+            os_semaphore_create(&_semaphore, 1, 0);
+            pinMode(_interruptPin, INPUT_PULLUP);
+            attachInterrupt(_interruptPin, &McpCanTransport::onInterrupt, this, FALLING);
+        }
+        if (CAN_OK != _can.begin(MCP_STDEXT, speed, CLOCK)) {
+            return false;
+        }
+
+        // Masks are written in the extended layout, which leaves the data byte filters of standard frames open
+        _can.init_Mask(0, 1, plan.masks[0]);
+        _can.init_Mask(1, 1, plan.masks[1]);
+        for (size_t i = 0; i < CanFilterPlan::FILTERS; i++) {
+            auto& filter = plan.filters[i];
+            _can.init_Filt(i, (filter.extended) ? 1 : 0, (filter.extended) ? filter.id : ((filter.id >> 18) << 16));
+        }
+        _listenOnly = listenOnly;
+        return (MCP2515_OK == _can.setMode((listenOnly) ? MCP_LISTENONLY : MCP_NORMAL));
+    }
+
+    void wait(uint32_t timeoutMs) override {
+        // The interrupt line stays low while frames are waiting
+        if (digitalRead(_interruptPin)) {
+            os_semaphore_take(_semaphore, timeoutMs, false);
+        }
+    }
+
+    bool receive(CanFrame& frame) override {
+        if (CAN_MSGAVAIL != _can.checkReceive()) {
+            return false;
+        }
+
+        INT32U id;
+        INT8U extended, length;
+        if (CAN_OK != _can.readMsgBuf(&id, &extended, &length, frame.data)) {
+            return false;
+        }
+        frame.id = id & 0x1fffffff;
+        frame.extended = (0 != extended);
+        frame.length = (length > 8) ? 8 : length;
+        return true;
+    }
+
+    bool send(const CanFrame& frame) override {
+        if (_listenOnly) {
+            return false;
+        }
+        return (CAN_OK == _can.sendMsgBuf(frame.id, (frame.extended) ? 1 : 0, frame.length, (INT8U*)frame.data));
+    }
+
+    uint32_t takeOverruns() override {
+        return takeOverruns(_can, 0);
+    }
+
+private:
+    void onInterrupt() {
+        os_semaphore_give(_semaphore, false);
+    }
+
+    // Only library versions that can clear the overflow flags report overruns
+    template <typename Controller>
+    static auto takeOverruns(Controller& controller, int) -> decltype(controller.clearRXnOVR(), uint32_t()) {
+        auto flags = controller.getError();
+        uint32_t overruns = ((flags & MCP_EFLG_RX0OVR) ? 1 : 0) + ((flags & MCP_EFLG_RX1OVR) ? 1 : 0);
+        if (overruns) {
+            controller.clearRXnOVR();
+        }
+        return overruns;
+    }
+
+    template <typename Controller>
+    static uint32_t takeOverruns(Controller& controller, long) {
+        return 0;
+    }
+
+    MCP_CAN& _can;
+    pin_t _interruptPin;
+    os_semaphore_t _semaphore {nullptr};
+    bool _listenOnly {false};
+};
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "ModbusDecode.h"
+
+#include <cstring>
+
+
+void modbusDeriveSign(ModbusDecoding& decoding) {
+    auto bits = (uint32_t)(decoding.mask >> decoding.shift);
+    if (bits < 2) {
+        // The number doesn't have enough bits to represent a negative number
+        decoding.negativeTest = 0;
+        decoding.signExtend = 0;
+        return;
+    }
+
+    auto top = 31 - __builtin_clz((unsigned int)bits);
+    decoding.negativeTest = 1UL << top;
+    decoding.signExtend = UINT32_MAX << top;
+}
+
+uint64_t modbusJoinWords(const uint16_t* words, size_t count, ModbusByteOrder order) {
+    auto reverse = (ModbusByteOrder::CDAB == order) || (ModbusByteOrder::DCBA == order);
+    auto swap = (ModbusByteOrder::BADC == order) || (ModbusByteOrder::DCBA == order);
+
+    uint64_t joined = 0;
+    for (size_t i = 0; i < count; i++) {
+        auto word = words[(reverse) ? (count - 1 - i) : i];
+        if (swap) {
+            word = (uint16_t)((word << 8) | (word >> 8));
+        }
+        joined = (joined << 16) | word;
+    }
+    return joined;
+}
+
+bool modbusDecodeUint16(const uint16_t* words, const ModbusDecoding& decoding, double& value) {
+    value = (double)((uint32_t)(words[0] & decoding.mask) >> decoding.shift);
+    return true;
+}
+
+bool modbusDecodeInt16(const uint16_t* words, const ModbusDecoding& decoding, double& value) {
+    auto raw = (uint32_t)(words[0] & decoding.mask) >> decoding.shift;
+    if (raw & decoding.negativeTest) {
+        raw |= decoding.signExtend;
+    }
+    value = (double)(int32_t)raw;
+    return true;
+}
+
+bool modbusDecodeUint32(const uint16_t* words, const ModbusDecoding& decoding, double& value) {
+    value = (double)(uint32_t)modbusJoinWords(words, 2, decoding.order);
+    return true;
+}
+
+bool modbusDecodeInt32(const uint16_t* words, const ModbusDecoding& decoding, double& value) {
+    value = (double)(int32_t)(uint32_t)modbusJoinWords(words, 2, decoding.order);
+    return true;
+}
+
+bool modbusDecodeFloat32(const uint16_t* words, const ModbusDecoding& decoding, double& value) {
+    auto raw = (uint32_t)modbusJoinWords(words, 2, decoding.order);
+    float number;
+    memcpy(&number, &raw, sizeof(number));
+    value = (double)number;
+    return true;
+}
+
+bool modbusDecodeUint64(const uint16_t* words, const ModbusDecoding& decoding, double& value) {
+    value = (double)modbusJoinWords(words, 4, decoding.order);
+    return true;
+}
+
+bool modbusDecodeInt64(const uint16_t* words, const ModbusDecoding& decoding, double& value) {
+    value = (double)(int64_t)modbusJoinWords(words, 4, decoding.order);
+    return true;
+}
+
+bool modbusDecodeFloat64(const uint16_t* words, const ModbusDecoding& decoding, double& value) {
+    auto raw = modbusJoinWords(words, 4, decoding.order);
+    memcpy(&value, &raw, sizeof(value));
+    return true;
+}
+
+/**
+ * @brief Convert packed BCD digits, most significant first
+ *
+ */
+static bool modbusBcdToValue(uint32_t raw, size_t digits, double& value) {
+    uint32_t number = 0;
+    for (size_t i = 0; i < digits; i++) {
+        auto digit = (raw >> (4 * (digits - 1 - i))) & 0xf;
+        if (digit > 9) {
+            return false;
+        }
+        number = number * 10 + digit;
+    }
+    value = (double)number;
+    return true;
+}
+
+bool modbusDecodeBcd16(const uint16_t* words, const ModbusDecoding& decoding, double& value) {
+    return modbusBcdToValue((uint32_t)(words[0] & decoding.mask) >> decoding.shift, 4, value);
+}
+
+bool modbusDecodeBcd32(const uint16_t* words, const ModbusDecoding& decoding, double& value) {
+    return modbusBcdToValue((uint32_t)modbusJoinWords(words, 2, decoding.order), 8, value);
+}
+
+size_t modbusDecodeText(const uint16_t* words, size_t count, ModbusByteOrder order, char* text, size_t size) {
+    if (0 == size) {
+        return 0;
+    }
+
+    auto lowFirst = (ModbusByteOrder::BADC == order) || (ModbusByteOrder::DCBA == order);
+    size_t length = 0;
+    for (size_t i = 0; (i < 2 * count) && (length + 1 < size); i++) {
+        auto word = words[i / 2];
+        auto high = ((i % 2) == 0) != lowFirst;
+        auto c = (char)((high) ? (word >> 8) : (word & 0xff));
+        if ('\0' == c) {
+            break;
+        }
+        text[length++] = ((c >= ' ') && (c <= '~')) ? c : '?';
+    }
+    while ((length > 0) && (' ' == text[length - 1])) {
+        length--;
+    }
+    text[length] = '\0';
+
+    return length;
+}
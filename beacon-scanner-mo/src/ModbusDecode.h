@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief Order of the bytes of a multi-register value as they arrive on the wire
+ *
+ * @details Letters name the bytes of the value from most to least significant.  ABCD is
+ *          big endian throughout, BADC swaps the bytes of each register, CDAB reverses the
+ *          order of the registers and DCBA reverses both.  The same rule applies to 64-bit
+ *          values, so CDAB reads GHEFCDAB.
+ */
+enum class ModbusByteOrder : uint8_t {
+    ABCD,
+    BADC,
+    CDAB,
+    DCBA,
+};
+
+/**
+ * @brief Decode settings of a point, fixed when the point is configured
+ *
+ */
+struct ModbusDecoding {
+    uint16_t mask                   {UINT16_MAX};   ///< Applied to 16-bit values before the shift
+    uint8_t shift                   {0};
+    ModbusByteOrder order           {ModbusByteOrder::ABCD};
+    uint32_t negativeTest           {0x8000};       ///< Sign bit of a masked and shifted 16-bit value
+    uint32_t signExtend             {0};            ///< Bits set in a negative masked and shifted 16-bit value
+};
+
+/**
+ * @brief Decode one value starting at the given register
+ *
+ * @param words Registers, or bits packed from bit zero for coil and discrete reads
+ * @param decoding Decode settings of the point
+ * @param value Decoded value before scaling
+ * @return true Value decoded
+ * @return false Registers do not hold a valid value
+ */
+using ModbusDecoder = bool (*)(const uint16_t* words, const ModbusDecoding& decoding, double& value);
+
+/**
+ * @brief Fill in the sign test and extension of a masked and shifted signed 16-bit value
+ *
+ * @param decoding Decode settings with the mask and shift filled in
+ */
+void modbusDeriveSign(ModbusDecoding& decoding);
+
+/**
+ * @brief Join registers into an integer, the first register in the byte order being the most significant
+ *
+ * @param words Registers
+ * @param count Number of registers, up to four
+ * @param order Byte order
+ * @return uint64_t Joined value
+ */
+uint64_t modbusJoinWords(const uint16_t* words, size_t count, ModbusByteOrder order);
+
+bool modbusDecodeUint16(const uint16_t* words, const ModbusDecoding& decoding, double& value);
+bool modbusDecodeInt16(const uint16_t* words, const ModbusDecoding& decoding, double& value);
+bool modbusDecodeUint32(const uint16_t* words, const ModbusDecoding& decoding, double& value);
+bool modbusDecodeInt32(const uint16_t* words, const ModbusDecoding& decoding, double& value);
+bool modbusDecodeFloat32(const uint16_t* words, const ModbusDecoding& decoding, double& value);
+bool modbusDecodeUint64(const uint16_t* words, const ModbusDecoding& decoding, double& value);
+bool modbusDecodeInt64(const uint16_t* words, const ModbusDecoding& decoding, double& value);
+bool modbusDecodeFloat64(const uint16_t* words, const ModbusDecoding& decoding, double& value);
+
+/**
+ * @brief Decode packed BCD, four digits to a register, failing on any digit above nine
+ *
+ */
+bool modbusDecodeBcd16(const uint16_t* words, const ModbusDecoding& decoding, double& value);
+bool modbusDecodeBcd32(const uint16_t* words, const ModbusDecoding& decoding, double& value);
+
+/**
+ * @brief Decode an ASCII string packed two characters to a register
+ *
+ * @details The string ends at the first NUL and trailing spaces are removed.  Characters
+ *          outside of printable ASCII are replaced with '?'.  The byte order decides which
+ *          byte of each register comes first, BADC and DCBA putting the low byte first.
+ *
+ * @param words Registers
+ * @param count Number of registers
+ * @param order Byte order
+ * @param text Output buffer, always terminated
+ * @param size Size of the output buffer
+ * @return size_t Length of the string
+ */
+size_t modbusDecodeText(const uint16_t* words, size_t count, ModbusByteOrder order, char* text, size_t size);
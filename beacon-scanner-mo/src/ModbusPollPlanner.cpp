@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ModbusPollPlanner.h"
+
+
+static bool requestBefore(const ModbusPollRequest& a, const ModbusPollRequest& b) {
+    if (a.id != b.id) {
+        return a.id < b.id;
+    }
+    if (a.function != b.function) {
+        return a.function < b.function;
+    }
+    return a.address < b.address;
+}
+
+size_t modbusPlanPoll(ModbusPollRequest* requests, size_t count, int gap,
+    uint16_t maxRegisters, uint16_t maxBits, ModbusPollBlock* blocks, size_t maxBlocks) {
+
+    // Insertion sort, the request list is short and usually close to sorted already
+    for (size_t i = 1; i < count; i++) {
+        auto request = requests[i];
+        auto j = i;
+        while ((j > 0) && requestBefore(request, requests[j - 1])) {
+            requests[j] = requests[j - 1];
+            j--;
+        }
+        requests[j] = request;
+    }
+
+    size_t blockCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        auto& request = requests[i];
+        uint32_t requestEnd = (uint32_t)request.address + request.length;
+
+        if (blockCount && (gap >= 0)) {
+            auto& block = blocks[blockCount - 1];
+            uint32_t blockEnd = (uint32_t)block.address + block.length;
+            auto limit = (block.bits) ? maxBits : maxRegisters;
+            auto mergedEnd = (requestEnd > blockEnd) ? requestEnd : blockEnd;
+
+            if ((block.id == request.id) && (block.function == request.function) &&
+                ((uint32_t)request.address <= (blockEnd + (uint32_t)gap)) &&
+                ((mergedEnd - block.address) <= limit)) {
+                block.length = (uint16_t)(mergedEnd - block.address);
+                block.count++;
+                continue;
+            }
+        }
+
+        if (blockCount >= maxBlocks) {
+            break;
+        }
+        blocks[blockCount++] = {request.id, request.function, request.bits, request.address, request.length, i, 1};
+    }
+
+    return blockCount;
+}
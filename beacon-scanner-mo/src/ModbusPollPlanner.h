@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief One register or bit range that is due to be read
+ *
+ */
+struct ModbusPollRequest {
+    uint8_t id;                             ///< Slave ID
+    uint8_t function;                       ///< Read function, requests only merge with the same function
+    bool bits;                              ///< Coil or discrete input function, length counts bits
+    uint16_t address;                       ///< First register or bit
+    uint16_t length;                        ///< Number of registers or bits
+    uint16_t tag;                           ///< Caller index for fanning results back out
+};
+
+/**
+ * @brief One read transaction covering one or more requests
+ *
+ */
+struct ModbusPollBlock {
+    uint8_t id;
+    uint8_t function;
+    bool bits;
+    uint16_t address;
+    uint16_t length;
+    size_t first;                           ///< Index of the first request covered in the sorted request list
+    size_t count;                           ///< Number of requests covered
+};
+
+/**
+ * @brief Group due requests by slave and function and merge nearby ranges into block reads
+ *
+ * @details Requests are sorted in place by slave, function and address.  Consecutive requests
+ *          are merged while the unrequested span between them is no more than gap and the
+ *          merged length stays within the limit for the function.
+ *
+ * @param requests Requests to plan, reordered on return
+ * @param count Number of requests
+ * @param gap Largest span of unrequested registers or bits bridged by a merge, negative disables merging
+ * @param maxRegisters Longest register read allowed
+ * @param maxBits Longest coil or discrete input read allowed
+ * @param blocks Output block list
+ * @param maxBlocks Size of the block list
+ * @return size_t Number of blocks planned
+ */
+size_t modbusPlanPoll(ModbusPollRequest* requests, size_t count, int gap,
+    uint16_t maxRegisters, uint16_t maxBits, ModbusPollBlock* blocks, size_t maxBlocks);
+
+/**
+ * @brief Number of RTU characters exchanged by one read transaction
+ *
+ * @param bits Coil or discrete input function
+ * @param length Number of registers or bits read
+ * @return uint32_t Request plus response characters
+ */
+inline uint32_t modbusReadFrameChars(bool bits, uint16_t length) {
+    // Request is address, function, start, quantity and CRC.  Response is address, function, byte count, data and CRC.
+    auto dataBytes = (bits) ? (((uint32_t)length + 7) / 8) : ((uint32_t)length * 2);
+    return 8 + 5 + dataBytes;
+}
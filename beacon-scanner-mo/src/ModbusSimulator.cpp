@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "ModbusSimulator.h"
+
+
+bool ModbusSimulator::addSlave(uint8_t id, uint32_t turnaroundUs, uint32_t jitterUs) {
+    auto slave = findSlave(id);
+    if (!slave) {
+        if (_slaveCount >= SLAVE_COUNT) {
+            return false;
+        }
+        slave = &_slaves[_slaveCount++];
+        *slave = {};
+    }
+    slave->id = id;
+    slave->turnaroundUs = turnaroundUs;
+    slave->jitterUs = jitterUs;
+
+    return true;
+}
+
+bool ModbusSimulator::map(uint8_t id, Table table, uint16_t first, uint16_t count, uint16_t* values) {
+    if ((_mapCount >= MAP_COUNT) || (nullptr == values) || (0 == count)) {
+        return false;
+    }
+    _maps[_mapCount++] = {id, table, first, count, values};
+
+    return true;
+}
+
+void ModbusSimulator::setFaults(uint8_t id, const Faults& faults) {
+    auto slave = findSlave(id);
+    if (slave) {
+        slave->faults = faults;
+    }
+}
+
+void ModbusSimulator::configure(uint32_t baud, uint32_t parity) {
+    if (0 == baud) {
+        return;
+    }
+    _baud = baud;
+    _parity = parity;
+    auto charBits = (SERIAL_PARITY_NO == parity) ? 10UL : 11UL;
+    _charUs = charBits * 1000000UL / baud;
+    _silentUs = (baud > 19200) ? 1750UL : (_charUs * 7 / 2);
+}
+
+ModbusSimulator::Slave* ModbusSimulator::findSlave(uint8_t id) {
+    for (size_t i = 0; i < _slaveCount; i++) {
+        if (_slaves[i].id == id) {
+            return &_slaves[i];
+        }
+    }
+    return nullptr;
+}
+
+uint16_t* ModbusSimulator::findValue(uint8_t id, Table table, uint16_t address) {
+    for (size_t i = 0; i < _mapCount; i++) {
+        auto& mapping = _maps[i];
+        if ((mapping.id == id) && (mapping.table == table) && (address >= mapping.first) &&
+            ((uint32_t)address < ((uint32_t)mapping.first + mapping.count))) {
+            return &mapping.values[address - mapping.first];
+        }
+    }
+    return nullptr;
+}
+
+bool ModbusSimulator::chance(float probability) {
+    if (probability <= 0.0f) {
+        return false;
+    }
+
+    // xorshift32
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+    return ((float)_random / 4294967296.0f) < probability;
+}
+
+uint8_t ModbusSimulator::transact(uint8_t id, size_t requestChars, size_t responseChars) {
+    _transactions++;
+
+    auto requestUs = requestChars * _charUs + _silentUs;
+    auto slave = findSlave(id);
+    auto garbled = (0 != _lineBaud) && ((_lineBaud != _baud) || (_lineParity != _parity));
+    if (!slave || garbled || chance(slave->faults.timeout)) {
+        auto waitUs = requestUs + _timeoutMs * 1000;
+        _busUs += waitUs;
+        if (_sleep) {
+            _sleep(waitUs);
+        }
+        else {
+            delayMicroseconds(waitUs);
+        }
+        return ModbusClient::ku8MBResponseTimedOut;
+    }
+
+    auto turnaroundUs = slave->turnaroundUs;
+    if (slave->jitterUs) {
+        chance(1.0f);
+        turnaroundUs += _random % (slave->jitterUs + 1);
+    }
+
+    auto exception = chance(slave->faults.exception);
+    // The silent interval after the response is left to the master, which waits it out before the next request
+    auto waitUs = requestUs + turnaroundUs + ((exception) ? 5 : responseChars) * _charUs;
+    _busUs += waitUs;
+    if (_sleep) {
+        _sleep(waitUs);
+    }
+    else {
+        delayMicroseconds(waitUs);
+    }
+
+    if (exception) {
+        return ModbusClient::ku8MBSlaveDeviceFailure;
+    }
+    if (chance(slave->faults.crc)) {
+        return ModbusClient::ku8MBInvalidCRC;
+    }
+    return ModbusClient::ku8MBSuccess;
+}
+
+uint8_t ModbusSimulator::read(uint8_t id, Table table, uint16_t address, uint16_t count, ModbusClientContext& context) {
+    auto bits = (Table::Coils == table) || (Table::DiscreteInputs == table);
+    auto capacity = sizeof(context.readBuffer) / sizeof(context.readBuffer[0]);
+    auto words = (size_t)((bits) ? ((count + 15) / 16) : count);
+    auto dataChars = (size_t)((bits) ? ((count + 7) / 8) : (2 * count));
+    if ((0 == count) || (words > capacity)) {
+        return ModbusClient::ku8MBIllegalDataValue;
+    }
+
+    auto result = transact(id, 8, 5 + dataChars);
+    if (ModbusClient::ku8MBSuccess != result) {
+        return result;
+    }
+
+    // Bits are packed 16 to a word starting at the least significant bit of the first word
+    memset(context.readBuffer, 0, sizeof(context.readBuffer));
+    for (size_t i = 0; i < count; i++) {
+        auto location = findValue(id, table, (uint16_t)(address + i));
+        if (!location && !_generator) {
+            return ModbusClient::ku8MBIllegalDataAddress;
+        }
+        auto value = (location) ? *location : _generator(id, table, (uint16_t)(address + i));
+        if (bits) {
+            context.readBuffer[i / 16] |= (value) ? (uint16_t)(1U << (i % 16)) : 0;
+        }
+        else {
+            context.readBuffer[i] = value;
+        }
+    }
+    return ModbusClient::ku8MBSuccess;
+}
+
+uint8_t ModbusSimulator::write(uint8_t id, Table table, uint16_t address, uint16_t count, const uint16_t* values, bool packed, size_t requestChars) {
+    auto result = transact(id, requestChars, 8);
+    if (ModbusClient::ku8MBSuccess != result) {
+        return result;
+    }
+
+    // Writes to generated addresses are accepted and forgotten
+    for (size_t i = 0; !_generator && (i < count); i++) {
+        if (!findValue(id, table, (uint16_t)(address + i))) {
+            return ModbusClient::ku8MBIllegalDataAddress;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        auto location = findValue(id, table, (uint16_t)(address + i));
+        if (location) {
+            *location = (packed) ? ((values[i / 16] >> (i % 16)) & 1) : values[i];
+        }
+    }
+    return ModbusClient::ku8MBSuccess;
+}
+
+uint8_t ModbusSimulator::writeSingleCoil(uint8_t id, uint16_t address, uint8_t state, ModbusClientContext& context) {
+    uint16_t value = (state) ? 1 : 0;
+    return write(id, Table::Coils, address, 1, &value, false, 8);
+}
+
+uint8_t ModbusSimulator::writeSingleRegister(uint8_t id, uint16_t address, uint16_t value, ModbusClientContext& context) {
+    return write(id, Table::HoldingRegisters, address, 1, &value, false, 8);
+}
+
+uint8_t ModbusSimulator::writeMultipleCoils(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) {
+    auto capacity = 16 * sizeof(context.writeBuffer) / sizeof(context.writeBuffer[0]);
+    if ((0 == count) || (count > capacity)) {
+        return ModbusClient::ku8MBIllegalDataValue;
+    }
+    return write(id, Table::Coils, address, count, context.writeBuffer, true, 9 + (count + 7) / 8);
+}
+
+uint8_t ModbusSimulator::writeMultipleRegisters(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) {
+    if ((0 == count) || (count > (sizeof(context.writeBuffer) / sizeof(context.writeBuffer[0])))) {
+        return ModbusClient::ku8MBIllegalDataValue;
+    }
+    return write(id, Table::HoldingRegisters, address, count, context.writeBuffer, false, 9 + 2 * (size_t)count);
+}
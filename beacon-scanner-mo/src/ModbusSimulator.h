@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "ModbusTransport.h"
+
+
+/**
+ * @brief In-process Modbus RTU slaves for exercising the polling engine without hardware
+ *
+ * @details Each simulated slave answers from registers mapped onto caller supplied storage,
+ *          falling back to an optional generator for addresses outside every mapping.  A
+ *          transaction takes as long as its request and response frames at the configured
+ *          line settings plus the slave turnaround, so bus timing behaves as on a real line.
+ *          Faults are injected at random with per slave probabilities.  Unknown slaves and
+ *          requests sent at the wrong line settings time out, and unmapped addresses return an
+ *          illegal data address exception.
+ */
+class ModbusSimulator : public ModbusTransport {
+public:
+    static constexpr size_t SLAVE_COUNT     {8};
+    static constexpr size_t MAP_COUNT       {16};
+
+    enum class Table : uint8_t {
+        Coils,
+        DiscreteInputs,
+        InputRegisters,
+        HoldingRegisters,
+    };
+
+    struct Faults {
+        float timeout                       {0.0f};     ///< Probability a request goes unanswered
+        float crc                           {0.0f};     ///< Probability a response is corrupted
+        float exception                     {0.0f};     ///< Probability of a slave device failure exception
+    };
+
+    /**
+     * @brief Produces the value of an address outside every mapping
+     *
+     * @param id Slave ID
+     * @param table Table read
+     * @param address Register or bit address
+     * @return uint16_t Register value, or zero and one for bits
+     */
+    using Generator = uint16_t (*)(uint8_t id, Table table, uint16_t address);
+
+    /**
+     * @brief Waits while a transaction is on the bus
+     *
+     * @param us Microseconds
+     */
+    using Sleep = void (*)(uint32_t us);
+
+    /**
+     * @brief Add a slave
+     *
+     * @param id Slave ID
+     * @param turnaroundUs Time the slave takes to start answering
+     * @param jitterUs Largest random addition to the turnaround
+     * @return true Slave added
+     * @return false No room for another slave
+     */
+    bool addSlave(uint8_t id, uint32_t turnaroundUs, uint32_t jitterUs = 0);
+
+    /**
+     * @brief Map a range of a slave table onto storage
+     *
+     * @param id Slave ID
+     * @param table Table to map
+     * @param first First address
+     * @param count Number of addresses
+     * @param values Storage, one entry per address, bits hold zero or one
+     * @return true Range mapped
+     * @return false No room for another mapping
+     */
+    bool map(uint8_t id, Table table, uint16_t first, uint16_t count, uint16_t* values);
+
+    /**
+     * @brief Answer every address of the slave tables outside the mappings from a generator
+     *
+     * @param generator Generator, nullptr to answer with an exception
+     */
+    void setGenerator(Generator generator) {
+        _generator = generator;
+    }
+
+    /**
+     * @brief Set the fault probabilities of a slave
+     *
+     */
+    void setFaults(uint8_t id, const Faults& faults);
+
+    /**
+     * @brief Replace the wait used to model bus time, delayMicroseconds() by default
+     *
+     */
+    void setSleep(Sleep sleep) {
+        _sleep = sleep;
+    }
+
+    /**
+     * @brief Line settings the slaves listen at, requests sent with any other settings time out
+     *
+     * @param baud Baud rate, zero for slaves that understand any settings
+     * @param parity Parity, SERIAL_PARITY_NO or SERIAL_PARITY_EVEN
+     */
+    void setLine(uint32_t baud, uint32_t parity) {
+        _lineBaud = baud;
+        _lineParity = parity;
+    }
+
+    void setSeed(uint32_t seed) {
+        _random = (seed) ? seed : 1;
+    }
+
+    /**
+     * @brief Number of transactions attempted since construction
+     *
+     */
+    uint32_t getTransactions() const {
+        return _transactions;
+    }
+
+    /**
+     * @brief Bus time of all transactions since construction in microseconds
+     *
+     */
+    uint64_t getBusUs() const {
+        return _busUs;
+    }
+
+    void configure(uint32_t baud, uint32_t parity) override;
+
+    void setResponseTimeout(uint32_t timeout) override {
+        _timeoutMs = timeout;
+    }
+
+    uint8_t readCoils(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) override {
+        return read(id, Table::Coils, address, count, context);
+    }
+
+    uint8_t readDiscreteInputs(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) override {
+        return read(id, Table::DiscreteInputs, address, count, context);
+    }
+
+    uint8_t readInputRegisters(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) override {
+        return read(id, Table::InputRegisters, address, count, context);
+    }
+
+    uint8_t readHoldingRegisters(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) override {
+        return read(id, Table::HoldingRegisters, address, count, context);
+    }
+
+    uint8_t writeSingleCoil(uint8_t id, uint16_t address, uint8_t state, ModbusClientContext& context) override;
+    uint8_t writeSingleRegister(uint8_t id, uint16_t address, uint16_t value, ModbusClientContext& context) override;
+    uint8_t writeMultipleCoils(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) override;
+    uint8_t writeMultipleRegisters(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) override;
+
+private:
+    struct Slave {
+        uint8_t id;
+        uint32_t turnaroundUs;
+        uint32_t jitterUs;
+        Faults faults;
+    };
+
+    struct Mapping {
+        uint8_t id;
+        Table table;
+        uint16_t first;
+        uint16_t count;
+        uint16_t* values;
+    };
+
+    Slave* findSlave(uint8_t id);
+    uint16_t* findValue(uint8_t id, Table table, uint16_t address);
+    bool chance(float probability);
+
+    /**
+     * @brief Run the common part of a transaction, returning a failure code or success
+     *
+     * @param id Slave ID
+     * @param requestChars Request frame length
+     * @param responseChars Response frame length
+     */
+    uint8_t transact(uint8_t id, size_t requestChars, size_t responseChars);
+    uint8_t read(uint8_t id, Table table, uint16_t address, uint16_t count, ModbusClientContext& context);
+    uint8_t write(uint8_t id, Table table, uint16_t address, uint16_t count, const uint16_t* values, bool packed, size_t requestChars);
+
+    Slave _slaves[SLAVE_COUNT] {};
+    size_t _slaveCount {0};
+    Mapping _maps[MAP_COUNT] {};
+    size_t _mapCount {0};
+    Generator _generator {nullptr};
+    Sleep _sleep {nullptr};
+    uint32_t _charUs {260};                     // 10 bit characters at 38400 baud
+    uint32_t _silentUs {1750};
+    uint32_t _baud {38400};
+    uint32_t _parity {SERIAL_PARITY_NO};
+    uint32_t _lineBaud {0};
+    uint32_t _lineParity {SERIAL_PARITY_NO};
+    uint32_t _timeoutMs {2000};
+    uint32_t _random {1};
+    uint32_t _transactions {0};
+    uint64_t _busUs {0};
+};
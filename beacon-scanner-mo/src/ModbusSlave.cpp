@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "ModbusSlave.h"
+
+
+uint16_t ModbusSlave::crc16(const uint8_t* data, size_t length) {
+    uint16_t crc = 0xffff;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xa001) : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+void ModbusSlave::service(Stream& stream, uint32_t gapUs) {
+    while (stream.available() > 0) {
+        auto c = stream.read();
+        if (c < 0) {
+            break;
+        }
+        if (_length < FRAME_SIZE) {
+            _frame[_length++] = (uint8_t)c;
+        }
+        else {
+            _overrun = true;
+        }
+        _lastUs = micros();
+    }
+
+    if ((0 == _length) || ((micros() - _lastUs) < gapUs)) {
+        return;
+    }
+    if (_overrun) {
+        _stats.overruns++;
+    }
+    else {
+        handleFrame(stream);
+    }
+    reset();
+}
+
+void ModbusSlave::handleFrame(Stream& stream) {
+    if (_length < 4) {
+        return;
+    }
+    auto crc = crc16(_frame, _length - 2);
+    if ((_frame[_length - 2] != (uint8_t)crc) || (_frame[_length - 1] != (uint8_t)(crc >> 8))) {
+        _stats.crcErrors++;
+        return;
+    }
+    // Broadcasts never get an answer and reads make no sense as broadcasts
+    if (_frame[0] != _id) {
+        return;
+    }
+    _stats.requests++;
+
+    auto function = _frame[1];
+    if ((0x03 != function) && (0x04 != function)) {
+        replyException(stream, function, ILLEGAL_FUNCTION);
+        return;
+    }
+    if (8 != _length) {
+        replyException(stream, function, ILLEGAL_DATA_VALUE);
+        return;
+    }
+
+    auto address = (uint16_t)((_frame[2] << 8) | _frame[3]);
+    auto count = (uint16_t)((_frame[4] << 8) | _frame[5]);
+    if ((0 == count) || (count > READ_LIMIT)) {
+        replyException(stream, function, ILLEGAL_DATA_VALUE);
+        return;
+    }
+    if ((uint32_t)address + count > 0x10000) {
+        replyException(stream, function, ILLEGAL_DATA_ADDRESS);
+        return;
+    }
+
+    auto code = _reader(function, address, count, _values);
+    if (code) {
+        replyException(stream, function, code);
+        return;
+    }
+
+    _frame[2] = (uint8_t)(2 * count);
+    for (size_t i = 0; i < count; i++) {
+        _frame[3 + 2 * i] = (uint8_t)(_values[i] >> 8);
+        _frame[4 + 2 * i] = (uint8_t)_values[i];
+    }
+    reply(stream, 3 + 2 * (size_t)count);
+}
+
+void ModbusSlave::replyException(Stream& stream, uint8_t function, uint8_t code) {
+    _stats.exceptions++;
+    _frame[1] = function | 0x80;
+    _frame[2] = code;
+    reply(stream, 3);
+}
+
+void ModbusSlave::reply(Stream& stream, size_t length) {
+    auto crc = crc16(_frame, length);
+    _frame[length++] = (uint8_t)crc;
+    _frame[length++] = (uint8_t)(crc >> 8);
+
+    if (_direction) {
+        _direction(true);
+    }
+    stream.write(_frame, length);
+    stream.flush();
+    if (_direction) {
+        _direction(false);
+    }
+}
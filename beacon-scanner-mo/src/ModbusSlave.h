@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "Particle.h"
+
+
+/**
+ * @brief Modbus RTU slave answering register reads on a serial stream
+ *
+ * @details Received characters are collected until the line has been silent for the frame
+ *          gap, then the frame is checked and answered.  Read holding registers (0x03) and
+ *          read input registers (0x04) are served through a reader callback, every other
+ *          function gets an illegal function exception.  Frames for other slave IDs and
+ *          broadcasts are ignored so that the slave can share a bus.
+ */
+class ModbusSlave {
+public:
+    static constexpr size_t FRAME_SIZE          {256};
+    static constexpr uint16_t READ_LIMIT        {125};      // Registers in the largest read response
+
+    static constexpr uint8_t ILLEGAL_FUNCTION       {0x01};
+    static constexpr uint8_t ILLEGAL_DATA_ADDRESS   {0x02};
+    static constexpr uint8_t ILLEGAL_DATA_VALUE     {0x03};
+    static constexpr uint8_t SLAVE_DEVICE_BUSY      {0x06};
+
+    /**
+     * @brief Supplies the registers for a read request
+     *
+     * @param function Modbus function code
+     * @param address First register
+     * @param count Number of registers, 1 to READ_LIMIT
+     * @param values Output, count entries
+     * @return uint8_t Zero on success, otherwise the exception code to answer with
+     */
+    using Reader = uint8_t (*)(uint8_t function, uint16_t address, uint16_t count, uint16_t* values);
+
+    /**
+     * @brief Switches an RS-485 transceiver between receive and transmit
+     *
+     * @param transmit True to drive the line
+     */
+    using Direction = void (*)(bool transmit);
+
+    struct Stats {
+        uint32_t requests;                      ///< Valid frames addressed to this slave
+        uint32_t exceptions;                    ///< Requests answered with an exception
+        uint32_t crcErrors;
+        uint32_t overruns;                      ///< Frames longer than FRAME_SIZE
+    };
+
+    ModbusSlave(Reader reader, Direction direction = nullptr)
+        : _reader(reader), _direction(direction) {}
+
+    void setId(uint8_t id) {
+        _id = id;
+    }
+
+    /**
+     * @brief Take the received characters and answer a frame once the line goes quiet
+     *
+     * @param stream Serial stream the requests arrive on
+     * @param gapUs Silence that ends a frame
+     */
+    void service(Stream& stream, uint32_t gapUs);
+
+    /**
+     * @brief Drop a partially received frame
+     *
+     */
+    void reset() {
+        _length = 0;
+        _overrun = false;
+    }
+
+    const Stats& getStats() const {
+        return _stats;
+    }
+
+    /**
+     * @brief Modbus CRC-16, sent low byte first
+     *
+     */
+    static uint16_t crc16(const uint8_t* data, size_t length);
+
+private:
+    void handleFrame(Stream& stream);
+    void reply(Stream& stream, size_t length);
+    void replyException(Stream& stream, uint8_t function, uint8_t code);
+
+    Reader _reader;
+    Direction _direction;
+    uint8_t _id {1};
+    uint8_t _frame[FRAME_SIZE] {};
+    uint16_t _values[READ_LIMIT] {};
+    size_t _length {0};
+    bool _overrun {false};
+    uint32_t _lastUs {0};
+    Stats _stats {};
+};
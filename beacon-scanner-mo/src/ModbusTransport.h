@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "Particle.h"
+#include "ModbusClient.h"
+
+
+/**
+ * @brief Bus the polling engine issues Modbus transactions on
+ *
+ * @details Every call is one complete transaction.  Responses land in the context read buffer
+ *          and multiple writes take their values from the context write buffer, as with
+ *          ModbusClient.  Return values are ModbusClient result codes.
+ */
+class ModbusTransport {
+public:
+    virtual ~ModbusTransport() = default;
+
+    /**
+     * @brief Apply serial line settings
+     *
+     * @param baud Baud rate
+     * @param parity SERIAL_PARITY_NO or SERIAL_PARITY_EVEN
+     */
+    virtual void configure(uint32_t baud, uint32_t parity) = 0;
+
+    /**
+     * @brief Set the longest wait for a response, ignored by transports with a fixed timeout
+     *
+     * @param timeout Milliseconds
+     */
+    virtual void setResponseTimeout(uint32_t timeout) {}
+
+    virtual uint8_t readCoils(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) = 0;
+    virtual uint8_t readDiscreteInputs(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) = 0;
+    virtual uint8_t readInputRegisters(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) = 0;
+    virtual uint8_t readHoldingRegisters(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) = 0;
+    virtual uint8_t writeSingleCoil(uint8_t id, uint16_t address, uint8_t state, ModbusClientContext& context) = 0;
+    virtual uint8_t writeSingleRegister(uint8_t id, uint16_t address, uint16_t value, ModbusClientContext& context) = 0;
+    virtual uint8_t writeMultipleCoils(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) = 0;
+    virtual uint8_t writeMultipleRegisters(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) = 0;
+};
+
+/**
+ * @brief Transport over the RS-485 serial port using ModbusClient
+ *
+ */
+class ModbusClientTransport : public ModbusTransport {
+public:
+    ModbusClientTransport(ModbusClient& client, USARTSerial& serial)
+        : _client(client), _serial(serial) {}
+
+    void configure(uint32_t baud, uint32_t parity) override {
+        _serial.begin(baud, SERIAL_DATA_BITS_8 | SERIAL_STOP_BITS_1 | parity);
+    }
+
+    void setResponseTimeout(uint32_t timeout) override {
+        _client.setResponseTimeout(timeout);
+    }
+
+    uint8_t readCoils(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) override {
+        return _client.readCoils(id, address, count, context);
+    }
+
+    uint8_t readDiscreteInputs(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) override {
+        return _client.readDiscreteInputs(id, address, count, context);
+    }
+
+    uint8_t readInputRegisters(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) override {
+        return _client.readInputRegisters(id, address, count, context);
+    }
+
+    uint8_t readHoldingRegisters(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) override {
+        return _client.readHoldingRegisters(id, address, count, context);
+    }
+
+    uint8_t writeSingleCoil(uint8_t id, uint16_t address, uint8_t state, ModbusClientContext& context) override {
+        return _client.writeSingleCoil(id, address, state, context);
+    }
+
+    uint8_t writeSingleRegister(uint8_t id, uint16_t address, uint16_t value, ModbusClientContext& context) override {
+        return _client.writeSingleRegister(id, address, value, context);
+    }
+
+    uint8_t writeMultipleCoils(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) override {
+        return _client.writeMultipleCoils(id, address, count, context);
+    }
+
+    uint8_t writeMultipleRegisters(uint8_t id, uint16_t address, uint16_t count, ModbusClientContext& context) override {
+        return _client.writeMultipleRegisters(id, address, count, context);
+    }
+
+private:
+    ModbusClient& _client;
+    USARTSerial& _serial;
+};
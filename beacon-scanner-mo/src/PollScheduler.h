@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief Min-heap of poll deadlines
+ *
+ * @details Deadlines are millisecond timestamps compared with wrap around so the scheduler
+ *          keeps working across the 49 day millis() rollover.
+ */
+class PollScheduler {
+public:
+    struct Entry {
+        uint32_t due;                       ///< Millisecond timestamp
+        uint16_t index;                     ///< Caller index
+    };
+
+    /**
+     * @brief Construct a new scheduler over caller supplied storage
+     *
+     * @param storage Heap storage
+     * @param capacity Number of entries the storage can hold
+     */
+    PollScheduler(Entry* storage, size_t capacity)
+        : _heap(storage), _capacity(capacity) {}
+
+    void clear() {
+        _size = 0;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return (0 == _size);
+    }
+
+    /**
+     * @brief Add a deadline
+     *
+     * @param index Caller index
+     * @param due Millisecond timestamp
+     * @return true Deadline added
+     * @return false Scheduler is full
+     */
+    bool push(uint16_t index, uint32_t due) {
+        if (_size >= _capacity) {
+            return false;
+        }
+
+        auto i = _size++;
+        while (i > 0) {
+            auto parent = (i - 1) / 2;
+            if (!before(due, _heap[parent].due)) {
+                break;
+            }
+            _heap[i] = _heap[parent];
+            i = parent;
+        }
+        _heap[i] = {due, index};
+
+        return true;
+    }
+
+    /**
+     * @brief Earliest deadline, only valid when not empty
+     *
+     */
+    const Entry& top() const {
+        return _heap[0];
+    }
+
+    /**
+     * @brief Remove the earliest deadline
+     *
+     * @return Entry Removed deadline
+     */
+    Entry pop() {
+        auto first = _heap[0];
+        auto last = _heap[--_size];
+
+        size_t i = 0;
+        while (true) {
+            auto child = 2 * i + 1;
+            if (child >= _size) {
+                break;
+            }
+            if (((child + 1) < _size) && before(_heap[child + 1].due, _heap[child].due)) {
+                child++;
+            }
+            if (!before(_heap[child].due, last.due)) {
+                break;
+            }
+            _heap[i] = _heap[child];
+            i = child;
+        }
+        if (_size) {
+            _heap[i] = last;
+        }
+
+        return first;
+    }
+
+    /**
+     * @brief Compare timestamps allowing for wrap around
+     *
+     * @return true a is earlier than b
+     */
+    static bool before(uint32_t a, uint32_t b) {
+        return (int32_t)(a - b) < 0;
+    }
+
+private:
+    Entry* _heap;
+    size_t _capacity;
+    size_t _size {0};
+};
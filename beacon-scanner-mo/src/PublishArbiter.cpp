@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include "PublishArbiter.h"
+
+#include <cstring>
+
+// Each record is a two byte length, a flags byte, then the name and the data, both terminated.
+// A zero length, or too little room left for a length, sends the reader back to the start.
+static constexpr size_t RECORD_HEADER           {3};
+static constexpr uint8_t RECORD_PACKABLE        {0x01};
+
+
+PublishArbiter::PublishArbiter(uint8_t* const storage[PRIORITY_COUNT], const size_t sizes[PRIORITY_COUNT]) {
+    for (size_t i = 0; i < PRIORITY_COUNT; i++) {
+        _queues[i] = {storage[i], sizes[i], 0, 0, 0, 0};
+    }
+}
+
+void PublishArbiter::setRate(uint32_t periodMs, uint32_t burst, uint32_t now) {
+    _periodMs = (periodMs) ? periodMs : 1;
+    _burst = (burst) ? burst : 1;
+    if (_burst > (UINT32_MAX / _periodMs)) {
+        _burst = UINT32_MAX / _periodMs;
+    }
+    _credit = _burst * _periodMs;
+    _updated = now;
+}
+
+void PublishArbiter::refill(uint32_t now) {
+    auto credit = (uint64_t)_credit + (uint32_t)(now - _updated);
+    auto capacity = (uint64_t)_burst * _periodMs;
+    _credit = (uint32_t)((credit > capacity) ? capacity : credit);
+    _updated = now;
+}
+
+void PublishArbiter::charge(uint32_t now) {
+    refill(now);
+    _credit = (_credit > _periodMs) ? (_credit - _periodMs) : 0;
+    _stats.external++;
+}
+
+bool PublishArbiter::empty() const {
+    for (auto& queue : _queues) {
+        if (queue.count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t PublishArbiter::start(const Queue& queue, size_t offset) {
+    if (((queue.size - offset) < RECORD_HEADER) ||
+        (0 == (queue.storage[offset] | (queue.storage[offset + 1] << 8)))) {
+        return 0;
+    }
+    return offset;
+}
+
+void PublishArbiter::read(const Queue& queue, size_t offset, Record& record) {
+    auto entry = &queue.storage[offset];
+    record.bytes = entry[0] | (entry[1] << 8);
+    record.packable = (entry[2] & RECORD_PACKABLE);
+    record.name = (const char*)&entry[RECORD_HEADER];
+    record.data = record.name + strlen(record.name) + 1;
+    record.dataLength = strlen(record.data);
+}
+
+bool PublishArbiter::submit(Priority priority, const char* name, const char* data, bool packable) {
+    auto& queue = _queues[(size_t)priority];
+    _stats.submitted[(size_t)priority]++;
+
+    auto nameLength = strlen(name);
+    auto dataLength = strlen(data);
+    auto bytes = RECORD_HEADER + nameLength + 1 + dataLength + 1;
+    if ((nameLength > NAME_LENGTH) || (dataLength > EVENT_SIZE) || (bytes > UINT16_MAX)) {
+        _stats.dropped[(size_t)priority]++;
+        return false;
+    }
+
+    if (0 == queue.count) {
+        queue.head = queue.tail = 0;
+    }
+
+    // Records never straddle the end of the storage, the space left there is skipped
+    auto offset = queue.tail;
+    size_t skipped = 0;
+    if (0 == queue.count) {
+        offset = 0;
+        if (bytes > queue.size) {
+            offset = SIZE_MAX;
+        }
+    }
+    else if (queue.tail > queue.head) {
+        if (bytes > (queue.size - queue.tail)) {
+            skipped = queue.size - queue.tail;
+            offset = (bytes <= queue.head) ? 0 : SIZE_MAX;
+        }
+    }
+    else if (bytes > (queue.head - queue.tail)) {
+        offset = SIZE_MAX;                      // Also when full, with the tail caught up on the head
+    }
+    if (SIZE_MAX == offset) {
+        _stats.dropped[(size_t)priority]++;
+        return false;
+    }
+
+    if (skipped >= RECORD_HEADER) {
+        queue.storage[queue.tail] = 0;
+        queue.storage[queue.tail + 1] = 0;
+    }
+    auto entry = &queue.storage[offset];
+    entry[0] = (uint8_t)bytes;
+    entry[1] = (uint8_t)(bytes >> 8);
+    entry[2] = (packable) ? RECORD_PACKABLE : 0;
+    memcpy(&entry[RECORD_HEADER], name, nameLength + 1);
+    memcpy(&entry[RECORD_HEADER + nameLength + 1], data, dataLength + 1);
+
+    queue.tail = offset + bytes;
+    queue.count++;
+    return true;
+}
+
+bool PublishArbiter::next(uint32_t now, char* name, char* data) {
+    if (_busy || empty()) {
+        return false;
+    }
+    if (_backoffMs && ((now - _failedAt) < _backoffMs)) {
+        return false;
+    }
+    refill(now);
+    if (_credit < _periodMs) {
+        return false;
+    }
+
+    // Gather records from the front of each queue, highest priority first, while they fit
+    _packCount = 0;
+    size_t size = 2;
+    auto packing = true;
+    for (auto& queue : _queues) {
+        queue.taken = 0;
+        auto offset = queue.head;
+        while (packing && (queue.taken < queue.count) && (_packCount < PACK_RECORDS)) {
+            offset = start(queue, offset);
+            Record record;
+            read(queue, offset, record);
+
+            auto alone = !record.packable || (record.dataLength > PACK_LIMIT);
+            if (0 == _packCount) {
+                _pack[_packCount++] = record;
+                queue.taken++;
+                packing = !alone;
+                size += strlen(record.name) + 5 + record.dataLength + 1;
+                offset += record.bytes;
+                continue;
+            }
+
+            auto grow = record.dataLength + 1;
+            auto named = false;
+            for (size_t i = 0; i < _packCount; i++) {
+                named = named || (0 == strcmp(_pack[i].name, record.name));
+            }
+            grow += (named) ? 0 : (strlen(record.name) + 5);
+            if (alone || ((size + grow) > EVENT_SIZE)) {
+                // Later records of this queue would overtake it, try the next queue
+                break;
+            }
+            _pack[_packCount++] = record;
+            queue.taken++;
+            size += grow;
+            offset += record.bytes;
+        }
+    }
+
+    if (1 == _packCount) {
+        strncpy(name, _pack[0].name, NAME_LENGTH);
+        name[NAME_LENGTH] = '\0';
+        memcpy(data, _pack[0].data, _pack[0].dataLength + 1);
+    }
+    else {
+        strcpy(name, PACK_NAME);
+        pack(data);
+    }
+
+    _credit -= _periodMs;
+    _busy = true;
+    return true;
+}
+
+void PublishArbiter::pack(char* data) {
+    auto out = data;
+    *out++ = '{';
+    for (size_t i = 0; i < _packCount; i++) {
+        // Each name is written once, at its first record, followed by every record carrying it
+        auto first = true;
+        for (size_t j = 0; j < i; j++) {
+            first = first && (0 != strcmp(_pack[j].name, _pack[i].name));
+        }
+        if (!first) {
+            continue;
+        }
+
+        if (out != (data + 1)) {
+            *out++ = ',';
+        }
+        *out++ = '"';
+        auto length = strlen(_pack[i].name);
+        memcpy(out, _pack[i].name, length);
+        out += length;
+        *out++ = '"';
+        *out++ = ':';
+        *out++ = '[';
+        for (size_t j = i; j < _packCount; j++) {
+            if (0 != strcmp(_pack[j].name, _pack[i].name)) {
+                continue;
+            }
+            if (j != i) {
+                *out++ = ',';
+            }
+            memcpy(out, _pack[j].data, _pack[j].dataLength);
+            out += _pack[j].dataLength;
+        }
+        *out++ = ']';
+    }
+    *out++ = '}';
+    *out = '\0';
+}
+
+void PublishArbiter::complete(uint32_t now, bool published) {
+    if (!_busy) {
+        return;
+    }
+    _busy = false;
+
+    if (!published) {
+        // The cloud refused or dropped it, hold off and send the same records again
+        _stats.failures++;
+        _backoffMs = (_backoffMs) ? ((_backoffMs < 16 * _periodMs) ? 2 * _backoffMs : _backoffMs) : _periodMs;
+        _failedAt = now;
+        for (auto& queue : _queues) {
+            queue.taken = 0;
+        }
+        return;
+    }
+
+    _backoffMs = 0;
+    _stats.events++;
+    _stats.packed += (_packCount > 1) ? _packCount : 0;
+    for (auto& queue : _queues) {
+        for (; queue.taken; queue.taken--) {
+            Record record;
+            auto offset = start(queue, queue.head);
+            read(queue, offset, record);
+            queue.head = offset + record.bytes;
+            queue.count--;
+        }
+    }
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+
+/**
+ * @brief Edge counter and period statistics for a pulse input
+ *
+ * @details edge() is called from the pin interrupt with a free running microsecond timestamp
+ *          and only does integer arithmetic.  Readers copy the accumulators out with take()
+ *          while interrupts are masked and then summarize the copy at leisure.
+ */
+class PulseCounter {
+public:
+    struct Accumulator {
+        uint32_t pulses;                    // Edges accepted during the interval
+        uint32_t periods;                   // Edge to edge periods measured during the interval
+        uint32_t minPeriod;                 // Microseconds
+        uint32_t maxPeriod;                 // Microseconds
+        uint64_t sumPeriod;                 // Microseconds
+        uint64_t sumSquares;                // Microseconds squared
+        uint32_t elapsed;                   // Interval length in microseconds
+    };
+
+    struct Summary {
+        uint32_t pulses;
+        float rate;                         // Hertz
+        float period;                       // Mean period in microseconds, NAN if none measured
+        float jitter;                       // Period standard deviation in microseconds
+        float minPeriod;
+        float maxPeriod;
+    };
+
+    /**
+     * @brief Discard all counts and start a new interval
+     *
+     * @param now Current microsecond timestamp
+     */
+    void reset(uint32_t now) {
+        _total = 0;
+        _hasEdge = false;
+        clearInterval(now);
+    }
+
+    /**
+     * @brief Set the shortest period accepted as a real pulse
+     *
+     * @param minPeriod Microseconds, edges arriving sooner than this after the last one are ignored
+     */
+    void setMinPeriod(uint32_t minPeriod) {
+        _minAccepted = minPeriod;
+    }
+
+    /**
+     * @brief Record an edge, called from the pin interrupt
+     *
+     * @param now Current microsecond timestamp
+     */
+    void edge(uint32_t now) {
+        if (_hasEdge) {
+            auto period = now - _lastEdge;
+            if (period < _minAccepted) {
+                return;
+            }
+            _interval.periods++;
+            _interval.sumPeriod += period;
+            _interval.sumSquares += (uint64_t)period * period;
+            _interval.minPeriod = (period < _interval.minPeriod) ? period : _interval.minPeriod;
+            _interval.maxPeriod = (period > _interval.maxPeriod) ? period : _interval.maxPeriod;
+        }
+        _hasEdge = true;
+        _lastEdge = now;
+        _interval.pulses++;
+        _total++;
+    }
+
+    /**
+     * @brief Copy out the current interval and start a new one, call with interrupts masked
+     *
+     * @param now Current microsecond timestamp
+     * @return Accumulator Counts for the interval just ended
+     */
+    Accumulator take(uint32_t now) {
+        auto interval = _interval;
+        interval.elapsed = now - _intervalStart;
+        clearInterval(now);
+        return interval;
+    }
+
+    /**
+     * @brief Total number of edges accepted since the last reset
+     *
+     */
+    uint32_t getTotal() const {
+        return _total;
+    }
+
+    /**
+     * @brief Convert interval counts to rate and period statistics
+     *
+     * @param interval Counts from take()
+     * @return Summary Derived statistics
+     */
+    static Summary summarize(const Accumulator& interval) {
+        Summary summary {interval.pulses, 0.0f, NAN, 0.0f, NAN, NAN};
+        if (interval.elapsed) {
+            summary.rate = (float)((double)interval.pulses * 1.0e6 / (double)interval.elapsed);
+        }
+        if (interval.periods) {
+            auto n = (double)interval.periods;
+            auto mean = (double)interval.sumPeriod / n;
+            summary.period = (float)mean;
+            summary.minPeriod = (float)interval.minPeriod;
+            summary.maxPeriod = (float)interval.maxPeriod;
+            if (interval.periods > 1) {
+                auto variance = ((double)interval.sumSquares - n * mean * mean) / (n - 1.0);
+                summary.jitter = (variance > 0.0) ? (float)std::sqrt(variance) : 0.0f;
+            }
+        }
+        return summary;
+    }
+
+private:
+    void clearInterval(uint32_t now) {
+        _interval = {0, 0, UINT32_MAX, 0, 0, 0, 0};
+        _intervalStart = now;
+    }
+
+    Accumulator _interval {0, 0, UINT32_MAX, 0, 0, 0, 0};
+    uint32_t _intervalStart {0};
+    uint32_t _lastEdge {0};
+    uint32_t _minAccepted {0};
+    uint32_t _total {0};
+    bool _hasEdge {false};
+};
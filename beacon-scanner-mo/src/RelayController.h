@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+
+/**
+ * @brief Relay state machine enforcing minimum on and off times and an interlock
+ *
+ * @details The caller supplies the demanded state on every update.  A change in demand is
+ *          held off until the relay has spent its minimum time in the current state.  An
+ *          active interlock forces the relay off immediately, ignoring the minimum on time,
+ *          and blocks it from turning on again until the interlock is released.
+ */
+class RelayController {
+public:
+    enum class Action {
+        None,
+        On,
+        Off,
+    };
+
+    /**
+     * @brief Set the minimum time the relay stays in each state
+     *
+     * @param minOn Milliseconds the relay stays on before it may turn off
+     * @param minOff Milliseconds the relay stays off before it may turn on
+     */
+    void setMinTimes(uint32_t minOn, uint32_t minOff) {
+        _minOn = minOn;
+        _minOff = minOff;
+    }
+
+    /**
+     * @brief Evaluate the relay against the current demand
+     *
+     * @param demand Relay should be on
+     * @param interlock Relay must be off
+     * @param now Current millisecond timestamp
+     * @return Action Change the caller must apply to the relay output
+     */
+    Action update(bool demand, bool interlock, uint32_t now) {
+        _blocked = interlock && demand;
+        auto want = demand && !interlock;
+        if (want == _on) {
+            return Action::None;
+        }
+
+        if (!interlock && _changed) {
+            auto minimum = (_on) ? _minOn : _minOff;
+            if ((now - _changedAt) < minimum) {
+                return Action::None;
+            }
+        }
+
+        set(want, now);
+        return (want) ? Action::On : Action::Off;
+    }
+
+    /**
+     * @brief Record a relay change made outside of the controller
+     *
+     * @param on New relay state
+     * @param now Current millisecond timestamp
+     */
+    void set(bool on, uint32_t now) {
+        if (on != _on) {
+            _on = on;
+            _changed = true;
+            _changedAt = now;
+            _switches++;
+        }
+    }
+
+    bool isOn() const {
+        return _on;
+    }
+
+    /**
+     * @brief Interlock held the relay off against demand at the last update
+     *
+     */
+    bool isBlocked() const {
+        return _blocked;
+    }
+
+    /**
+     * @brief Number of relay changes since construction
+     *
+     */
+    uint32_t getSwitches() const {
+        return _switches;
+    }
+
+private:
+    uint32_t _minOn {0};
+    uint32_t _minOff {0};
+    uint32_t _changedAt {0};
+    uint32_t _switches {0};
+    bool _changed {false};                  // No minimum applies until the first change
+    bool _on {false};
+    bool _blocked {false};
+};
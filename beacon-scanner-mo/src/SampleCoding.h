@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+//
+// Small helpers for packing sample data into compact cloud payloads
+//
+
+/**
+ * @brief Map a signed value onto an unsigned value so that small magnitudes stay small
+ *
+ * @param value Signed value
+ * @return uint32_t Zigzag encoded value
+ */
+inline uint32_t zigzagEncode(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/**
+ * @brief Reverse zigzag encoding
+ *
+ * @param value Zigzag encoded value
+ * @return int32_t Signed value
+ */
+inline int32_t zigzagDecode(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/**
+ * @brief Write an unsigned value as a LEB128 style variable length integer
+ *
+ * @param value Value to write
+ * @param out Output buffer
+ * @param size Space remaining in the output buffer
+ * @return size_t Number of bytes written, zero if the value did not fit
+ */
+inline size_t varintWrite(uint32_t value, uint8_t* out, size_t size) {
+    size_t count = 0;
+    do {
+        if (count >= size) {
+            return 0;
+        }
+        auto byte = (uint8_t)(value & 0x7f);
+        value >>= 7;
+        out[count++] = (value) ? (byte | 0x80) : byte;
+    } while (value);
+
+    return count;
+}
+
+/**
+ * @brief Number of characters required to base64 encode a binary buffer, excluding terminator
+ *
+ * @param size Length of the binary data
+ * @return size_t Encoded length
+ */
+constexpr size_t base64Length(size_t size) {
+    return ((size + 2) / 3) * 4;
+}
+
+/**
+ * @brief Base64 encode a binary buffer into a null terminated string
+ *
+ * @param in Binary data
+ * @param size Length of the binary data
+ * @param out Output string buffer
+ * @param outSize Size of the output buffer including the terminator
+ * @return size_t Encoded length, zero if the output buffer was too small
+ */
+inline size_t base64Encode(const uint8_t* in, size_t size, char* out, size_t outSize) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    auto length = base64Length(size);
+    if (outSize < (length + 1)) {
+        return 0;
+    }
+
+    size_t o = 0;
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t triple = (uint32_t)in[i] << 16;
+        if ((i + 1) < size) triple |= (uint32_t)in[i + 1] << 8;
+        if ((i + 2) < size) triple |= (uint32_t)in[i + 2];
+
+        out[o++] = alphabet[(triple >> 18) & 0x3f];
+        out[o++] = alphabet[(triple >> 12) & 0x3f];
+        out[o++] = ((i + 1) < size) ? alphabet[(triple >> 6) & 0x3f] : '=';
+        out[o++] = ((i + 2) < size) ? alphabet[triple & 0x3f] : '=';
+    }
+    out[o] = '\0';
+
+    return length;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+/**
+ * @brief Block of 16 bit registers written by one thread and read by others without locking
+ *
+ * @details The writer brackets its stores with beginWrite() and endWrite(), which bump a
+ *          sequence number to odd and back to even.  A reader copies the registers and keeps
+ *          the copy only when the sequence was even and unchanged across it, so a read never
+ *          mixes registers from two updates.  The writer never waits.  A reader retries while
+ *          an update is in progress and gives up after a bounded number of attempts.  Only one
+ *          thread may write each block.
+ */
+template <size_t COUNT>
+class SeqLockRegisters {
+public:
+    static constexpr size_t READ_ATTEMPTS   {64};
+
+    SeqLockRegisters() {
+        for (auto& reg : _registers) {
+            reg.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    static constexpr size_t size() {
+        return COUNT;
+    }
+
+    void beginWrite() {
+        auto sequence = _sequence.load(std::memory_order_relaxed);
+        _sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void endWrite() {
+        _sequence.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Store one register, only between beginWrite() and endWrite()
+     *
+     */
+    void set(size_t index, uint16_t value) {
+        if (index < COUNT) {
+            _registers[index].store(value, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Store a 32 bit value across two registers, high word first
+     *
+     */
+    void set32(size_t index, uint32_t value) {
+        set(index, (uint16_t)(value >> 16));
+        set(index + 1, (uint16_t)value);
+    }
+
+    /**
+     * @brief Store an IEEE 754 single across two registers, high word first
+     *
+     */
+    void setFloat(size_t index, float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        set32(index, bits);
+    }
+
+    /**
+     * @brief Copy a consistent range of registers
+     *
+     * @param first First register
+     * @param count Number of registers
+     * @param values Output, count entries
+     * @return true Registers copied from a single update
+     * @return false Range outside the block or the writer kept the block busy
+     */
+    bool read(size_t first, size_t count, uint16_t* values) const {
+        if ((first > COUNT) || (count > (COUNT - first))) {
+            return false;
+        }
+
+        for (size_t attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+            auto before = _sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            for (size_t i = 0; i < count; i++) {
+                values[i] = _registers[first + i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (before == _sequence.load(std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::atomic<uint32_t> _sequence {0};
+    std::atomic<uint16_t> _registers[COUNT];
+};
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+
+#include "StreamingStats.h"
+
+
+/**
+ * @brief Response tracking for one bus slave
+ *
+ * @details Response times feed a 95th percentile estimate from which the response timeout
+ *          is derived, capped by the configured timeout.  Consecutive communication failures
+ *          first mark the slave suspect and then quarantine it.  A quarantined slave is only
+ *          probed after a backoff that doubles with every failed probe, so that a dead slave
+ *          costs the bus one timeout per backoff period instead of one per poll.
+ */
+class SlaveHealth {
+public:
+    enum class State : uint8_t {
+        Healthy,
+        Suspect,                            ///< Failed recently, timeouts are not shortened
+        Quarantined,                        ///< Only probed once the backoff expires
+    };
+
+    static constexpr uint32_t FAILURES_TO_QUARANTINE    {3};
+    static constexpr uint32_t BACKOFF_MIN_MS            {5000};
+    static constexpr uint32_t BACKOFF_MAX_MS            {300000};
+    static constexpr uint32_t MIN_SAMPLES               {8};    // Responses needed before the timeout adapts
+    static constexpr uint32_t TIMEOUT_MIN_MS            {50};
+    static constexpr uint32_t TIMEOUT_MARGIN_MS         {20};
+
+    /**
+     * @brief Forget all history and start tracking a slave
+     *
+     * @param id Slave ID
+     * @param maxTimeout Configured timeout in milliseconds, never exceeded
+     */
+    void reset(uint8_t id, uint32_t maxTimeout) {
+        *this = SlaveHealth();
+        _id = id;
+        _maxTimeout = maxTimeout;
+    }
+
+    uint8_t getId() const {
+        return _id;
+    }
+
+    void setMaxTimeout(uint32_t maxTimeout) {
+        _maxTimeout = maxTimeout;
+    }
+
+    uint32_t getMaxTimeout() const {
+        return _maxTimeout;
+    }
+
+    State getState() const {
+        return _state;
+    }
+
+    /**
+     * @brief Response timeout to use for the next request
+     *
+     * @return uint32_t Twice the 95th percentile response time plus a margin once enough
+     *         responses were seen from a healthy slave, the configured timeout otherwise
+     */
+    uint32_t getTimeout() const {
+        if ((State::Healthy != _state) || (_samples < MIN_SAMPLES)) {
+            return _maxTimeout;
+        }
+        auto timeout = (uint32_t)(2.0f * _p95.get()) + TIMEOUT_MARGIN_MS;
+        timeout = (timeout < TIMEOUT_MIN_MS) ? TIMEOUT_MIN_MS : timeout;
+        return (timeout > _maxTimeout) ? _maxTimeout : timeout;
+    }
+
+    /**
+     * @brief Whether the slave may be polled
+     *
+     * @param now Current millisecond timestamp
+     */
+    bool isReady(uint32_t now) const {
+        return (State::Quarantined != _state) || ((int32_t)(now - _retryAt) >= 0);
+    }
+
+    /**
+     * @brief Record a response, including exception responses
+     *
+     * @param now Current millisecond timestamp
+     * @param responseMs Time taken by the transaction
+     * @return true Slave left quarantine
+     */
+    bool success(uint32_t now, uint32_t responseMs) {
+        (void)now;
+        auto recovered = (State::Quarantined == _state);
+        _state = State::Healthy;
+        _failures = 0;
+        _backoff = 0;
+        _p95.push((float)responseMs);
+        _samples++;
+
+        return recovered;
+    }
+
+    /**
+     * @brief Record a failure to get a valid response
+     *
+     * @param now Current millisecond timestamp
+     * @return true Slave entered quarantine
+     */
+    bool failure(uint32_t now) {
+        _failures++;
+        _totalFailures++;
+        if (_failures < FAILURES_TO_QUARANTINE) {
+            _state = State::Suspect;
+            return false;
+        }
+
+        auto entered = (State::Quarantined != _state);
+        _state = State::Quarantined;
+        _backoff = (0 == _backoff) ? BACKOFF_MIN_MS : ((_backoff * 2 > BACKOFF_MAX_MS) ? BACKOFF_MAX_MS : _backoff * 2);
+        _retryAt = now + _backoff;
+
+        return entered;
+    }
+
+    /**
+     * @brief Consecutive failures since the last response
+     *
+     */
+    uint32_t getFailures() const {
+        return _failures;
+    }
+
+    uint32_t getTotalFailures() const {
+        return _totalFailures;
+    }
+
+    /**
+     * @brief Current quarantine backoff in milliseconds, zero when not quarantined
+     *
+     */
+    uint32_t getBackoff() const {
+        return _backoff;
+    }
+
+private:
+    uint8_t _id {0};
+    State _state {State::Healthy};
+    uint32_t _maxTimeout {2000};
+    uint32_t _failures {0};
+    uint32_t _totalFailures {0};
+    uint32_t _backoff {0};
+    uint32_t _retryAt {0};
+    uint32_t _samples {0};
+    P2Quantile _p95 {0.95f};
+};
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "SocketCanTransport.h"
+
+#if defined(__linux__)
+
+#include <cstring>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+SocketCanTransport::~SocketCanTransport() {
+    if (_socket >= 0) {
+        close(_socket);
+    }
+}
+
+bool SocketCanTransport::begin(uint32_t bitrate, bool listenOnly, const CanFilterPlan& plan) {
+    (void)bitrate;
+    if (_socket < 0) {
+        _socket = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK, CAN_RAW);
+        if (_socket < 0) {
+            return false;
+        }
+
+        struct ifreq request {};
+        strncpy(request.ifr_name, _interface, sizeof(request.ifr_name) - 1);
+        struct sockaddr_can address {};
+        address.can_family = AF_CAN;
+        auto bound = (0 == ioctl(_socket, SIOCGIFINDEX, &request));
+        address.can_ifindex = request.ifr_ifindex;
+        bound = bound && (0 == bind(_socket, (struct sockaddr*)&address, sizeof(address)));
+
+        // Kernel drop counts arrive with each frame
+        int on = 1;
+        if (!bound || (0 != setsockopt(_socket, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)))) {
+            close(_socket);
+            _socket = -1;
+            return false;
+        }
+    }
+
+    // Controller layout back to kernel filters, each matching the frame type of its controller filter
+    struct can_filter filters[CanFilterPlan::FILTERS];
+    for (size_t i = 0; i < CanFilterPlan::FILTERS; i++) {
+        auto& filter = plan.filters[i];
+        auto mask = plan.masks[(i < 2) ? 0 : 1];
+        if (filter.extended) {
+            filters[i].can_id = filter.id | CAN_EFF_FLAG;
+            filters[i].can_mask = mask | CAN_EFF_FLAG;
+        }
+        else {
+            filters[i].can_id = filter.id >> 18;
+            filters[i].can_mask = (mask >> 18) | CAN_EFF_FLAG;
+        }
+    }
+    _listenOnly = listenOnly;
+    return (0 == setsockopt(_socket, SOL_CAN_RAW, CAN_RAW_FILTER, filters, sizeof(filters)));
+}
+
+void SocketCanTransport::wait(uint32_t timeoutMs) {
+    struct pollfd descriptor {_socket, POLLIN, 0};
+    poll(&descriptor, 1, (int)timeoutMs);
+}
+
+bool SocketCanTransport::receive(CanFrame& frame) {
+    struct can_frame raw;
+    struct iovec vector {&raw, sizeof(raw)};
+    char control[CMSG_SPACE(sizeof(uint32_t))];
+    struct msghdr message {};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if (recvmsg(_socket, &message, 0) != (ssize_t)sizeof(raw)) {
+        return false;
+    }
+
+    for (auto header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+        if ((SOL_SOCKET == header->cmsg_level) && (SO_RXQ_OVFL == header->cmsg_type)) {
+            memcpy(&_drops, CMSG_DATA(header), sizeof(_drops));
+        }
+    }
+
+    frame.extended = (0 != (raw.can_id & CAN_EFF_FLAG));
+    frame.id = raw.can_id & ((frame.extended) ? CAN_EFF_MASK : CAN_SFF_MASK);
+    frame.length = (raw.can_dlc > 8) ? 8 : raw.can_dlc;
+    memcpy(frame.data, raw.data, sizeof(frame.data));
+    return true;
+}
+
+bool SocketCanTransport::send(const CanFrame& frame) {
+    if (_listenOnly || (_socket < 0)) {
+        return false;
+    }
+
+    struct can_frame raw {};
+    raw.can_id = frame.id | ((frame.extended) ? CAN_EFF_FLAG : 0);
+    raw.can_dlc = frame.length;
+    memcpy(raw.data, frame.data, sizeof(raw.data));
+    return (write(_socket, &raw, sizeof(raw)) == (ssize_t)sizeof(raw));
+}
+
+uint32_t SocketCanTransport::takeOverruns() {
+    auto overruns = _drops - _dropsTaken;
+    _dropsTaken = _drops;
+    return overruns;
+}
+
+#endif // __linux__
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "CanTransport.h"
+
+#if defined(__linux__)
+
+/**
+ * @brief Transport over a Linux SocketCAN interface, such as vcan0, for running the CAN engine on a host
+ *
+ * @details Receive filters are installed as kernel filters exactly as planned for the
+ *          controller, so frames get through on the host just as they would on the device.
+ *          The bit rate belongs to the interface and is not changed.
+ */
+class SocketCanTransport : public CanTransport {
+public:
+    explicit SocketCanTransport(const char* interface) : _interface(interface) {}
+    ~SocketCanTransport() override;
+
+    bool begin(uint32_t bitrate, bool listenOnly, const CanFilterPlan& plan) override;
+    void wait(uint32_t timeoutMs) override;
+    bool receive(CanFrame& frame) override;
+    bool send(const CanFrame& frame) override;
+    uint32_t takeOverruns() override;
+
+private:
+    const char* _interface;
+    int _socket {-1};
+    bool _listenOnly {false};
+    uint32_t _drops {0};                    ///< Kernel drop count at the last receive
+    uint32_t _dropsTaken {0};
+};
+
+#endif // __linux__
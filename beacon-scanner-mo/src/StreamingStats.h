@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief Fixed memory quantile estimator using the P-square algorithm
+ *
+ * @details Tracks five markers whose heights approximate the minimum, p/2, p, (1+p)/2 and
+ *          maximum quantiles.  See Jain and Chlamtac, "The P2 algorithm for dynamic
+ *          calculation of quantiles and histograms without storing observations", 1985.
+ */
+class P2Quantile {
+public:
+    /**
+     * @brief Construct a new quantile estimator
+     *
+     * @param p Quantile to estimate between 0 and 1
+     */
+    explicit P2Quantile(float p) : _p(p) {
+        reset();
+    }
+
+    void reset() {
+        _count = 0;
+        _dn[0] = 0.0f;
+        _dn[1] = _p / 2.0f;
+        _dn[2] = _p;
+        _dn[3] = (1.0f + _p) / 2.0f;
+        _dn[4] = 1.0f;
+    }
+
+    void push(float x) {
+        if (_count < MARKERS) {
+            // Collect the first observations verbatim, kept sorted
+            auto i = _count++;
+            while ((i > 0) && (_q[i - 1] > x)) {
+                _q[i] = _q[i - 1];
+                i--;
+            }
+            _q[i] = x;
+
+            if (MARKERS == _count) {
+                for (int m = 0; m < MARKERS; m++) {
+                    _n[m] = m + 1;
+                }
+                _np[0] = 1.0f;
+                _np[1] = 1.0f + 2.0f * _p;
+                _np[2] = 1.0f + 4.0f * _p;
+                _np[3] = 3.0f + 2.0f * _p;
+                _np[4] = 5.0f;
+            }
+            return;
+        }
+        _count++;
+
+        // Find the cell containing the new observation and extend the extremes if needed
+        int k;
+        if (x < _q[0]) {
+            _q[0] = x;
+            k = 0;
+        }
+        else if (x >= _q[4]) {
+            _q[4] = x;
+            k = 3;
+        }
+        else {
+            for (k = 0; k < 3; k++) {
+                if (x < _q[k + 1]) {
+                    break;
+                }
+            }
+        }
+
+        for (int m = k + 1; m < MARKERS; m++) {
+            _n[m]++;
+        }
+        for (int m = 0; m < MARKERS; m++) {
+            _np[m] += _dn[m];
+        }
+
+        // Nudge the middle markers toward their desired positions
+        for (int m = 1; m < (MARKERS - 1); m++) {
+            auto d = _np[m] - (float)_n[m];
+            if (((d >= 1.0f) && ((_n[m + 1] - _n[m]) > 1)) || ((d <= -1.0f) && ((_n[m - 1] - _n[m]) < -1))) {
+                int ds = (d > 0.0f) ? 1 : -1;
+                auto q = parabolic(m, ds);
+                if ((_q[m - 1] < q) && (q < _q[m + 1])) {
+                    _q[m] = q;
+                }
+                else {
+                    _q[m] = _q[m] + (float)ds * (_q[m + ds] - _q[m]) / (float)(_n[m + ds] - _n[m]);
+                }
+                _n[m] += ds;
+            }
+        }
+    }
+
+    /**
+     * @brief Current estimate of the quantile
+     *
+     * @return float Estimate, NAN if no observations were made
+     */
+    float get() const {
+        if (0 == _count) {
+            return NAN;
+        }
+        if (_count < MARKERS) {
+            return _q[(int)std::lround(_p * (float)(_count - 1))];
+        }
+        return _q[2];
+    }
+
+private:
+    static constexpr int MARKERS {5};
+
+    float parabolic(int m, int ds) const {
+        auto d = (float)ds;
+        auto left = (float)(_n[m] - _n[m - 1]);
+        auto right = (float)(_n[m + 1] - _n[m]);
+        return _q[m] + d / (float)(_n[m + 1] - _n[m - 1]) *
+            ((left + d) * (_q[m + 1] - _q[m]) / right + (right - d) * (_q[m] - _q[m - 1]) / left);
+    }
+
+    float _p;
+    float _q[MARKERS] {};
+    int _n[MARKERS] {};
+    float _np[MARKERS] {};
+    float _dn[MARKERS] {};
+    uint32_t _count {0};
+};
+
+
+/**
+ * @brief Streaming summary statistics for one input over an interval
+ *
+ * @details Mean and variance use Welford's method.  Median and 95th percentile are
+ *          approximated with P-square estimators so that memory use is constant.
+ */
+class StreamingStats {
+public:
+    void reset() {
+        _count = 0;
+        _min = INFINITY;
+        _max = -INFINITY;
+        _mean = 0.0;
+        _m2 = 0.0;
+        _p50.reset();
+        _p95.reset();
+    }
+
+    void push(float x) {
+        _count++;
+        _min = (x < _min) ? x : _min;
+        _max = (x > _max) ? x : _max;
+        auto delta = (double)x - _mean;
+        _mean += delta / (double)_count;
+        _m2 += delta * ((double)x - _mean);
+        _p50.push(x);
+        _p95.push(x);
+    }
+
+    uint32_t getCount() const {
+        return _count;
+    }
+
+    float getMin() const {
+        return (_count) ? _min : NAN;
+    }
+
+    float getMax() const {
+        return (_count) ? _max : NAN;
+    }
+
+    double getMean() const {
+        return (_count) ? _mean : NAN;
+    }
+
+    double getStdDev() const {
+        return (_count > 1) ? std::sqrt(_m2 / (double)(_count - 1)) : 0.0;
+    }
+
+    float getP50() const {
+        return _p50.get();
+    }
+
+    float getP95() const {
+        return _p95.get();
+    }
+
+private:
+    uint32_t _count {0};
+    float _min {INFINITY};
+    float _max {-INFINITY};
+    double _mean {0.0};
+    double _m2 {0.0};
+    P2Quantile _p50 {0.50f};
+    P2Quantile _p95 {0.95f};
+};
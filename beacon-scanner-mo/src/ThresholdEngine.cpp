@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ThresholdEngine.h"
+
+#include <cmath>
+#include <cstdio>
+
+
+void ThresholdRule::setEvent(const char* event) {
+    if (reportClear) {
+        snprintf(raiseEvent, sizeof(raiseEvent), "%.*s_raise", (int)EVENT_LENGTH, event);
+        snprintf(clearEvent, sizeof(clearEvent), "%.*s_clr", (int)EVENT_LENGTH, event);
+    }
+    else {
+        snprintf(raiseEvent, sizeof(raiseEvent), "%.*s", (int)EVENT_LENGTH, event);
+        clearEvent[0] = '\0';
+    }
+}
+
+void ThresholdEngine::evaluate(const float* channels, size_t channelCount) {
+    for (size_t i = 0; i < _count; i++) {
+        auto& rule = _rules[i];
+        if (!rule.active || (rule.channel >= channelCount)) {
+            continue;
+        }
+
+        auto value = channels[rule.channel];
+        bool raised;
+        if (std::isnan(value)) {
+            if (ThresholdStale::Hold == rule.stale) {
+                continue;
+            }
+            raised = (ThresholdStale::Raise == rule.stale);
+        }
+        else {
+            // Fold both directions into a single comparison where positive means beyond the threshold
+            auto excess = (ThresholdDirection::Above == rule.direction) ? (value - rule.threshold) : (rule.threshold - value);
+            raised = (rule.raised) ? (excess > -rule.hysteresis) : (excess > 0.0f);
+        }
+
+        if (rule.evaluated && (raised == rule.raised)) {
+            continue;
+        }
+
+        // The first evaluation only reports a rule that starts out raised
+        auto report = rule.evaluated || raised;
+        rule.raised = raised;
+        rule.evaluated = true;
+
+        if (report && rule.enabled && (raised || rule.reportClear) && _callback) {
+            _callback(rule, raised);
+        }
+    }
+}
+
+uint32_t ThresholdEngine::raisedMask(size_t first) const {
+    uint32_t mask = 0;
+    for (size_t i = first; (i < _count) && ((i - first) < 32); i++) {
+        if (_rules[i].active && _rules[i].raised) {
+            mask |= 1UL << (i - first);
+        }
+    }
+    return mask;
+}
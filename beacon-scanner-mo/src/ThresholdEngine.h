@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+enum class ThresholdDirection : uint8_t {
+    Above,                                  ///< Raised when the channel rises above the threshold
+    Below,                                  ///< Raised when the channel falls below the threshold
+};
+
+enum class ThresholdStale : uint8_t {
+    Hold,                                   ///< Keep the previous state while the channel holds NAN
+    Clear,                                  ///< Clear the rule while the channel holds NAN
+    Raise,                                  ///< Raise the rule while the channel holds NAN
+};
+
+/**
+ * @brief One threshold rule evaluated by the threshold engine
+ *
+ * @details Hysteresis is applied on the clearing side of the threshold.  An Above rule is
+ *          raised when the value exceeds the threshold and cleared when it falls below
+ *          threshold minus hysteresis, and the reverse for a Below rule.
+ */
+struct ThresholdRule {
+    static constexpr size_t EVENT_LENGTH {24};
+
+    bool active                     {false};    ///< Rule is evaluated
+    bool enabled                    {false};    ///< Rule state changes are reported
+    bool reportClear                {false};    ///< Report clearing as well as raising
+    bool capture                    {false};    ///< Raising the rule triggers a waveform capture
+    uint16_t channel                {0};        ///< Index into the channel value table
+    ThresholdDirection direction    {ThresholdDirection::Above};
+    ThresholdStale stale            {ThresholdStale::Hold};    ///< State while the channel has no value
+    float threshold                 {0.0f};
+    float hysteresis                {0.0f};
+    char raiseEvent[EVENT_LENGTH + 8] {};       ///< Trigger name when raised
+    char clearEvent[EVENT_LENGTH + 8] {};       ///< Trigger name when cleared
+
+    // Runtime state
+    bool raised                     {false};
+    bool evaluated                  {false};
+
+    /**
+     * @brief Set the rule event names from a base name
+     *
+     * @details Rules that report clearing get "_raise" and "_clr" suffixes, otherwise the
+     *          base name is used for the raise event as is.
+     *
+     * @param event Base event name
+     */
+    void setEvent(const char* event);
+
+    /**
+     * @brief Forget the current state so that the next evaluation starts fresh
+     *
+     */
+    void resetState() {
+        raised = false;
+        evaluated = false;
+    }
+};
+
+/**
+ * @brief Evaluates a table of threshold rules against a table of channel values
+ *
+ */
+class ThresholdEngine {
+public:
+    using Callback = void (*)(const ThresholdRule& rule, bool raised);
+
+    /**
+     * @brief Construct a new threshold engine over caller supplied rules
+     *
+     * @param rules Rule table
+     * @param count Number of rules in the table
+     * @param callback Called for every reportable state change of an enabled rule
+     */
+    ThresholdEngine(ThresholdRule* rules, size_t count, Callback callback)
+        : _rules(rules), _count(count), _callback(callback) {}
+
+    /**
+     * @brief Evaluate every active rule against the latest channel values
+     *
+     * @details A channel holding NAN has no current value, such as a failed poll.  Its rules
+     *          keep their previous state, or are cleared or raised as their stale policy says.
+     *
+     * @param channels Channel value table
+     * @param channelCount Number of channels in the table
+     */
+    void evaluate(const float* channels, size_t channelCount);
+
+    /**
+     * @brief Bitmask of raised rules starting at a given rule index
+     *
+     * @param first Index of the first rule to report
+     * @return uint32_t Bit n is set if rule first + n is raised
+     */
+    uint32_t raisedMask(size_t first = 0) const;
+
+private:
+    ThresholdRule* _rules;
+    size_t _count;
+    Callback _callback;
+};
@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "TimeSeriesCodec.h"
+
+#include <cstring>
+
+
+namespace {
+
+// Delta of delta buckets, each a prefix and a two's complement field width
+struct DeltaBucket {
+    uint8_t prefix;
+    uint8_t prefixBits;
+    uint8_t width;
+};
+
+constexpr DeltaBucket DELTA_BUCKETS[] {
+    {0x2, 2, 7},
+    {0x6, 3, 9},
+    {0xe, 4, 12},
+};
+constexpr uint32_t DELTA_ESCAPE         {0xf};  // Followed by the full 32 bit delta of delta
+constexpr uint8_t DELTA_ESCAPE_BITS     {4};
+
+inline uint32_t floatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline float bitsFloat(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline uint8_t leadingZeros(uint32_t value) {
+    return (value) ? (uint8_t)__builtin_clz(value) : 32;
+}
+
+inline uint8_t trailingZeros(uint32_t value) {
+    return (value) ? (uint8_t)__builtin_ctz(value) : 32;
+}
+
+} // namespace
+
+
+void TimeSeriesEncoder::begin(uint8_t* out, size_t size) {
+    _out = out;
+    _capacityBits = size * 8;
+    _bits = 0;
+    _count = 0;
+    _delta = 0;
+    _leading = 0xff;
+    _trailing = 0;
+    memset(out, 0, size);
+}
+
+void TimeSeriesEncoder::write(uint32_t value, uint8_t bits) {
+    while (bits) {
+        auto byte = _bits / 8;
+        auto free = (uint8_t)(8 - (_bits % 8));
+        auto take = (bits < free) ? bits : free;
+        auto chunk = (uint8_t)((value >> (bits - take)) & ((1U << take) - 1));
+        _out[byte] |= (uint8_t)(chunk << (free - take));
+        _bits += take;
+        bits -= take;
+    }
+}
+
+bool TimeSeriesEncoder::append(uint32_t time, float value) {
+    if ((nullptr == _out) || ((_bits + MAX_SAMPLE_BITS) > _capacityBits) || (UINT16_MAX == _count)) {
+        return false;
+    }
+
+    auto bits = floatBits(value);
+    if (0 == _count) {
+        write(time, 32);
+        write(bits, 32);
+        _time = time;
+        _value = bits;
+        _count++;
+        return true;
+    }
+
+    // Timestamp as the change in interval since the previous sample
+    auto delta = (int32_t)(time - _time);
+    auto dod = delta - _delta;
+    if (0 == dod) {
+        write(0, 1);
+    }
+    else {
+        auto written = false;
+        for (auto& bucket: DELTA_BUCKETS) {
+            auto limit = (int32_t)1 << (bucket.width - 1);
+            if ((dod >= -limit) && (dod < limit)) {
+                write(bucket.prefix, bucket.prefixBits);
+                write((uint32_t)dod, bucket.width);
+                written = true;
+                break;
+            }
+        }
+        if (!written) {
+            write(DELTA_ESCAPE, DELTA_ESCAPE_BITS);
+            write((uint32_t)dod, 32);
+        }
+    }
+    _time = time;
+    _delta = delta;
+
+    // Value as the XOR with the previous value
+    auto x = bits ^ _value;
+    if (0 == x) {
+        write(0, 1);
+    }
+    else {
+        auto leading = leadingZeros(x);
+        auto trailing = trailingZeros(x);
+        leading = (leading > 31) ? 31 : leading;
+        if ((0xff != _leading) && (leading >= _leading) && (trailing >= _trailing)) {
+            write(0x2, 2);
+            write(x >> _trailing, (uint8_t)(32 - _leading - _trailing));
+        }
+        else {
+            auto length = (uint8_t)(32 - leading - trailing);
+            write(0x3, 2);
+            write(leading, 5);
+            write(length - 1, 5);
+            write(x >> trailing, length);
+            _leading = leading;
+            _trailing = trailing;
+        }
+    }
+    _value = bits;
+    _count++;
+
+    return true;
+}
+
+
+void TimeSeriesDecoder::begin(const uint8_t* in, size_t size, uint16_t count) {
+    _in = in;
+    _sizeBits = size * 8;
+    _bits = 0;
+    _count = count;
+    _index = 0;
+    _delta = 0;
+    _leading = 0;
+    _trailing = 0;
+}
+
+bool TimeSeriesDecoder::read(uint32_t& value, uint8_t bits) {
+    if ((_bits + bits) > _sizeBits) {
+        return false;
+    }
+
+    value = 0;
+    while (bits) {
+        auto byte = _in[_bits / 8];
+        auto available = (uint8_t)(8 - (_bits % 8));
+        auto take = (bits < available) ? bits : available;
+        auto chunk = (uint32_t)((byte >> (available - take)) & ((1U << take) - 1));
+        value = (take < 32) ? ((value << take) | chunk) : chunk;
+        _bits += take;
+        bits -= take;
+    }
+
+    return true;
+}
+
+bool TimeSeriesDecoder::next(uint32_t& time, float& value) {
+    if (_index >= _count) {
+        return false;
+    }
+
+    uint32_t field;
+    if (0 == _index) {
+        if (!read(_time, 32) || !read(_value, 32)) {
+            return false;
+        }
+    }
+    else {
+        // Count the leading one bits of the timestamp prefix
+        uint8_t ones = 0;
+        while ((ones < DELTA_ESCAPE_BITS) && read(field, 1) && field) {
+            ones++;
+        }
+
+        int32_t dod = 0;
+        if (ones) {
+            auto width = (ones < DELTA_ESCAPE_BITS) ? DELTA_BUCKETS[ones - 1].width : (uint8_t)32;
+            if (!read(field, width)) {
+                return false;
+            }
+            // Sign extend the field
+            dod = (width < 32) ? (int32_t)(field << (32 - width)) >> (32 - width) : (int32_t)field;
+        }
+        _delta += dod;
+        _time += (uint32_t)_delta;
+
+        if (!read(field, 1)) {
+            return false;
+        }
+        if (field) {
+            if (!read(field, 1)) {
+                return false;
+            }
+            if (field) {
+                uint32_t leading, length;
+                if (!read(leading, 5) || !read(length, 5)) {
+                    return false;
+                }
+                length++;
+                _leading = (uint8_t)leading;
+                _trailing = (uint8_t)(32 - leading - length);
+            }
+            auto length = (uint8_t)(32 - _leading - _trailing);
+            if (!read(field, length)) {
+                return false;
+            }
+            _value ^= field << _trailing;
+        }
+    }
+
+    time = _time;
+    value = bitsFloat(_value);
+    _index++;
+
+    return true;
+}
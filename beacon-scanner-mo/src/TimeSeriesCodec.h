@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief Gorilla style encoder for one series of timestamped float samples
+ *
+ * @details Timestamps are stored as the delta of the delta between samples using a small set
+ *          of prefix coded bucket widths.  Values are stored as the XOR with the previous
+ *          value, reusing the previous window of meaningful bits when the new XOR fits inside
+ *          it.  See Pelkonen et al., "Gorilla: A Fast, Scalable, In-Memory Time Series
+ *          Database", VLDB 2015.  The first sample is stored verbatim so that every block
+ *          decodes on its own.
+ */
+class TimeSeriesEncoder {
+public:
+    static constexpr size_t MAX_SAMPLE_BITS {4 + 32 + 2 + 5 + 5 + 32};  // Worst case bits for one sample
+
+    /**
+     * @brief Start a new block
+     *
+     * @param out Block storage
+     * @param size Size of the block storage in bytes
+     */
+    void begin(uint8_t* out, size_t size);
+
+    /**
+     * @brief Append a sample if it is certain to fit
+     *
+     * @param time Millisecond timestamp
+     * @param value Sample value
+     * @return true Sample appended
+     * @return false Block is full and must be sealed
+     */
+    bool append(uint32_t time, float value);
+
+    /**
+     * @brief Number of bytes used so far, the last byte may be partly filled
+     *
+     */
+    size_t getBytes() const {
+        return (_bits + 7) / 8;
+    }
+
+    uint16_t getCount() const {
+        return _count;
+    }
+
+private:
+    void write(uint32_t value, uint8_t bits);
+
+    uint8_t* _out {nullptr};
+    size_t _capacityBits {0};
+    size_t _bits {0};
+    uint16_t _count {0};
+    uint32_t _time {0};
+    int32_t _delta {0};
+    uint32_t _value {0};
+    uint8_t _leading {0xff};                // Window of meaningful bits of the previous XOR
+    uint8_t _trailing {0};
+};
+
+/**
+ * @brief Decoder for blocks written by TimeSeriesEncoder
+ *
+ */
+class TimeSeriesDecoder {
+public:
+    /**
+     * @brief Start decoding a block
+     *
+     * @param in Block data
+     * @param size Size of the block data in bytes
+     * @param count Number of samples in the block
+     */
+    void begin(const uint8_t* in, size_t size, uint16_t count);
+
+    /**
+     * @brief Decode the next sample
+     *
+     * @param time Millisecond timestamp
+     * @param value Sample value
+     * @return true Sample decoded
+     * @return false No samples left or the block is malformed
+     */
+    bool next(uint32_t& time, float& value);
+
+private:
+    bool read(uint32_t& value, uint8_t bits);
+
+    const uint8_t* _in {nullptr};
+    size_t _sizeBits {0};
+    size_t _bits {0};
+    uint16_t _count {0};
+    uint16_t _index {0};
+    uint32_t _time {0};
+    int32_t _delta {0};
+    uint32_t _value {0};
+    uint8_t _leading {0};
+    uint8_t _trailing {0};
+};
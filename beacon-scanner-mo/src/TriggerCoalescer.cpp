@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include "TriggerCoalescer.h"
+
+#include <cstring>
+
+
+void TriggerCoalescer::configure(const Settings& settings) {
+    _settings = settings;
+    // Keep the bucket in range of the credit counter
+    if (_settings.refillMs && (_settings.burst > (UINT32_MAX / _settings.refillMs))) {
+        _settings.burst = UINT32_MAX / _settings.refillMs;
+    }
+    for (auto& reason : _reasons) {
+        reason.credit = capacity();
+    }
+}
+
+TriggerCoalescer::Reason* TriggerCoalescer::find(const char* name, uint32_t now) {
+    Reason* spare = nullptr;
+    for (auto& reason : _reasons) {
+        if (reason.used) {
+            if (0 == strncmp(reason.name, name, REASON_LENGTH - 1)) {
+                return &reason;
+            }
+            // A reason with a full bucket and nothing pending carries no state worth keeping
+            auto credit = (uint64_t)reason.credit + (uint32_t)(now - reason.updated);
+            if (!spare && !reason.pending && (credit >= capacity())) {
+                spare = &reason;
+            }
+        }
+        else if (!spare || spare->used) {
+            spare = &reason;
+        }
+    }
+
+    if (spare) {
+        strncpy(spare->name, name, REASON_LENGTH - 1);
+        spare->name[REASON_LENGTH - 1] = '\0';
+        spare->credit = capacity();
+        spare->updated = now;
+        spare->used = true;
+        spare->pending = false;
+    }
+    return spare;
+}
+
+bool TriggerCoalescer::submit(const char* reason, bool immediate, uint32_t now) {
+    auto entry = find(reason, now);
+    if (!entry) {
+        _suppressed++;
+        _suppressedTotal++;
+        return false;
+    }
+
+    if (entry->pending) {
+        _mergedTotal++;
+        _immediate = _immediate || immediate;
+        return true;
+    }
+
+    if (_settings.burst) {
+        auto credit = (uint64_t)entry->credit + (uint32_t)(now - entry->updated);
+        entry->credit = (credit > capacity()) ? capacity() : (uint32_t)credit;
+        entry->updated = now;
+        if (entry->credit < _settings.refillMs) {
+            _suppressed++;
+            _suppressedTotal++;
+            return false;
+        }
+        entry->credit -= _settings.refillMs;
+    }
+
+    entry->pending = true;
+    if (!_open) {
+        _open = true;
+        _openedAt = now;
+    }
+    _immediate = _immediate || immediate;
+    return true;
+}
+
+size_t TriggerCoalescer::flush(uint32_t now, Emit emit) {
+    if (!_open || ((now - _openedAt) < _settings.windowMs)) {
+        return 0;
+    }
+
+    size_t count = 0;
+    for (auto& reason : _reasons) {
+        if (reason.pending) {
+            reason.pending = false;
+            emit(reason.name, _immediate);
+            count++;
+        }
+    }
+    _open = false;
+    _immediate = false;
+    return count;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief Merges location publish triggers that arrive close together and rate limits each reason
+ *
+ * @details The first accepted trigger opens a window.  Every reason accepted before the window
+ *          closes is handed out together when flush() is called after it, so that a single
+ *          location publish carries all of them.  The merged triggers are immediate if any of
+ *          them was.  A reason repeated within the window is merged without cost.  Otherwise
+ *          each reason spends a token from its own bucket, which holds up to burst tokens and
+ *          gains one every refill period.  A trigger finding its bucket empty is suppressed and
+ *          counted.
+ */
+class TriggerCoalescer {
+public:
+    static constexpr size_t REASON_COUNT        {48};
+    static constexpr size_t REASON_LENGTH       {32};
+
+    struct Settings {
+        uint32_t windowMs;                      ///< Time triggers are gathered before they go out
+        uint32_t burst;                         ///< Bucket size per reason, 0 for no limit
+        uint32_t refillMs;                      ///< Time to earn back one token
+    };
+
+    /**
+     * @brief Emits one merged reason from flush()
+     *
+     * @param reason Trigger reason
+     * @param immediate Publish without waiting for the normal interval
+     */
+    using Emit = void (*)(const char* reason, bool immediate);
+
+    /**
+     * @brief Change the window and bucket settings, buckets start out full again
+     *
+     */
+    void configure(const Settings& settings);
+
+    /**
+     * @brief Record a trigger
+     *
+     * @param reason Trigger reason, copied
+     * @param immediate Trigger asks for an immediate publish
+     * @param now Current millisecond timestamp
+     * @return true Trigger goes out with the current window
+     * @return false Trigger was suppressed
+     */
+    bool submit(const char* reason, bool immediate, uint32_t now);
+
+    /**
+     * @brief Hand out the gathered reasons once the window has closed
+     *
+     * @param now Current millisecond timestamp
+     * @param emit Called once for every gathered reason
+     * @return size_t Number of reasons handed out
+     */
+    size_t flush(uint32_t now, Emit emit);
+
+    /**
+     * @brief Triggers suppressed since the last call
+     *
+     */
+    uint32_t takeSuppressed() {
+        auto suppressed = _suppressed;
+        _suppressed = 0;
+        return suppressed;
+    }
+
+    /**
+     * @brief Triggers suppressed since construction
+     *
+     */
+    uint32_t getSuppressedTotal() const {
+        return _suppressedTotal;
+    }
+
+    /**
+     * @brief Triggers merged into a window that already held their reason since construction
+     *
+     */
+    uint32_t getMergedTotal() const {
+        return _mergedTotal;
+    }
+
+private:
+    struct Reason {
+        char name[REASON_LENGTH];
+        uint32_t credit;                        ///< Milliseconds of refill earned, refillMs per token
+        uint32_t updated;
+        bool used;
+        bool pending;
+    };
+
+    Reason* find(const char* name, uint32_t now);
+    uint32_t capacity() const {
+        return _settings.burst * _settings.refillMs;
+    }
+
+    Settings _settings {0, 0, 0};
+    Reason _reasons[REASON_COUNT] {};
+    bool _open {false};
+    bool _immediate {false};
+    uint32_t _openedAt {0};
+    uint32_t _suppressed {0};
+    uint32_t _suppressedTotal {0};
+    uint32_t _mergedTotal {0};
+};
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "WaveformCapture.h"
+#include "SampleCoding.h"
+
+
+bool WaveformCapture::configure(size_t depth, size_t preTrigger, uint32_t divider) {
+    if ((0 == depth) || (depth > _capacity) || (preTrigger >= depth)) {
+        return false;
+    }
+
+    _state = State::Disabled;
+    _depth = depth;
+    _pre = preTrigger;
+    _post = depth - preTrigger;
+    _divider = (divider) ? divider : 1;
+    _tick = 0;
+    _head = 0;
+    _count = 0;
+    _state = State::Armed;
+
+    return true;
+}
+
+void WaveformCapture::disable() {
+    _state = State::Disabled;
+    _head = 0;
+    _count = 0;
+}
+
+void WaveformCapture::push(uint16_t ch0, uint16_t ch1) {
+    auto state = _state.load();
+    if ((State::Armed != state) && (State::Triggered != state)) {
+        return;
+    }
+
+    if (++_tick < _divider) {
+        return;
+    }
+    _tick = 0;
+
+    auto frame = &_storage[_head * CHANNELS];
+    frame[0] = ch0;
+    frame[1] = ch1;
+    _head = (_head + 1) % _depth;
+    if (_count < _depth) {
+        _count++;
+    }
+
+    if ((State::Triggered == state) && (0 == --_remaining)) {
+        _state = State::Frozen;
+    }
+}
+
+bool WaveformCapture::trigger(const char* reason) {
+    if (State::Armed != _state.load()) {
+        return false;
+    }
+
+    _reason = reason;
+    _id++;
+    _remaining = _post;
+    _state = State::Triggered;
+
+    return true;
+}
+
+void WaveformCapture::rearm() {
+    if (State::Frozen != _state.load()) {
+        return;
+    }
+
+    _tick = 0;
+    _head = 0;
+    _count = 0;
+    _state = State::Armed;
+}
+
+size_t WaveformCapture::encode(size_t& cursor, uint8_t* out, size_t size) const {
+    if (State::Frozen != _state.load()) {
+        return 0;
+    }
+
+    // Oldest frame sits at the write head once the ring has wrapped
+    auto oldest = (_count < _depth) ? 0 : _head;
+    int32_t last[CHANNELS] {};
+    size_t written = 0;
+
+    while ((cursor < _count) && ((size - written) >= MAX_FRAME_BYTES)) {
+        auto frame = &_storage[((oldest + cursor) % _depth) * CHANNELS];
+        for (size_t channel = 0; channel < CHANNELS; channel++) {
+            auto delta = (int32_t)frame[channel] - last[channel];
+            last[channel] = (int32_t)frame[channel];
+            written += varintWrite(zigzagEncode(delta), &out[written], size - written);
+        }
+        cursor++;
+    }
+
+    return written;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief Pre/post trigger capture of raw analog samples into a RAM ring buffer
+ *
+ * @details Samples are pushed continuously from the sample timer while armed.  A trigger
+ *          records a fixed number of post trigger frames and then freezes the ring so that
+ *          it can be encoded and uploaded at leisure.  Each frame holds one sample per channel.
+ */
+class WaveformCapture {
+public:
+    static constexpr size_t CHANNELS {2};
+    static constexpr size_t MAX_FRAME_BYTES {CHANNELS * 5}; // Worst case varint length for each channel
+
+    enum class State : uint8_t {
+        Disabled,
+        Armed,
+        Triggered,
+        Frozen,
+    };
+
+    /**
+     * @brief Construct a new capture object over caller supplied storage
+     *
+     * @param storage Sample storage of at least CHANNELS * capacity elements
+     * @param capacity Maximum number of frames the storage can hold
+     */
+    WaveformCapture(uint16_t* storage, size_t capacity)
+        : _storage(storage), _capacity(capacity) {}
+
+    /**
+     * @brief Apply new capture settings and arm the capture
+     *
+     * @param depth Total number of frames captured
+     * @param preTrigger Number of frames kept from before the trigger
+     * @param divider Number of sample timer ticks per captured frame
+     * @return true Settings accepted and capture armed
+     * @return false Settings do not fit the storage
+     */
+    bool configure(size_t depth, size_t preTrigger, uint32_t divider);
+
+    /**
+     * @brief Stop capturing and discard any captured frames
+     *
+     */
+    void disable();
+
+    /**
+     * @brief Push one frame of raw samples, called from the sample timer
+     *
+     * @param ch0 Sample for the first channel
+     * @param ch1 Sample for the second channel
+     */
+    void push(uint16_t ch0, uint16_t ch1);
+
+    /**
+     * @brief Start the post trigger phase of an armed capture
+     *
+     * @param reason Static string describing the trigger
+     * @return true Capture triggered
+     * @return false Capture was not armed
+     */
+    bool trigger(const char* reason);
+
+    /**
+     * @brief Discard the frozen capture and start collecting again
+     *
+     */
+    void rearm();
+
+    /**
+     * @brief Delta and variable length encode frozen frames
+     *
+     * @details The first frame of each call is encoded relative to zero so that every chunk
+     *          can be decoded on its own.  Channels are interleaved within each frame.
+     *
+     * @param cursor Index of the next frame to encode, advanced past the frames encoded
+     * @param out Output buffer
+     * @param size Size of the output buffer
+     * @return size_t Number of bytes written
+     */
+    size_t encode(size_t& cursor, uint8_t* out, size_t size) const;
+
+    State getState() const {
+        return _state.load();
+    }
+
+    /**
+     * @brief Number of frames held by a frozen capture
+     *
+     */
+    size_t getFrames() const {
+        return _count;
+    }
+
+    /**
+     * @brief Number of frozen frames collected before the trigger
+     *
+     */
+    size_t getPreTriggerFrames() const {
+        return (_count > _post) ? (_count - _post) : 0;
+    }
+
+    const char* getReason() const {
+        return _reason;
+    }
+
+    /**
+     * @brief Identifier that increments with every trigger
+     *
+     */
+    uint32_t getId() const {
+        return _id;
+    }
+
+private:
+    uint16_t* _storage;
+    size_t _capacity;
+    size_t _depth {0};
+    size_t _pre {0};
+    size_t _post {0};
+    uint32_t _divider {1};
+    uint32_t _tick {0};
+    size_t _head {0};
+    size_t _count {0};
+    std::atomic<size_t> _remaining {0};
+    std::atomic<State> _state {State::Disabled};
+    const char* _reason {""};
+    uint32_t _id {0};
+};
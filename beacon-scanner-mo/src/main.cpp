@@ -3,6 +3,7 @@
 
 #include "Particle.h"
 #include "edge.h"
+#include "user_config.h"
 
 #include <BeaconScanner.h>
 
@@ -40,6 +41,7 @@ void setup()
     Serial.begin(115200);
     Wire.begin();
     Edge::instance().init();
+    publishInit();
 
     BLE.on();
     Scanner.setCallback(scanCb);
@@ -66,7 +68,8 @@ void loop()
             writer.name("beacon_minor").value(ibeacon.getMinor());
             writer.name("distance_m").value(estDistance);
             writer.endObject();
-            Particle.publish("BEACON-DIST", jsonBuf);
+            // The web app takes one reading per BEACON-DIST event, so it never goes out packed
+            publishSubmit(PublishArbiter::Priority::Data, "BEACON-DIST", jsonBuf, false);
         }
 
         lastTime = millis();
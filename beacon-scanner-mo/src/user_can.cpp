@@ -0,0 +1,845 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "user_config.h"
+
+#include "Particle.h"
+#include "config_service.h"
+#include "ConfigSnapshot.h"
+#include "CanSignal.h"
+#include "CanTransport.h"
+
+#include <cmath>
+
+#if defined(CAN_SOCKETCAN) && CAN_SOCKETCAN
+#include "SocketCanTransport.h"
+#else
+#include "McpCanTransport.h"
+#endif
+
+
+//
+// Constants
+//
+enum class CanBitrate {
+    Kbps125,
+    Kbps250,
+    Kbps500,
+    Kbps1000,
+};
+
+static constexpr size_t CAN_REQUEST_COUNT               {4};    // Request frames sent on a schedule
+static constexpr size_t CAN_SIGNAL_TEXT_LENGTH          {64};   // Longest compact signal definition
+static constexpr size_t CAN_REQUEST_TEXT_LENGTH         {48};   // Longest compact request definition
+static constexpr CanBitrate CAN_BITRATE_DEFAULT         {CanBitrate::Kbps250};  // J1939 rate
+static constexpr int32_t CAN_INTERVAL_DEFAULT           {60};   // Seconds between signal reports
+static constexpr size_t CAN_RECEIVE_BATCH               {64};   // Most frames taken before due requests are checked
+static constexpr uint32_t CAN_WAIT_MAX_MS               {1000}; // Longest sleep of the CAN thread
+static constexpr uint32_t CAN_PUBLISH_WAIT_MS           {1000}; // Time between events while a report is waiting
+static constexpr size_t CAN_PUBLISH_SIZE                {1024}; // Largest event payload
+static constexpr size_t CAN_PUBLISH_ENTRY_MAX           {112};  // Longest serialized signal
+static constexpr size_t CAN_PUBLISH_TAIL_MAX            {160};  // Room kept for the bus statistics and closing brackets
+static constexpr char CAN_SOCKET_INTERFACE[]            {"vcan0"};
+
+
+//
+// Global variables
+//
+static Logger monitorOneLog("IoCan");
+static Thread* canThread;
+
+struct CanSettings {
+    bool enabled;
+    CanBitrate bitrate;
+    bool listen;                                ///< Listen only, never transmit or acknowledge
+    int32_t interval;                           ///< Seconds between signal reports
+};
+
+struct CanRequest {
+    bool enabled;
+    uint32_t periodMs;
+    CanFrame frame;
+};
+
+// Everything the CAN thread works from, swapped in whole so that it never sees a half written change
+struct CanTable {
+    CanSettings settings;
+    CanSignal signals[CAN_SIGNAL_COUNT];
+    CanRequest requests[CAN_REQUEST_COUNT];
+};
+
+static CanSettings canSettings {false, CAN_BITRATE_DEFAULT, false, CAN_INTERVAL_DEFAULT};
+static CanSettings canSettingsShadow {canSettings};
+
+static CanTable canTables[2] {};
+static ConfigSnapshot<CanTable> canTable(&canTables[0], &canTables[1], 1);
+static CanTable canShadow {};                   // Tables being written, only touched by the config service
+
+// Names of the signal and request configuration nodes
+struct CanKey {
+    char name[4];
+    uint16_t index;
+};
+
+static CanKey canSignalKeys[CAN_SIGNAL_COUNT];
+static CanKey canRequestKeys[CAN_REQUEST_COUNT];
+
+// Aggregates kept lean so that the receive path stays cheap at full bus load
+struct CanSignalStats {
+    uint32_t count;
+    float min;
+    float max;
+    double sum;
+    float last;
+};
+
+struct CanBusStats {
+    uint32_t received;
+    uint32_t matched;                           ///< Frames carrying at least one signal
+    uint32_t overruns;                          ///< Frames lost to full receive buffers
+    uint32_t sent;
+    uint32_t sendFailures;
+    uint32_t dropped;                           ///< Report events the publish queue turned away
+    uint64_t bits;                              ///< Bits received, without stuff bits
+};
+
+// Statistics for the current interval and the last finished one, only touched by the CAN thread
+static CanSignalStats canStats[CAN_SIGNAL_COUNT] {};
+static CanBusStats canBusStats {};
+static CanSignalStats canReport[CAN_SIGNAL_COUNT] {};
+static CanBusStats canBusReport {};
+static uint32_t canReportMs {0};                // Length of the reported interval
+static size_t canReportCursor {CAN_SIGNAL_COUNT};
+static bool canReportPending {false};
+static uint32_t canRequestDue[CAN_REQUEST_COUNT] {};
+
+#if defined(CAN_SOCKETCAN) && CAN_SOCKETCAN
+static SocketCanTransport canSocketBus(CAN_SOCKET_INTERFACE);
+static CanTransport& canBus {canSocketBus};
+#else
+static MCP_CAN canController(CAN_CS, SPI1);
+static McpCanTransport canControllerBus(canController, CAN_INT);
+static CanTransport& canBus {canControllerBus};
+#endif
+
+
+//
+// Functions
+//
+
+/**
+ * @brief Split text in place at commas, keeping empty fields
+ *
+ * @param text Text to split
+ * @param fields Receives the start of each field
+ * @param size Size of the field list
+ * @return size_t Number of fields, size + 1 if there were more
+ */
+static size_t canSplit(char* text, char** fields, size_t size)
+{
+    size_t count = 0;
+    for (auto field = text; field; count++)
+    {
+        if (count == size)
+        {
+            return size + 1;
+        }
+        fields[count] = field;
+        field = strchr(field, ',');
+        if (field)
+        {
+            *field++ = '\0';
+        }
+    }
+    return count;
+}
+
+static uint32_t canBitrateToBps(CanBitrate bitrate)
+{
+    switch (bitrate)
+    {
+        case CanBitrate::Kbps125:   return 125000;
+        case CanBitrate::Kbps250:   return 250000;
+        case CanBitrate::Kbps500:   return 500000;
+        case CanBitrate::Kbps1000:  return 1000000;
+    }
+    return 0;
+}
+
+/**
+ * @brief Parse a compact signal definition
+ *
+ * @details The definition is "id,mask,byte[.bit],bits[,scale[,offset[,flags]]]".  An empty
+ *          mask matches the identifier exactly.  Flags are x for an extended identifier, which
+ *          is implied by identifiers above 0x7ff, s for signed, m for Motorola byte order and n
+ *          to treat a raw value of all ones as not available.  The bit defaults to 0 for Intel
+ *          and 7 for Motorola signals.  An empty definition disables the signal.
+ *
+ * @param text Signal definition
+ * @param signal Signal to fill in
+ * @retval SYSTEM_ERROR_NONE Success
+ * @retval SYSTEM_ERROR_INVALID_ARGUMENT Definition is malformed
+ */
+static int canParseSignal(const char* text, CanSignal& signal)
+{
+    signal = {};
+    if ((nullptr == text) || ('\0' == text[0]))
+    {
+        return SYSTEM_ERROR_NONE;
+    }
+
+    char buffer[CAN_SIGNAL_TEXT_LENGTH + 1];
+    if (strlen(text) > CAN_SIGNAL_TEXT_LENGTH)
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    strcpy(buffer, text);
+
+    char* fields[7] {};
+    auto count = canSplit(buffer, fields, 7);
+    if ((count < 4) || (count > 7))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    char* end = nullptr;
+    auto flags = (count > 6) ? fields[6] : (char*)"";
+    if (strspn(flags, "xsmn") != strlen(flags))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    signal.motorola = (nullptr != strchr(flags, 'm'));
+    signal.isSigned = (nullptr != strchr(flags, 's'));
+    signal.notAvailable = (nullptr != strchr(flags, 'n'));
+
+    signal.id = strtoul(fields[0], &end, 0);
+    signal.extended = (nullptr != strchr(flags, 'x')) || (signal.id > 0x7ff);
+    auto full = (signal.extended) ? 0x1ffffffful : 0x7fful;
+    if (*end || ('\0' == fields[0][0]) || (signal.id > full))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    signal.mask = ('\0' == fields[1][0]) ? full : strtoul(fields[1], &end, 0);
+    if (*end || (signal.mask > full))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    signal.byte = (uint8_t)strtoul(fields[2], &end, 10);
+    signal.bit = (signal.motorola) ? 7 : 0;
+    if ('.' == *end)
+    {
+        signal.bit = (uint8_t)strtoul(end + 1, &end, 10);
+    }
+    if (*end)
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    signal.bits = (uint8_t)strtoul(fields[3], &end, 10);
+    if (*end)
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    if ((count > 4) && ('\0' != fields[4][0]))
+    {
+        signal.scale = strtod(fields[4], &end);
+        if (*end)
+        {
+            return SYSTEM_ERROR_INVALID_ARGUMENT;
+        }
+    }
+    if ((count > 5) && ('\0' != fields[5][0]))
+    {
+        signal.offset = strtod(fields[5], &end);
+        if (*end)
+        {
+            return SYSTEM_ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    if (!canDeriveSignal(signal))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    signal.id &= signal.mask;
+    signal.enabled = true;
+
+    return SYSTEM_ERROR_NONE;
+}
+
+/**
+ * @brief Format a signal as its compact definition
+ *
+ * @param signal Signal
+ * @param text Output text
+ * @param size Size of the output
+ */
+static void canFormatSignal(const CanSignal& signal, char* text, size_t size)
+{
+    if (!signal.enabled)
+    {
+        text[0] = '\0';
+        return;
+    }
+
+    char flags[5] {};
+    auto flag = flags;
+    if (signal.extended && (signal.id <= 0x7ff))
+    {
+        *flag++ = 'x';
+    }
+    if (signal.isSigned)
+    {
+        *flag++ = 's';
+    }
+    if (signal.motorola)
+    {
+        *flag++ = 'm';
+    }
+    if (signal.notAvailable)
+    {
+        *flag++ = 'n';
+    }
+    snprintf(text, size, "0x%lx,0x%lx,%u.%u,%u,%g,%g%s%s", (unsigned long)signal.id, (unsigned long)signal.mask,
+        (unsigned int)signal.byte, (unsigned int)signal.bit, (unsigned int)signal.bits, signal.scale, signal.offset,
+        (flags[0]) ? "," : "", flags);
+}
+
+/**
+ * @brief Parse a compact request definition
+ *
+ * @details The definition is "id,data,period[,x]" where data is up to eight bytes in hex and
+ *          period is in seconds, or milliseconds with an ms suffix.  The x flag sends an
+ *          extended identifier, which is implied by identifiers above 0x7ff.  An empty
+ *          definition disables the request.
+ *
+ * @param text Request definition
+ * @param request Request to fill in
+ * @retval SYSTEM_ERROR_NONE Success
+ * @retval SYSTEM_ERROR_INVALID_ARGUMENT Definition is malformed
+ */
+static int canParseRequest(const char* text, CanRequest& request)
+{
+    request = {};
+    if ((nullptr == text) || ('\0' == text[0]))
+    {
+        return SYSTEM_ERROR_NONE;
+    }
+
+    char buffer[CAN_REQUEST_TEXT_LENGTH + 1];
+    if (strlen(text) > CAN_REQUEST_TEXT_LENGTH)
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    strcpy(buffer, text);
+
+    char* fields[4] {};
+    auto count = canSplit(buffer, fields, 4);
+    if ((count < 3) || (count > 4) || ((4 == count) && strcmp(fields[3], "x")))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    char* end = nullptr;
+    auto& frame = request.frame;
+    frame.id = strtoul(fields[0], &end, 0);
+    frame.extended = (4 == count) || (frame.id > 0x7ff);
+    if (*end || ('\0' == fields[0][0]) || (frame.id > ((frame.extended) ? 0x1ffffffful : 0x7fful)))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    auto digits = strlen(fields[1]);
+    if ((digits & 1) || (digits > 16) || (strspn(fields[1], "0123456789abcdefABCDEF") != digits))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    frame.length = (uint8_t)(digits / 2);
+    for (size_t i = 0; i < frame.length; i++)
+    {
+        char byte[3] = {fields[1][2 * i], fields[1][2 * i + 1], '\0'};
+        frame.data[i] = (uint8_t)strtoul(byte, nullptr, 16);
+    }
+
+    auto period = strtoul(fields[2], &end, 10);
+    if (0 == strcmp(end, "ms"))
+    {
+        end += 2;
+    }
+    else
+    {
+        period *= 1000;
+    }
+    if (*end || (period < 10))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    request.periodMs = period;
+    request.enabled = true;
+
+    return SYSTEM_ERROR_NONE;
+}
+
+/**
+ * @brief Format a request as its compact definition
+ *
+ * @param request Request
+ * @param text Output text
+ * @param size Size of the output
+ */
+static void canFormatRequest(const CanRequest& request, char* text, size_t size)
+{
+    if (!request.enabled)
+    {
+        text[0] = '\0';
+        return;
+    }
+
+    auto& frame = request.frame;
+    auto length = snprintf(text, size, "0x%lx,", (unsigned long)frame.id);
+    for (size_t i = 0; i < frame.length; i++)
+    {
+        length += snprintf(text + length, size - min((size_t)length, size), "%02X", frame.data[i]);
+    }
+    if (0 == (request.periodMs % 1000))
+    {
+        length += snprintf(text + length, size - min((size_t)length, size), ",%lu", (unsigned long)(request.periodMs / 1000));
+    }
+    else
+    {
+        length += snprintf(text + length, size - min((size_t)length, size), ",%lums", (unsigned long)request.periodMs);
+    }
+    if (frame.extended && (frame.id <= 0x7ff))
+    {
+        snprintf(text + length, size - min((size_t)length, size), ",x");
+    }
+}
+
+/**
+ * @brief Start the controller with the settings and filters of a table
+ *
+ * @param table Configuration
+ * @return true Controller running
+ */
+static bool canStart(const CanTable& table)
+{
+    CanFilter wanted[CAN_SIGNAL_COUNT];
+    size_t count = 0;
+    for (auto& signal: table.signals)
+    {
+        if (signal.enabled)
+        {
+            wanted[count++] = {signal.id, signal.mask, signal.extended};
+        }
+    }
+
+    CanFilterPlan plan;
+    canPlanFilters(wanted, count, plan);
+    auto bitrate = canBitrateToBps(table.settings.bitrate);
+    if (!canBus.begin(bitrate, table.settings.listen, plan))
+    {
+        monitorOneLog.error("CAN controller did not start at %lu bps", bitrate);
+        return false;
+    }
+
+    monitorOneLog.info("CAN running at %lu bps%s with %u signals", bitrate, (table.settings.listen) ? " listen only" : "", (unsigned int)count);
+    return true;
+}
+
+/**
+ * @brief Decode every signal a received frame carries and fold it into the interval statistics
+ *
+ * @param table Configuration
+ * @param frame Received frame
+ */
+static void canHandleFrame(const CanTable& table, const CanFrame& frame)
+{
+    canBusStats.received++;
+    canBusStats.bits += canFrameBits(frame);
+
+    auto matched = false;
+    for (size_t i = 0; i < CAN_SIGNAL_COUNT; i++)
+    {
+        auto& signal = table.signals[i];
+        double value;
+        if (!signal.matches(frame) || !canDecodeSignal(signal, frame, value))
+        {
+            continue;
+        }
+        matched = true;
+
+        auto& stats = canStats[i];
+        auto sample = (float)value;
+        stats.min = (0 == stats.count) ? sample : min(stats.min, sample);
+        stats.max = (0 == stats.count) ? sample : max(stats.max, sample);
+        stats.sum += value;
+        stats.last = sample;
+        stats.count++;
+        ioUpdateCanChannel((int)i, value);
+    }
+    canBusStats.matched += (matched) ? 1 : 0;
+}
+
+/**
+ * @brief Publish the finished interval, as many events as it takes one event a second
+ *
+ * @param table Configuration
+ */
+static void canPublishReport(const CanTable& table)
+{
+    static char publishBuffer[CAN_PUBLISH_SIZE + 1];
+    memset(publishBuffer, 0, sizeof(publishBuffer));
+    JSONBufferWriter writer(publishBuffer, CAN_PUBLISH_SIZE);
+    writer.beginObject();
+    writer.name("can").beginArray();
+    while ((canReportCursor < CAN_SIGNAL_COUNT) &&
+        ((writer.dataSize() + CAN_PUBLISH_ENTRY_MAX + CAN_PUBLISH_TAIL_MAX) <= CAN_PUBLISH_SIZE))
+    {
+        auto i = canReportCursor++;
+        auto& stats = canReport[i];
+        if (!table.signals[i].enabled || (0 == stats.count))
+        {
+            continue;
+        }
+
+        char name[16];
+        snprintf(name, sizeof(name), "can%u", (unsigned int)(i + 1));
+        writer.beginObject();
+        writer.name("name").value(name);
+        writer.name("n").value((unsigned long)stats.count);
+        writer.name("avg").value(stats.sum / (double)stats.count, 3);
+        writer.name("min").value(stats.min, 3);
+        writer.name("max").value(stats.max, 3);
+        writer.name("last").value(stats.last, 3);
+        writer.endObject();
+    }
+    writer.endArray();
+
+    // Bus statistics go with the last event of the report
+    if (CAN_SIGNAL_COUNT == canReportCursor)
+    {
+        auto bitrate = canBitrateToBps(table.settings.bitrate);
+        writer.name("bus").beginObject();
+        writer.name("rx").value((unsigned long)canBusReport.received);
+        writer.name("match").value((unsigned long)canBusReport.matched);
+        writer.name("ovr").value((unsigned long)canBusReport.overruns);
+        writer.name("tx").value((unsigned long)canBusReport.sent);
+        writer.name("txf").value((unsigned long)canBusReport.sendFailures);
+        writer.name("drop").value((unsigned long)canBusReport.dropped);
+        if (bitrate && canReportMs)
+        {
+            writer.name("load").value((double)canBusReport.bits * 100.0 / ((double)bitrate * (double)canReportMs / 1000.0), 1);
+        }
+        writer.endObject();
+        canReportPending = false;
+    }
+    writer.endObject();
+
+    if (!publishSubmit(PublishArbiter::Priority::Data, "can", publishBuffer))
+    {
+        canBusStats.dropped++;
+    }
+}
+
+/**
+ * @brief CAN thread receiving frames, sending scheduled requests and reporting signals
+ *
+ * @details Frames are decoded as they are drained from the controller.  The controller is
+ *          restarted whenever the configuration changes, since its filters follow the signal
+ *          table.
+ *
+ * @param param Unused
+ */
+void canThreadLoop(void* param)
+{
+    auto epoch = canTable.getEpoch() - 1;
+    auto running = false;
+    auto intervalStart = millis();
+    uint32_t publishMs = 0;
+
+    while (true)
+    {
+        const auto& table = *canTable.acquire();
+        auto now = millis();
+        if (canTable.getEpoch() != epoch)
+        {
+            epoch = canTable.getEpoch();
+            running = table.settings.enabled && canStart(table);
+            for (size_t i = 0; i < CAN_REQUEST_COUNT; i++)
+            {
+                canRequestDue[i] = now;
+            }
+        }
+
+        size_t received = 0;
+        if (running)
+        {
+            CanFrame frame;
+            while ((received < CAN_RECEIVE_BATCH) && canBus.receive(frame))
+            {
+                received++;
+                canHandleFrame(table, frame);
+            }
+
+            for (size_t i = 0; !table.settings.listen && (i < CAN_REQUEST_COUNT); i++)
+            {
+                auto& request = table.requests[i];
+                if (!request.enabled || ((int32_t)(now - canRequestDue[i]) < 0))
+                {
+                    continue;
+                }
+                // Keep a fixed cadence unless the request fell a whole period behind
+                canRequestDue[i] += request.periodMs;
+                if ((int32_t)(now - canRequestDue[i]) >= 0)
+                {
+                    canRequestDue[i] = now + request.periodMs;
+                }
+                if (canBus.send(request.frame))
+                {
+                    canBusStats.sent++;
+                }
+                else
+                {
+                    canBusStats.sendFailures++;
+                }
+            }
+        }
+
+        // Roll the interval over, the previous report is dropped if it never got out
+        if (running && ((now - intervalStart) >= (uint32_t)table.settings.interval * 1000))
+        {
+            canBusStats.overruns += canBus.takeOverruns();
+            memcpy(canReport, canStats, sizeof(canReport));
+            canBusReport = canBusStats;
+            canReportMs = now - intervalStart;
+            canReportCursor = 0;
+            canReportPending = true;
+            memset(canStats, 0, sizeof(canStats));
+            canBusStats = {};
+            intervalStart = now;
+
+            // Signals that went quiet no longer hold up threshold rules
+            for (size_t i = 0; i < CAN_SIGNAL_COUNT; i++)
+            {
+                if (0 == canReport[i].count)
+                {
+                    ioUpdateCanChannel((int)i, NAN);
+                }
+            }
+        }
+        if (canReportPending && ((now - publishMs) >= CAN_PUBLISH_WAIT_MS))
+        {
+            publishMs = now;
+            canPublishReport(table);
+        }
+
+        // Sleep until a frame arrives, a request is due or a report event can go out
+        uint32_t wait = CAN_WAIT_MAX_MS;
+        for (size_t i = 0; running && !table.settings.listen && (i < CAN_REQUEST_COUNT); i++)
+        {
+            if (table.requests[i].enabled)
+            {
+                auto delta = (int32_t)(canRequestDue[i] - now);
+                wait = (delta <= 0) ? 0 : min(wait, (uint32_t)delta);
+            }
+        }
+        canTable.release();
+
+        if (received == CAN_RECEIVE_BATCH)
+        {
+            // More frames are probably waiting
+            os_thread_yield();
+        }
+        else if (running)
+        {
+            canBus.wait(wait);
+        }
+        else
+        {
+            delay(wait);
+        }
+    }
+}
+
+/**
+ * @brief Start editing the CAN configuration
+ *
+ * @param write Indicates whether the current operation is to write
+ * @param context Unused
+ * @return int Zero (success) always
+ */
+static int canConfigEnter(bool write, const void *context)
+{
+    if (write)
+    {
+        canSettingsShadow = canSettings;
+        memcpy(&canShadow, canTable.current(), sizeof(canShadow));
+    }
+    return 0;
+}
+
+/**
+ * @brief Swap in the edited CAN configuration and wake the CAN thread through the new epoch
+ *
+ * @param write Indicates whether the current operation is to write
+ * @param status Status of the command return value
+ * @param context Unused
+ * @return int The command return value
+ */
+static int canConfigExit(bool write, int status, const void *context)
+{
+    if (write && (0 == status))
+    {
+        canSettings = canSettingsShadow;
+        canShadow.settings = canSettings;
+        auto table = canTable.edit([]() {delay(1);});
+        memcpy(table, &canShadow, sizeof(canShadow));
+        canTable.commit();
+    }
+    return status;
+}
+
+/**
+ * @brief Create the configuration node for one signal table entry
+ *
+ * @param n Zero based signal number
+ * @return ConfigString Node that reads and writes the compact signal definition
+ */
+static ConfigString canSignalNode(size_t n)
+{
+    auto& key = canSignalKeys[n];
+    snprintf(key.name, sizeof(key.name), "s%u", (unsigned int)(n + 1));
+    key.index = (uint16_t)n;
+
+    return ConfigString(key.name,
+        [](const char * &value, const void *context) {
+            static char text[CAN_SIGNAL_TEXT_LENGTH + 1];
+            canFormatSignal(canTable.current()->signals[((const CanKey*)context)->index], text, sizeof(text));
+            value = text;
+            return 0;
+        },
+        [](const char * value, const void *context) {
+            return canParseSignal(value, *(CanSignal*)context);
+        },
+        &key, &canShadow.signals[n]);
+}
+
+/**
+ * @brief Create the configuration node for one request table entry
+ *
+ * @param n Zero based request number
+ * @return ConfigString Node that reads and writes the compact request definition
+ */
+static ConfigString canRequestNode(size_t n)
+{
+    auto& key = canRequestKeys[n];
+    snprintf(key.name, sizeof(key.name), "r%u", (unsigned int)(n + 1));
+    key.index = (uint16_t)n;
+
+    return ConfigString(key.name,
+        [](const char * &value, const void *context) {
+            static char text[CAN_REQUEST_TEXT_LENGTH + 1];
+            canFormatRequest(canTable.current()->requests[((const CanKey*)context)->index], text, sizeof(text));
+            value = text;
+            return 0;
+        },
+        [](const char * value, const void *context) {
+            return canParseRequest(value, *(CanRequest*)context);
+        },
+        &key, &canShadow.requests[n]);
+}
+
+/**
+ * @brief Register the CAN configuration objects
+ *
+ * @details The "can" object holds the bus settings, "can_sigs" the signal table and
+ *          "can_reqs" the request frames sent on a schedule.
+ */
+static void buildCanSettings()
+{
+    static ConfigObject canConfig("can", {
+        ConfigBool("enable",
+            config_get_bool_cb, config_set_bool_cb,
+            &canSettings.enabled, &canSettingsShadow.enabled),
+        ConfigStringEnum("bitrate", {
+                {"125", (int32_t) CanBitrate::Kbps125},
+                {"250", (int32_t) CanBitrate::Kbps250},
+                {"500", (int32_t) CanBitrate::Kbps500},
+                {"1000", (int32_t) CanBitrate::Kbps1000},
+            },
+            config_get_int32_cb, config_set_int32_cb,
+            &canSettings.bitrate, &canSettingsShadow.bitrate),
+        ConfigBool("listen",
+            config_get_bool_cb, config_set_bool_cb,
+            &canSettings.listen, &canSettingsShadow.listen),
+        ConfigInt("interval",
+            config_get_int32_cb, config_set_int32_cb,
+            &canSettings.interval, &canSettingsShadow.interval,
+            1, 86400),
+    },
+    canConfigEnter, canConfigExit);
+    ConfigService::instance().registerModule(canConfig);
+
+    static_assert(16 == CAN_SIGNAL_COUNT, "Signal configuration expects 16 signals");
+    static ConfigObject canSignalConfig("can_sigs", {
+        canSignalNode(0), canSignalNode(1), canSignalNode(2), canSignalNode(3),
+        canSignalNode(4), canSignalNode(5), canSignalNode(6), canSignalNode(7),
+        canSignalNode(8), canSignalNode(9), canSignalNode(10), canSignalNode(11),
+        canSignalNode(12), canSignalNode(13), canSignalNode(14), canSignalNode(15),
+    },
+    canConfigEnter, canConfigExit);
+    ConfigService::instance().registerModule(canSignalConfig);
+
+    static_assert(4 == CAN_REQUEST_COUNT, "Request configuration expects 4 requests");
+    static ConfigObject canRequestConfig("can_reqs", {
+        canRequestNode(0), canRequestNode(1), canRequestNode(2), canRequestNode(3),
+    },
+    canConfigEnter, canConfigExit);
+    ConfigService::instance().registerModule(canRequestConfig);
+}
+
+/**
+ * @brief Power up the CAN controller, register the configuration and start the CAN thread
+ *
+ * @return int Zero (success) always
+ */
+int canInit()
+{
+#if !(defined(CAN_SOCKETCAN) && CAN_SOCKETCAN)
+    // Transceiver out of standby, then a clean reset of the controller
+    pinMode(CAN_PWR, OUTPUT);
+    digitalWrite(CAN_PWR, HIGH);
+    pinMode(CAN_STBY, OUTPUT);
+    digitalWrite(CAN_STBY, LOW);
+    pinMode(CAN_RST, OUTPUT);
+    digitalWrite(CAN_RST, LOW);
+    delay(50);
+    digitalWrite(CAN_RST, HIGH);
+#endif
+
+    canTables[0].settings = canSettings;
+    buildCanSettings();
+
+    if (nullptr == canThread)
+    {
+        canThread = new Thread("can", canThreadLoop, nullptr, OS_THREAD_PRIORITY_DEFAULT, 3*1024);
+    }
+    return 0;
+}
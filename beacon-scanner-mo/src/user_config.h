@@ -18,12 +18,22 @@
 
 #include "tracker_config.h"             // For TSOM related configuration
 #include "monitor_one_config.h"         // For Monitor One related configuration
+#include "PublishArbiter.h"
 
 #define MONITOR_ONE_SUPPORT_PROTO       (1)
 #define MONITOR_ONE_SUPPORT_IOEXP       (1)
+#ifndef MODBUS_SIMULATOR
+#define MODBUS_SIMULATOR                (0)     // Poll simulated slaves instead of the RS-485 port
+#endif
+#ifndef CAN_SOCKETCAN
+#define CAN_SOCKETCAN                   (0)     // Use the Linux SocketCAN interface vcan0 instead of the CAN controller
+#endif
 
 using MonitorOneCardFunction = std::function<int(void)>;
 
+int publishInit();
+bool publishSubmit(PublishArbiter::Priority priority, const char* name, const char* data, bool packable = true);
+
 #if defined(MONITOR_ONE_SUPPORT_PROTO) && MONITOR_ONE_SUPPORT_PROTO
 constexpr char MONITOREDGE_PROTO_SKU[]  {"EXP1_PROTO"};
 #endif // MONITOR_ONE_SUPPORT_PROTO
@@ -31,6 +41,30 @@ constexpr char MONITOREDGE_PROTO_SKU[]  {"EXP1_PROTO"};
 
 #if defined(MONITOR_ONE_SUPPORT_IOEXP) && MONITOR_ONE_SUPPORT_IOEXP
 #include "monitor_edge_ioexpansion.h"
+static constexpr int MODBUS_CLIENT_COUNT        {3};    // Points configured through modbusN objects
+static constexpr int MODBUS_TABLE_PAGE_POINTS   {16};   // Points configured through each modbus_ptsN page
+static constexpr int MODBUS_TABLE_PAGES         {8};
+static constexpr int MODBUS_TABLE_POINTS        {MODBUS_TABLE_PAGES * MODBUS_TABLE_PAGE_POINTS};
+static constexpr int MODBUS_POINT_COUNT         {MODBUS_CLIENT_COUNT + MODBUS_TABLE_POINTS};
 int expanderIoInit();
 int expanderIoLoop();
+void ioUpdateModbusChannel(int point, double value);
+int modbusQueueWrite(const char* text);
+int modbusValidateWrite(const char* text);
+
+static constexpr int CAN_SIGNAL_COUNT           {16};   // Signals configured through can_sigs
+int canInit();
+void ioUpdateCanChannel(int signal, double value);
+
+int modbusSlaveInit();
+void modbusSlaveSetInputs(float voltage, float current, bool digitalIn, bool relay, uint32_t pulses, float pulseRate);
+void modbusSlaveSetPoint(int point, float value);
+void modbusSlaveSetSignal(int signal, float value);
+bool modbusSlaveOwnsRs485();
+void modbusSlaveServeRs485(uint32_t gapUs, uint32_t durationMs);
+
+static constexpr int TIME_SERIES_IO_VOLTAGE     {0};    // Recorded series numbers
+static constexpr int TIME_SERIES_IO_CURRENT     {1};
+static constexpr int TIME_SERIES_MODBUS         {2};    // Plus zero based Modbus point index
+void timeSeriesRecord(int series, uint32_t ms, float value);
 #endif // MONITOR_ONE_SUPPORT_IOEXP
@@ -23,6 +23,16 @@
 #include "DebounceSwitchRK.h"
 #include "StatisticCollector.h"
 #include "ThresholdComparator.h"
+#include "FilterBank.h"
+#include "WaveformCapture.h"
+#include "SampleCoding.h"
+#include "StreamingStats.h"
+#include "ThresholdEngine.h"
+#include "PulseCounter.h"
+#include "RelayController.h"
+#include "TriggerCoalescer.h"
+
+#include <mutex>
 
 
 //
@@ -58,6 +68,67 @@ static constexpr double CURRENT_IN_HYST_HIGH        {0.002};  // Hysteresis for
 
 static constexpr double ANALOG_SAMPLE_MS            {10}; // 100Hz
 static constexpr double ANALOG_SAMPLE_S             {ANALOG_SAMPLE_MS / 1000.0};
+static constexpr double ANALOG_SAMPLE_HZ            {1.0 / ANALOG_SAMPLE_S};
+
+static constexpr double FILTER_NOTCH_Q_LOW          {0.5};
+static constexpr double FILTER_NOTCH_Q_HIGH         {50.0};
+static constexpr double FILTER_LPF_HIGH             {ANALOG_SAMPLE_HZ * 0.45};  // Keep the low pass section clear of Nyquist
+
+static constexpr size_t WAVEFORM_BUDGET_BYTES      {4096};  // RAM reserved for raw waveform capture
+static constexpr size_t WAVEFORM_CAPACITY           {WAVEFORM_BUDGET_BYTES / (sizeof(uint16_t) * WaveformCapture::CHANNELS)};
+static constexpr int32_t WAVEFORM_DEPTH_DEFAULT     {500};  // Frames
+static constexpr int32_t WAVEFORM_PRE_DEFAULT       {100};  // Frames
+static constexpr int32_t WAVEFORM_RATE_DEFAULT      {100};  // Hertz
+static constexpr size_t WAVEFORM_CHUNK_BYTES        {384};  // Binary bytes per upload event before base64 encoding
+static constexpr unsigned int WAVEFORM_CHUNK_MS     {1000};  // Minimum time between upload events
+
+static constexpr int32_t PULSE_MIN_PERIOD_DEFAULT   {200};  // Microseconds, rejects edges faster than 5kHz
+static constexpr int32_t PULSE_MIN_PERIOD_HIGH      {1000000};  // Microseconds
+static constexpr unsigned int PULSE_RATE_WINDOW_MS  {1000};  // Averaging window for the pulse rate variable
+
+static constexpr int32_t RELAY_MIN_TIME_HIGH        {86400};  // Seconds
+
+static constexpr int32_t TRIGGER_WINDOW_DEFAULT     {1000};  // Milliseconds triggers are gathered into one publish
+static constexpr int32_t TRIGGER_WINDOW_HIGH        {60000};
+static constexpr int32_t TRIGGER_BURST_DEFAULT      {3};  // Publishes a reason may cause back to back
+static constexpr int32_t TRIGGER_BURST_HIGH         {100};
+static constexpr int32_t TRIGGER_REFILL_DEFAULT     {60};  // Seconds to earn back one publish per reason
+static constexpr int32_t TRIGGER_REFILL_HIGH        {86400};
+
+// Channels available to threshold rules, Modbus points and then CAN signals follow the fixed inputs
+static constexpr uint16_t IO_CHANNEL_VOLTAGE        {0};
+static constexpr uint16_t IO_CHANNEL_CURRENT        {1};
+static constexpr uint16_t IO_CHANNEL_CURRENT_RAW    {2};  // Calibrated current before sensor scaling
+static constexpr uint16_t IO_CHANNEL_MODBUS         {3};
+static constexpr uint16_t IO_CHANNEL_CAN            {IO_CHANNEL_MODBUS + MODBUS_POINT_COUNT};
+static constexpr size_t IO_CHANNEL_COUNT            {IO_CHANNEL_CAN + CAN_SIGNAL_COUNT};
+
+// Built in threshold rules come first in the rule table, configurable rules follow
+static constexpr size_t IO_RULE_VOLTAGE_LOW         {0};
+static constexpr size_t IO_RULE_VOLTAGE_HIGH        {1};
+static constexpr size_t IO_RULE_CURRENT_LOW         {2};
+static constexpr size_t IO_RULE_CURRENT_HIGH        {3};
+static constexpr size_t IO_RULE_CURRENT_FAULT_LOW   {4};
+static constexpr size_t IO_RULE_CURRENT_FAULT_HIGH  {5};
+static constexpr size_t IO_RULE_RELAY               {6};  // Drives the relay when in rule mode
+static constexpr size_t IO_RULE_USER                {7};
+static constexpr size_t IO_USER_RULE_COUNT          {10};
+static constexpr size_t IO_RULE_COUNT               {IO_RULE_USER + IO_USER_RULE_COUNT};
+static constexpr size_t IO_RULE_WRITE_LENGTH        {48}; // Longest Modbus write request of a rule
+
+enum class MainsNotchType {
+    None,
+    Notch50Hz,
+    Notch60Hz,
+};
+
+enum class IoRuleChannel {
+    Voltage,
+    Current,
+    CurrentRaw,
+    Modbus,
+    Can,
+};
 
 enum class HvInputEdgeType {
     None,
@@ -66,12 +137,31 @@ enum class HvInputEdgeType {
     Both
 };
 
+enum class HvInputModeType {
+    Switch,
+    Pulse,
+};
+
+enum class RelayModeType {
+    Manual,
+    Rule,
+};
+
+enum class RelayInterlockType {
+    None,
+    InputOn,
+    InputOff,
+    CurrentFault,
+};
+
 
 //
 // Protypes
 //
 int modbusInit();
 int modbusLoop();
+int timeSeriesInit();
+int timeSeriesLoop();
 
 
 //
@@ -89,6 +179,8 @@ static ThresholdState CurrentInLowThState {};
 static ThresholdState CurrentInHighThState {};
 static bool CurrentInFaultLowThState {};
 static bool CurrentInFaultHighThState {};
+static double PulseRateValue {};
+static bool RelayOutValue {};
 
 // Configuration settings
 static double voltageCalGain {1.0};
@@ -96,54 +188,399 @@ static double voltageCalOffset {0.0};
 static double voltageSensorLow {VOLTAGE_IN_LOW};
 static double voltageSensorHigh {VOLTAGE_IN_HIGH};
 static double voltageFilterFc {1.0}; // Hertz
+static FilterBankSettings voltageFilterSettings {};
+static MainsNotchType voltageFilterNotch {MainsNotchType::None};
+static FilterBank voltageFilter {};
 static StatisticCollector<float> voltageIn(0.061, true); // For Fc=1Hz
-static ThresholdComparator<float> voltageLow(VOLTAGE_IN_THRESH_LOW);
-static bool voltageThresholdLowEnable {false};
-static double voltageThresholdLow {VOLTAGE_IN_THRESH_LOW};
-static double voltageHysteresisLow {VOLTAGE_IN_HYST_LOW};
-static ThresholdComparator<float> voltageHigh(VOLTAGE_IN_THRESH_HIGH);
-static bool voltageThresholdHighEnable {false};
-static double voltageThresholdHigh {VOLTAGE_IN_THRESH_HIGH};
-static double voltageHysteresisHigh {VOLTAGE_IN_HYST_HIGH};
+static StreamingStats voltageStats {};
 
 static double currentCalGain {1.0};
 static double currentCalOffset {0.0};
 static double currentSensorLow {CURRENT_IN_LOW};
 static double currentSensorHigh {CURRENT_IN_HIGH};
 static double currentFilterFc {1.0}; // Hertz
+static FilterBankSettings currentFilterSettings {};
+static MainsNotchType currentFilterNotch {MainsNotchType::None};
+static FilterBank currentFilter {};
 static StatisticCollector<float> currentIn(0.061, true); // For Fc=1Hz
-static ThresholdComparator<float> currentFaultLow(CURRENT_IN_FAULT_TH_LOW);
-static bool currentFaultLowEnable {false};
-static double currentFaultThresholdLow {CURRENT_IN_FAULT_TH_LOW};
-static double currentFaultHysteresisLow {CURRENT_IN_FAULT_HYST_LOW};
-static ThresholdComparator<float> currentFaultHigh(CURRENT_IN_FAULT_TH_HIGH);
-static bool currentFaultHighEnable {false};
-static double currentFaultThresholdHigh {CURRENT_IN_FAULT_TH_HIGH};
-static double currentFaultHysteresisHigh {CURRENT_IN_FAULT_HYST_HIGH};
-static ThresholdComparator<float> currentLow(CURRENT_IN_THRESH_LOW);
-static bool currentLowEnable {false};
-static double currentThresholdLow {CURRENT_IN_THRESH_LOW};
-static double currentHysteresisLow {CURRENT_IN_HYST_LOW};
-static ThresholdComparator<float> currentHigh(CURRENT_IN_THRESH_HIGH);
-static bool currentHighEnable {false};
-static double currentThresholdHigh {CURRENT_IN_THRESH_HIGH};
-static double currentHysteresisHigh {CURRENT_IN_HYST_HIGH};
+static StreamingStats currentStats {};
+
+struct ThresholdRuleConfig {
+    bool enabled;
+    IoRuleChannel channel;
+    int32_t point;                          // Modbus point number for Modbus channels
+    ThresholdDirection direction;
+    double threshold;
+    double hysteresis;
+    bool clear;
+    bool capture;
+    char event[ThresholdRule::EVENT_LENGTH + 1];
+    char write[IO_RULE_WRITE_LENGTH + 1];       // Modbus write queued when the rule is raised
+    char writeClear[IO_RULE_WRITE_LENGTH + 1];  // Modbus write queued when the rule clears
+};
+
+static ThresholdRuleConfig ioRuleConfigs[IO_RULE_COUNT] {
+    {false, IoRuleChannel::Voltage, 0, ThresholdDirection::Below, VOLTAGE_IN_THRESH_LOW, VOLTAGE_IN_HYST_LOW, false, false, "io_vlow"},
+    {false, IoRuleChannel::Voltage, 0, ThresholdDirection::Above, VOLTAGE_IN_THRESH_HIGH, VOLTAGE_IN_HYST_HIGH, false, true, "io_vhigh"},
+    {false, IoRuleChannel::Current, 0, ThresholdDirection::Below, CURRENT_IN_THRESH_LOW, CURRENT_IN_HYST_LOW, false, false, "io_alow"},
+    {false, IoRuleChannel::Current, 0, ThresholdDirection::Above, CURRENT_IN_THRESH_HIGH, CURRENT_IN_HYST_HIGH, false, false, "io_ahigh"},
+    {false, IoRuleChannel::CurrentRaw, 0, ThresholdDirection::Below, CURRENT_IN_FAULT_TH_LOW, CURRENT_IN_FAULT_HYST_LOW, true, false, "io_afltlow"},
+    {false, IoRuleChannel::CurrentRaw, 0, ThresholdDirection::Above, CURRENT_IN_FAULT_TH_HIGH, CURRENT_IN_FAULT_HYST_HIGH, true, true, "io_aflthigh"},
+    {false, IoRuleChannel::Current, 1, ThresholdDirection::Above, CURRENT_IN_THRESH_HIGH, CURRENT_IN_HYST_HIGH, false, false, "io_relay"},
+};
+static char ioRuleNames[IO_USER_RULE_COUNT][12] {};
+static ThresholdRule ioRules[IO_RULE_COUNT] {};
+static float ioChannels[IO_CHANNEL_COUNT] {};   // Single word stores are atomic so the modbus thread may write directly
+
+static void onThresholdRule(const ThresholdRule& rule, bool raised);
+static ThresholdEngine ioThresholds(ioRules, IO_RULE_COUNT, onThresholdRule);
+
+struct WaveformSettings {
+    bool enabled;
+    int32_t depth;
+    int32_t pre;
+    int32_t rate;
+};
+
+static WaveformSettings waveformSettings {false, WAVEFORM_DEPTH_DEFAULT, WAVEFORM_PRE_DEFAULT, WAVEFORM_RATE_DEFAULT};
+static WaveformSettings waveformSettingsShadow {waveformSettings};
+static uint16_t waveformStorage[WAVEFORM_CAPACITY * WaveformCapture::CHANNELS];
+static WaveformCapture waveform(waveformStorage, WAVEFORM_CAPACITY);
+static size_t waveformCursor {0};
+static unsigned int waveformSequence {0};
+static unsigned int waveformChunkTick {0};
 
 static bool inputPublishNow {false};
 static HvInputEdgeType inputEdgeType {HvInputEdgeType::None};
 static bool inputStateLast {false};
+static HvInputModeType inputMode {HvInputModeType::Switch};
+static HvInputEdgeType pulseEdgeType {HvInputEdgeType::Rising};
+static int32_t pulseMinPeriod {PULSE_MIN_PERIOD_DEFAULT};
+static PulseCounter pulseCounter {};
+static bool pulseAttached {false};
+static uint32_t pulseRateTotal {0};
+static unsigned int pulseRateTick {0};
+
+static RelayModeType relayMode {RelayModeType::Manual};
+static RelayInterlockType relayInterlock {RelayInterlockType::None};
+static ThresholdStale relayStale {ThresholdStale::Clear};  // Releases the relay when its channel has no value
+static int32_t relayMinOn {0};  // Seconds
+static int32_t relayMinOff {0};  // Seconds
+static bool relayPublishNow {false};
+static RelayController relayController {};
+static uint32_t relaySwitchesReported {0};
+
+static int32_t triggerWindow {TRIGGER_WINDOW_DEFAULT};  // Milliseconds
+static int32_t triggerBurst {TRIGGER_BURST_DEFAULT};
+static int32_t triggerRefill {TRIGGER_REFILL_DEFAULT};  // Seconds
+static TriggerCoalescer triggerCoalescer {};
+static Mutex triggerMutex;  // The debounce thread submits triggers as well as the IO loop
 
 
+/**
+ * @brief Convert an averaged voltage ADC reading to sensor units
+ *
+ * @param adc ADC reading in bits
+ * @return double Calibrated and scaled voltage input
+ */
+static double scaleVoltage(double adc) {
+    auto rawVoltage = map(adc, VOLTAGE_IN_LOW_BITS, VOLTAGE_IN_HIGH_BITS, 0.0, VOLTAGE_IN_FULL_SCALE);
+    auto calibratedVoltage = (rawVoltage + voltageCalOffset) * voltageCalGain;
+    return map(calibratedVoltage, VOLTAGE_IN_LOW, VOLTAGE_IN_HIGH, voltageSensorLow, voltageSensorHigh);
+}
+
+/**
+ * @brief Convert an averaged current ADC reading to calibrated amps
+ *
+ * @param adc ADC reading in bits
+ * @return double Calibrated current input before sensor scaling
+ */
+static double calibrateCurrent(double adc) {
+    auto rawCurrent = map(adc, CURRENT_IN_LOW_BITS, CURRENT_IN_HIGH_BITS, 0.0, CURRENT_IN_FULL_SCALE);
+    return (rawCurrent + currentCalOffset) * currentCalGain;
+}
+
+/**
+ * @brief Convert a calibrated current to sensor units
+ *
+ * @param calibratedCurrent Calibrated current in amps
+ * @return double Scaled current input
+ */
+static double scaleCurrent(double calibratedCurrent) {
+    return map(calibratedCurrent, CURRENT_IN_LOW, CURRENT_IN_HIGH, currentSensorLow, currentSensorHigh);
+}
+
+/**
+ * @brief Write interval statistics for one input into a location publish
+ *
+ * @param writer JSON writer for the location publish
+ * @param name Name of the statistics object
+ * @param stats Statistics collected since the last publish
+ */
+static void writeInputStats(JSONWriter& writer, const char* name, const StreamingStats& stats) {
+    if (0 == stats.getCount()) {
+        return;
+    }
+    writer.name(name).beginObject();
+    writer.name("n").value((unsigned int)stats.getCount());
+    writer.name("min").value(stats.getMin(), 3);
+    writer.name("max").value(stats.getMax(), 3);
+    writer.name("avg").value(stats.getMean(), 3);
+    writer.name("sd").value(stats.getStdDev(), 3);
+    writer.name("p50").value(stats.getP50(), 3);
+    writer.name("p95").value(stats.getP95(), 3);
+    writer.endObject();
+}
+
 /**
  * @brief Timer callback to collect and average ADC values.
  *
  */
 static void readAnalogInputs() {
-    // Perform averaging of the raw ADC values
     auto rawVoltage = analogRead(MONITOREDGE_IOEX_VOLTAGE_IN_PIN);
-    voltageIn.pushValue((float)rawVoltage);
     auto rawCurrent = analogRead(MONITOREDGE_IOEX_CURRENT_IN_PIN);
-    currentIn.pushValue((float)rawCurrent);
+    waveform.push((uint16_t)rawVoltage, (uint16_t)rawCurrent);
+
+    // Run the raw ADC values through the filter bank and average whatever comes out after decimation
+    float filtered {};
+    if (voltageFilter.process((float)rawVoltage, filtered)) {
+        voltageIn.pushValue(filtered);
+        voltageStats.push((float)scaleVoltage((double)filtered));
+    }
+    if (currentFilter.process((float)rawCurrent, filtered)) {
+        currentIn.pushValue(filtered);
+        currentStats.push((float)scaleCurrent(calibrateCurrent((double)filtered)));
+    }
+}
+
+/**
+ * @brief Rebuild an analog input filter bank from its configuration settings
+ *
+ * @param filter Filter bank to reconfigure
+ * @param settings Filter settings from the configuration service
+ * @param notch Mains notch selection
+ * @param average Averaging collector that follows the filter bank
+ * @param fc Cutoff frequency for the averaging collector
+ */
+static void applyFilterSettings(FilterBank& filter, FilterBankSettings& settings, MainsNotchType notch,
+    StatisticCollector<float>& average, double fc) {
+
+    switch (notch) {
+        case MainsNotchType::None:
+            settings.notchHz = 0.0;
+            break;
+
+        case MainsNotchType::Notch50Hz:
+            settings.notchHz = 50.0;
+            break;
+
+        case MainsNotchType::Notch60Hz:
+            settings.notchHz = 60.0;
+            break;
+    }
+
+    // The sample timer callback runs the filter so swap settings without being preempted
+    SINGLE_THREADED_BLOCK() {
+        filter.configure((float)ANALOG_SAMPLE_HZ, settings);
+        average.setAverageAlpha((float)StatisticCollector<double>::frequencyToAlpha(1.0 / filter.outputRate(), fc));
+    }
+}
+
+/**
+ * @brief Apply waveform capture settings
+ *
+ * @param settings Settings to apply
+ */
+static void applyWaveformSettings(const WaveformSettings& settings) {
+    auto divider = (uint32_t)max(1L, lround(ANALOG_SAMPLE_HZ / (double)settings.rate));
+
+    // The sample timer callback pushes into the capture so reconfigure without being preempted
+    SINGLE_THREADED_BLOCK() {
+        if (settings.enabled) {
+            waveform.configure((size_t)settings.depth, (size_t)settings.pre, divider);
+        }
+        else {
+            waveform.disable();
+        }
+    }
+    waveformCursor = 0;
+    waveformSequence = 0;
+}
+
+/**
+ * @brief Upload a frozen waveform capture one chunk at a time
+ *
+ * @details Each chunk is a separate io_wave event carrying base64 encoded, delta and
+ *          variable length coded frames.  The capture is rearmed after the last chunk.
+ */
+static void uploadWaveform() {
+    if ((WaveformCapture::State::Frozen != waveform.getState()) || !Particle.connected() ||
+        ((millis() - waveformChunkTick) < WAVEFORM_CHUNK_MS)) {
+        return;
+    }
+    waveformChunkTick = millis();
+
+    static uint8_t chunk[WAVEFORM_CHUNK_BYTES];
+    static char encoded[base64Length(WAVEFORM_CHUNK_BYTES) + 1];
+    static char publishBuffer[base64Length(WAVEFORM_CHUNK_BYTES) + 192];
+
+    auto cursor = waveformCursor;
+    auto first = cursor;
+    auto size = waveform.encode(cursor, chunk, sizeof(chunk));
+    base64Encode(chunk, size, encoded, sizeof(encoded));
+    auto last = (cursor >= waveform.getFrames());
+
+    memset(publishBuffer, 0, sizeof(publishBuffer));
+    JSONBufferWriter writer(publishBuffer, sizeof(publishBuffer));
+    writer.beginObject();
+    writer.name("id").value((unsigned int)waveform.getId());
+    writer.name("seq").value(waveformSequence);
+    writer.name("trig").value(waveform.getReason());
+    writer.name("rate").value((int)waveformSettings.rate);
+    writer.name("pre").value((unsigned int)waveform.getPreTriggerFrames());
+    writer.name("n").value((unsigned int)waveform.getFrames());
+    writer.name("off").value((unsigned int)first);
+    writer.name("last").value(last);
+    writer.name("d").value(encoded);
+    writer.endObject();
+
+    if (!publishSubmit(PublishArbiter::Priority::Bulk, "io_wave", publishBuffer, false)) {
+        return;
+    }
+
+    waveformCursor = cursor;
+    waveformSequence++;
+    if (last) {
+        monitorOneLog.info("Uploaded waveform %lu in %u chunks", waveform.getId(), waveformSequence);
+        waveformCursor = 0;
+        waveformSequence = 0;
+        waveform.rearm();
+    }
+}
+
+/**
+ * @brief Queue a location publish trigger for the next merged publish
+ *
+ * @param reason Trigger reason
+ * @param immediate Publish without waiting for the normal interval
+ */
+static void submitTrigger(const char* reason, bool immediate) {
+    const std::lock_guard<Mutex> lock(triggerMutex);
+    if (!triggerCoalescer.submit(reason, immediate, millis())) {
+        monitorOneLog.trace("Trigger %s suppressed", reason);
+    }
+}
+
+/**
+ * @brief Hand the gathered triggers to the location service once their window closes
+ *
+ */
+static void flushTriggers() {
+    const std::lock_guard<Mutex> lock(triggerMutex);
+    triggerCoalescer.flush(millis(), [](const char* reason, bool immediate) {
+        EdgeLocation::instance().triggerLocPub((immediate) ? Trigger::IMMEDIATE : Trigger::NORMAL, reason);
+    });
+}
+
+static void applyTriggerSettings() {
+    const std::lock_guard<Mutex> lock(triggerMutex);
+    triggerCoalescer.configure({(uint32_t)triggerWindow, (uint32_t)triggerBurst, (uint32_t)triggerRefill * 1000});
+}
+
+/**
+ * @brief Report a threshold rule state change
+ *
+ * @param rule Rule that changed state
+ * @param raised True if the rule was raised, false if cleared
+ */
+static void onThresholdRule(const ThresholdRule& rule, bool raised) {
+    auto event = (raised) ? rule.raiseEvent : rule.clearEvent;
+    if (raised && rule.capture) {
+        waveform.trigger(event);
+    }
+
+    auto& config = ioRuleConfigs[&rule - ioRules];
+    auto write = (raised) ? config.write : config.writeClear;
+    if (('\0' != write[0]) && (SYSTEM_ERROR_NONE != modbusQueueWrite(write))) {
+        monitorOneLog.warn("Modbus write of %s not queued", event);
+    }
+    submitTrigger(event, true);
+}
+
+/**
+ * @brief Build the runtime threshold rule from its configuration
+ *
+ * @param index Index of the rule in the rule table
+ */
+static void compileIoRule(size_t index) {
+    auto& config = ioRuleConfigs[index];
+    auto& rule = ioRules[index];
+
+    uint16_t channel {};
+    auto active = (index < IO_RULE_USER) || config.enabled;
+    switch (config.channel) {
+        case IoRuleChannel::Voltage:
+            channel = IO_CHANNEL_VOLTAGE;
+            break;
+
+        case IoRuleChannel::Current:
+            channel = IO_CHANNEL_CURRENT;
+            break;
+
+        case IoRuleChannel::CurrentRaw:
+            channel = IO_CHANNEL_CURRENT_RAW;
+            break;
+
+        case IoRuleChannel::Modbus:
+            channel = IO_CHANNEL_MODBUS + (uint16_t)(config.point - 1);
+            active = active && (config.point >= 1) && (config.point <= MODBUS_POINT_COUNT);
+            break;
+
+        case IoRuleChannel::Can:
+            channel = IO_CHANNEL_CAN + (uint16_t)(config.point - 1);
+            active = active && (config.point >= 1) && (config.point <= CAN_SIGNAL_COUNT);
+            break;
+    }
+
+    // Only start over when the rule is watching something different
+    if ((rule.channel != channel) || (rule.direction != config.direction) || (rule.active != active)) {
+        rule.resetState();
+    }
+    rule.active = active;
+    rule.enabled = config.enabled;
+    rule.reportClear = config.clear;
+    rule.capture = config.capture;
+    rule.channel = channel;
+    rule.direction = config.direction;
+    rule.threshold = (float)config.threshold;
+    rule.hysteresis = (float)config.hysteresis;
+    rule.stale = (IO_RULE_RELAY == index) ? relayStale : ThresholdStale::Hold;
+
+    if ('\0' == config.event[0]) {
+        snprintf(config.event, sizeof(config.event), "io_rule%u", (unsigned int)(index - IO_RULE_USER + 1));
+    }
+    rule.setEvent(config.event);
+}
+
+/**
+ * @brief Rebuild every runtime threshold rule from configuration
+ *
+ */
+static void compileIoRules() {
+    for (size_t i = 0; i < IO_RULE_COUNT; i++) {
+        compileIoRule(i);
+    }
+}
+
+/**
+ * @brief Convert a rule state to the comparator state reported in variables and publishes
+ *
+ * @param rule Threshold rule
+ * @return ThresholdState Side of the threshold the channel is on
+ */
+static ThresholdState ruleThresholdState(const ThresholdRule& rule) {
+    return (rule.raised == (ThresholdDirection::Above == rule.direction)) ?
+        ThresholdState::AboveThreshold : ThresholdState::BelowThreshold;
 }
 
 /**
@@ -162,6 +599,139 @@ static String readThresholdState(ThresholdState state) {
     return "unknown";
 }
 
+/**
+ * @brief Drive the relay output
+ *
+ * @param on True to energize the relay
+ */
+static void writeRelay(bool on) {
+    digitalWrite(MONITOREDGE_IOEX_RELAY_OUT_PIN, (on) ? HIGH : LOW);
+    RelayOutValue = on;
+}
+
+/**
+ * @brief Check whether the configured interlock holds the relay off
+ *
+ * @return true Relay must be off
+ */
+static bool relayInterlocked() {
+    switch (relayInterlock) {
+        case RelayInterlockType::None:
+            break;
+
+        case RelayInterlockType::InputOn:
+            return DigitalInValue;
+
+        case RelayInterlockType::InputOff:
+            return !DigitalInValue;
+
+        case RelayInterlockType::CurrentFault:
+            return ioRules[IO_RULE_CURRENT_FAULT_LOW].raised || ioRules[IO_RULE_CURRENT_FAULT_HIGH].raised;
+    }
+    return false;
+}
+
+/**
+ * @brief Run the relay rule against the latest threshold states
+ *
+ * @details Called from the IO loop right after the threshold rules are evaluated so that the
+ *          relay reacts within one pass of the loop instead of waiting on a cloud function.
+ */
+static void updateRelay() {
+    if (RelayModeType::Rule != relayMode) {
+        return;
+    }
+
+    auto action = relayController.update(ioRules[IO_RULE_RELAY].raised, relayInterlocked(), millis());
+    if (RelayController::Action::None == action) {
+        return;
+    }
+
+    auto on = (RelayController::Action::On == action);
+    writeRelay(on);
+    submitTrigger((on) ? "io_relay_on" : "io_relay_off", relayPublishNow);
+}
+
+/**
+ * @brief Interrupt handler for the digital input in pulse mode
+ *
+ */
+static void pulseInputIsr() {
+    pulseCounter.edge(micros());
+}
+
+/**
+ * @brief Switch the digital input between debounced switch and pulse counting modes
+ *
+ * @return int Zero on success, otherwise error
+ */
+static int applyInputMode() {
+    if (pulseAttached) {
+        detachInterrupt(MONITOREDGE_IOEX_DIGITAL_IN_PIN);
+        pulseAttached = false;
+    }
+
+    if (HvInputModeType::Pulse != inputMode) {
+        return 0;
+    }
+
+    // The 24V input is inverted as it passes through an optoisolator so swap the pin edges
+    auto interruptMode = FALLING;
+    switch (pulseEdgeType) {
+        case HvInputEdgeType::Falling:
+            interruptMode = RISING;
+            break;
+
+        case HvInputEdgeType::Both:
+            interruptMode = CHANGE;
+            break;
+
+        default:
+            break;
+    }
+
+    ATOMIC_BLOCK() {
+        pulseCounter.setMinPeriod((uint32_t)pulseMinPeriod);
+        pulseCounter.reset(micros());
+    }
+    pulseRateTotal = 0;
+    pulseRateTick = millis();
+    PulseRateValue = 0.0;
+
+    if (!attachInterrupt(MONITOREDGE_IOEX_DIGITAL_IN_PIN, pulseInputIsr, interruptMode)) {
+        monitorOneLog.error("Unable to attach pulse input interrupt");
+        return (int)SYSTEM_ERROR_NOT_SUPPORTED;
+    }
+    pulseAttached = true;
+
+    return 0;
+}
+
+/**
+ * @brief Write pulse counts and period statistics for the interval into a location publish
+ *
+ * @param writer JSON writer for the location publish
+ */
+static void writePulseStats(JSONWriter& writer) {
+    PulseCounter::Accumulator interval;
+    ATOMIC_BLOCK() {
+        interval = pulseCounter.take(micros());
+    }
+    auto summary = PulseCounter::summarize(interval);
+
+    writer.name("io_pls").beginObject();
+    writer.name("n").value((unsigned int)summary.pulses);
+    writer.name("tot").value((unsigned int)pulseCounter.getTotal());
+    writer.name("hz").value(summary.rate, 3);
+    if (interval.periods) {
+        writer.name("per").value(summary.period, 1);
+        writer.name("jit").value(summary.jitter, 1);
+        writer.name("min").value(summary.minPeriod, 0);
+        writer.name("max").value(summary.maxPeriod, 0);
+    }
+    writer.endObject();
+}
+
 /**
  * @brief A device OS timer to periodically sample analog inputs
  *
@@ -169,6 +739,92 @@ static String readThresholdState(ThresholdState state) {
  */
 static Timer sampleTimer(ANALOG_SAMPLE_MS, readAnalogInputs);
 
+/**
+ * @brief Create the configuration settings for one user threshold rule
+ *
+ * @param n Zero based user rule number
+ * @return int Zero (success) always
+ */
+static int buildIoRuleSettings(size_t n) {
+    auto& config = ioRuleConfigs[IO_RULE_USER + n];
+    config.channel = IoRuleChannel::Voltage;
+    config.point = 1;
+    config.direction = ThresholdDirection::Above;
+
+    snprintf(ioRuleNames[n], sizeof(ioRuleNames[n]), "io_rule%u", (unsigned int)(n + 1));
+
+    auto configObject = new ConfigObject(ioRuleNames[n],
+        {
+            ConfigBool("enable", &config.enabled),
+            ConfigStringEnum("channel", {
+                    {"voltage", (int32_t) IoRuleChannel::Voltage},
+                    {"current", (int32_t) IoRuleChannel::Current},
+                    {"current_raw", (int32_t) IoRuleChannel::CurrentRaw},
+                    {"modbus", (int32_t) IoRuleChannel::Modbus},
+                    {"can", (int32_t) IoRuleChannel::Can},
+                },
+                &config.channel),
+            ConfigInt("point", &config.point, 1, MODBUS_POINT_COUNT),
+            ConfigStringEnum("dir", {
+                    {"above", (int32_t) ThresholdDirection::Above},
+                    {"below", (int32_t) ThresholdDirection::Below},
+                },
+                &config.direction),
+            ConfigFloat("thresh", &config.threshold, NAN, NAN),
+            ConfigFloat("hyst", &config.hysteresis, 0.0, NAN),
+            ConfigBool("clear", &config.clear),
+            ConfigBool("capture", &config.capture),
+            ConfigString("event",
+                [](const char * &value, const void *context) {
+                    value = ((const ThresholdRuleConfig*)context)->event;
+                    return 0;
+                },
+                [](const char * value, const void *context) {
+                    auto ruleConfig = (ThresholdRuleConfig*)context;
+                    snprintf(ruleConfig->event, sizeof(ruleConfig->event), "%s", value);
+                    return 0;
+                },
+                &config, &config),
+            ConfigString("write",
+                [](const char * &value, const void *context) {
+                    value = ((const ThresholdRuleConfig*)context)->write;
+                    return 0;
+                },
+                [](const char * value, const void *context) {
+                    if ((strlen(value) > IO_RULE_WRITE_LENGTH) || (('\0' != value[0]) && (SYSTEM_ERROR_NONE != modbusValidateWrite(value)))) {
+                        return (int)SYSTEM_ERROR_INVALID_ARGUMENT;
+                    }
+                    strcpy(((ThresholdRuleConfig*)context)->write, value);
+                    return 0;
+                },
+                &config, &config),
+            ConfigString("write_clr",
+                [](const char * &value, const void *context) {
+                    value = ((const ThresholdRuleConfig*)context)->writeClear;
+                    return 0;
+                },
+                [](const char * value, const void *context) {
+                    if ((strlen(value) > IO_RULE_WRITE_LENGTH) || (('\0' != value[0]) && (SYSTEM_ERROR_NONE != modbusValidateWrite(value)))) {
+                        return (int)SYSTEM_ERROR_INVALID_ARGUMENT;
+                    }
+                    strcpy(((ThresholdRuleConfig*)context)->writeClear, value);
+                    return 0;
+                },
+                &config, &config),
+        },
+        nullptr,
+        [](bool write, int status, const void *context) {
+            if (write && (0 == status)) {
+                compileIoRules();
+            }
+            return status;
+        }
+    );
+    ConfigService::instance().registerModule(*configObject);
+
+    return 0;
+}
+
 /**
  * @brief Create the general analog and digital IO configuration settings
  *
@@ -184,6 +840,9 @@ int buildIoSettings() {
     Particle.variable("Current High Th", []{ return readThresholdState(CurrentInHighThState); });
     Particle.variable("Current Low Fault", CurrentInFaultLowThState);
     Particle.variable("Current High Fault", CurrentInFaultHighThState);
+    Particle.variable("Pulse Count", []{ return (double)pulseCounter.getTotal(); });
+    Particle.variable("Pulse Rate", PulseRateValue);
+    Particle.variable("Relay", RelayOutValue);
 
     static ConfigObject ioCalibrationConfiguration("iocal", {
         ConfigObject("voltage", {
@@ -205,7 +864,7 @@ int buildIoSettings() {
                 config_get_float_cb,
                 [](double value, const void *context) {
                     voltageFilterFc = value;
-                    voltageIn.setAverageAlpha((float)StatisticCollector<double>::frequencyToAlpha(ANALOG_SAMPLE_S, value));
+                    voltageIn.setAverageAlpha((float)StatisticCollector<double>::frequencyToAlpha(1.0 / voltageFilter.outputRate(), value));
                     return 0;
                 },
                 &voltageFilterFc,
@@ -213,20 +872,30 @@ int buildIoSettings() {
                 VOLTAGE_IN_CUTOFF_LOW,
                 VOLTAGE_IN_CUTOFF_HIGH
             ),
-            ConfigFloat("threshlow",
-                config_get_float_cb, [](double value, const void *context){voltageThresholdLow = value; voltageLow.setThreshold((float)value); return 0;},
-                &voltageThresholdLow, nullptr, NAN, NAN),
-            ConfigFloat("hystlow",
-                config_get_float_cb, [](double value, const void *context){voltageHysteresisLow = value; voltageLow.setHysteresis((float)value); return 0;},
-                &voltageHysteresisLow, nullptr, 0.0, NAN),
-            ConfigBool("th_low_en", &voltageThresholdLowEnable),
-            ConfigFloat("threshhigh",
-                config_get_float_cb, [](double value, const void *context){voltageThresholdHigh = value; voltageHigh.setThreshold((float)value); return 0;},
-                &voltageThresholdHigh, nullptr, NAN, NAN),
-            ConfigFloat("hysthigh",
-                config_get_float_cb, [](double value, const void *context){voltageHysteresisHigh = value; voltageHigh.setHysteresis((float)value); return 0;},
-                &voltageHysteresisHigh, nullptr, 0.0, NAN),
-            ConfigBool("th_high_en", &voltageThresholdHighEnable),
+            ConfigInt("median", &voltageFilterSettings.median, 1, (int32_t)MedianFilter::MAX_WINDOW),
+            ConfigStringEnum("notch", {
+                {"none", (int32_t) MainsNotchType::None},
+                {"50hz", (int32_t) MainsNotchType::Notch50Hz},
+                {"60hz", (int32_t) MainsNotchType::Notch60Hz}
+            }, &voltageFilterNotch),
+            ConfigFloat("notch_q", &voltageFilterSettings.notchQ, FILTER_NOTCH_Q_LOW, FILTER_NOTCH_Q_HIGH),
+            ConfigFloat("lpf_fc", &voltageFilterSettings.lowPassHz, 0.0, FILTER_LPF_HIGH),
+            ConfigInt("decimate", &voltageFilterSettings.decimate, 1, (int32_t)CicDecimator::MAX_RATIO),
+            ConfigInt("cic_order", &voltageFilterSettings.cicOrder, 1, (int32_t)CicDecimator::MAX_ORDER),
+            ConfigFloat("threshlow", &ioRuleConfigs[IO_RULE_VOLTAGE_LOW].threshold, NAN, NAN),
+            ConfigFloat("hystlow", &ioRuleConfigs[IO_RULE_VOLTAGE_LOW].hysteresis, 0.0, NAN),
+            ConfigBool("th_low_en", &ioRuleConfigs[IO_RULE_VOLTAGE_LOW].enabled),
+            ConfigFloat("threshhigh", &ioRuleConfigs[IO_RULE_VOLTAGE_HIGH].threshold, NAN, NAN),
+            ConfigFloat("hysthigh", &ioRuleConfigs[IO_RULE_VOLTAGE_HIGH].hysteresis, 0.0, NAN),
+            ConfigBool("th_high_en", &ioRuleConfigs[IO_RULE_VOLTAGE_HIGH].enabled),
+        },
+        nullptr,
+        [](bool write, int status, const void *context) {
+            if (write && (0 == status)) {
+                applyFilterSettings(voltageFilter, voltageFilterSettings, voltageFilterNotch, voltageIn, voltageFilterFc);
+                compileIoRules();
+            }
+            return status;
         }),
         ConfigObject("current", {
             ConfigFloat("sensorlow", &currentSensorLow),
@@ -235,7 +904,7 @@ int buildIoSettings() {
                 config_get_float_cb,
                 [](double value, const void *context) {
                     currentFilterFc = value;
-                    currentIn.setAverageAlpha((float)StatisticCollector<double>::frequencyToAlpha(ANALOG_SAMPLE_S, value));
+                    currentIn.setAverageAlpha((float)StatisticCollector<double>::frequencyToAlpha(1.0 / currentFilter.outputRate(), value));
                     return 0;
                 },
                 &currentFilterFc,
@@ -243,34 +912,117 @@ int buildIoSettings() {
                 CURRENT_IN_CUTOFF_LOW,
                 CURRENT_IN_CUTOFF_HIGH
             ),
-            ConfigFloat("threshlow",
-                config_get_float_cb, [](double value, const void *context){currentThresholdLow = value; currentLow.setThreshold((float)value); return 0;},
-                &currentThresholdLow, nullptr, NAN, NAN),
-            ConfigFloat("hystlow",
-                config_get_float_cb, [](double value, const void *context){currentHysteresisLow = value; currentLow.setHysteresis((float)value); return 0;},
-                &currentHysteresisLow, nullptr, 0.0, NAN),
-            ConfigBool("th_low_en", &currentLowEnable),
-            ConfigFloat("threshhigh",
-                config_get_float_cb, [](double value, const void *context){currentThresholdHigh = value; currentHigh.setThreshold((float)value); return 0;},
-                &currentThresholdHigh, nullptr, NAN, NAN),
-            ConfigFloat("hysthigh",
-                config_get_float_cb, [](double value, const void *context){currentHysteresisHigh = value; currentHigh.setHysteresis((float)value); return 0;},
-                &currentHysteresisHigh, nullptr, 0.0, NAN),
-            ConfigBool("th_high_en", &currentHighEnable),
-            ConfigFloat("th_fault_low",
-                config_get_float_cb, [](double value, const void *context){currentFaultThresholdLow = value; currentFaultLow.setThreshold((float)value); return 0;},
-                &currentFaultThresholdLow, nullptr, 0.0, 0.030),
-            ConfigFloat("hyst_fault_low",
-                config_get_float_cb, [](double value, const void *context){currentFaultHysteresisLow = value; currentFaultLow.setHysteresis((float)value); return 0;},
-                &currentFaultHysteresisLow, nullptr, 0.0, CURRENT_IN_HIGH),
-            ConfigBool("th_fault_low_en", &currentFaultLowEnable),
-            ConfigFloat("th_fault_high",
-                config_get_float_cb, [](double value, const void *context){currentFaultThresholdHigh = value; currentFaultHigh.setThreshold((float)value); return 0;},
-                &currentFaultThresholdHigh, nullptr, 0.0, 0.030),
-            ConfigFloat("hyst_fault_high",
-                config_get_float_cb, [](double value, const void *context){currentFaultHysteresisHigh = value; currentFaultHigh.setHysteresis((float)value); return 0;},
-                &currentFaultHysteresisHigh, nullptr, 0.0, CURRENT_IN_HIGH),
-            ConfigBool("th_fault_high_en", &currentFaultHighEnable),
+            ConfigInt("median", &currentFilterSettings.median, 1, (int32_t)MedianFilter::MAX_WINDOW),
+            ConfigStringEnum("notch", {
+                {"none", (int32_t) MainsNotchType::None},
+                {"50hz", (int32_t) MainsNotchType::Notch50Hz},
+                {"60hz", (int32_t) MainsNotchType::Notch60Hz}
+            }, &currentFilterNotch),
+            ConfigFloat("notch_q", &currentFilterSettings.notchQ, FILTER_NOTCH_Q_LOW, FILTER_NOTCH_Q_HIGH),
+            ConfigFloat("lpf_fc", &currentFilterSettings.lowPassHz, 0.0, FILTER_LPF_HIGH),
+            ConfigInt("decimate", &currentFilterSettings.decimate, 1, (int32_t)CicDecimator::MAX_RATIO),
+            ConfigInt("cic_order", &currentFilterSettings.cicOrder, 1, (int32_t)CicDecimator::MAX_ORDER),
+            ConfigFloat("threshlow", &ioRuleConfigs[IO_RULE_CURRENT_LOW].threshold, NAN, NAN),
+            ConfigFloat("hystlow", &ioRuleConfigs[IO_RULE_CURRENT_LOW].hysteresis, 0.0, NAN),
+            ConfigBool("th_low_en", &ioRuleConfigs[IO_RULE_CURRENT_LOW].enabled),
+            ConfigFloat("threshhigh", &ioRuleConfigs[IO_RULE_CURRENT_HIGH].threshold, NAN, NAN),
+            ConfigFloat("hysthigh", &ioRuleConfigs[IO_RULE_CURRENT_HIGH].hysteresis, 0.0, NAN),
+            ConfigBool("th_high_en", &ioRuleConfigs[IO_RULE_CURRENT_HIGH].enabled),
+            ConfigFloat("th_fault_low", &ioRuleConfigs[IO_RULE_CURRENT_FAULT_LOW].threshold, 0.0, 0.030),
+            ConfigFloat("hyst_fault_low", &ioRuleConfigs[IO_RULE_CURRENT_FAULT_LOW].hysteresis, 0.0, CURRENT_IN_HIGH),
+            ConfigBool("th_fault_low_en", &ioRuleConfigs[IO_RULE_CURRENT_FAULT_LOW].enabled),
+            ConfigFloat("th_fault_high", &ioRuleConfigs[IO_RULE_CURRENT_FAULT_HIGH].threshold, 0.0, 0.030),
+            ConfigFloat("hyst_fault_high", &ioRuleConfigs[IO_RULE_CURRENT_FAULT_HIGH].hysteresis, 0.0, CURRENT_IN_HIGH),
+            ConfigBool("th_fault_high_en", &ioRuleConfigs[IO_RULE_CURRENT_FAULT_HIGH].enabled),
+        },
+        nullptr,
+        [](bool write, int status, const void *context) {
+            if (write && (0 == status)) {
+                applyFilterSettings(currentFilter, currentFilterSettings, currentFilterNotch, currentIn, currentFilterFc);
+                compileIoRules();
+            }
+            return status;
+        }),
+        ConfigObject("capture", {
+            ConfigBool("enable",
+                config_get_bool_cb, config_set_bool_cb,
+                &waveformSettings.enabled, &waveformSettingsShadow.enabled),
+            ConfigInt("depth",
+                config_get_int32_cb, config_set_int32_cb,
+                &waveformSettings.depth, &waveformSettingsShadow.depth,
+                1, INT32_MAX),
+            ConfigInt("pre",
+                config_get_int32_cb, config_set_int32_cb,
+                &waveformSettings.pre, &waveformSettingsShadow.pre,
+                0, INT32_MAX),
+            ConfigInt("rate",
+                config_get_int32_cb, config_set_int32_cb,
+                &waveformSettings.rate, &waveformSettingsShadow.rate,
+                1, (int32_t)ANALOG_SAMPLE_HZ),
+        },
+        [](bool write, const void *context) {
+            if (write) {
+                waveformSettingsShadow = waveformSettings;
+            }
+            return 0;
+        },
+        [](bool write, int status, const void *context) {
+            if (write && (0 == status)) {
+                // Enforce the RAM budget here so that an oversized capture is rejected with the configuration
+                auto bytes = (size_t)waveformSettingsShadow.depth * WaveformCapture::CHANNELS * sizeof(uint16_t);
+                if (bytes > WAVEFORM_BUDGET_BYTES) {
+                    monitorOneLog.error("Waveform capture needs %u bytes, budget is %u", bytes, WAVEFORM_BUDGET_BYTES);
+                    return (int)SYSTEM_ERROR_NO_MEMORY;
+                }
+                if (waveformSettingsShadow.pre >= waveformSettingsShadow.depth) {
+                    return (int)SYSTEM_ERROR_INVALID_ARGUMENT;
+                }
+                waveformSettings = waveformSettingsShadow;
+                applyWaveformSettings(waveformSettings);
+            }
+            return status;
+        }),
+        ConfigObject("relay", {
+            ConfigStringEnum("mode", {
+                {"manual", (int32_t) RelayModeType::Manual},
+                {"rule", (int32_t) RelayModeType::Rule}
+            }, &relayMode),
+            ConfigStringEnum("channel", {
+                {"voltage", (int32_t) IoRuleChannel::Voltage},
+                {"current", (int32_t) IoRuleChannel::Current},
+                {"current_raw", (int32_t) IoRuleChannel::CurrentRaw},
+                {"modbus", (int32_t) IoRuleChannel::Modbus},
+                {"can", (int32_t) IoRuleChannel::Can}
+            }, &ioRuleConfigs[IO_RULE_RELAY].channel),
+            ConfigInt("point", &ioRuleConfigs[IO_RULE_RELAY].point, 1, MODBUS_POINT_COUNT),
+            ConfigStringEnum("dir", {
+                {"above", (int32_t) ThresholdDirection::Above},
+                {"below", (int32_t) ThresholdDirection::Below}
+            }, &ioRuleConfigs[IO_RULE_RELAY].direction),
+            ConfigFloat("thresh", &ioRuleConfigs[IO_RULE_RELAY].threshold, NAN, NAN),
+            ConfigFloat("hyst", &ioRuleConfigs[IO_RULE_RELAY].hysteresis, 0.0, NAN),
+            ConfigInt("min_on", &relayMinOn, 0, RELAY_MIN_TIME_HIGH),
+            ConfigInt("min_off", &relayMinOff, 0, RELAY_MIN_TIME_HIGH),
+            ConfigStringEnum("interlock", {
+                {"none", (int32_t) RelayInterlockType::None},
+                {"input_on", (int32_t) RelayInterlockType::InputOn},
+                {"input_off", (int32_t) RelayInterlockType::InputOff},
+                {"current_fault", (int32_t) RelayInterlockType::CurrentFault}
+            }, &relayInterlock),
+            ConfigStringEnum("stale", {
+                {"off", (int32_t) ThresholdStale::Clear},
+                {"hold", (int32_t) ThresholdStale::Hold},
+                {"on", (int32_t) ThresholdStale::Raise}
+            }, &relayStale),
+            ConfigBool("immediate", &relayPublishNow)
+        },
+        nullptr,
+        [](bool write, int status, const void *context) {
+            if (write && (0 == status)) {
+                relayController.setMinTimes((uint32_t)relayMinOn * 1000, (uint32_t)relayMinOff * 1000);
+                compileIoRules();
+            }
+            return status;
         }),
         ConfigObject("input", {
             ConfigBool("immediate", &inputPublishNow),
@@ -279,46 +1031,61 @@ int buildIoSettings() {
                 {"rising", (int32_t) HvInputEdgeType::Rising},
                 {"falling", (int32_t) HvInputEdgeType::Falling},
                 {"both", (int32_t) HvInputEdgeType::Both}
-            }, &inputEdgeType)
+            }, &inputEdgeType),
+            ConfigStringEnum("mode", {
+                {"switch", (int32_t) HvInputModeType::Switch},
+                {"pulse", (int32_t) HvInputModeType::Pulse}
+            }, &inputMode),
+            ConfigStringEnum("pulse_edge", {
+                {"rising", (int32_t) HvInputEdgeType::Rising},
+                {"falling", (int32_t) HvInputEdgeType::Falling},
+                {"both", (int32_t) HvInputEdgeType::Both}
+            }, &pulseEdgeType),
+            ConfigInt("pulse_min_us", &pulseMinPeriod, 0, PULSE_MIN_PERIOD_HIGH)
+        },
+        nullptr,
+        [](bool write, int status, const void *context) {
+            if (write && (0 == status)) {
+                status = applyInputMode();
+            }
+            return status;
+        }),
+        ConfigObject("trig", {
+            ConfigInt("window", &triggerWindow, 0, TRIGGER_WINDOW_HIGH),
+            ConfigInt("burst", &triggerBurst, 0, TRIGGER_BURST_HIGH),
+            ConfigInt("refill", &triggerRefill, 1, TRIGGER_REFILL_HIGH)
+        },
+        nullptr,
+        [](bool write, int status, const void *context) {
+            if (write && (0 == status)) {
+                applyTriggerSettings();
+            }
+            return status;
         })
     });
     ConfigService::instance().registerModule(ioConfiguration);
+    applyTriggerSettings();
 
-    voltageLow.setCallback([](float value, ThresholdState state) {
-        if (voltageThresholdLowEnable && (ThresholdState::BelowThreshold == state)) {
-            EdgeLocation::instance().triggerLocPub(Trigger::IMMEDIATE, "io_vlow");
-        }
-    });
-    voltageHigh.setCallback([](float value, ThresholdState state) {
-        if (voltageThresholdHighEnable && (ThresholdState::AboveThreshold == state)) {
-            EdgeLocation::instance().triggerLocPub(Trigger::IMMEDIATE, "io_vhigh");
-        }
-    });
-    currentFaultLow.setCallback([](float value, ThresholdState state) {
-        if (currentFaultLowEnable) {
-            auto event = (ThresholdState::BelowThreshold == state) ? "io_afltlow_raise" : "io_afltlow_clr";
-            EdgeLocation::instance().triggerLocPub(Trigger::IMMEDIATE, event);
-        }
-    });
-    currentFaultHigh.setCallback([](float value, ThresholdState state) {
-        if (currentFaultHighEnable) {
-            auto event = (ThresholdState::AboveThreshold == state) ? "io_aflthigh_raise" : "io_aflthigh_clr";
-            EdgeLocation::instance().triggerLocPub(Trigger::IMMEDIATE, event);
-        }
-    });
-    currentLow.setCallback([](float value, ThresholdState state) {
-        if (currentLowEnable && (ThresholdState::BelowThreshold == state)) {
-            EdgeLocation::instance().triggerLocPub(Trigger::IMMEDIATE, "io_alow");
-        }
-    });
-    currentHigh.setCallback([](float value, ThresholdState state) {
-        if (currentHighEnable && (ThresholdState::AboveThreshold == state)) {
-            EdgeLocation::instance().triggerLocPub(Trigger::IMMEDIATE, "io_ahigh");
-        }
-    });
+    applyFilterSettings(voltageFilter, voltageFilterSettings, voltageFilterNotch, voltageIn, voltageFilterFc);
+    applyFilterSettings(currentFilter, currentFilterSettings, currentFilterNotch, currentIn, currentFilterFc);
+    applyWaveformSettings(waveformSettings);
+
+    for (size_t i = 0; i < IO_USER_RULE_COUNT; i++) {
+        buildIoRuleSettings(i);
+    }
+    compileIoRules();
 
     EdgeLocation::instance().regLocGenCallback(
         [](JSONWriter& writer, LocationPoint& location, const void* nothing) {
+            // Take the interval statistics and start a new interval without racing the sample timer
+            StreamingStats voltageInterval, currentInterval;
+            SINGLE_THREADED_BLOCK() {
+                voltageInterval = voltageStats;
+                currentInterval = currentStats;
+                voltageStats.reset();
+                currentStats.reset();
+            }
+
             writer.name("io_v").value(VoltageInValue, 3);
             writer.name("io_a").value(CurrentInValue, 3);
             writer.name("io_in").value(DigitalInValue);
@@ -328,6 +1095,33 @@ int buildIoSettings() {
             writer.name("io_ahigh").value((int)CurrentInHighThState);
             writer.name("io_afltlow").value(CurrentInFaultLowThState);
             writer.name("io_aflthigh").value(CurrentInFaultHighThState);
+            auto userRules = ioThresholds.raisedMask(IO_RULE_USER);
+            if (userRules) {
+                writer.name("io_rules").value((unsigned int)userRules);
+            }
+            uint32_t suppressed;
+            {
+                const std::lock_guard<Mutex> lock(triggerMutex);
+                suppressed = triggerCoalescer.takeSuppressed();
+            }
+            if (suppressed) {
+                writer.name("io_trig_sup").value((unsigned int)suppressed);
+            }
+            writeInputStats(writer, "io_v_st", voltageInterval);
+            writeInputStats(writer, "io_a_st", currentInterval);
+            if (HvInputModeType::Pulse == inputMode) {
+                writePulseStats(writer);
+            }
+
+            auto switches = relayController.getSwitches();
+            writer.name("io_rly").beginObject();
+            writer.name("on").value(RelayOutValue);
+            writer.name("n").value((unsigned int)(switches - relaySwitchesReported));
+            if (relayController.isBlocked()) {
+                writer.name("blk").value(true);
+            }
+            writer.endObject();
+            relaySwitchesReported = switches;
         }
     );
 
@@ -336,6 +1130,35 @@ int buildIoSettings() {
     return 0;
 }
 
+/**
+ * @brief Update the threshold channel for a Modbus point, called from the modbus thread
+ *
+ * @param point Zero based Modbus point index
+ * @param value Latest scaled value, NAN if the poll failed
+ */
+void ioUpdateModbusChannel(int point, double value)
+{
+    if ((point >= 0) && (point < MODBUS_POINT_COUNT)) {
+        ioChannels[IO_CHANNEL_MODBUS + point] = (float)value;
+        timeSeriesRecord(TIME_SERIES_MODBUS + point, millis(), (float)value);
+        modbusSlaveSetPoint(point, (float)value);
+    }
+}
+
+/**
+ * @brief Update the threshold channel for a CAN signal, called from the can thread
+ *
+ * @param signal Zero based CAN signal index
+ * @param value Latest decoded value, NAN when the signal is stale or not available
+ */
+void ioUpdateCanChannel(int signal, double value)
+{
+    if ((signal >= 0) && (signal < CAN_SIGNAL_COUNT)) {
+        ioChannels[IO_CHANNEL_CAN + signal] = (float)value;
+        modbusSlaveSetSignal(signal, (float)value);
+    }
+}
+
 /**
  * @brief Setup the Monitor One IO expansion card
  *
@@ -356,18 +1179,27 @@ int expanderIoInit()
     Particle.function("Relay", [](String val){
         auto trueMatch = (0 == strncasecmp("true", val.c_str(), sizeof("true")));
         auto falseMatch = (0 == strncasecmp("false", val.c_str(), sizeof("false")));
-        uint8_t relay = LOW;
+        auto relay = false;
         if (trueMatch != falseMatch) {
-            relay = (trueMatch && !falseMatch) ? HIGH : LOW;
+            relay = (trueMatch && !falseMatch);
         }
         else {
-            relay = (0 == val.toInt()) ? LOW : HIGH;
+            relay = (0 != val.toInt());
         }
-        digitalWrite(MONITOREDGE_IOEX_RELAY_OUT_PIN, relay);
+
+        // The relay belongs to the local rule when one is configured
+        if (RelayModeType::Rule == relayMode) {
+            return (int)SYSTEM_ERROR_INVALID_STATE;
+        }
+        relayController.set(relay, millis());
+        writeRelay(relay);
 
         return 0;
     }, nullptr);
 
+    for (size_t i = IO_CHANNEL_MODBUS; i < IO_CHANNEL_COUNT; i++) {
+        ioChannels[i] = NAN;
+    }
     buildIoSettings();
 
     // The general purpose 24V input is inverted as it passes through an optoisolator.
@@ -386,6 +1218,12 @@ int expanderIoInit()
                     break;
             }
 
+            // Pulse mode edges are counted by the interrupt handler and are too fast to publish
+            if (HvInputModeType::Pulse == inputMode) {
+                inputStateLast = DigitalInValue;
+                return;
+            }
+
             auto inputEdgeEvent = false;
             switch (inputEdgeType) {
                 case HvInputEdgeType::Rising:
@@ -401,30 +1239,56 @@ int expanderIoInit()
                     break;
             }
             if (inputEdgeEvent) {
-                EdgeLocation::instance().triggerLocPub((inputPublishNow) ? Trigger::IMMEDIATE : Trigger::NORMAL, "io_in");
+                submitTrigger("io_in", inputPublishNow);
             }
             inputStateLast = DigitalInValue;
         }
     );
 
+    applyInputMode();
+    // The slave clears its register image before the CAN and Modbus threads start writing it
+    modbusSlaveInit();
+    timeSeriesInit();
+    canInit();
+
     return modbusInit();
 }
 
 int expanderIoLoop()
 {
-    auto rawVoltage = map((double)voltageIn.getAverage(), VOLTAGE_IN_LOW_BITS, VOLTAGE_IN_HIGH_BITS, 0.0, VOLTAGE_IN_FULL_SCALE);
-    auto calibratedVoltage = (rawVoltage + voltageCalOffset) * voltageCalGain;
-    VoltageInValue = map(calibratedVoltage, VOLTAGE_IN_LOW, VOLTAGE_IN_HIGH, voltageSensorLow, voltageSensorHigh);
-    VoltageInLowThState = voltageLow.evaluate((float)VoltageInValue);
-    VoltageInHighThState = voltageHigh.evaluate((float)VoltageInValue);
-
-    auto rawCurrent = map((double)currentIn.getAverage(), CURRENT_IN_LOW_BITS, CURRENT_IN_HIGH_BITS, 0.0, CURRENT_IN_FULL_SCALE);
-    auto calibratedCurrent = (rawCurrent + currentCalOffset) * currentCalGain;
-    CurrentInFaultLowThState = (currentFaultLow.evaluate((float)calibratedCurrent) == ThresholdState::BelowThreshold);
-    CurrentInFaultHighThState = (currentFaultHigh.evaluate((float)calibratedCurrent) == ThresholdState::AboveThreshold);
-    CurrentInValue = map(calibratedCurrent, CURRENT_IN_LOW, CURRENT_IN_HIGH, currentSensorLow, currentSensorHigh);
-    CurrentInLowThState = currentLow.evaluate((float)CurrentInValue);
-    CurrentInHighThState = currentHigh.evaluate((float)CurrentInValue);
+    VoltageInValue = scaleVoltage((double)voltageIn.getAverage());
+    auto calibratedCurrent = calibrateCurrent((double)currentIn.getAverage());
+    CurrentInValue = scaleCurrent(calibratedCurrent);
+
+    ioChannels[IO_CHANNEL_VOLTAGE] = (float)VoltageInValue;
+    ioChannels[IO_CHANNEL_CURRENT] = (float)CurrentInValue;
+    ioChannels[IO_CHANNEL_CURRENT_RAW] = (float)calibratedCurrent;
+    timeSeriesRecord(TIME_SERIES_IO_VOLTAGE, millis(), (float)VoltageInValue);
+    timeSeriesRecord(TIME_SERIES_IO_CURRENT, millis(), (float)CurrentInValue);
+    ioThresholds.evaluate(ioChannels, IO_CHANNEL_COUNT);
+    updateRelay();
+    flushTriggers();
+
+    VoltageInLowThState = ruleThresholdState(ioRules[IO_RULE_VOLTAGE_LOW]);
+    VoltageInHighThState = ruleThresholdState(ioRules[IO_RULE_VOLTAGE_HIGH]);
+    CurrentInLowThState = ruleThresholdState(ioRules[IO_RULE_CURRENT_LOW]);
+    CurrentInHighThState = ruleThresholdState(ioRules[IO_RULE_CURRENT_HIGH]);
+    CurrentInFaultLowThState = ioRules[IO_RULE_CURRENT_FAULT_LOW].raised;
+    CurrentInFaultHighThState = ioRules[IO_RULE_CURRENT_FAULT_HIGH].raised;
+
+    if (pulseAttached && ((millis() - pulseRateTick) >= PULSE_RATE_WINDOW_MS)) {
+        auto now = millis();
+        auto total = pulseCounter.getTotal();
+        PulseRateValue = (double)(total - pulseRateTotal) * 1000.0 / (double)(now - pulseRateTick);
+        pulseRateTotal = total;
+        pulseRateTick = now;
+    }
+
+    modbusSlaveSetInputs((float)VoltageInValue, (float)CurrentInValue, DigitalInValue, RelayOutValue,
+        pulseCounter.getTotal(), (float)PulseRateValue);
+
+    uploadWaveform();
+    timeSeriesLoop();
 
     return 0;
 }
@@ -14,11 +14,32 @@
  * limitations under the License.
  */
 
+#include "user_config.h"
+
 #include "Particle.h"
 #include "tracker_config.h"
 #include "edge.h"
 #include "monitor_edge_ioexpansion.h"
 #include "ModbusClient.h"
+#include "ModbusDecode.h"
+#include "ModbusTransport.h"
+#include "ModbusPollPlanner.h"
+#include "PollScheduler.h"
+#include "FixedRing.h"
+#include "ConfigSnapshot.h"
+#include "SlaveHealth.h"
+
+#include <atomic>
+
+#if defined(MODBUS_SIMULATOR) && MODBUS_SIMULATOR
+#include "ModbusSimulator.h"
+#endif
+
+// Memfault is left out of builds for Device OS 5 and later
+#if __has_include("memfault/metrics/metrics.h")
+#include "memfault/metrics/metrics.h"
+#define MODBUS_MEMFAULT_METRICS         (1)
+#endif
 
 
 //
@@ -44,10 +65,53 @@ enum class ModbusParity {
     Even,
 };
 
-static constexpr int MODBUS_CLIENT_COUNT                {3};
 static constexpr ModbusBaudRates MODBUS_BAUD_DEFAULT    {ModbusBaudRates::Baud38400};
 static constexpr ModbusParity MODBUS_PARITY_DEFAULT     {ModbusParity::None};
 static constexpr int32_t MODBUS_IMD_DEFAULT             {0};
+static constexpr int32_t MODBUS_GAP_DEFAULT             {0};    // Merge only touching or overlapping ranges
+static constexpr uint16_t MODBUS_MAX_READ_REGISTERS     {125};  // Protocol limit for register reads
+static constexpr uint16_t MODBUS_MAX_READ_BITS          {2000}; // Protocol limit for coil and discrete input reads
+static constexpr uint16_t MODBUS_READ_BUFFER_WORDS      {sizeof(ModbusClientContext::readBuffer) / sizeof(uint16_t)};
+static constexpr uint16_t MODBUS_BLOCK_REGISTERS        {(MODBUS_READ_BUFFER_WORDS < MODBUS_MAX_READ_REGISTERS) ? MODBUS_READ_BUFFER_WORDS : MODBUS_MAX_READ_REGISTERS};
+static constexpr uint16_t MODBUS_BLOCK_BITS             {((MODBUS_READ_BUFFER_WORDS * 16) < MODBUS_MAX_READ_BITS) ? (uint16_t)(MODBUS_READ_BUFFER_WORDS * 16) : MODBUS_MAX_READ_BITS};
+static constexpr size_t MODBUS_POLL_BATCH               {32};   // Most points planned together in one pass of the poll thread
+static constexpr size_t MODBUS_POINT_TEXT_LENGTH        {96};   // Longest compact point definition
+static constexpr size_t MODBUS_POINT_FIELDS             {14};   // Fields in a full compact point definition
+static constexpr uint32_t MODBUS_SCHEDULE_SLACK_MS      {20};   // Points due this close together are polled together so they can share block reads
+static constexpr uint32_t MODBUS_PUBLISH_WAIT_MS        {1000}; // Longest sleep while results refused by the publish queue wait
+static constexpr size_t MODBUS_PUBLISH_SIZE             {1024}; // Largest event payload
+static constexpr size_t MODBUS_PUBLISH_ENTRY_MAX        {72};   // Longest serialized result
+static constexpr size_t MODBUS_PUBLISH_TAIL_MAX         {352};  // Room kept for the bus statistics and closing brackets
+static constexpr size_t MODBUS_RESULT_CAPACITY          {256};  // Results held between publishes
+static constexpr size_t MODBUS_WIDE_REGISTERS           {16};   // Most registers in a string or register array
+static constexpr size_t MODBUS_WIDE_CAPACITY            {32};   // String and array results held between publishes
+static constexpr size_t MODBUS_PUBLISH_WIDE_MAX         {200};  // Longest serialized string or array result
+static constexpr uint8_t MODBUS_RESULT_UNDECODABLE      {0xe8}; // Result code of a read whose registers hold no valid value
+static constexpr size_t MODBUS_SLAVE_COUNT              {16};   // Slaves whose health is tracked
+static constexpr size_t MODBUS_RETRY_LIMIT              {2};    // Retries of a transaction after a transient error
+static constexpr size_t MODBUS_FAULT_CAPACITY           {8};    // Slave fault notices held between publishes
+static constexpr size_t MODBUS_WRITE_CAPACITY           {16};   // Writes waiting for the bus
+static constexpr size_t MODBUS_WRITE_VALUES             {32};   // Most registers or coils in one write, including coalesced writes
+static constexpr size_t MODBUS_WRITE_TEXT_LENGTH        {256};  // Longest write request
+static constexpr size_t MODBUS_PUBLISH_WRITE_MAX        {96};   // Longest serialized write outcome
+static constexpr uint32_t MODBUS_TIMEOUT_DEFAULT_MS     {2000};
+static constexpr size_t MODBUS_DIAG_SLAVE_MAX           {200};  // Longest serialized slave diagnostics entry
+static constexpr size_t MODBUS_DIAG_POINT_MAX           {56};   // Longest serialized point diagnostics entry
+static constexpr uint32_t MODBUS_RESPONSE_LIMITS_MS[]   {10, 25, 50, 100, 250, 500, 1000};  // Upper bounds of the response time histogram buckets
+static constexpr size_t MODBUS_RESPONSE_BUCKETS         {sizeof(MODBUS_RESPONSE_LIMITS_MS) / sizeof(MODBUS_RESPONSE_LIMITS_MS[0]) + 1};
+static constexpr uint32_t MODBUS_CPU_WINDOW_MS          {10000}; // Averaging window for the thread activity metric
+static constexpr uint32_t MODBUS_POLL_MIN_MS            {50};   // Fastest poll period accepted
+static constexpr int32_t MODBUS_PRIORITY_HIGH           {3};
+static constexpr uint32_t MODBUS_OVERLOAD_BUS_PERCENT   {90};   // Bus busier than this over a window counts as overloaded
+static constexpr uint32_t MODBUS_JITTER_LIMITS_MS[]     {5, 20, 50, 100, 250, 1000};    // Upper bounds of the lateness histogram buckets
+static constexpr size_t MODBUS_JITTER_BUCKETS           {sizeof(MODBUS_JITTER_LIMITS_MS) / sizeof(MODBUS_JITTER_LIMITS_MS[0]) + 1};
+static constexpr uint32_t MODBUS_DISCOVER_TIMEOUT_MS    {100};  // Slave turnaround allowed for each discovery probe, on top of the frame time
+static constexpr uint32_t MODBUS_DISCOVER_SETTLE_MS     {5};    // Bus silence after changing the port settings
+static constexpr uint32_t MODBUS_DISCOVER_HOLDOFF_MS    {300000}; // Least time between discoveries started by bus errors
+static constexpr uint32_t MODBUS_DISCOVER_MIN_REQUESTS  {20};   // Transactions needed in a window before its error rate counts
+static constexpr uint32_t MODBUS_SLAVE_SERVE_MS         {200};  // Time the local slave serves the port between checks of its settings
+static constexpr size_t MODBUS_THREAD_STACK             {3 * 1024};
+static constexpr size_t MODBUS_STACK_LOW_WORDS          {128};  // Stack headroom below which a warning is logged
 
 enum class ModbusServerPublish
 {
@@ -74,6 +138,26 @@ enum class ModbusServerType
     Float32cdab,
     Float32dcba,
     Bits,
+    Int64,
+    Uint64,
+    Int64cdab,
+    Uint64cdab,
+    Float64abcd,
+    Float64badc,
+    Float64cdab,
+    Float64dcba,
+    Bcd16,
+    Bcd32,
+    String,
+    Int16Array,
+    Uint16Array,
+};
+
+enum class ModbusValueKind : uint8_t
+{
+    Number,                                     ///< One value
+    Text,                                       ///< ASCII string over count registers
+    Array,                                      ///< One 16-bit value per register over count registers
 };
 
 
@@ -82,6 +166,7 @@ enum class ModbusServerType
 //
 static Logger monitorOneLog("IoModbus");
 static Thread* modbusThread;
+static os_semaphore_t modbusWakeSemaphore;
 
 struct ModbusSettings
 {
@@ -91,54 +176,337 @@ struct ModbusSettings
 
 static ModbusSettings modbusRtuSettings { MODBUS_BAUD_DEFAULT, MODBUS_PARITY_DEFAULT};
 static ModbusSettings modbusRtuSettingsShadow { MODBUS_BAUD_DEFAULT, MODBUS_PARITY_DEFAULT};
+// Settings from the config service wait here for the poll thread, the only thread that changes the port
+static ModbusSettings modbusRtuSettingsRequested { MODBUS_BAUD_DEFAULT, MODBUS_PARITY_DEFAULT};
+static std::atomic<bool> modbusSettingsRequested {false};
+static RecursiveMutex modbusSettingsMutex;          // Guards the live and requested settings between threads
+
+// Baud rate and parity discovery against a known slave and register
+struct ModbusDiscoverConfig {
+    bool enabled                        {false};    ///< Discover the settings at boot and when bus errors spike
+    int32_t id                          {1};        ///< Slave ID probed
+    int32_t address                     {0};        ///< Register probed
+    ModbusServerFunction function       {ModbusServerFunction::HoldingRegister};
+    int32_t errorRate                   {0};        ///< Percent of failed transactions in a window that starts discovery, zero to disable
+};
+
+static ModbusDiscoverConfig modbusDiscoverConfig {};
+static std::atomic<bool> modbusDiscoverRequested {false};
 static int32_t modbusInterMessageDelay {MODBUS_IMD_DEFAULT};
+static uint32_t modbusFrameEndUs {0};           // Microsecond timestamp of the end of the last transaction
+static int32_t modbusBlockGap {MODBUS_GAP_DEFAULT};
 static ModbusClient modbusRtu;
 
+// Transport every transaction goes through, the RS-485 port unless built for the simulator
+#if defined(MODBUS_SIMULATOR) && MODBUS_SIMULATOR
+static ModbusSimulator modbusSimulator;
+static ModbusTransport& modbusBus {modbusSimulator};
+#else
+static ModbusClientTransport modbusClientBus(modbusRtu, Serial1);
+static ModbusTransport& modbusBus {modbusClientBus};
+#endif
+
 struct ModbusServerConfig {
     bool enabled                        {false};
     int32_t id                          {1};
     int32_t timeout                     {2000};
     int32_t pollInterval                {1};
+    int32_t pollMs                      {0};    ///< Overrides pollInterval when not zero
+    int32_t priority                    {0};
     ModbusServerPublish publish         {ModbusServerPublish::Always};
     ModbusServerFunction function       {ModbusServerFunction::Coil};
     uint32_t address                    {0};
     ModbusServerType type               {ModbusServerType::Uint16};
     uint32_t mask                       {UINT16_MAX};
     uint32_t shift                      {0};
+    int32_t count                       {1};    ///< Registers in a string or register array
     double offset                       {0.0};
     double scale                        {1.0};
-
-    // Other fields that descibe the data
-    unsigned int readLength             {1};
-    bool signedInt                      {false};
-    uint32_t negativeTest               {0x8000};
-    uint32_t signExtend                 {0};
-    bool isFloat                        {false};
-    ModbusFloatEndianess endian         {ModbusFloatEndianess::CDAB};
+    double deadband                     {0.0};
+    double deadbandPercent              {0.0};
+    double rate                         {0.0};
+    int32_t heartbeat                   {0};
 };
 
 struct ModbusServerObject {
     char name[16];
+    int index;
     ModbusServerConfig primary;
     ModbusServerConfig shadow;
     ConfigObject* configObject;
-    RecursiveMutex mutex;
-    unsigned int loopTick;
-    ModbusClientContext context;
 };
 
-static Vector<ModbusServerObject*> modbusServers {};
+// Runtime form of one polled point whether configured through a modbusN object or the point table
+struct ModbusPoint {
+    bool enabled                        {false};
+    uint8_t id                          {1};
+    uint8_t shift                       {0};
+    uint8_t readLength                  {1};
+    ModbusServerFunction function       {ModbusServerFunction::Coil};
+    ModbusServerType type               {ModbusServerType::Uint16};
+    uint16_t address                    {0};
+    uint16_t mask                       {UINT16_MAX};
+    uint16_t timeoutMs                  {MODBUS_TIMEOUT_DEFAULT_MS};    ///< Longest wait for a response
+    uint8_t priority                    {0};    ///< Higher priority points are polled first when the bus falls behind
+    uint32_t pollMs                     {1000};
+    double offset                       {0.0};
+    double scale                        {1.0};
+
+    // Report by exception settings, used when publish is OnThreshold
+    ModbusServerPublish publish         {ModbusServerPublish::Always};
+    float deadband                      {0.0f}; ///< Change from the last reported value that is reported
+    float deadbandPercent               {0.0f}; ///< As above in percent of the last reported value
+    float rate                          {0.0f}; ///< Rate of change between polls, in units per second, that is reported
+    uint32_t heartbeatMs                {0};    ///< Longest time without a report, zero for no limit
+
+    // Other fields that descibe the data
+    uint8_t count                       {1};    ///< Registers in a string or register array
+    ModbusValueKind kind                {ModbusValueKind::Number};
+    ModbusDecoder decode                {modbusDecodeUint16};
+    ModbusDecoding decoding             {};
+};
+
+struct ModbusPointKey {
+    char name[8];
+    uint16_t index;                             ///< Pool index of the point
+};
+
+struct ModbusPointPage {
+    char name[16];
+    size_t first;                               ///< Pool index of the first point on the page
+    ConfigObject* configObject;
+};
+
+static ModbusServerObject modbusServers[MODBUS_CLIENT_COUNT] {};
+static ModbusPointPage modbusPages[MODBUS_TABLE_PAGES] {};
+
+// Fixed point pool, the modbusN objects come first and the point table follows.  Configuration
+// changes publish a new copy of the pool that the poll thread picks up without locking.
+static ModbusPoint modbusPointBuffers[2][MODBUS_POINT_COUNT] {};
+static ConfigSnapshot<ModbusPoint> modbusPoints(modbusPointBuffers[0], modbusPointBuffers[1], MODBUS_POINT_COUNT);
+static RecursiveMutex modbusPointsMutex;           // Serializes configuration writers
+static ModbusPoint modbusPageShadow[MODBUS_TABLE_PAGE_POINTS] {};
+static ModbusPointKey modbusPointKeys[MODBUS_TABLE_POINTS] {};
 
 struct ModbusPublish {
-    char* name {nullptr};
-    //bool isFloat {false};
-    //bool signedInt {false};
     double value {0.0};
+    uint16_t point {0};
+    uint8_t result {0};
+};
+
+// Results waiting to be published, only touched by the poll thread
+static ModbusPublish resultStorage[MODBUS_RESULT_CAPACITY];
+static FixedRing<ModbusPublish> resultsToPublish(resultStorage, MODBUS_RESULT_CAPACITY);
+
+struct ModbusWidePublish {
+    uint16_t point {0};
     uint8_t result {0};
+    uint8_t count {0};                          ///< Values of an array result, zero for a string
+    union {
+        float values[MODBUS_WIDE_REGISTERS];
+        char text[2 * MODBUS_WIDE_REGISTERS + 1];
+    };
+};
+
+// String and register array results waiting to be published, only touched by the poll thread
+static ModbusWidePublish wideResultStorage[MODBUS_WIDE_CAPACITY];
+static FixedRing<ModbusWidePublish> wideResultsToPublish(wideResultStorage, MODBUS_WIDE_CAPACITY);
+
+// Last reported and last polled values of each point, only touched by the poll thread
+struct ModbusReportState {
+    bool reported;
+    uint8_t result;
+    double value;
+    double sample;
+    uint32_t sampleMs;
+    uint32_t reportMs;
+    uint32_t digest;                            ///< Hash of the last reported registers of a string or array
+};
+
+static ModbusReportState modbusReports[MODBUS_POINT_COUNT] {};
+
+// Transaction outcomes since boot
+struct ModbusCounters {
+    uint32_t requests;
+    uint32_t successes;
+    uint32_t timeouts;
+    uint32_t crcErrors;
+    uint32_t exceptions;                        ///< Exception responses from the slave
+    uint32_t garbled;                           ///< Responses from the wrong slave or for the wrong function
+    uint32_t response[MODBUS_RESPONSE_BUCKETS]; ///< Transaction time of every response
+};
+
+struct ModbusSlave {
+    SlaveHealth health;
+    ModbusCounters counters;
+};
+
+// Health of each slave in use, only touched by the poll thread
+static ModbusSlave modbusSlaves[MODBUS_SLAVE_COUNT];
+static size_t modbusSlaveCount {0};
+static ModbusCounters busCounters {};
+
+// Poll outcomes under the current configuration
+struct ModbusPointCounters {
+    uint32_t polls;
+    uint32_t failures;
+    uint32_t lagMaxMs;                          ///< Longest a poll started after its deadline
+    uint8_t result;                             ///< Last Modbus result code
+};
+
+static ModbusPointCounters modbusPointCounters[MODBUS_POINT_COUNT] {};
+
+// Diagnostics requested through the cloud function, published by the poll thread
+static std::atomic<bool> modbusDiagRequested {false};
+static size_t modbusDiagCursor {0};
+static bool modbusDiagActive {false};
+
+struct ModbusFaultNotice {
+    uint8_t id;
+    uint8_t result;                             ///< Last Modbus result code
+    bool quarantined;                           ///< Entered quarantine, otherwise recovered
+    uint32_t failures;
+    uint32_t backoffMs;
+};
+
+static ModbusFaultNotice faultStorage[MODBUS_FAULT_CAPACITY];
+static FixedRing<ModbusFaultNotice> modbusFaults(faultStorage, MODBUS_FAULT_CAPACITY);
+
+// Outcome of the last discovery waiting to be published, only touched by the poll thread
+struct ModbusDiscoverNotice {
+    bool pending;
+    bool found;
+    ModbusSettings settings;                    ///< Settings in use after discovery
+    uint32_t probes;
+    uint32_t elapsedMs;
+};
+
+static ModbusDiscoverNotice modbusDiscoverNotice {};
+static uint32_t modbusDiscoverAt {0};
+static bool modbusDiscovered {false};           ///< At least one discovery has run
+
+struct ModbusWrite {
+    uint8_t id;
+    bool coil;                                  ///< Coils, otherwise holding registers
+    bool verify;                                ///< Read the values back after writing
+    uint8_t count;
+    uint16_t address;
+    uint16_t values[MODBUS_WRITE_VALUES];       ///< Register values, or zero and one for coils
+};
+
+// Writes waiting for the bus, queued from any thread and run ahead of polls by the poll thread
+static RecursiveMutex modbusWritesMutex;
+static ModbusWrite writeStorage[MODBUS_WRITE_CAPACITY];
+static FixedRing<ModbusWrite> modbusWrites(writeStorage, MODBUS_WRITE_CAPACITY);
+static_assert(MODBUS_WRITE_VALUES <= (sizeof(ModbusClientContext::writeBuffer) / sizeof(uint16_t)), "Writes must fit the client write buffer");
+
+enum class ModbusVerifyState : uint8_t {
+    None,
+    Passed,
+    Failed,
+};
+
+struct ModbusWriteOutcome {
+    uint8_t id;
+    bool coil;
+    uint8_t count;
+    uint8_t result;                             ///< Modbus result code of the write
+    uint16_t address;
+    ModbusVerifyState verify;
+};
+
+// Write outcomes waiting to be published, only touched by the poll thread
+static ModbusWriteOutcome writeOutcomeStorage[MODBUS_WRITE_CAPACITY];
+static FixedRing<ModbusWriteOutcome> writeOutcomes(writeOutcomeStorage, MODBUS_WRITE_CAPACITY);
+
+// Bus time accumulated between publishes
+struct ModbusBusStats {
+    uint32_t transactions;
+    uint32_t measuredUs;                        ///< Time spent in read transactions
+    uint32_t estimateUs;                        ///< Estimated time for the block reads issued
+    uint32_t estimateSingleUs;                  ///< Estimated time had each object been read on its own
+    uint32_t missed;                            ///< Deadlines skipped because a poll fell a whole period behind
+    uint32_t jitter[MODBUS_JITTER_BUCKETS];     ///< Lateness of each poll against its deadline
+    uint32_t suppressed;                        ///< Polls not reported because nothing of note changed
+    uint32_t retries;                           ///< Transactions repeated after a transient error
+    uint32_t skipped;                           ///< Polls of quarantined slaves left out
+    uint32_t dropped;                           ///< Events the publish queue turned away
+};
+
+static ModbusBusStats busStats {};
+
+// Time the poll thread spends awake rather than blocked waiting for the next deadline
+struct ModbusThreadStats {
+    uint32_t activeUs;
+    uint32_t wakeups;
+    uint32_t windowStart;
+    uint32_t busUs;
+    uint32_t missed;
+    uint32_t lagMaxMs;
+};
+
+static ModbusThreadStats threadStats {};
+static double modbusThreadLoad {0.0};   // Percent of the last window spent awake
+static bool modbusOverload {false};     // Bus could not keep up with the requested poll rates over the last window
+static double modbusBusUtil {0.0};      // Percent of the last window spent in bus transactions
+static int modbusLagMs {0};             // Longest poll lag behind schedule in the last window
+static size_t modbusStackFree {0};      // Least stack left free on the poll thread, in words
+
+// Poll planning buffers, only touched by the modbus thread
+static PollScheduler::Entry pollHeap[MODBUS_POINT_COUNT];
+static PollScheduler pollSchedule(pollHeap, MODBUS_POINT_COUNT);
+static uint32_t pollIntervals[MODBUS_POINT_COUNT];  // Milliseconds
+static uint16_t pollGroups[MODBUS_POINT_COUNT];
+static ModbusPoint pollConfigs[MODBUS_POLL_BATCH];
+static uint16_t pollPoints[MODBUS_POLL_BATCH];
+static uint32_t pollDue[MODBUS_POLL_BATCH];
+static PollScheduler::Entry pollReady[MODBUS_POINT_COUNT];
+static ModbusPollRequest pollRequests[MODBUS_POLL_BATCH];
+static ModbusPollBlock pollBlocks[MODBUS_POLL_BATCH];
+static ModbusClientContext pollContext;
+
+static const struct {
+    const char* name;
+    ModbusServerFunction function;
+} modbusFunctionNames[] {
+    {"coil", ModbusServerFunction::Coil},
+    {"di", ModbusServerFunction::DiscreteInput},
+    {"ir", ModbusServerFunction::InputRegister},
+    {"hr", ModbusServerFunction::HoldingRegister},
 };
 
-static Vector<ModbusPublish> resultsToPublish;
-static unsigned int publishTick;
+// Everything needed to read and decode each data type, looked up once when a point is configured
+static const struct {
+    const char* name;
+    ModbusServerType type;
+    uint8_t words;                              ///< Registers read, zero for the configured count
+    ModbusByteOrder order;
+    ModbusValueKind kind;
+    ModbusDecoder decode;                       ///< Decoder of one value, or of each element of an array
+} modbusTypeNames[] {
+    {"int16", ModbusServerType::Int16, 1, ModbusByteOrder::ABCD, ModbusValueKind::Number, modbusDecodeInt16},
+    {"uint16", ModbusServerType::Uint16, 1, ModbusByteOrder::ABCD, ModbusValueKind::Number, modbusDecodeUint16},
+    {"int32", ModbusServerType::Int32, 2, ModbusByteOrder::ABCD, ModbusValueKind::Number, modbusDecodeInt32},
+    {"uint32", ModbusServerType::Uint32, 2, ModbusByteOrder::ABCD, ModbusValueKind::Number, modbusDecodeUint32},
+    {"float32_abcd", ModbusServerType::Float32abcd, 2, ModbusByteOrder::ABCD, ModbusValueKind::Number, modbusDecodeFloat32},
+    {"float32_badc", ModbusServerType::Float32badc, 2, ModbusByteOrder::BADC, ModbusValueKind::Number, modbusDecodeFloat32},
+    {"float32_cdab", ModbusServerType::Float32cdab, 2, ModbusByteOrder::CDAB, ModbusValueKind::Number, modbusDecodeFloat32},
+    {"float32_dcba", ModbusServerType::Float32dcba, 2, ModbusByteOrder::DCBA, ModbusValueKind::Number, modbusDecodeFloat32},
+    {"bits", ModbusServerType::Bits, 1, ModbusByteOrder::ABCD, ModbusValueKind::Number, modbusDecodeUint16},
+    {"int64", ModbusServerType::Int64, 4, ModbusByteOrder::ABCD, ModbusValueKind::Number, modbusDecodeInt64},
+    {"uint64", ModbusServerType::Uint64, 4, ModbusByteOrder::ABCD, ModbusValueKind::Number, modbusDecodeUint64},
+    {"int64_cdab", ModbusServerType::Int64cdab, 4, ModbusByteOrder::CDAB, ModbusValueKind::Number, modbusDecodeInt64},
+    {"uint64_cdab", ModbusServerType::Uint64cdab, 4, ModbusByteOrder::CDAB, ModbusValueKind::Number, modbusDecodeUint64},
+    {"float64_abcd", ModbusServerType::Float64abcd, 4, ModbusByteOrder::ABCD, ModbusValueKind::Number, modbusDecodeFloat64},
+    {"float64_badc", ModbusServerType::Float64badc, 4, ModbusByteOrder::BADC, ModbusValueKind::Number, modbusDecodeFloat64},
+    {"float64_cdab", ModbusServerType::Float64cdab, 4, ModbusByteOrder::CDAB, ModbusValueKind::Number, modbusDecodeFloat64},
+    {"float64_dcba", ModbusServerType::Float64dcba, 4, ModbusByteOrder::DCBA, ModbusValueKind::Number, modbusDecodeFloat64},
+    {"bcd16", ModbusServerType::Bcd16, 1, ModbusByteOrder::ABCD, ModbusValueKind::Number, modbusDecodeBcd16},
+    {"bcd32", ModbusServerType::Bcd32, 2, ModbusByteOrder::ABCD, ModbusValueKind::Number, modbusDecodeBcd32},
+    {"string", ModbusServerType::String, 0, ModbusByteOrder::ABCD, ModbusValueKind::Text, nullptr},
+    {"int16_array", ModbusServerType::Int16Array, 0, ModbusByteOrder::ABCD, ModbusValueKind::Array, modbusDecodeInt16},
+    {"uint16_array", ModbusServerType::Uint16Array, 0, ModbusByteOrder::ABCD, ModbusValueKind::Array, modbusDecodeUint16},
+};
 
 
 //
@@ -250,7 +618,7 @@ int modbusChangeInterfaceSettings(ModbusSettings& settings)
         return SYSTEM_ERROR_INVALID_ARGUMENT;
     }
 
-    Serial1.begin(baud, SERIAL_DATA_BITS_8 | SERIAL_STOP_BITS_1 | parity);
+    modbusBus.configure(baud, parity);
 
     return SYSTEM_ERROR_NONE;
 }
@@ -266,6 +634,7 @@ int config_modbus_enter(bool write, const void *context)
 {
     if (write)
     {
+        const std::lock_guard<RecursiveMutex> lock(modbusSettingsMutex);
         memcpy(&modbusRtuSettingsShadow, &modbusRtuSettings, sizeof(modbusRtuSettingsShadow));
     }
     return 0;
@@ -274,6 +643,9 @@ int config_modbus_enter(bool write, const void *context)
 /**
  * @brief Config service object settings to commit new JSON configuration
  *
+ * @details The new settings are posted to the poll thread, which applies them between
+ *          transactions rather than changing the port underneath one.
+ *
  * @param write Indicates whether the current operation is to write
  * @param status Status of the command return value
  * @param context Unused
@@ -283,12 +655,72 @@ int config_modbus_exit(bool write, int status, const void *context)
 {
     if (write && (0 == status))
     {
-        memcpy(&modbusRtuSettings, &modbusRtuSettingsShadow, sizeof(modbusRtuSettings));
-        modbusChangeInterfaceSettings(modbusRtuSettings);
+        {
+            const std::lock_guard<RecursiveMutex> lock(modbusSettingsMutex);
+            memcpy(&modbusRtuSettingsRequested, &modbusRtuSettingsShadow, sizeof(modbusRtuSettingsRequested));
+        }
+        modbusSettingsRequested = true;
+
+        // The configured settings become the first guess of a fresh discovery
+        if (modbusDiscoverConfig.enabled)
+        {
+            modbusDiscoverRequested = true;
+        }
+        if (nullptr != modbusWakeSemaphore)
+        {
+            os_semaphore_give(modbusWakeSemaphore, false);
+        }
     }
     return status;
 }
 
+/**
+ * @brief Change the live settings and the port to match, called from the poll thread only
+ *
+ * @param settings New settings
+ */
+static void modbusApplySettings(const ModbusSettings& settings)
+{
+    const std::lock_guard<RecursiveMutex> lock(modbusSettingsMutex);
+    modbusRtuSettings = settings;
+    modbusChangeInterfaceSettings(modbusRtuSettings);
+}
+
+/**
+ * @brief Apply settings posted by the config service, if any
+ *
+ */
+static void modbusApplyRequestedSettings()
+{
+    if (modbusSettingsRequested.exchange(false))
+    {
+        const std::lock_guard<RecursiveMutex> lock(modbusSettingsMutex);
+        modbusApplySettings(modbusRtuSettingsRequested);
+    }
+}
+
+#if defined(MODBUS_SIMULATOR) && MODBUS_SIMULATOR
+/**
+ * @brief Bring up simulated slaves 1 to 4 answering every address with a slowly changing value
+ *
+ */
+static void modbusSimulatorSetup()
+{
+    for (uint8_t id = 1; id <= 4; id++)
+    {
+        modbusSimulator.addSlave(id, 2000, 1000);
+    }
+    modbusSimulator.setGenerator([](uint8_t id, ModbusSimulator::Table table, uint16_t address) {
+        auto seconds = millis() / 1000;
+        if ((ModbusSimulator::Table::Coils == table) || (ModbusSimulator::Table::DiscreteInputs == table))
+        {
+            return (uint16_t)((seconds + address) & 1);
+        }
+        return (uint16_t)(id * 1000 + address + seconds % 100);
+    });
+}
+#endif
+
 /**
  * @brief Create the Modbus RTU configuration settings
  *
@@ -318,7 +750,18 @@ int buildModbusRtuSettings() {
                 },
                 config_get_int32_cb, config_set_int32_cb,
                 &modbusRtuSettings.parity, &modbusRtuSettingsShadow.parity),
-            ConfigInt("imd", &modbusInterMessageDelay)
+            ConfigInt("imd", &modbusInterMessageDelay),
+            ConfigInt("gap", &modbusBlockGap, -1, MODBUS_MAX_READ_REGISTERS),
+            ConfigBool("discover", &modbusDiscoverConfig.enabled),
+            ConfigInt("probe_id", &modbusDiscoverConfig.id, 1, 247),
+            ConfigInt("probe_addr", &modbusDiscoverConfig.address, 0, UINT16_MAX),
+            ConfigStringEnum("probe_fn", {
+                    {"input_register", (int32_t) ModbusServerFunction::InputRegister},
+                    {"holding_register", (int32_t) ModbusServerFunction::HoldingRegister},
+                },
+                config_get_int32_cb, config_set_int32_cb,
+                &modbusDiscoverConfig.function, &modbusDiscoverConfig.function),
+            ConfigInt("err_rate", &modbusDiscoverConfig.errorRate, 0, 100)
         },
         config_modbus_enter,
         config_modbus_exit
@@ -327,15 +770,78 @@ int buildModbusRtuSettings() {
 
     // Modbus RTU settings
     modbusChangeInterfaceSettings(modbusRtuSettings);
+#if defined(MODBUS_SIMULATOR) && MODBUS_SIMULATOR
+    modbusSimulatorSetup();
+#else
     modbusRtu.begin(Serial1);
     // Callbacks allow us to configure the RS485 transceiver correctly
     modbusRtu.preTransmission([]() {digitalWrite(MONITOREDGE_IOEX_RS485_DE_PIN, 1);});
     modbusRtu.postTransmission([]() {digitalWrite(MONITOREDGE_IOEX_RS485_DE_PIN, 0);});
     modbusRtu.idle([]() {os_thread_yield();});
+#endif
 
     return 0;
 }
 
+/**
+ * @brief Replace points in the pool and wake the poll thread
+ *
+ * @param first Pool index of the first point
+ * @param points Replacement points
+ * @param count Number of points to replace
+ */
+static void modbusCommitPoints(size_t first, const ModbusPoint* points, size_t count)
+{
+    {
+        const std::lock_guard<RecursiveMutex> lock(modbusPointsMutex);
+        // The poll thread only holds a snapshot while it picks the points that are due
+        auto edit = modbusPoints.edit([]() { delay(1); });
+        memcpy(&edit[first], points, count * sizeof(ModbusPoint));
+        modbusPoints.commit();
+    }
+
+    if (nullptr != modbusWakeSemaphore)
+    {
+        os_semaphore_give(modbusWakeSemaphore, false);
+    }
+}
+
+/**
+ * @brief Fill in the fields that describe how to read and decode a point
+ *
+ * @param point Point with its user settings filled in
+ */
+static void modbusDerivePoint(ModbusPoint& point)
+{
+    auto info = &modbusTypeNames[0];
+    for (auto& entry: modbusTypeNames)
+    {
+        if (entry.type == point.type)
+        {
+            info = &entry;
+        }
+    }
+
+    // Fixed for paranoia
+    point.shift = min(point.shift, (uint8_t)15);
+    point.pollMs = max(point.pollMs, MODBUS_POLL_MIN_MS);
+    point.priority = min(point.priority, (uint8_t)MODBUS_PRIORITY_HIGH);
+    point.deadband = fabsf(point.deadband);
+    point.deadbandPercent = fabsf(point.deadbandPercent);
+    point.rate = fabsf(point.rate);
+
+    point.kind = info->kind;
+    point.decode = info->decode;
+    point.count = (ModbusValueKind::Number == info->kind) ? 1 : min(max(point.count, (uint8_t)1), (uint8_t)MODBUS_WIDE_REGISTERS);
+    point.readLength = (0 != info->words) ? info->words : point.count;
+
+    point.decoding = {};
+    point.decoding.mask = point.mask;
+    point.decoding.shift = point.shift;
+    point.decoding.order = info->order;
+    modbusDeriveSign(point.decoding);
+}
+
 /**
  * @brief Config service object setting upon new JSON configuration for polling
  *
@@ -350,7 +856,6 @@ int modbusConfigEnter(bool write, const void *context)
 
     if (write)
     {
-        const std::lock_guard<RecursiveMutex> lock(modbusContext->mutex);
         memcpy(&modbusContext->shadow, &modbusContext->primary, sizeof(modbusContext->shadow));
     }
     return 0;
@@ -371,95 +876,30 @@ int modbusConfigExit(bool write, int status, const void *context)
 
     if (write && (0 == status))
     {
-        const std::lock_guard<RecursiveMutex> lock(modbusContext->mutex);
         memcpy(&modbusContext->primary, &modbusContext->shadow, sizeof(modbusContext->primary));
 
-        // Collect properties of the data type
-        modbusContext->primary.signedInt = false;
-        modbusContext->primary.isFloat = false;
-        switch (modbusContext->primary.type)
-        {
-            case ModbusServerType::Int16:
-                modbusContext->primary.signedInt = true;
-                // Fall through
-            case ModbusServerType::Uint16:
-            // Fall through
-            case ModbusServerType::Bits:
-                modbusContext->primary.readLength = 1;
-                break;
-
-            case ModbusServerType::Int32:
-                modbusContext->primary.signedInt = true;
-                // Fall through
-            case ModbusServerType::Uint32:
-                modbusContext->primary.readLength = 2;
-                break;
-
-            case ModbusServerType::Float32abcd:
-                // Fall through
-            case ModbusServerType::Float32badc:
-                // Fall through
-            case ModbusServerType::Float32cdab:
-                // Fall through
-            case ModbusServerType::Float32dcba:
-                modbusContext->primary.isFloat = true;
-                modbusContext->primary.readLength = 2;
-                break;
-        }
-
-        switch (modbusContext->primary.type)
-        {
-            case ModbusServerType::Float32abcd:
-                modbusContext->primary.endian = ModbusFloatEndianess::ABCD;
-                break;
-
-            case ModbusServerType::Float32badc:
-                modbusContext->primary.endian = ModbusFloatEndianess::BADC;
-                break;
-
-            case ModbusServerType::Float32cdab:
-                modbusContext->primary.endian = ModbusFloatEndianess::CDAB;
-                break;
-
-            case ModbusServerType::Float32dcba:
-                modbusContext->primary.endian = ModbusFloatEndianess::DCBA;
-                break;
-        }
-
-        // Fixed for paranoia
-        modbusContext->primary.shift = min(modbusContext->primary.shift, 15UL);
-        modbusContext->primary.mask &= 0xffff;
-        modbusContext->primary.address &= 0xffff;
-
-        if (modbusContext->primary.signedInt)
-        {
-            // Figure out sign extension for signed types
-            auto leadingZeros = __builtin_clz((unsigned int)(modbusContext->primary.mask >> modbusContext->primary.shift));
-            leadingZeros -= 16; // We only care about the least significant 16 bits
-
-            if (15 > leadingZeros)
-            {
-                modbusContext->primary.negativeTest = 1UL << (15 - leadingZeros);  // This is a mask to test the sign bit
-                modbusContext->primary.signExtend = UINT32_MAX << (15 - leadingZeros); // This is the pattern to OR the result to extend the sign bit
-            }
-            else
-            {
-                // The number doesn't have enough bits to represent a negative number
-                modbusContext->primary.negativeTest = 0;
-                modbusContext->primary.signExtend = 0;
-            }
-        }
-
-        // Serial.printlnf(
-        //     "ID=%ld, TO=%ld, PI=%ld, FN=%d, ADD=0x%04lx, MASK=0x%04lx, SHIFT=%ld, NT=0x%04lx, SE=0x%04lx, LOW=%0.3lf, HIGH=%0.3lf",
-        //     modbusContext->primary.id,
-        //     modbusContext->primary.timeout,
-        //     modbusContext->primary.pollInterval,
-        //     (int)modbusContext->primary.function,
-        //     modbusContext->primary.address,
-        //     modbusContext->primary.mask, modbusContext->primary.shift,
-        //     modbusContext->primary.negativeTest, modbusContext->primary.signExtend,
-        //     modbusContext->primary.offset, modbusContext->primary.scale);
+        ModbusPoint point {};
+        point.enabled = modbusContext->primary.enabled;
+        point.id = (uint8_t)modbusContext->primary.id;
+        point.function = modbusContext->primary.function;
+        point.type = modbusContext->primary.type;
+        point.address = (uint16_t)(modbusContext->primary.address & 0xffff);
+        point.mask = (uint16_t)(modbusContext->primary.mask & 0xffff);
+        point.shift = (uint8_t)min(modbusContext->primary.shift, 15UL);
+        point.count = (uint8_t)min(max(modbusContext->primary.count, 1L), (int32_t)MODBUS_WIDE_REGISTERS);
+        point.pollMs = (modbusContext->primary.pollMs > 0) ? (uint32_t)modbusContext->primary.pollMs : (uint32_t)max(modbusContext->primary.pollInterval, 1L) * 1000;
+        point.priority = (uint8_t)modbusContext->primary.priority;
+        point.timeoutMs = (uint16_t)min(max(modbusContext->primary.timeout, (int32_t)SlaveHealth::TIMEOUT_MIN_MS), 10000L);
+        point.offset = modbusContext->primary.offset;
+        point.scale = modbusContext->primary.scale;
+        point.publish = modbusContext->primary.publish;
+        point.deadband = (float)modbusContext->primary.deadband;
+        point.deadbandPercent = (float)modbusContext->primary.deadbandPercent;
+        point.rate = (float)modbusContext->primary.rate;
+        point.heartbeatMs = (uint32_t)max(modbusContext->primary.heartbeat, 0L) * 1000;
+        modbusDerivePoint(point);
+
+        modbusCommitPoints(modbusContext->index, &point, 1);
     }
     return status;
 }
@@ -470,9 +910,10 @@ int modbusConfigExit(bool write, int status, const void *context)
  * @return int Zero (success) always
  */
 int buildModbusSettings(int n) {
-    auto serverConfig = new ModbusServerObject();
+    auto serverConfig = &modbusServers[n - 1];
 
     snprintf(serverConfig->name, sizeof(serverConfig->name), "modbus%d", n);
+    serverConfig->index = n - 1;
 
     serverConfig->configObject = new ConfigObject(serverConfig->name,
         {
@@ -488,8 +929,17 @@ int buildModbusSettings(int n) {
             ConfigInt("poll",
                 config_get_int32_cb, config_set_int32_cb,
                 &serverConfig->primary.pollInterval, &serverConfig->shadow.pollInterval),
+            ConfigInt("poll_ms",
+                config_get_int32_cb, config_set_int32_cb,
+                &serverConfig->primary.pollMs, &serverConfig->shadow.pollMs,
+                0, INT32_MAX),
+            ConfigInt("priority",
+                config_get_int32_cb, config_set_int32_cb,
+                &serverConfig->primary.priority, &serverConfig->shadow.priority,
+                0, MODBUS_PRIORITY_HIGH),
             ConfigStringEnum("publish", {
                     {"always", (int32_t) ModbusServerPublish::Always},
+                    {"on_threshold", (int32_t) ModbusServerPublish::OnThreshold},
                 },
                 config_get_int32_cb, config_set_int32_cb,
                 &serverConfig->primary.publish, &serverConfig->shadow.publish),
@@ -514,6 +964,19 @@ int buildModbusSettings(int n) {
                     {"float32_cdab", (int32_t) ModbusServerType::Float32cdab},
                     {"float32_dcba", (int32_t) ModbusServerType::Float32dcba},
                     {"bits", (int32_t) ModbusServerType::Bits},
+                    {"int64", (int32_t) ModbusServerType::Int64},
+                    {"uint64", (int32_t) ModbusServerType::Uint64},
+                    {"int64_cdab", (int32_t) ModbusServerType::Int64cdab},
+                    {"uint64_cdab", (int32_t) ModbusServerType::Uint64cdab},
+                    {"float64_abcd", (int32_t) ModbusServerType::Float64abcd},
+                    {"float64_badc", (int32_t) ModbusServerType::Float64badc},
+                    {"float64_cdab", (int32_t) ModbusServerType::Float64cdab},
+                    {"float64_dcba", (int32_t) ModbusServerType::Float64dcba},
+                    {"bcd16", (int32_t) ModbusServerType::Bcd16},
+                    {"bcd32", (int32_t) ModbusServerType::Bcd32},
+                    {"string", (int32_t) ModbusServerType::String},
+                    {"int16_array", (int32_t) ModbusServerType::Int16Array},
+                    {"uint16_array", (int32_t) ModbusServerType::Uint16Array},
                 },
                 config_get_int32_cb, config_set_int32_cb,
                 &serverConfig->primary.type, &serverConfig->shadow.type),
@@ -523,160 +986,1899 @@ int buildModbusSettings(int n) {
             ConfigInt("shift",
                 config_get_int32_cb, config_set_int32_cb,
                 &serverConfig->primary.shift, &serverConfig->shadow.shift),
+            ConfigInt("count",
+                config_get_int32_cb, config_set_int32_cb,
+                &serverConfig->primary.count, &serverConfig->shadow.count,
+                1, MODBUS_WIDE_REGISTERS),
             ConfigFloat("offset",
                 config_get_float_cb, config_set_float_cb,
                 &serverConfig->primary.offset, &serverConfig->shadow.offset),
             ConfigFloat("scale",
                 config_get_float_cb, config_set_float_cb,
                 &serverConfig->primary.scale, &serverConfig->shadow.scale),
+            ConfigFloat("deadband",
+                config_get_float_cb, config_set_float_cb,
+                &serverConfig->primary.deadband, &serverConfig->shadow.deadband),
+            ConfigFloat("deadband_pct",
+                config_get_float_cb, config_set_float_cb,
+                &serverConfig->primary.deadbandPercent, &serverConfig->shadow.deadbandPercent),
+            ConfigFloat("rate",
+                config_get_float_cb, config_set_float_cb,
+                &serverConfig->primary.rate, &serverConfig->shadow.rate),
+            ConfigInt("heartbeat",
+                config_get_int32_cb, config_set_int32_cb,
+                &serverConfig->primary.heartbeat, &serverConfig->shadow.heartbeat,
+                0, 86400),
         },
         modbusConfigEnter,
         modbusConfigExit,
         serverConfig, serverConfig
     );
     ConfigService::instance().registerModule(*serverConfig->configObject);
-    modbusServers.append(serverConfig);
 
     return 0;
 }
 
-
 /**
- * @brief The thread that service all poll requests
+ * @brief Parse a whole field of a point definition as an unsigned number
  *
- * @param param Unused
+ * @param field Field text
+ * @param value Parsed value
+ * @param base Number base as for strtoul, zero to accept a 0x prefix
+ * @return true The field holds a number and nothing else
+ * @return false The field is empty, signed or has trailing characters
  */
-void modbusThreadLoop(void* param)
+static bool modbusParseField(const char* field, unsigned long& value, int base = 10)
 {
-    while (true)
-    {
-        for (auto server: modbusServers) {
-            ModbusServerConfig safeConfig {};
-            {
-                const std::lock_guard<RecursiveMutex> lock(server->mutex);
-                memcpy(&safeConfig, &server->primary, sizeof(safeConfig));
-            }
-            if (safeConfig.enabled && ((System.uptime() - server->loopTick) >= (unsigned int)safeConfig.pollInterval)) {
-                server->loopTick = System.uptime();
-
-                uint8_t result {};
-                switch (safeConfig.function)
-                {
-                    case ModbusServerFunction::Coil:
-                        result = modbusRtu.readCoils(safeConfig.id, safeConfig.address, safeConfig.readLength, server->context);
-                        break;
-                    case ModbusServerFunction::DiscreteInput:
-                        result = modbusRtu.readDiscreteInputs(safeConfig.id, safeConfig.address, safeConfig.readLength, server->context);
-                        break;
-                    case ModbusServerFunction::InputRegister:
-                        result = modbusRtu.readInputRegisters(safeConfig.id, safeConfig.address, safeConfig.readLength, server->context);
-                        break;
-                    case ModbusServerFunction::HoldingRegister:
-                        result = modbusRtu.readHoldingRegisters(safeConfig.id, safeConfig.address, safeConfig.readLength, server->context);
-                        break;
-                }
+    char* end = nullptr;
+    value = strtoul(field, &end, base);
+    return isdigit((unsigned char)field[0]) && ('\0' == *end);
+}
 
-                uint32_t uint32_Value {};
+/**
+ * @brief Parse a whole field of a point definition as a finite number
+ *
+ * @param field Field text
+ * @param value Parsed value
+ * @return true The field holds a number and nothing else
+ * @return false The field is empty, not finite or has trailing characters
+ */
+static bool modbusParseField(const char* field, double& value)
+{
+    char* end = nullptr;
+    value = strtod(field, &end);
+    return (end != field) && ('\0' == *end) && std::isfinite(value);
+}
 
-                if (ModbusClient::ku8MBSuccess == result)
-                {
-                    switch (safeConfig.type)
-                    {
-                        case ModbusServerType::Int16:
-                            // Fall through
-                        case ModbusServerType::Bits:
-                            // Fall through
-                        case ModbusServerType::Uint16:
-                            uint32_Value = (uint32_t)server->context.readBuffer[0];
-                            uint32_Value &= safeConfig.mask;
-                            uint32_Value >>= safeConfig.shift;
-                            if (safeConfig.signedInt && (uint32_Value & safeConfig.negativeTest))
-                            {
-                                uint32_Value |= safeConfig.signExtend;
-                            }
-                            break;
-
-                        case ModbusServerType::Int32:
-                            // Fall through
-                        case ModbusServerType::Uint32:
-                            uint32_Value = ModbusClient::wordsToDword(server->context.readBuffer[0], server->context.readBuffer[1]);
-                            break;
-                    }
-                }
+static bool modbusParseField(const char* field, float& value)
+{
+    double number;
+    if (!modbusParseField(field, number))
+    {
+        return false;
+    }
+    value = (float)number;
+    return true;
+}
 
-                double sensorValue {};
-                if (safeConfig.isFloat)
-                {
-                    sensorValue = (double)ModbusClient::wordsToFloat(server->context.readBuffer[0], server->context.readBuffer[1], safeConfig.endian);
-                }
-                else if (safeConfig.signedInt)
-                {
-                    sensorValue = (double)((int32_t)uint32_Value);
-                }
-                else
-                {
-                    sensorValue = (double)uint32_Value;
-                }
+/**
+ * @brief Parse a compact point definition
+ *
+ * @details The definition is
+ *          "id,function,address,type,poll[,scale[,offset[,mask[,shift[,priority[,deadband[,percent[,rate[,heartbeat]]]]]]]]]"
+ *          where function is one of coil, di, ir or hr and type uses the modbusN type names.
+ *          String and array types take their register count as a suffix, as in "string*8".
+ *          The poll period is in seconds, or in milliseconds with an "ms" suffix.  Giving a
+ *          deadband, even zero, reports the point by exception.  Every field given must hold
+ *          a value, so an empty field or one with trailing characters rejects the whole
+ *          definition.  An empty definition disables the point.
+ *
+ * @param text Point definition
+ * @param point Point to fill in
+ * @retval SYSTEM_ERROR_NONE Success
+ * @retval SYSTEM_ERROR_INVALID_ARGUMENT Definition is malformed
+ */
+static int modbusParsePoint(const char* text, ModbusPoint& point)
+{
+    point = {};
+    if ((nullptr == text) || ('\0' == text[0]))
+    {
+        return SYSTEM_ERROR_NONE;
+    }
 
-                sensorValue = sensorValue * safeConfig.scale + safeConfig.offset;
+    char buffer[MODBUS_POINT_TEXT_LENGTH + 1];
+    if (strlen(text) > MODBUS_POINT_TEXT_LENGTH)
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    strcpy(buffer, text);
 
-                ModbusPublish publishMe {};
-                publishMe.name = server->name;
-                publishMe.value = sensorValue;
-                publishMe.result = result;
-                resultsToPublish.append(publishMe);
-            }
+    // Split by hand since strtok_r merges empty fields, which would shift every later column
+    char* fields[MODBUS_POINT_FIELDS] {};
+    size_t count = 0;
+    for (auto field = buffer; field; )
+    {
+        if (count >= MODBUS_POINT_FIELDS)
+        {
+            return SYSTEM_ERROR_INVALID_ARGUMENT;
         }
-
-        if (!resultsToPublish.isEmpty() && ((System.uptime() != publishTick)))
+        fields[count++] = field;
+        field = strchr(field, ',');
+        if (field)
         {
-            publishTick = System.uptime();
-            static char publish1[1024] = {};
-            memset(publish1, 0, sizeof(publish1));
-            JSONBufferWriter toPublish(publish1, sizeof(publish1));
-            toPublish.beginObject();
-            toPublish.name("modbus").beginArray();
+            *field++ = '\0';
+        }
+    }
+    if (count < 5)
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if ('\0' == fields[i][0])
+        {
+            return SYSTEM_ERROR_INVALID_ARGUMENT;
+        }
+    }
 
-            for (auto client: resultsToPublish)
-            {
-                toPublish.beginObject().name("name").value(client.name);
-                toPublish.name("result").value((unsigned long)client.result);
-                if (modbusRtu.ku8MBSuccess == client.result)
-                {
-                    toPublish.name("value").value(client.value);
-                }
-                toPublish.endObject();
-            }
-            toPublish.endArray().endObject();
-            resultsToPublish.clear();
-            if (Particle.connected())
-                Particle.publish("modbus", publish1);
+    unsigned long id;
+    if (!modbusParseField(fields[0], id) || (id < 1) || (id > 255))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    auto function = -1;
+    for (auto& entry: modbusFunctionNames)
+    {
+        if (0 == strcmp(entry.name, fields[1]))
+        {
+            function = (int)entry.function;
         }
-        // Play fair and let other threads execute
-        os_thread_yield();
     }
 
-    // It is safe to exit here with Thread::run properly handling OS thread exit
-}
+    unsigned long address;
+    if ((function < 0) || !modbusParseField(fields[2], address) || (address > 0xffff))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
 
-/**
- * @brief Initializes the Modbus settings and polling thread
- *
- * @return int Zero (success) always
- */
-int modbusInit()
-{
-    buildModbusRtuSettings();
+    auto type = -1;
+    unsigned long registers = 1;
+    auto suffix = strchr(fields[3], '*');
+    if (suffix)
+    {
+        *suffix = '\0';
+        if (!modbusParseField(suffix + 1, registers) || (registers < 1) || (registers > MODBUS_WIDE_REGISTERS))
+        {
+            return SYSTEM_ERROR_INVALID_ARGUMENT;
+        }
+    }
+    for (auto& entry: modbusTypeNames)
+    {
+        if (0 == strcmp(entry.name, fields[3]))
+        {
+            type = (int)entry.type;
+        }
+    }
 
-    //for loop for instances
-    for (int i = 1; i <= MODBUS_CLIENT_COUNT;i++)
+    auto units = strstr(fields[4], "ms");
+    if (units && ('\0' == units[2]))
     {
-        buildModbusSettings(i);
+        *units = '\0';
     }
+    unsigned long poll;
+    if ((type < 0) || !modbusParseField(fields[4], poll))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    poll *= (units) ? 1 : 1000;
+    if (poll < 1)
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    // Fill in a copy so that a rejected definition leaves the point disabled
+    ModbusPoint parsed {};
+    parsed.enabled = true;
+    parsed.id = (uint8_t)id;
+    parsed.function = (ModbusServerFunction)function;
+    parsed.address = (uint16_t)address;
+    parsed.type = (ModbusServerType)type;
+    parsed.count = (uint8_t)registers;
+    parsed.pollMs = poll;
+
+    unsigned long number;
+    if ((count > 5) && !modbusParseField(fields[5], parsed.scale))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    if ((count > 6) && !modbusParseField(fields[6], parsed.offset))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    if (count > 7)
+    {
+        if (!modbusParseField(fields[7], number, 0) || (number > 0xffff))
+        {
+            return SYSTEM_ERROR_INVALID_ARGUMENT;
+        }
+        parsed.mask = (uint16_t)number;
+    }
+    if (count > 8)
+    {
+        if (!modbusParseField(fields[8], number) || (number > 15))
+        {
+            return SYSTEM_ERROR_INVALID_ARGUMENT;
+        }
+        parsed.shift = (uint8_t)number;
+    }
+    if (count > 9)
+    {
+        if (!modbusParseField(fields[9], number))
+        {
+            return SYSTEM_ERROR_INVALID_ARGUMENT;
+        }
+        parsed.priority = (uint8_t)min(number, (unsigned long)MODBUS_PRIORITY_HIGH);
+    }
+    if (count > 10)
+    {
+        parsed.publish = ModbusServerPublish::OnThreshold;
+        if (!modbusParseField(fields[10], parsed.deadband))
+        {
+            return SYSTEM_ERROR_INVALID_ARGUMENT;
+        }
+    }
+    if ((count > 11) && !modbusParseField(fields[11], parsed.deadbandPercent))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    if ((count > 12) && !modbusParseField(fields[12], parsed.rate))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    if (count > 13)
+    {
+        if (!modbusParseField(fields[13], number))
+        {
+            return SYSTEM_ERROR_INVALID_ARGUMENT;
+        }
+        parsed.heartbeatMs = number * 1000;
+    }
+    modbusDerivePoint(parsed);
+    point = parsed;
+
+    return SYSTEM_ERROR_NONE;
+}
+
+/**
+ * @brief Write a point back out in its compact form, leaving off trailing defaults
+ *
+ * @param point Point to describe
+ * @param text Output buffer
+ * @param size Size of the output buffer
+ */
+static void modbusFormatPoint(const ModbusPoint& point, char* text, size_t size)
+{
+    text[0] = '\0';
+    if (!point.enabled)
+    {
+        return;
+    }
+
+    const char* function = "";
+    for (auto& entry: modbusFunctionNames)
+    {
+        if (entry.function == point.function)
+        {
+            function = entry.name;
+        }
+    }
+
+    char type[24] {};
+    for (auto& entry: modbusTypeNames)
+    {
+        if ((entry.type == point.type) && (ModbusValueKind::Number == entry.kind))
+        {
+            snprintf(type, sizeof(type), "%s", entry.name);
+        }
+        else if (entry.type == point.type)
+        {
+            snprintf(type, sizeof(type), "%s*%u", entry.name, point.count);
+        }
+    }
+
+    auto length = (0 == (point.pollMs % 1000)) ?
+        snprintf(text, size, "%u,%s,%u,%s,%lu", point.id, function, point.address, type, (unsigned long)(point.pollMs / 1000)) :
+        snprintf(text, size, "%u,%s,%u,%s,%lums", point.id, function, point.address, type, (unsigned long)point.pollMs);
+
+    auto extras = (0 != point.heartbeatMs) ? 9 : (0.0f != point.rate) ? 8 : (0.0f != point.deadbandPercent) ? 7 :
+        (ModbusServerPublish::OnThreshold == point.publish) ? 6 :
+        (0 != point.priority) ? 5 : (0 != point.shift) ? 4 : (UINT16_MAX != point.mask) ? 3 : (0.0 != point.offset) ? 2 : (1.0 != point.scale) ? 1 : 0;
+    if (extras >= 1)
+    {
+        length += snprintf(text + length, size - min((size_t)length, size), ",%g", point.scale);
+    }
+    if (extras >= 2)
+    {
+        length += snprintf(text + length, size - min((size_t)length, size), ",%g", point.offset);
+    }
+    if (extras >= 3)
+    {
+        length += snprintf(text + length, size - min((size_t)length, size), ",%u", point.mask);
+    }
+    if (extras >= 4)
+    {
+        length += snprintf(text + length, size - min((size_t)length, size), ",%u", point.shift);
+    }
+    if (extras >= 5)
+    {
+        length += snprintf(text + length, size - min((size_t)length, size), ",%u", point.priority);
+    }
+    if (extras >= 6)
+    {
+        length += snprintf(text + length, size - min((size_t)length, size), ",%g", point.deadband);
+    }
+    if (extras >= 7)
+    {
+        length += snprintf(text + length, size - min((size_t)length, size), ",%g", point.deadbandPercent);
+    }
+    if (extras >= 8)
+    {
+        length += snprintf(text + length, size - min((size_t)length, size), ",%g", point.rate);
+    }
+    if (extras >= 9)
+    {
+        snprintf(text + length, size - min((size_t)length, size), ",%lu", (unsigned long)(point.heartbeatMs / 1000));
+    }
+}
+
+/**
+ * @brief Create the configuration node for one point table entry
+ *
+ * @param page Page holding the point
+ * @param n Zero based point number within the page
+ * @return ConfigString Node that reads and writes the compact point definition
+ */
+static ConfigString modbusPointNode(ModbusPointPage& page, size_t n)
+{
+    auto index = page.first + n;
+    auto& key = modbusPointKeys[index - MODBUS_CLIENT_COUNT];
+    snprintf(key.name, sizeof(key.name), "p%u", (unsigned int)(index + 1));
+    key.index = (uint16_t)index;
+
+    return ConfigString(key.name,
+        [](const char * &value, const void *context) {
+            static char text[MODBUS_POINT_TEXT_LENGTH + 1];
+            modbusFormatPoint(modbusPoints.current()[((const ModbusPointKey*)context)->index], text, sizeof(text));
+            value = text;
+            return 0;
+        },
+        [](const char * value, const void *context) {
+            return modbusParsePoint(value, *(ModbusPoint*)context);
+        },
+        &key, &modbusPageShadow[n]);
+}
+
+/**
+ * @brief Create the configuration settings for one page of the point table
+ *
+ * @param n One based page number
+ * @return int Zero (success) always
+ */
+int buildModbusPointPage(int n) {
+    auto& page = modbusPages[n - 1];
+
+    snprintf(page.name, sizeof(page.name), "modbus_pts%d", n);
+    page.first = MODBUS_CLIENT_COUNT + (size_t)(n - 1) * MODBUS_TABLE_PAGE_POINTS;
+
+    static_assert(16 == MODBUS_TABLE_PAGE_POINTS, "Point page configuration expects 16 points per page");
+    page.configObject = new ConfigObject(page.name,
+        {
+            modbusPointNode(page, 0), modbusPointNode(page, 1), modbusPointNode(page, 2), modbusPointNode(page, 3),
+            modbusPointNode(page, 4), modbusPointNode(page, 5), modbusPointNode(page, 6), modbusPointNode(page, 7),
+            modbusPointNode(page, 8), modbusPointNode(page, 9), modbusPointNode(page, 10), modbusPointNode(page, 11),
+            modbusPointNode(page, 12), modbusPointNode(page, 13), modbusPointNode(page, 14), modbusPointNode(page, 15),
+        },
+        [](bool write, const void *context) {
+            auto page = (const ModbusPointPage*)context;
+            if (write)
+            {
+                memcpy(modbusPageShadow, &modbusPoints.current()[page->first], sizeof(modbusPageShadow));
+            }
+            return 0;
+        },
+        [](bool write, int status, const void *context) {
+            auto page = (const ModbusPointPage*)context;
+            if (write && (0 == status))
+            {
+                modbusCommitPoints(page->first, modbusPageShadow, MODBUS_TABLE_PAGE_POINTS);
+            }
+            return status;
+        },
+        &page, &page
+    );
+    ConfigService::instance().registerModule(*page.configObject);
+
+    return 0;
+}
+
+
+/**
+ * @brief Issue one Modbus read transaction
+ *
+ * @param function Read function
+ * @param id Slave ID
+ * @param address First register or bit
+ * @param length Number of registers or bits
+ * @param context Context receiving the response
+ * @return uint8_t Modbus result code
+ */
+static uint8_t modbusRead(ModbusServerFunction function, uint8_t id, uint16_t address, uint16_t length, ModbusClientContext& context)
+{
+    switch (function)
+    {
+        case ModbusServerFunction::Coil:
+            return modbusBus.readCoils(id, address, length, context);
+        case ModbusServerFunction::DiscreteInput:
+            return modbusBus.readDiscreteInputs(id, address, length, context);
+        case ModbusServerFunction::InputRegister:
+            return modbusBus.readInputRegisters(id, address, length, context);
+        case ModbusServerFunction::HoldingRegister:
+            return modbusBus.readHoldingRegisters(id, address, length, context);
+    }
+
+    return ModbusClient::ku8MBIllegalFunction;
+}
+
+/**
+ * @brief Character time and RTU silent interval at the current line settings
+ *
+ * @details The silent interval is 3.5 character times, fixed at 1750 microseconds above
+ *          19200 baud as the RTU specification recommends.
+ *
+ * @param charUs Microseconds to send one character
+ * @param silentUs Microseconds of silence that end a frame
+ * @return true Settings are valid
+ * @return false Baud rate is unknown and both times are zero
+ */
+static bool modbusLineTiming(uint32_t& charUs, uint32_t& silentUs)
+{
+    auto baud = modbusEnumToBaud(modbusRtuSettings.baud);
+    if (0 == baud)
+    {
+        charUs = silentUs = 0;
+        return false;
+    }
+
+    auto charBits = (ModbusParity::None == modbusRtuSettings.parity) ? 10UL : 11UL;
+    charUs = charBits * 1000000UL / baud;
+    silentUs = (baud > 19200) ? 1750UL : (charUs * 7 / 2);
+    return true;
+}
+
+/**
+ * @brief Gap kept between the end of a response and the next request
+ *
+ * @return uint32_t Microseconds, the silent interval or the inter message delay if longer
+ */
+static uint32_t modbusFrameGapUs()
+{
+    uint32_t charUs, silentUs;
+    modbusLineTiming(charUs, silentUs);
+    return max(silentUs, (uint32_t)modbusInterMessageDelay * 1000);
+}
+
+/**
+ * @brief Wait until the gap since the end of the last transaction has gone by
+ *
+ * @details Time the thread spent elsewhere since the last response counts towards the gap,
+ *          whole milliseconds are slept and the remainder is timed to the microsecond.
+ */
+static void modbusWaitForGap()
+{
+    auto gapUs = modbusFrameGapUs();
+    auto elapsedUs = micros() - modbusFrameEndUs;
+    if (elapsedUs >= gapUs)
+    {
+        return;
+    }
+
+    auto remainingUs = gapUs - elapsedUs;
+    if (remainingUs >= 1000)
+    {
+        delay(remainingUs / 1000);
+        elapsedUs = micros() - modbusFrameEndUs;
+        remainingUs = (elapsedUs < gapUs) ? (gapUs - elapsedUs) : 0;
+    }
+    if (remainingUs)
+    {
+        delayMicroseconds(remainingUs);
+    }
+}
+
+/**
+ * @brief Estimate the bus time of one read transaction
+ *
+ * @details Counts the request and response frames, the silent interval after the request
+ *          and the gap after the response.  Slave turnaround time is not included.
+ *
+ * @param bits Coil or discrete input function
+ * @param length Number of registers or bits read
+ * @return uint32_t Microseconds
+ */
+static uint32_t modbusEstimateReadUs(bool bits, uint16_t length)
+{
+    uint32_t charUs, silentUs;
+    if (!modbusLineTiming(charUs, silentUs))
+    {
+        return 0;
+    }
+
+    return modbusReadFrameChars(bits, length) * charUs + silentUs + modbusFrameGapUs();
+}
+
+/**
+ * @brief Decide whether a poll of a report by exception point is worth publishing
+ *
+ * @details A poll is reported when the result code changes, when the value moves outside
+ *          either deadband around the last reported value (any change if neither is set),
+ *          when it changes faster than the rate limit since the previous poll, or when the
+ *          heartbeat has gone by without a report.
+ *
+ * @param index Pool index of the point that was polled
+ * @param config Snapshot of the point configuration used for the poll
+ * @param result Modbus result code
+ * @param value Scaled value
+ * @return true Report the poll
+ * @return false Suppress the poll
+ */
+static bool modbusShouldReport(uint16_t index, const ModbusPoint& config, uint8_t result, double value)
+{
+    auto& state = modbusReports[index];
+    auto now = millis();
+    auto success = (ModbusClient::ku8MBSuccess == result);
+
+    bool report = !state.reported || (result != state.result);
+    if (!report && (0 != config.heartbeatMs) && ((now - state.reportMs) >= config.heartbeatMs))
+    {
+        report = true;
+    }
+    if (!report && success)
+    {
+        auto change = fabs(value - state.value);
+        if ((0.0f == config.deadband) && (0.0f == config.deadbandPercent))
+        {
+            report = (0.0 != change);
+        }
+        else
+        {
+            report = ((0.0f != config.deadband) && (change > config.deadband)) ||
+                ((0.0f != config.deadbandPercent) && (change * 100.0 > fabs(state.value) * config.deadbandPercent));
+        }
+    }
+    if (!report && success && (0.0f != config.rate) && (now != state.sampleMs))
+    {
+        auto perSecond = fabs(value - state.sample) * 1000.0 / (double)(now - state.sampleMs);
+        report = (perSecond >= config.rate);
+    }
+
+    if (success)
+    {
+        state.sample = value;
+        state.sampleMs = now;
+    }
+    if (report)
+    {
+        state.reported = true;
+        state.result = result;
+        state.value = success ? value : state.value;
+        state.reportMs = now;
+    }
+    return report;
+}
+
+/**
+ * @brief Queue a polled string or register array
+ *
+ * @details Report by exception publishes these when the result code or the registers change,
+ *          or when the heartbeat has gone by.  Deadbands and the rate limit do not apply.
+ *
+ * @param index Pool index of the point that was polled
+ * @param config Snapshot of the point configuration used for the poll
+ * @param result Modbus result code
+ * @param words Registers read for this point
+ */
+static void modbusHandleWideResult(uint16_t index, const ModbusPoint& config, uint8_t result, const uint16_t* words)
+{
+    auto success = (ModbusClient::ku8MBSuccess == result);
+
+    if (ModbusServerPublish::OnThreshold == config.publish)
+    {
+        // FNV-1a over the registers
+        uint32_t digest = 2166136261UL;
+        for (size_t i = 0; success && (i < config.count); i++)
+        {
+            digest = (digest ^ words[i]) * 16777619UL;
+        }
+
+        auto& state = modbusReports[index];
+        auto now = millis();
+        if (state.reported && (result == state.result) && (digest == state.digest) &&
+            ((0 == config.heartbeatMs) || ((now - state.reportMs) < config.heartbeatMs)))
+        {
+            busStats.suppressed++;
+            return;
+        }
+        state.reported = true;
+        state.result = result;
+        state.digest = digest;
+        state.reportMs = now;
+    }
+
+    ModbusWidePublish publishMe {};
+    publishMe.point = index;
+    publishMe.result = result;
+    if (success && (ModbusValueKind::Text == config.kind))
+    {
+        modbusDecodeText(words, config.count, config.decoding.order, publishMe.text, sizeof(publishMe.text));
+    }
+    else if (success)
+    {
+        publishMe.count = config.count;
+        for (size_t i = 0; i < config.count; i++)
+        {
+            double value {};
+            config.decode(&words[i], config.decoding, value);
+            publishMe.values[i] = (float)(value * config.scale + config.offset);
+        }
+    }
+    wideResultsToPublish.push(publishMe);
+}
+
+/**
+ * @brief Decode, scale and queue one polled value
+ *
+ * @param index Pool index of the point that was polled
+ * @param config Snapshot of the point configuration used for the poll
+ * @param result Modbus result code
+ * @param words Registers read for this point, or bits packed from bit zero for coil and discrete reads
+ */
+static void modbusHandleResult(uint16_t index, const ModbusPoint& config, uint8_t result, const uint16_t* words)
+{
+    double sensorValue {};
+    if ((ModbusClient::ku8MBSuccess == result) && (ModbusValueKind::Number == config.kind) &&
+        !config.decode(words, config.decoding, sensorValue))
+    {
+        result = MODBUS_RESULT_UNDECODABLE;
+    }
+
+    sensorValue = sensorValue * config.scale + config.offset;
+    auto numeric = (ModbusClient::ku8MBSuccess == result) && (ModbusValueKind::Number == config.kind);
+    ioUpdateModbusChannel(index, (numeric) ? sensorValue : NAN);
+
+    auto& counters = modbusPointCounters[index];
+    counters.polls++;
+    counters.failures += (ModbusClient::ku8MBSuccess == result) ? 0 : 1;
+    counters.result = result;
+
+    if (ModbusValueKind::Number != config.kind)
+    {
+        modbusHandleWideResult(index, config, result, words);
+        return;
+    }
+
+    if ((ModbusServerPublish::OnThreshold == config.publish) && !modbusShouldReport(index, config, result, sensorValue))
+    {
+        busStats.suppressed++;
+        return;
+    }
+
+    ModbusPublish publishMe {};
+    publishMe.point = index;
+    publishMe.value = sensorValue;
+    publishMe.result = result;
+    resultsToPublish.push(publishMe);
+}
+
+/**
+ * @brief Hand the part of a block read belonging to one request to its server
+ *
+ * @param request Request covered by the read
+ * @param blockAddress First register or bit of the read
+ * @param result Modbus result code of the read
+ */
+static void modbusFanOut(const ModbusPollRequest& request, uint16_t blockAddress, uint8_t result)
+{
+    auto offset = (size_t)(request.address - blockAddress);
+    uint16_t bitWords[MODBUS_WIDE_REGISTERS] {};
+    const uint16_t* words = &pollContext.readBuffer[offset];
+
+    if (request.bits)
+    {
+        // Bit reads are packed 16 to a word starting at the least significant bit of the first word
+        for (size_t bit = 0; bit < min((size_t)request.length, MODBUS_WIDE_REGISTERS * 16); bit++)
+        {
+            auto source = offset + bit;
+            if (pollContext.readBuffer[source / 16] & (1U << (source % 16)))
+            {
+                bitWords[bit / 16] |= (uint16_t)(1U << (bit % 16));
+            }
+        }
+        words = bitWords;
+    }
+
+    modbusHandleResult(pollPoints[request.tag], pollConfigs[request.tag], result, words);
+}
+
+/**
+ * @brief Find the health record of a slave
+ *
+ * @param id Slave ID
+ * @return ModbusSlave* Health record, nullptr if the slave is not tracked
+ */
+static ModbusSlave* modbusFindSlave(uint8_t id)
+{
+    for (size_t i = 0; i < modbusSlaveCount; i++)
+    {
+        if (modbusSlaves[i].health.getId() == id)
+        {
+            return &modbusSlaves[i];
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Count the outcome of one transaction
+ *
+ * @param counters Counters to update
+ * @param result Modbus result code
+ * @param elapsedMs Transaction time
+ */
+static void modbusCount(ModbusCounters& counters, uint8_t result, uint32_t elapsedMs)
+{
+    counters.requests++;
+    switch (result)
+    {
+        case ModbusClient::ku8MBSuccess:
+            counters.successes++;
+            break;
+
+        case ModbusClient::ku8MBResponseTimedOut:
+            counters.timeouts++;
+            return;
+
+        case ModbusClient::ku8MBInvalidCRC:
+            counters.crcErrors++;
+            return;
+
+        case ModbusClient::ku8MBInvalidSlaveID:
+            // Fall through
+        case ModbusClient::ku8MBInvalidFunction:
+            counters.garbled++;
+            return;
+
+        default:
+            counters.exceptions++;
+            break;
+    }
+
+    size_t bucket = 0;
+    while ((bucket < (MODBUS_RESPONSE_BUCKETS - 1)) && (elapsedMs >= MODBUS_RESPONSE_LIMITS_MS[bucket]))
+    {
+        bucket++;
+    }
+    counters.response[bucket]++;
+}
+
+/**
+ * @brief Issue one transaction with health tracking and bounded retries
+ *
+ * @details CRC errors and garbled responses are retried, as is a timeout from a slave that
+ *          has been answering.  Exception responses show the slave is alive and are not
+ *          retried.  Transactions with a slave quarantined earlier in the pass are not sent.
+ *
+ * @param id Slave ID
+ * @param estimateUs Estimated bus time of one attempt
+ * @param issue Sends the request and waits for the response, returning the Modbus result code
+ * @return uint8_t Modbus result code
+ */
+template <typename Issue>
+static uint8_t modbusTransactWith(uint8_t id, uint32_t estimateUs, Issue issue)
+{
+    auto slave = modbusFindSlave(id);
+    if (slave && !slave->health.isReady(millis()))
+    {
+        return ModbusClient::ku8MBResponseTimedOut;
+    }
+
+    uint8_t result {};
+    for (size_t attempt = 0; attempt <= MODBUS_RETRY_LIMIT; attempt++)
+    {
+        modbusWaitForGap();
+        modbusBus.setResponseTimeout((slave) ? slave->health.getTimeout() : MODBUS_TIMEOUT_DEFAULT_MS);
+
+        auto start = micros();
+        result = issue();
+        modbusFrameEndUs = micros();
+        auto elapsed = modbusFrameEndUs - start;
+        busStats.measuredUs += elapsed;
+        threadStats.busUs += elapsed;
+        busStats.estimateUs += estimateUs;
+        busStats.transactions++;
+        modbusCount(busCounters, result, elapsed / 1000);
+        if (slave)
+        {
+            modbusCount(slave->counters, result, elapsed / 1000);
+        }
+
+        auto responded = (result < ModbusClient::ku8MBInvalidSlaveID);
+        auto transient = (ModbusClient::ku8MBInvalidCRC == result) || (ModbusClient::ku8MBInvalidSlaveID == result) ||
+            (ModbusClient::ku8MBInvalidFunction == result) ||
+            ((ModbusClient::ku8MBResponseTimedOut == result) && slave && (SlaveHealth::State::Healthy == slave->health.getState()));
+        if (responded || !transient || (attempt == MODBUS_RETRY_LIMIT))
+        {
+            if (!slave)
+            {
+                break;
+            }
+            auto now = millis();
+            auto& health = slave->health;
+            if (responded && health.success(now, elapsed / 1000))
+            {
+                modbusFaults.push({id, result, false, 0, 0});
+                monitorOneLog.info("Modbus slave %u responding again", id);
+            }
+            else if (!responded && health.failure(now))
+            {
+                modbusFaults.push({id, result, true, health.getFailures(), health.getBackoff()});
+                monitorOneLog.warn("Modbus slave %u quarantined after %lu failures", id, health.getFailures());
+            }
+            break;
+        }
+        busStats.retries++;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Issue one read transaction with health tracking and bounded retries
+ *
+ * @param function Read function
+ * @param id Slave ID
+ * @param address First register or bit
+ * @param length Number of registers or bits
+ * @param bits Coil or discrete input function
+ * @return uint8_t Modbus result code
+ */
+static uint8_t modbusTransact(ModbusServerFunction function, uint8_t id, uint16_t address, uint16_t length, bool bits)
+{
+    return modbusTransactWith(id, modbusEstimateReadUs(bits, length), [&]() {
+        return modbusRead(function, id, address, length, pollContext);
+    });
+}
+
+/**
+ * @brief Send one write request
+ *
+ * @param write Write to send
+ * @param context Context holding the request
+ * @return uint8_t Modbus result code
+ */
+static uint8_t modbusSendWrite(const ModbusWrite& write, ModbusClientContext& context)
+{
+    if (write.coil && (1 == write.count))
+    {
+        return modbusBus.writeSingleCoil(write.id, write.address, (uint8_t)write.values[0], context);
+    }
+    if (1 == write.count)
+    {
+        return modbusBus.writeSingleRegister(write.id, write.address, write.values[0], context);
+    }
+
+    memset(context.writeBuffer, 0, sizeof(context.writeBuffer));
+    if (write.coil)
+    {
+        // Coils are packed 16 to a word starting at the least significant bit of the first word
+        for (size_t i = 0; i < write.count; i++)
+        {
+            context.writeBuffer[i / 16] |= (write.values[i]) ? (uint16_t)(1U << (i % 16)) : 0;
+        }
+        return modbusBus.writeMultipleCoils(write.id, write.address, write.count, context);
+    }
+    memcpy(context.writeBuffer, write.values, write.count * sizeof(write.values[0]));
+    return modbusBus.writeMultipleRegisters(write.id, write.address, write.count, context);
+}
+
+/**
+ * @brief Run every queued write, reading the values back where asked
+ *
+ * @details Called before each block read so that a write waits for at most one read
+ *          transaction.  Write requests carry the same values on every attempt so they are
+ *          retried like reads.
+ */
+static void modbusRunWrites()
+{
+    while (true)
+    {
+        ModbusWrite write;
+        {
+            const std::lock_guard<RecursiveMutex> lock(modbusWritesMutex);
+            if (modbusWrites.empty())
+            {
+                return;
+            }
+            write = modbusWrites.front();
+            modbusWrites.pop();
+        }
+
+        // A write request is about as long as a read response of the same size
+        ModbusWriteOutcome outcome {write.id, write.coil, write.count, 0, write.address, ModbusVerifyState::None};
+        outcome.result = modbusTransactWith(write.id, modbusEstimateReadUs(write.coil, write.count), [&]() {
+            return modbusSendWrite(write, pollContext);
+        });
+
+        if ((ModbusClient::ku8MBSuccess == outcome.result) && write.verify)
+        {
+            auto function = (write.coil) ? ModbusServerFunction::Coil : ModbusServerFunction::HoldingRegister;
+            auto passed = (ModbusClient::ku8MBSuccess == modbusTransact(function, write.id, write.address, write.count, write.coil));
+            for (size_t i = 0; passed && (i < write.count); i++)
+            {
+                auto value = (write.coil) ? (uint16_t)((pollContext.readBuffer[i / 16] >> (i % 16)) & 1) : pollContext.readBuffer[i];
+                passed = (value == write.values[i]);
+            }
+            outcome.verify = (passed) ? ModbusVerifyState::Passed : ModbusVerifyState::Failed;
+        }
+        writeOutcomes.push(outcome);
+    }
+}
+
+/**
+ * @brief Count how late a poll started against its deadline
+ *
+ * @param late Milliseconds after the deadline
+ */
+static void modbusRecordLateness(int32_t late)
+{
+    size_t bucket = 0;
+    while ((bucket < (MODBUS_JITTER_BUCKETS - 1)) && (late >= (int32_t)MODBUS_JITTER_LIMITS_MS[bucket]))
+    {
+        bucket++;
+    }
+    busStats.jitter[bucket]++;
+}
+
+/**
+ * @brief Read a planned block and fan the values out to each server it covers
+ *
+ * @param block Block to read
+ */
+static void modbusReadBlock(const ModbusPollBlock& block)
+{
+    auto started = millis();
+    for (size_t i = block.first; i < (block.first + block.count); i++)
+    {
+        auto tag = pollRequests[i].tag;
+        auto late = (int32_t)(started - pollDue[tag]);
+        modbusRecordLateness(late);
+
+        auto lag = (uint32_t)max(late, 0L);
+        auto& counters = modbusPointCounters[pollPoints[tag]];
+        counters.lagMaxMs = max(counters.lagMaxMs, lag);
+        threadStats.lagMaxMs = max(threadStats.lagMaxMs, lag);
+    }
+
+    auto function = (ModbusServerFunction)block.function;
+    auto result = modbusTransact(function, block.id, block.address, block.length, block.bits);
+
+    if ((ModbusClient::ku8MBIllegalDataAddress == result) && (block.count > 1))
+    {
+        // Something inside a merged range doesn't exist on the slave so fall back to reading each request on its own
+        for (size_t i = block.first; i < (block.first + block.count); i++)
+        {
+            auto& request = pollRequests[i];
+            result = modbusTransact(function, request.id, request.address, request.length, request.bits);
+            modbusFanOut(request, request.address, result);
+        }
+        return;
+    }
+
+    for (size_t i = block.first; i < (block.first + block.count); i++)
+    {
+        modbusFanOut(pollRequests[i], block.address, result);
+    }
+}
+
+/**
+ * @brief Write transaction counters into a diagnostics object
+ *
+ * @param writer JSON writer positioned inside an object
+ * @param counters Counters to write
+ */
+static void modbusWriteCounters(JSONWriter& writer, const ModbusCounters& counters)
+{
+    writer.name("req").value((unsigned long)counters.requests);
+    writer.name("ok").value((unsigned long)counters.successes);
+    writer.name("tmo").value((unsigned long)counters.timeouts);
+    writer.name("crc").value((unsigned long)counters.crcErrors);
+    writer.name("exc").value((unsigned long)counters.exceptions);
+    writer.name("bad").value((unsigned long)counters.garbled);
+    writer.name("rsp").beginArray();
+    for (auto count: counters.response)
+    {
+        writer.value((unsigned long)count);
+    }
+    writer.endArray();
+}
+
+/**
+ * @brief Publish the next part of a diagnostics report
+ *
+ * @details The first event carries the bus totals.  Slaves and then every point polled under
+ *          the current configuration follow, split over as many events as needed.  Points are
+ *          reported as [point, polls, failures, max lag ms, last result].
+ *
+ * @return true The event was queued
+ * @return false The publish queue refused the event
+ */
+static bool modbusPublishDiag()
+{
+    static char diagPublish[MODBUS_PUBLISH_SIZE + 1] = {};
+    memset(diagPublish, 0, sizeof(diagPublish));
+    JSONBufferWriter toPublish(diagPublish, MODBUS_PUBLISH_SIZE);
+    toPublish.beginObject();
+
+    if (0 == modbusDiagCursor)
+    {
+        toPublish.name("bus").beginObject();
+        modbusWriteCounters(toPublish, busCounters);
+        toPublish.name("util").value(modbusBusUtil, 1);
+        toPublish.name("lag").value(modbusLagMs);
+        toPublish.name("load").value(modbusThreadLoad, 2);
+        toPublish.name("stack").value((unsigned int)modbusStackFree);
+        toPublish.endObject();
+    }
+
+    auto fits = [&](size_t entry) {
+        return (toPublish.dataSize() + entry + MODBUS_DIAG_POINT_MAX) <= MODBUS_PUBLISH_SIZE;
+    };
+
+    if ((modbusDiagCursor < modbusSlaveCount) && fits(MODBUS_DIAG_SLAVE_MAX))
+    {
+        toPublish.name("slaves").beginArray();
+        while ((modbusDiagCursor < modbusSlaveCount) && fits(MODBUS_DIAG_SLAVE_MAX))
+        {
+            auto& slave = modbusSlaves[modbusDiagCursor++];
+            toPublish.beginObject();
+            toPublish.name("id").value((unsigned int)slave.health.getId());
+            toPublish.name("st").value((int)slave.health.getState());
+            toPublish.name("to").value((unsigned long)slave.health.getTimeout());
+            modbusWriteCounters(toPublish, slave.counters);
+            toPublish.endObject();
+        }
+        toPublish.endArray();
+    }
+
+    auto end = modbusSlaveCount + MODBUS_POINT_COUNT;
+    if ((modbusDiagCursor >= modbusSlaveCount) && (modbusDiagCursor < end) && fits(MODBUS_DIAG_POINT_MAX))
+    {
+        toPublish.name("pts").beginArray();
+        while ((modbusDiagCursor < end) && fits(MODBUS_DIAG_POINT_MAX))
+        {
+            auto point = modbusDiagCursor++ - modbusSlaveCount;
+            auto& counters = modbusPointCounters[point];
+            if (0 == counters.polls)
+            {
+                continue;
+            }
+            toPublish.beginArray();
+            toPublish.value((unsigned int)(point + 1));
+            toPublish.value((unsigned long)counters.polls);
+            toPublish.value((unsigned long)counters.failures);
+            toPublish.value((unsigned long)counters.lagMaxMs);
+            toPublish.value((unsigned int)counters.result);
+            toPublish.endArray();
+        }
+        toPublish.endArray();
+    }
+
+    modbusDiagActive = (modbusDiagCursor < end);
+    toPublish.name("more").value(modbusDiagActive);
+    toPublish.endObject();
+    if (!publishSubmit(PublishArbiter::Priority::Bulk, "modbus_diag", diagPublish))
+    {
+        busStats.dropped++;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Read the stack high water mark of the poll thread, must be called on that thread
+ *
+ * @details Logging, event formatting and discovery all run on the poll thread, so its stack
+ *          use is watched and a warning logged the first time headroom runs low.
+ */
+static void modbusCheckStack()
+{
+    static bool warned {false};
+    size_t words = 0;
+    os_thread_dump(os_thread_current(nullptr), [](os_thread_dump_info_t* info, void* data) {
+        *(size_t*)data = info->stack_high_watermark;
+        return (os_result_t)0;
+    }, &words);
+
+    modbusStackFree = words;
+    if (!warned && (words < MODBUS_STACK_LOW_WORDS))
+    {
+        warned = true;
+        monitorOneLog.warn("Modbus thread stack headroom down to %u words", (unsigned int)words);
+    }
+}
+
+/**
+ * @brief Update the bus metrics at the end of a measurement window
+ *
+ * @param elapsed Length of the window in milliseconds
+ */
+static void modbusUpdateMetrics(uint32_t elapsed)
+{
+    modbusBusUtil = (double)threadStats.busUs / ((double)elapsed * 10.0);
+    modbusLagMs = (int)threadStats.lagMaxMs;
+    modbusCheckStack();
+
+#if defined(MODBUS_MEMFAULT_METRICS) && MODBUS_MEMFAULT_METRICS
+    // Counters are added as deltas so that each heartbeat carries the totals for its interval
+    static ModbusCounters reported {};
+    memfault_metrics_heartbeat_add(MEMFAULT_METRICS_KEY(Modbus_Requests), (int32_t)(busCounters.requests - reported.requests));
+    memfault_metrics_heartbeat_add(MEMFAULT_METRICS_KEY(Modbus_Successes), (int32_t)(busCounters.successes - reported.successes));
+    memfault_metrics_heartbeat_add(MEMFAULT_METRICS_KEY(Modbus_Timeouts), (int32_t)(busCounters.timeouts - reported.timeouts));
+    memfault_metrics_heartbeat_add(MEMFAULT_METRICS_KEY(Modbus_CrcErrors), (int32_t)(busCounters.crcErrors - reported.crcErrors));
+    memfault_metrics_heartbeat_add(MEMFAULT_METRICS_KEY(Modbus_Exceptions), (int32_t)(busCounters.exceptions - reported.exceptions));
+    reported = busCounters;
+
+    size_t quarantined = 0;
+    for (size_t i = 0; i < modbusSlaveCount; i++)
+    {
+        quarantined += (SlaveHealth::State::Quarantined == modbusSlaves[i].health.getState()) ? 1 : 0;
+    }
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(Modbus_BusUtil), (uint32_t)(modbusBusUtil * 10.0));
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(Modbus_LagMax), threadStats.lagMaxMs);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(Modbus_Quarantined), quarantined);
+    memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(Modbus_StackFree), (uint32_t)modbusStackFree);
+#endif // MODBUS_MEMFAULT_METRICS
+}
+
+/**
+ * @brief Sweep baud rate and parity combinations until the probe slave answers
+ *
+ * @details The current settings are probed first, then the common baud rates from the most
+ *          used down, each with the current parity before the other.  Any response with a
+ *          valid frame counts, an exception response included, and the sweep stops at the
+ *          first one.  The settings found are applied and slave health is reset so that
+ *          slaves quarantined under the wrong settings are polled again straight away.  If
+ *          nothing answers the previous settings are restored.  New settings from the config
+ *          service end the sweep early and are left to replace the ones it was trying.
+ */
+static void modbusDiscover()
+{
+    static constexpr ModbusBaudRates bauds[] {
+        ModbusBaudRates::Baud9600, ModbusBaudRates::Baud19200, ModbusBaudRates::Baud38400,
+        ModbusBaudRates::Baud115200, ModbusBaudRates::Baud57600, ModbusBaudRates::Baud4800,
+        ModbusBaudRates::Baud2400, ModbusBaudRates::Baud1200, ModbusBaudRates::Baud76800,
+        ModbusBaudRates::Baud28800,
+    };
+
+    auto start = millis();
+    auto previous = modbusRtuSettings;
+    auto otherParity = (ModbusParity::None == previous.parity) ? ModbusParity::Even : ModbusParity::None;
+    auto id = (uint8_t)modbusDiscoverConfig.id;
+    auto address = (uint16_t)modbusDiscoverConfig.address;
+    modbusDiscoverAt = start;
+    modbusDiscovered = true;
+
+    uint32_t probes = 0;
+    auto found = false;
+    for (size_t i = 0; !found && !modbusSettingsRequested && (i <= 2 * (sizeof(bauds) / sizeof(bauds[0]))); i++)
+    {
+        // Probe zero is the current settings, which the sweep then skips
+        ModbusSettings candidate = previous;
+        if (i > 0)
+        {
+            candidate.baud = bauds[(i - 1) / 2];
+            candidate.parity = ((i - 1) & 1) ? otherParity : previous.parity;
+            if ((candidate.baud == previous.baud) && (candidate.parity == previous.parity))
+            {
+                continue;
+            }
+        }
+
+        modbusApplySettings(candidate);
+        delay(MODBUS_DISCOVER_SETTLE_MS);
+        modbusBus.setResponseTimeout(MODBUS_DISCOVER_TIMEOUT_MS + modbusEstimateReadUs(false, 1) / 1000);
+
+        modbusWaitForGap();
+        auto result = modbusRead(modbusDiscoverConfig.function, id, address, 1, pollContext);
+        modbusFrameEndUs = micros();
+        probes++;
+        found = (result < ModbusClient::ku8MBInvalidSlaveID);
+    }
+
+    if (found)
+    {
+        monitorOneLog.info("Modbus discovery found %lu baud, %s parity after %lu probes",
+            modbusEnumToBaud(modbusRtuSettings.baud), (ModbusParity::None == modbusRtuSettings.parity) ? "no" : "even", probes);
+        for (size_t i = 0; i < modbusSlaveCount; i++)
+        {
+            auto& health = modbusSlaves[i].health;
+            health.reset(health.getId(), health.getMaxTimeout());
+        }
+    }
+    else if (modbusSettingsRequested)
+    {
+        monitorOneLog.info("Modbus discovery stopped by new settings after %lu probes", probes);
+    }
+    else
+    {
+        monitorOneLog.warn("Modbus discovery found no response from slave %u after %lu probes", id, probes);
+        modbusApplySettings(previous);
+    }
+
+    modbusDiscoverNotice = {true, found, modbusRtuSettings, probes, millis() - start};
+}
+
+/**
+ * @brief Start discovery when the share of failed transactions over a window is too high
+ *
+ * @details Timeouts, CRC errors and garbled responses count as failures.  Windows with too
+ *          few transactions are ignored, as are windows soon after the last discovery.
+ */
+static void modbusCheckErrorRate()
+{
+    static ModbusCounters windowStart {};
+    auto requests = busCounters.requests - windowStart.requests;
+    auto failures = (busCounters.timeouts - windowStart.timeouts) + (busCounters.crcErrors - windowStart.crcErrors) +
+        (busCounters.garbled - windowStart.garbled);
+    windowStart = busCounters;
+
+    if (!modbusDiscoverConfig.enabled || (0 == modbusDiscoverConfig.errorRate) || (requests < MODBUS_DISCOVER_MIN_REQUESTS))
+    {
+        return;
+    }
+    if (modbusDiscovered && ((millis() - modbusDiscoverAt) < MODBUS_DISCOVER_HOLDOFF_MS))
+    {
+        return;
+    }
+    if ((uint64_t)failures * 100 >= (uint64_t)requests * (uint32_t)modbusDiscoverConfig.errorRate)
+    {
+        monitorOneLog.warn("Modbus errors on %lu of %lu transactions, starting discovery", failures, requests);
+        modbusDiscoverRequested = true;
+    }
+}
+
+/**
+ * @brief Rebuild the poll schedule from the point pool
+ *
+ * @details Points are grouped by slave and function.  Each group gets its own phase within
+ *          the poll interval so that polls are spread out instead of bursting together, while
+ *          points in the same group stay aligned and can still be merged into block reads.
+ *
+ * @param points Point pool snapshot
+ * @param now Current millisecond timestamp
+ */
+static void modbusRebuildSchedule(const ModbusPoint* points, uint32_t now)
+{
+    static uint16_t groupKeys[MODBUS_POINT_COUNT];  // Off the thread stack
+    size_t groupCount = 0;
+    for (size_t i = 0; i < MODBUS_POINT_COUNT; i++) {
+        auto& point = points[i];
+        if (!point.enabled) {
+            continue;
+        }
+        auto key = (uint16_t)((point.id << 8) | (uint8_t)point.function);
+        size_t group = 0;
+        while ((group < groupCount) && (groupKeys[group] != key)) {
+            group++;
+        }
+        if (group == groupCount) {
+            groupKeys[groupCount++] = key;
+        }
+        pollGroups[i] = (uint16_t)group;
+    }
+
+    // Report and count every point afresh under its new settings
+    memset(modbusReports, 0, sizeof(modbusReports));
+    memset(modbusPointCounters, 0, sizeof(modbusPointCounters));
+
+    // Track every slave in use, keeping the history of slaves that were already tracked
+    static uint8_t slaveIds[MODBUS_SLAVE_COUNT];
+    static uint32_t slaveTimeouts[MODBUS_SLAVE_COUNT];
+    size_t slaveCount = 0;
+    for (size_t i = 0; i < MODBUS_POINT_COUNT; i++) {
+        auto& point = points[i];
+        if (!point.enabled) {
+            continue;
+        }
+        size_t slave = 0;
+        while ((slave < slaveCount) && (slaveIds[slave] != point.id)) {
+            slave++;
+        }
+        if (slave == slaveCount) {
+            if (slaveCount >= MODBUS_SLAVE_COUNT) {
+                continue;
+            }
+            slaveIds[slaveCount] = point.id;
+            slaveTimeouts[slaveCount++] = point.timeoutMs;
+        }
+        slaveTimeouts[slave] = max(slaveTimeouts[slave], (uint32_t)point.timeoutMs);
+    }
+
+    static ModbusSlave slaves[MODBUS_SLAVE_COUNT];  // Off the thread stack
+    for (size_t i = 0; i < slaveCount; i++) {
+        auto existing = modbusFindSlave(slaveIds[i]);
+        if (existing) {
+            slaves[i] = *existing;
+            slaves[i].health.setMaxTimeout(slaveTimeouts[i]);
+        }
+        else {
+            slaves[i].health.reset(slaveIds[i], slaveTimeouts[i]);
+            slaves[i].counters = {};
+        }
+    }
+    for (size_t i = 0; i < slaveCount; i++) {
+        modbusSlaves[i] = slaves[i];
+    }
+    modbusSlaveCount = slaveCount;
+
+    pollSchedule.clear();
+    for (size_t i = 0; i < MODBUS_POINT_COUNT; i++) {
+        auto& point = points[i];
+        if (!point.enabled) {
+            continue;
+        }
+        pollIntervals[i] = point.pollMs;
+        auto phase = (uint32_t)((uint64_t)pollIntervals[i] * pollGroups[i] / groupCount);
+        pollSchedule.push((uint16_t)i, now + phase);
+    }
+}
+
+/**
+ * @brief The thread that service all poll requests
+ *
+ * @details The thread sleeps until the earliest poll deadline or a configuration change.
+ *          Points that are due are grouped by slave and function and nearby ranges are
+ *          merged so that each group costs a single transaction on the bus.
+ *
+ * @param param Unused
+ */
+void modbusThreadLoop(void* param)
+{
+    threadStats.windowStart = millis();
+    auto scheduleEpoch = modbusPoints.getEpoch() - 1;
+
+    while (true)
+    {
+        // A bus has a single master, polls wait while a local master reads the slave instead
+        if (modbusSlaveOwnsRs485())
+        {
+            uint32_t charUs, silentUs;
+            modbusLineTiming(charUs, silentUs);
+            modbusSlaveServeRs485(silentUs, MODBUS_SLAVE_SERVE_MS);
+            continue;
+        }
+
+        auto wakeUs = micros();
+        threadStats.wakeups++;
+
+        // New settings go in before a discovery, which then starts from them
+        modbusApplyRequestedSettings();
+
+        // Discovery owns the bus until it finishes, polls that fall due meanwhile catch up afterwards
+        if (modbusDiscoverRequested.exchange(false))
+        {
+            modbusDiscover();
+        }
+
+        auto now = millis();
+
+        // Take a batch of due points from the schedule, holding the snapshot only while copying
+        size_t due = 0;
+        {
+            auto points = modbusPoints.acquire();
+            auto epoch = modbusPoints.getEpoch();
+            if (epoch != scheduleEpoch) {
+                scheduleEpoch = epoch;
+                modbusRebuildSchedule(points, now);
+            }
+
+            size_t ready = 0;
+            while (!pollSchedule.empty() && !PollScheduler::before(now + MODBUS_SCHEDULE_SLACK_MS, pollSchedule.top().due)) {
+                auto entry = pollSchedule.pop();
+
+                // Highest priority first, then earliest deadline, so that low priority points absorb any overload
+                auto i = ready++;
+                while ((i > 0) && ((points[pollReady[i - 1].index].priority < points[entry.index].priority) ||
+                    ((points[pollReady[i - 1].index].priority == points[entry.index].priority) &&
+                    PollScheduler::before(entry.due, pollReady[i - 1].due)))) {
+                    pollReady[i] = pollReady[i - 1];
+                    i--;
+                }
+                pollReady[i] = entry;
+            }
+
+            for (size_t r = 0; r < ready; r++) {
+                auto entry = pollReady[r];
+                if (due >= MODBUS_POLL_BATCH) {
+                    // Still due, picked up on the next pass
+                    pollSchedule.push(entry.index, entry.due);
+                    continue;
+                }
+
+                // Keep a fixed cadence unless the poll fell a whole period behind
+                auto period = pollIntervals[entry.index];
+                auto next = entry.due + period;
+                if (PollScheduler::before(next, now)) {
+                    auto skipped = (now - entry.due) / period;
+                    busStats.missed += skipped;
+                    threadStats.missed += skipped;
+                    next = now + period;
+                }
+                pollSchedule.push(entry.index, next);
+
+                auto& point = points[entry.index];
+                if (!point.enabled) {
+                    continue;
+                }
+
+                // Quarantined slaves are left alone until their backoff expires
+                auto slave = modbusFindSlave(point.id);
+                if (slave && !slave->health.isReady(now)) {
+                    busStats.skipped++;
+                    continue;
+                }
+
+                auto bits = (ModbusServerFunction::Coil == point.function) || (ModbusServerFunction::DiscreteInput == point.function);
+                pollConfigs[due] = point;
+                pollPoints[due] = entry.index;
+                pollDue[due] = entry.due;
+                pollRequests[due] = {point.id, (uint8_t)point.function, bits, point.address, point.readLength, (uint16_t)due};
+                due++;
+            }
+            modbusPoints.release();
+        }
+        for (size_t i = 0; i < due; i++) {
+            busStats.estimateSingleUs += modbusEstimateReadUs(pollRequests[i].bits, pollRequests[i].length);
+        }
+
+        auto blockCount = modbusPlanPoll(pollRequests, due, modbusBlockGap,
+            MODBUS_BLOCK_REGISTERS, MODBUS_BLOCK_BITS, pollBlocks, MODBUS_POLL_BATCH);
+        for (size_t i = 0; i < blockCount; i++) {
+            modbusRunWrites();
+            modbusReadBlock(pollBlocks[i]);
+        }
+        modbusRunWrites();
+
+        // Events are queued as soon as they are ready, the publish arbiter paces and packs them.
+        // Slave faults go ahead of results.
+        if (!modbusFaults.empty())
+        {
+            static char faultPublish[MODBUS_FAULT_CAPACITY * 64 + 32] = {};
+            memset(faultPublish, 0, sizeof(faultPublish));
+            JSONBufferWriter toPublish(faultPublish, sizeof(faultPublish) - 1);
+            toPublish.beginObject();
+            toPublish.name("faults").beginArray();
+            while (!modbusFaults.empty())
+            {
+                auto& fault = modbusFaults.front();
+                toPublish.beginObject();
+                toPublish.name("id").value((unsigned int)fault.id);
+                toPublish.name("state").value((fault.quarantined) ? "quarantined" : "recovered");
+                if (fault.quarantined)
+                {
+                    toPublish.name("err").value((unsigned int)fault.result);
+                    toPublish.name("fails").value((unsigned long)fault.failures);
+                    toPublish.name("retry").value((unsigned long)(fault.backoffMs / 1000));
+                }
+                toPublish.endObject();
+                modbusFaults.pop();
+            }
+            toPublish.endArray();
+            toPublish.endObject();
+            if (!publishSubmit(PublishArbiter::Priority::Alarm, "modbus_fault", faultPublish))
+            {
+                busStats.dropped++;
+            }
+        }
+
+        // So does the outcome of a discovery
+        if (modbusDiscoverNotice.pending)
+        {
+            char discoverPublish[128];
+            memset(discoverPublish, 0, sizeof(discoverPublish));
+            JSONBufferWriter toPublish(discoverPublish, sizeof(discoverPublish) - 1);
+            toPublish.beginObject();
+            toPublish.name("found").value(modbusDiscoverNotice.found);
+            toPublish.name("baud").value((unsigned long)modbusEnumToBaud(modbusDiscoverNotice.settings.baud));
+            toPublish.name("parity").value((ModbusParity::None == modbusDiscoverNotice.settings.parity) ? "none" : "even");
+            toPublish.name("probes").value((unsigned long)modbusDiscoverNotice.probes);
+            toPublish.name("ms").value((unsigned long)modbusDiscoverNotice.elapsedMs);
+            toPublish.endObject();
+            modbusDiscoverNotice.pending = false;
+            if (!publishSubmit(PublishArbiter::Priority::Alarm, "modbus_discover", discoverPublish))
+            {
+                busStats.dropped++;
+            }
+        }
+
+        // A diagnostics report also goes out ahead of results
+        if (modbusDiagRequested.exchange(false))
+        {
+            modbusDiagActive = true;
+            modbusDiagCursor = 0;
+        }
+        while (modbusDiagActive && modbusPublishDiag())
+        {
+        }
+
+        // As many events as the results take, what is left after a refusal waits for the next pass
+        while (!resultsToPublish.empty() || !wideResultsToPublish.empty() || !writeOutcomes.empty())
+        {
+            static char publish1[MODBUS_PUBLISH_SIZE + 1] = {};
+            memset(publish1, 0, sizeof(publish1));
+            JSONBufferWriter toPublish(publish1, MODBUS_PUBLISH_SIZE);
+            toPublish.beginObject();
+            if (!writeOutcomes.empty())
+            {
+                toPublish.name("writes").beginArray();
+                while (!writeOutcomes.empty() &&
+                    ((toPublish.dataSize() + MODBUS_PUBLISH_WRITE_MAX + MODBUS_PUBLISH_TAIL_MAX) <= MODBUS_PUBLISH_SIZE))
+                {
+                    auto& outcome = writeOutcomes.front();
+                    toPublish.beginObject();
+                    toPublish.name("id").value((unsigned int)outcome.id);
+                    toPublish.name("fn").value((outcome.coil) ? "coil" : "hr");
+                    toPublish.name("addr").value((unsigned int)outcome.address);
+                    toPublish.name("n").value((unsigned int)outcome.count);
+                    toPublish.name("result").value((unsigned int)outcome.result);
+                    if (ModbusVerifyState::None != outcome.verify)
+                    {
+                        toPublish.name("verify").value((ModbusVerifyState::Passed == outcome.verify) ? "ok" : "failed");
+                    }
+                    toPublish.endObject();
+                    writeOutcomes.pop();
+                }
+                toPublish.endArray();
+            }
+            toPublish.name("modbus").beginArray();
+
+            while (!resultsToPublish.empty() &&
+                ((toPublish.dataSize() + MODBUS_PUBLISH_ENTRY_MAX + MODBUS_PUBLISH_TAIL_MAX) <= MODBUS_PUBLISH_SIZE))
+            {
+                auto& client = resultsToPublish.front();
+                char name[16];
+                snprintf(name, sizeof(name), "modbus%u", (unsigned int)(client.point + 1));
+                toPublish.beginObject().name("name").value(name);
+                toPublish.name("result").value((unsigned long)client.result);
+                if (modbusRtu.ku8MBSuccess == client.result)
+                {
+                    toPublish.name("value").value(client.value);
+                }
+                toPublish.endObject();
+                resultsToPublish.pop();
+            }
+            while (!wideResultsToPublish.empty() &&
+                ((toPublish.dataSize() + MODBUS_PUBLISH_WIDE_MAX + MODBUS_PUBLISH_TAIL_MAX) <= MODBUS_PUBLISH_SIZE))
+            {
+                auto& client = wideResultsToPublish.front();
+                char name[16];
+                snprintf(name, sizeof(name), "modbus%u", (unsigned int)(client.point + 1));
+                toPublish.beginObject().name("name").value(name);
+                toPublish.name("result").value((unsigned long)client.result);
+                if ((modbusRtu.ku8MBSuccess == client.result) && (0 == client.count))
+                {
+                    toPublish.name("value").value(client.text);
+                }
+                else if (modbusRtu.ku8MBSuccess == client.result)
+                {
+                    toPublish.name("value").beginArray();
+                    for (size_t i = 0; i < client.count; i++)
+                    {
+                        toPublish.value(client.values[i]);
+                    }
+                    toPublish.endArray();
+                }
+                toPublish.endObject();
+                wideResultsToPublish.pop();
+            }
+            toPublish.endArray();
+
+            if (!resultsToPublish.empty() || !wideResultsToPublish.empty() || !writeOutcomes.empty())
+            {
+                // Further results follow in the next event along with the bus statistics
+                toPublish.name("more").value((unsigned long)(resultsToPublish.size() + wideResultsToPublish.size() + writeOutcomes.size()));
+            }
+            else
+            {
+                // Bus time since the last publish, estimated for one read per object and for the planned blocks
+                toPublish.name("bus").beginObject();
+                toPublish.name("txn").value((unsigned long)busStats.transactions);
+                toPublish.name("ms").value((double)busStats.measuredUs / 1000.0, 1);
+                toPublish.name("est").value((double)busStats.estimateUs / 1000.0, 1);
+                toPublish.name("est1").value((double)busStats.estimateSingleUs / 1000.0, 1);
+                toPublish.name("load").value(modbusThreadLoad, 2);
+                toPublish.name("miss").value((unsigned long)busStats.missed);
+                toPublish.name("ovl").value(modbusOverload);
+                toPublish.name("sup").value((unsigned long)busStats.suppressed);
+                toPublish.name("ovf").value((unsigned long)(resultsToPublish.takeOverflows() + wideResultsToPublish.takeOverflows()));
+                toPublish.name("rty").value((unsigned long)busStats.retries);
+                toPublish.name("skip").value((unsigned long)busStats.skipped);
+                toPublish.name("drop").value((unsigned long)busStats.dropped);
+                size_t dead = 0;
+                for (size_t i = 0; i < modbusSlaveCount; i++)
+                {
+                    dead += (SlaveHealth::State::Quarantined == modbusSlaves[i].health.getState()) ? 1 : 0;
+                }
+                toPublish.name("dead").value((unsigned int)dead);
+                toPublish.name("jit").beginArray();
+                for (auto count: busStats.jitter)
+                {
+                    toPublish.value((unsigned long)count);
+                }
+                toPublish.endArray();
+                toPublish.endObject();
+                busStats = {};
+            }
+            toPublish.endObject();
+            if (!publishSubmit(PublishArbiter::Priority::Data, "modbus", publish1))
+            {
+                busStats.dropped++;
+                break;
+            }
+        }
+        // Sleep until the next deadline, a configuration change or a pending publish
+        uint32_t wait = MODBUS_CPU_WINDOW_MS;
+        if (!pollSchedule.empty()) {
+            auto delta = (int32_t)(pollSchedule.top().due - millis());
+            wait = (delta <= 0) ? 0 : min(wait, (uint32_t)delta);
+        }
+        if (!resultsToPublish.empty() || !wideResultsToPublish.empty() || !writeOutcomes.empty() || !modbusFaults.empty() || modbusDiagActive ||
+            modbusDiscoverNotice.pending) {
+            wait = min(wait, MODBUS_PUBLISH_WAIT_MS);
+        }
+
+        threadStats.activeUs += micros() - wakeUs;
+        auto elapsed = millis() - threadStats.windowStart;
+        if (elapsed >= MODBUS_CPU_WINDOW_MS) {
+            modbusThreadLoad = (double)threadStats.activeUs / ((double)elapsed * 10.0);
+
+            // Skipped deadlines or a saturated bus mean the requested rates cannot be sustained
+            auto overload = (0 != threadStats.missed) || ((uint64_t)threadStats.busUs * 100 > (uint64_t)elapsed * 1000 * MODBUS_OVERLOAD_BUS_PERCENT);
+            if (overload != modbusOverload) {
+                if (overload) {
+                    monitorOneLog.warn("Modbus overloaded, %lu polls skipped, bus busy %lu ms of %lu ms",
+                        threadStats.missed, threadStats.busUs / 1000, elapsed);
+                }
+                else {
+                    monitorOneLog.info("Modbus overload cleared");
+                }
+            }
+            modbusOverload = overload;
+            modbusUpdateMetrics(elapsed);
+            modbusCheckErrorRate();
+            threadStats = {0, 0, millis(), 0, 0, 0};
+        }
+
+        if (wait) {
+            os_semaphore_take(modbusWakeSemaphore, wait, false);
+        }
+        else {
+            // Play fair and let other threads execute
+            os_thread_yield();
+        }
+    }
+
+    // It is safe to exit here with Thread::run properly handling OS thread exit
+}
+
+/**
+ * @brief Parse a write request
+ *
+ * @details The request is "id,function,address,value[:value...][,verify]" where function is
+ *          coil or hr and values are separated by colons.  Register values range from -32768
+ *          to 65535 and any non-zero coil value turns the coil on.
+ *
+ * @param text Write request
+ * @param write Write to fill in
+ * @retval SYSTEM_ERROR_NONE Success
+ * @retval SYSTEM_ERROR_INVALID_ARGUMENT Request is malformed
+ */
+static int modbusParseWrite(const char* text, ModbusWrite& write)
+{
+    write = {};
+    if ((nullptr == text) || (strlen(text) > MODBUS_WRITE_TEXT_LENGTH))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    char buffer[MODBUS_WRITE_TEXT_LENGTH + 1];
+    strcpy(buffer, text);
+
+    char* fields[6] {};
+    size_t count = 0;
+    char* save = nullptr;
+    for (auto field = strtok_r(buffer, ",", &save); field && (count < 6); field = strtok_r(nullptr, ",", &save))
+    {
+        fields[count++] = field;
+    }
+    if ((count < 4) || (count > 5) || ((5 == count) && (0 != strcmp(fields[4], "verify"))))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    char* end = nullptr;
+    auto id = strtoul(fields[0], &end, 10);
+    if (*end || (id < 1) || (id > 247))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    auto coil = (0 == strcmp(fields[1], "coil"));
+    if (!coil && (0 != strcmp(fields[1], "hr")))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+    auto address = strtoul(fields[2], &end, 10);
+    if (*end || (address > 0xffff))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    for (auto value = strtok_r(fields[3], ":", &save); value; value = strtok_r(nullptr, ":", &save))
+    {
+        auto number = strtol(value, &end, 0);
+        if (*end || (number < INT16_MIN) || (number > UINT16_MAX) || (write.count >= MODBUS_WRITE_VALUES))
+        {
+            return SYSTEM_ERROR_INVALID_ARGUMENT;
+        }
+        write.values[write.count++] = (coil) ? (0 != number) : (uint16_t)number;
+    }
+    if ((0 == write.count) || ((address + write.count) > 0x10000))
+    {
+        return SYSTEM_ERROR_INVALID_ARGUMENT;
+    }
+
+    write.id = (uint8_t)id;
+    write.coil = coil;
+    write.verify = (5 == count);
+    write.address = (uint16_t)address;
+
+    return SYSTEM_ERROR_NONE;
+}
+
+/**
+ * @brief Check a write request without queuing it
+ *
+ * @param text Write request, see modbusQueueWrite()
+ * @retval SYSTEM_ERROR_NONE Request is valid
+ * @retval SYSTEM_ERROR_INVALID_ARGUMENT Request is malformed
+ */
+int modbusValidateWrite(const char* text)
+{
+    ModbusWrite write;
+    return modbusParseWrite(text, write);
+}
+
+/**
+ * @brief Queue a write to run ahead of the next poll
+ *
+ * @details The request is "id,function,address,value[:value...][,verify]" where function is
+ *          coil or hr.  A write that touches or overlaps the newest queued write to the same
+ *          slave and function is merged into it, the later values winning, so that a burst of
+ *          setpoint changes costs one transaction.  Safe to call from any thread.
+ *
+ * @param text Write request
+ * @retval SYSTEM_ERROR_NONE Write queued
+ * @retval SYSTEM_ERROR_INVALID_ARGUMENT Request is malformed
+ * @retval SYSTEM_ERROR_BUSY Write queue is full
+ */
+int modbusQueueWrite(const char* text)
+{
+    ModbusWrite write;
+    auto status = modbusParseWrite(text, write);
+    if (SYSTEM_ERROR_NONE != status)
+    {
+        return status;
+    }
+
+    {
+        const std::lock_guard<RecursiveMutex> lock(modbusWritesMutex);
+
+        // Only the newest write to the slave may absorb this one so that writes are never reordered
+        ModbusWrite* newest = nullptr;
+        for (size_t i = modbusWrites.size(); (nullptr == newest) && (i > 0); i--)
+        {
+            newest = (modbusWrites[i - 1].id == write.id) ? &modbusWrites[i - 1] : nullptr;
+        }
+
+        auto first = (newest) ? min(newest->address, write.address) : 0;
+        auto last = (newest) ? max(newest->address + newest->count, write.address + write.count) : 0;
+        if (newest && (newest->coil == write.coil) && (write.address <= (newest->address + newest->count)) &&
+            (newest->address <= (write.address + write.count)) && ((size_t)(last - first) <= MODBUS_WRITE_VALUES))
+        {
+            ModbusWrite merged = *newest;
+            merged.address = (uint16_t)first;
+            merged.count = (uint8_t)(last - first);
+            merged.verify = newest->verify || write.verify;
+            memcpy(&merged.values[newest->address - first], newest->values, newest->count * sizeof(newest->values[0]));
+            memcpy(&merged.values[write.address - first], write.values, write.count * sizeof(write.values[0]));
+            *newest = merged;
+        }
+        else if (modbusWrites.size() < modbusWrites.capacity())
+        {
+            modbusWrites.push(write);
+        }
+        else
+        {
+            return SYSTEM_ERROR_BUSY;
+        }
+    }
+
+    if (nullptr != modbusWakeSemaphore)
+    {
+        os_semaphore_give(modbusWakeSemaphore, false);
+    }
+    return SYSTEM_ERROR_NONE;
+}
+
+/**
+ * @brief Initializes the Modbus settings and polling thread
+ *
+ * @return int Zero (success) always
+ */
+int modbusInit()
+{
+    buildModbusRtuSettings();
+
+    //for loop for instances
+    for (int i = 1; i <= MODBUS_CLIENT_COUNT;i++)
+    {
+        buildModbusSettings(i);
+    }
+
+    for (int i = 1; i <= MODBUS_TABLE_PAGES; i++)
+    {
+        buildModbusPointPage(i);
+    }
+
+    Particle.variable("Modbus Load", modbusThreadLoad);
+    Particle.variable("Modbus Overload", modbusOverload);
+    Particle.variable("Modbus Util", modbusBusUtil);
+    Particle.variable("Modbus Lag", modbusLagMs);
+    Particle.function("Modbus Write", [](String val){
+        return modbusQueueWrite(val.c_str());
+    }, nullptr);
+    Particle.function("Modbus Discover", [](String val){
+        modbusDiscoverRequested = true;
+        if (nullptr != modbusWakeSemaphore)
+        {
+            os_semaphore_give(modbusWakeSemaphore, false);
+        }
+        return 0;
+    }, nullptr);
+    Particle.function("Modbus Diag", [](String val){
+        modbusDiagRequested = true;
+        if (nullptr != modbusWakeSemaphore)
+        {
+            os_semaphore_give(modbusWakeSemaphore, false);
+        }
+        return 0;
+    }, nullptr);
 
+    modbusDiscoverRequested = modbusDiscoverConfig.enabled;
     if (nullptr == modbusThread)
     {
-        modbusThread = new Thread("modbus", modbusThreadLoop, nullptr, OS_THREAD_PRIORITY_DEFAULT, 2*1024);
+        os_semaphore_create(&modbusWakeSemaphore, 1, 0);
+        modbusThread = new Thread("modbus", modbusThreadLoop, nullptr, OS_THREAD_PRIORITY_DEFAULT, MODBUS_THREAD_STACK);
     }
     return 0;
 }
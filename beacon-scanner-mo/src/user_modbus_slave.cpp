@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "user_config.h"
+
+#include "Particle.h"
+#include "config_service.h"
+#include "monitor_edge_ioexpansion.h"
+#include "ModbusSlave.h"
+#include "SeqLockRegisters.h"
+
+#include <atomic>
+#include <cmath>
+
+
+//
+// Constants
+//
+enum class ModbusSlavePort {
+    Usb,
+    Rs485,
+};
+
+// Input register map, every block also answers holding register reads
+static constexpr uint16_t SLAVE_IO_FIRST                {0};
+static constexpr uint16_t SLAVE_IO_VOLTAGE              {0};    // float32, high word first
+static constexpr uint16_t SLAVE_IO_CURRENT              {2};    // float32
+static constexpr uint16_t SLAVE_IO_DIGITAL_IN           {4};    // 0 or 1
+static constexpr uint16_t SLAVE_IO_RELAY                {5};    // 0 or 1
+static constexpr uint16_t SLAVE_IO_PULSE_COUNT          {6};    // uint32
+static constexpr uint16_t SLAVE_IO_PULSE_RATE           {8};    // float32
+static constexpr size_t SLAVE_IO_COUNT                  {10};
+static constexpr uint16_t SLAVE_MODBUS_FIRST            {100};  // float32 per polled point
+static constexpr size_t SLAVE_MODBUS_COUNT              {2 * MODBUS_POINT_COUNT};
+static constexpr uint16_t SLAVE_CAN_FIRST               {400};  // float32 per CAN signal
+static constexpr size_t SLAVE_CAN_COUNT                 {2 * CAN_SIGNAL_COUNT};
+static_assert(SLAVE_MODBUS_FIRST + SLAVE_MODBUS_COUNT <= SLAVE_CAN_FIRST, "Modbus points overlap the CAN signals");
+
+static constexpr int32_t SLAVE_ID_DEFAULT               {1};
+static constexpr uint32_t SLAVE_USB_GAP_US              {5000}; // USB delivers in packets, character timing means nothing
+static constexpr uint32_t SLAVE_IDLE_MS                 {100};  // Sleep of the USB thread while the slave is off
+
+
+//
+// Global variables
+//
+static Logger monitorOneLog("IoSlave");
+static Thread* slaveThread;
+
+// Defined in main.cpp, it shares the USB port with the slave
+extern SerialLogHandler logHandler;
+
+struct ModbusSlaveSettings {
+    bool enabled;
+    ModbusSlavePort port;
+    int32_t id;
+};
+
+static ModbusSlaveSettings slaveSettings {false, ModbusSlavePort::Usb, SLAVE_ID_DEFAULT};
+static ModbusSlaveSettings slaveSettingsShadow {slaveSettings};
+
+// Enabled settings as seen by the serving threads, (port << 8) | id, zero while the slave is off
+static std::atomic<uint16_t> slaveActive {0};
+static bool slaveLogRemoved {false};
+
+// One block per writer: the main loop, the modbus thread and the can thread
+static SeqLockRegisters<SLAVE_IO_COUNT> slaveIoRegisters;
+static SeqLockRegisters<SLAVE_MODBUS_COUNT> slaveModbusRegisters;
+static SeqLockRegisters<SLAVE_CAN_COUNT> slaveCanRegisters;
+
+static uint8_t slaveReadRegisters(uint8_t function, uint16_t address, uint16_t count, uint16_t* values);
+static void slaveDirection(bool transmit);
+
+// Only one of the two is serving at a time, each from its own thread
+static ModbusSlave slaveUsb(slaveReadRegisters);
+static ModbusSlave slaveRs485(slaveReadRegisters, slaveDirection);
+
+
+//
+// Functions
+//
+
+/**
+ * @brief Copy the registers of a read request from the block holding them
+ *
+ * @details A request must fall within a single block, which keeps every value it returns
+ *          from a single update of that block.
+ *
+ * @return uint8_t Zero on success, otherwise a Modbus exception code
+ */
+static uint8_t slaveReadRegisters(uint8_t function, uint16_t address, uint16_t count, uint16_t* values)
+{
+    uint32_t last = (uint32_t)address + count;
+    auto ok = false;
+    if ((address >= SLAVE_IO_FIRST) && (last <= SLAVE_IO_FIRST + SLAVE_IO_COUNT))
+    {
+        ok = slaveIoRegisters.read(address - SLAVE_IO_FIRST, count, values);
+    }
+    else if ((address >= SLAVE_MODBUS_FIRST) && (last <= SLAVE_MODBUS_FIRST + SLAVE_MODBUS_COUNT))
+    {
+        ok = slaveModbusRegisters.read(address - SLAVE_MODBUS_FIRST, count, values);
+    }
+    else if ((address >= SLAVE_CAN_FIRST) && (last <= SLAVE_CAN_FIRST + SLAVE_CAN_COUNT))
+    {
+        ok = slaveCanRegisters.read(address - SLAVE_CAN_FIRST, count, values);
+    }
+    else
+    {
+        return ModbusSlave::ILLEGAL_DATA_ADDRESS;
+    }
+
+    // A writer preempted in the middle of an update keeps the block busy until it runs again
+    return (ok) ? 0 : ModbusSlave::SLAVE_DEVICE_BUSY;
+}
+
+static void slaveDirection(bool transmit)
+{
+    digitalWrite(MONITOREDGE_IOEX_RS485_DE_PIN, (transmit) ? 1 : 0);
+}
+
+/**
+ * @brief Update the analog and digital input registers, called from the main loop
+ *
+ */
+void modbusSlaveSetInputs(float voltage, float current, bool digitalIn, bool relay, uint32_t pulses, float pulseRate)
+{
+    slaveIoRegisters.beginWrite();
+    slaveIoRegisters.setFloat(SLAVE_IO_VOLTAGE, voltage);
+    slaveIoRegisters.setFloat(SLAVE_IO_CURRENT, current);
+    slaveIoRegisters.set(SLAVE_IO_DIGITAL_IN, (digitalIn) ? 1 : 0);
+    slaveIoRegisters.set(SLAVE_IO_RELAY, (relay) ? 1 : 0);
+    slaveIoRegisters.set32(SLAVE_IO_PULSE_COUNT, pulses);
+    slaveIoRegisters.setFloat(SLAVE_IO_PULSE_RATE, pulseRate);
+    slaveIoRegisters.endWrite();
+}
+
+/**
+ * @brief Update the registers of a polled Modbus point, called from the modbus thread
+ *
+ * @param point Zero based Modbus point index
+ * @param value Latest scaled value, NAN if the poll failed
+ */
+void modbusSlaveSetPoint(int point, float value)
+{
+    if ((point >= 0) && (point < MODBUS_POINT_COUNT))
+    {
+        slaveModbusRegisters.beginWrite();
+        slaveModbusRegisters.setFloat(2 * point, value);
+        slaveModbusRegisters.endWrite();
+    }
+}
+
+/**
+ * @brief Update the registers of a CAN signal, called from the can thread
+ *
+ * @param signal Zero based CAN signal index
+ * @param value Latest decoded value, NAN when the signal is stale or not available
+ */
+void modbusSlaveSetSignal(int signal, float value)
+{
+    if ((signal >= 0) && (signal < CAN_SIGNAL_COUNT))
+    {
+        slaveCanRegisters.beginWrite();
+        slaveCanRegisters.setFloat(2 * signal, value);
+        slaveCanRegisters.endWrite();
+    }
+}
+
+static uint16_t slavePack(const ModbusSlaveSettings& settings)
+{
+    if (!settings.enabled)
+    {
+        return 0;
+    }
+    return (uint16_t)(((uint16_t)settings.port << 8) | (uint8_t)settings.id);
+}
+
+/**
+ * @brief Check whether the slave serves the RS-485 port, which stops the modbus thread from polling
+ *
+ */
+bool modbusSlaveOwnsRs485()
+{
+    auto active = slaveActive.load();
+    return active && (((uint16_t)ModbusSlavePort::Rs485 << 8) == (active & 0xff00));
+}
+
+/**
+ * @brief Serve requests on the RS-485 port, called from the modbus thread in place of polling
+ *
+ * @param gapUs Silent interval that ends a frame at the current line settings
+ * @param durationMs Time to serve before returning
+ */
+void modbusSlaveServeRs485(uint32_t gapUs, uint32_t durationMs)
+{
+    auto start = millis();
+    slaveRs485.reset();
+    while (modbusSlaveOwnsRs485() && ((millis() - start) < durationMs))
+    {
+        slaveRs485.setId((uint8_t)slaveActive.load());
+        slaveRs485.service(Serial1, gapUs);
+        delay(1);
+    }
+}
+
+/**
+ * @brief The thread that serves the slave on the USB port
+ *
+ * @details The USB port carries the log output unless the slave uses it, so the log handler is
+ *          taken off while the slave serves and put back when it stops.
+ *
+ * @param param Unused
+ */
+static void slaveThreadLoop(void* param)
+{
+    while (true)
+    {
+        auto active = slaveActive.load();
+        auto usb = active && (((uint16_t)ModbusSlavePort::Usb << 8) == (active & 0xff00));
+        if (usb != slaveLogRemoved)
+        {
+            if (usb)
+            {
+                monitorOneLog.info("Modbus slave %u serving the USB port, logging stops", (unsigned int)(uint8_t)active);
+                LogManager::instance()->removeHandler(&logHandler);
+            }
+            else
+            {
+                LogManager::instance()->addHandler(&logHandler);
+                monitorOneLog.info("Modbus slave left the USB port");
+            }
+            slaveUsb.reset();
+            slaveLogRemoved = usb;
+        }
+
+        if (!usb)
+        {
+            delay(SLAVE_IDLE_MS);
+            continue;
+        }
+        slaveUsb.setId((uint8_t)active);
+        slaveUsb.service(Serial, SLAVE_USB_GAP_US);
+        delay(1);
+    }
+}
+
+/**
+ * @brief Config service object settings to allow JSON configuration
+ *
+ * @param write Indicates whether the current operation is to write
+ * @param context Unused
+ * @return int The command return value
+ */
+static int slaveConfigEnter(bool write, const void *context)
+{
+    if (write)
+    {
+        slaveSettingsShadow = slaveSettings;
+    }
+    return 0;
+}
+
+/**
+ * @brief Config service object settings to commit new JSON configuration
+ *
+ * @param write Indicates whether the current operation is to write
+ * @param status Status of the command return value
+ * @param context Unused
+ * @return int The command return value
+ */
+static int slaveConfigExit(bool write, int status, const void *context)
+{
+    if (write && (0 == status))
+    {
+        slaveSettings = slaveSettingsShadow;
+        slaveActive.store(slavePack(slaveSettings));
+    }
+    return status;
+}
+
+/**
+ * @brief Register the slave configuration, clear the register image and start the USB thread
+ *
+ * @details Must run before the CAN and Modbus threads start, the image blocks they write
+ *          allow only one writer at a time.
+ *
+ * @return int Zero (success) always
+ */
+int modbusSlaveInit()
+{
+    modbusSlaveSetInputs(NAN, NAN, false, false, 0, NAN);
+    for (int i = 0; i < MODBUS_POINT_COUNT; i++)
+    {
+        modbusSlaveSetPoint(i, NAN);
+    }
+    for (int i = 0; i < CAN_SIGNAL_COUNT; i++)
+    {
+        modbusSlaveSetSignal(i, NAN);
+    }
+
+    static ConfigObject slaveConfig("modbus_slave", {
+        ConfigBool("enable",
+            config_get_bool_cb, config_set_bool_cb,
+            &slaveSettings.enabled, &slaveSettingsShadow.enabled),
+        ConfigStringEnum("port", {
+                {"usb", (int32_t) ModbusSlavePort::Usb},
+                {"rs485", (int32_t) ModbusSlavePort::Rs485},
+            },
+            config_get_int32_cb, config_set_int32_cb,
+            &slaveSettings.port, &slaveSettingsShadow.port),
+        ConfigInt("id",
+            config_get_int32_cb, config_set_int32_cb,
+            &slaveSettings.id, &slaveSettingsShadow.id,
+            1, 247),
+    },
+    slaveConfigEnter, slaveConfigExit);
+    ConfigService::instance().registerModule(slaveConfig);
+    slaveActive.store(slavePack(slaveSettings));
+
+    if (nullptr == slaveThread)
+    {
+        slaveThread = new Thread("mbslave", slaveThreadLoop, nullptr, OS_THREAD_PRIORITY_DEFAULT, 2*1024);
+    }
+    return 0;
+}
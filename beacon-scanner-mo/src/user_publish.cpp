@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "user_config.h"
+
+#include "Particle.h"
+#include "edge_location.h"
+#include "PublishArbiter.h"
+
+#include <mutex>
+
+
+//
+// Constants
+//
+static constexpr size_t PUBLISH_ALARM_BYTES             {1024};  // Queue storage per priority
+static constexpr size_t PUBLISH_DATA_BYTES              {4096};
+static constexpr size_t PUBLISH_BULK_BYTES              {3072};
+static constexpr uint32_t PUBLISH_PERIOD_MS             {1000};  // Cloud allows one event a second on average
+static constexpr uint32_t PUBLISH_BURST                 {4};     // and short bursts of four
+static constexpr uint32_t PUBLISH_IDLE_MS               {50};    // Sleep of the publish thread while nothing can go out
+
+
+//
+// Global variables
+//
+static Logger monitorOneLog("Publish");
+static Thread* publishThread;
+static Mutex publishMutex;                      // Producers submit from several threads
+
+static uint8_t publishAlarmQueue[PUBLISH_ALARM_BYTES];
+static uint8_t publishDataQueue[PUBLISH_DATA_BYTES];
+static uint8_t publishBulkQueue[PUBLISH_BULK_BYTES];
+static uint8_t* const publishQueues[PublishArbiter::PRIORITY_COUNT] {publishAlarmQueue, publishDataQueue, publishBulkQueue};
+static const size_t publishQueueSizes[PublishArbiter::PRIORITY_COUNT] {PUBLISH_ALARM_BYTES, PUBLISH_DATA_BYTES, PUBLISH_BULK_BYTES};
+static PublishArbiter publishArbiter(publishQueues, publishQueueSizes);
+static uint32_t publishDropsReported {0};
+
+
+//
+// Functions
+//
+
+/**
+ * @brief Queue an event for the publish thread without waiting on the cloud
+ *
+ * @param priority Queue to use
+ * @param name Event name
+ * @param data Event data, JSON when the record may be packed
+ * @param packable Record may share an event with records from other producers
+ * @return true Event queued
+ * @return false Queue full, the event was dropped
+ */
+bool publishSubmit(PublishArbiter::Priority priority, const char* name, const char* data, bool packable)
+{
+    const std::lock_guard<Mutex> lock(publishMutex);
+    return publishArbiter.submit(priority, name, data, packable);
+}
+
+/**
+ * @brief The thread that publishes queued events as the budget allows
+ *
+ * @details Only this thread waits on the cloud.  The arbiter is locked while an event is taken
+ *          and while its outcome is recorded, never during the publish itself.
+ *
+ * @param param Unused
+ */
+static void publishThreadLoop(void* param)
+{
+    static char name[PublishArbiter::NAME_LENGTH + 1];
+    static char data[PublishArbiter::EVENT_SIZE + 1];
+
+    while (true)
+    {
+        auto ready = false;
+        if (Particle.connected())
+        {
+            const std::lock_guard<Mutex> lock(publishMutex);
+            ready = publishArbiter.next(millis(), name, data);
+        }
+        if (!ready)
+        {
+            delay(PUBLISH_IDLE_MS);
+            continue;
+        }
+
+        auto published = Particle.publish(name, data);
+        if (!published)
+        {
+            monitorOneLog.warn("Publish of %s failed, retrying", name);
+        }
+
+        const std::lock_guard<Mutex> lock(publishMutex);
+        publishArbiter.complete(millis(), published);
+    }
+}
+
+/**
+ * @brief Start the publish thread and count location events against the shared budget
+ *
+ * @return int Zero (success) always
+ */
+int publishInit()
+{
+    publishArbiter.setRate(PUBLISH_PERIOD_MS, PUBLISH_BURST, millis());
+
+    // Location events go out through the location service, they still spend the same budget
+    EdgeLocation::instance().regLocGenCallback(
+        [](JSONWriter& writer, LocationPoint& location, const void* nothing) {
+            uint32_t dropped = 0;
+            {
+                const std::lock_guard<Mutex> lock(publishMutex);
+                publishArbiter.charge(millis());
+                auto& stats = publishArbiter.getStats();
+                for (auto count: stats.dropped)
+                {
+                    dropped += count;
+                }
+            }
+            if (dropped != publishDropsReported)
+            {
+                writer.name("pub_drop").value((unsigned long)(dropped - publishDropsReported));
+                publishDropsReported = dropped;
+            }
+        }
+    );
+
+    if (nullptr == publishThread)
+    {
+        publishThread = new Thread("publish", publishThreadLoop, nullptr, OS_THREAD_PRIORITY_DEFAULT, 2*1024);
+    }
+    return 0;
+}
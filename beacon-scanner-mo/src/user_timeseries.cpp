@@ -0,0 +1,606 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "user_config.h"
+
+#include "Particle.h"
+#include "config_service.h"
+#include "FixedRing.h"
+#include "SampleCoding.h"
+#include "TimeSeriesCodec.h"
+
+#include <cmath>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+//
+// Constants
+//
+static constexpr size_t TIME_SERIES_SLOTS               {16};   // Series recorded at once
+static constexpr size_t TIME_SERIES_BLOCKS              {20};   // RAM blocks shared by all series
+static constexpr size_t TIME_SERIES_BLOCK_BYTES         {240};  // Encoded bytes per block, one block per event
+static constexpr uint8_t TIME_SERIES_NO_BLOCK           {0xff};
+static constexpr uint32_t TIME_SERIES_CHUNK_MS          {1000}; // Time between uploaded blocks
+static constexpr size_t TIME_SERIES_POINTS_LENGTH       {64};
+static constexpr char TIME_SERIES_SPILL_PATH[]          {"/usr/timeseries.bin"};
+static constexpr off_t TIME_SERIES_SPILL_MAX            {64 * 1024};
+static constexpr int32_t TIME_SERIES_INTERVAL_DEFAULT   {1000};
+static constexpr int32_t TIME_SERIES_UPLOAD_DEFAULT     {300};
+
+
+//
+// Global variables
+//
+static Logger monitorOneLog("TimeSeries");
+
+struct TimeSeriesSettings {
+    bool enabled;
+    bool io;                                    ///< Record io_v and io_a
+    int32_t interval;                           ///< Shortest time between samples of a series in milliseconds
+    int32_t upload;                             ///< Time between uploads in seconds
+    bool flash;                                 ///< Spill sealed blocks to flash instead of dropping them
+    char points[TIME_SERIES_POINTS_LENGTH + 1]; ///< Modbus points to record such as "1-3,10"
+};
+
+static TimeSeriesSettings timeSeriesSettings {false, true, TIME_SERIES_INTERVAL_DEFAULT, TIME_SERIES_UPLOAD_DEFAULT, false, ""};
+static TimeSeriesSettings timeSeriesSettingsShadow {timeSeriesSettings};
+
+struct TimeSeriesBlock {
+    uint16_t series;
+    uint16_t count;
+    uint32_t unixTime;                          ///< Wall clock time of the first sample, zero if unknown
+    uint32_t startMs;                           ///< Millisecond timestamp of the first sample
+    uint16_t bytes;
+    uint8_t data[TIME_SERIES_BLOCK_BYTES];
+};
+
+struct TimeSeriesSlot {
+    int16_t series;                             ///< Negative when unused
+    uint8_t block;
+    uint32_t lastMs;
+    TimeSeriesEncoder encoder;
+};
+
+// Recording happens on the application and Modbus threads, uploading on the application thread.
+// The mutex covers the block pool and the spill file with its offsets.
+static RecursiveMutex timeSeriesMutex;
+static TimeSeriesBlock timeSeriesBlocks[TIME_SERIES_BLOCKS];
+static uint8_t timeSeriesFree[TIME_SERIES_BLOCKS];
+static size_t timeSeriesFreeCount {0};
+static uint8_t sealedStorage[TIME_SERIES_BLOCKS];
+static FixedRing<uint8_t> timeSeriesSealed(sealedStorage, TIME_SERIES_BLOCKS);
+static TimeSeriesSlot timeSeriesSlots[TIME_SERIES_SLOTS];
+
+static uint32_t timeSeriesDropped {0};          // Sealed blocks lost for lack of space
+static off_t timeSeriesSpillRead {0};           // Offset of the oldest block in the spill file
+static off_t timeSeriesSpillSize {0};
+static bool timeSeriesUploading {false};
+static unsigned int timeSeriesUploadTick {0};
+static unsigned int timeSeriesChunkTick {0};
+
+
+/**
+ * @brief Append a sealed block to the spill file
+ *
+ * @param block Block to keep
+ * @return true Block written
+ * @return false Spill file full or not writable
+ */
+static bool timeSeriesSpill(const TimeSeriesBlock& block)
+{
+    if ((timeSeriesSpillSize + (off_t)sizeof(block)) > TIME_SERIES_SPILL_MAX)
+    {
+        return false;
+    }
+
+    auto fd = open(TIME_SERIES_SPILL_PATH, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+    auto written = write(fd, &block, sizeof(block));
+    close(fd);
+    if (written != (ssize_t)sizeof(block))
+    {
+        return false;
+    }
+    timeSeriesSpillSize += sizeof(block);
+
+    return true;
+}
+
+/**
+ * @brief Take a block from the pool, making room by spilling or dropping the oldest sealed block
+ *
+ * @return uint8_t Block index, TIME_SERIES_NO_BLOCK if every block is in use by a series
+ */
+static uint8_t timeSeriesAllocate()
+{
+    if (timeSeriesFreeCount)
+    {
+        return timeSeriesFree[--timeSeriesFreeCount];
+    }
+    if (timeSeriesSealed.empty())
+    {
+        return TIME_SERIES_NO_BLOCK;
+    }
+
+    auto oldest = timeSeriesSealed.front();
+    timeSeriesSealed.pop();
+    if (!timeSeriesSettings.flash || !timeSeriesSpill(timeSeriesBlocks[oldest]))
+    {
+        timeSeriesDropped++;
+    }
+
+    return oldest;
+}
+
+/**
+ * @brief Queue the active block of a series for upload
+ *
+ * @param slot Series to seal
+ */
+static void timeSeriesSeal(TimeSeriesSlot& slot)
+{
+    if (TIME_SERIES_NO_BLOCK == slot.block)
+    {
+        return;
+    }
+
+    auto& block = timeSeriesBlocks[slot.block];
+    block.count = slot.encoder.getCount();
+    block.bytes = (uint16_t)slot.encoder.getBytes();
+    if (block.count)
+    {
+        timeSeriesSealed.push(slot.block);
+    }
+    else
+    {
+        timeSeriesFree[timeSeriesFreeCount++] = slot.block;
+    }
+    slot.block = TIME_SERIES_NO_BLOCK;
+}
+
+/**
+ * @brief Start a new block for a series
+ *
+ * @param slot Series needing a block
+ * @param ms Millisecond timestamp of the first sample
+ * @return true Block ready
+ * @return false No block available
+ */
+static bool timeSeriesStart(TimeSeriesSlot& slot, uint32_t ms)
+{
+    slot.block = timeSeriesAllocate();
+    if (TIME_SERIES_NO_BLOCK == slot.block)
+    {
+        return false;
+    }
+
+    auto& block = timeSeriesBlocks[slot.block];
+    block.series = (uint16_t)slot.series;
+    block.count = 0;
+    block.unixTime = Time.isValid() ? (uint32_t)Time.now() : 0;
+    block.startMs = ms;
+    block.bytes = 0;
+    slot.encoder.begin(block.data, sizeof(block.data));
+
+    return true;
+}
+
+/**
+ * @brief Parse one point number of the points setting
+ *
+ * @param text Start of the number, stops at the first character that is not a digit
+ * @param end Receives the first character after the number
+ * @param point Parsed point number
+ * @return true A point number between 1 and MODBUS_POINT_COUNT
+ */
+static bool timeSeriesParsePoint(const char* text, const char*& end, long& point)
+{
+    if (!isdigit((unsigned char)text[0]))
+    {
+        return false;
+    }
+    char* stop = nullptr;
+    point = strtol(text, &stop, 10);
+    end = stop;
+    return (point >= 1) && (point <= (long)MODBUS_POINT_COUNT);
+}
+
+/**
+ * @brief Walk the Modbus points of a points setting
+ *
+ * @details The setting is a comma separated list of one based point numbers and ranges, as in
+ *          "1-3,10".  Every field must hold a point or a range in ascending order, so an empty
+ *          field or one with other characters rejects the whole setting.  An empty setting
+ *          records no points.
+ *
+ * @param text Points setting
+ * @param each Called with every point number, only once the whole setting is known to be valid
+ * @return true Setting is valid
+ * @return false Setting is malformed
+ */
+template <typename Each>
+static bool timeSeriesParsePoints(const char* text, Each each)
+{
+    static constexpr size_t RANGES_MAX {TIME_SERIES_POINTS_LENGTH / 2 + 1};
+    long ranges[RANGES_MAX][2];
+    size_t count = 0;
+
+    auto cursor = text;
+    while ('\0' != *cursor)
+    {
+        auto& range = ranges[count++];
+        if (!timeSeriesParsePoint(cursor, cursor, range[0]))
+        {
+            return false;
+        }
+        range[1] = range[0];
+        if (('-' == *cursor) && (!timeSeriesParsePoint(cursor + 1, cursor, range[1]) || (range[1] < range[0])))
+        {
+            return false;
+        }
+        if (',' == *cursor)
+        {
+            cursor++;
+            if (('\0' == *cursor) || (count == RANGES_MAX))
+            {
+                return false;
+            }
+        }
+        else if ('\0' != *cursor)
+        {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        for (auto point = ranges[i][0]; point <= ranges[i][1]; point++)
+        {
+            each((int)point);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Assign series to slots from the settings, sealing whatever was being recorded
+ *
+ */
+static void applyTimeSeriesSettings()
+{
+    const std::lock_guard<RecursiveMutex> lock(timeSeriesMutex);
+
+    size_t count = 0;
+    auto assign = [&](int series) {
+        if (count < TIME_SERIES_SLOTS)
+        {
+            timeSeriesSlots[count].series = (int16_t)series;
+            timeSeriesSlots[count].lastMs = 0;
+            count++;
+        }
+    };
+
+    for (auto& slot: timeSeriesSlots)
+    {
+        timeSeriesSeal(slot);
+        slot.series = -1;
+    }
+    if (!timeSeriesSettings.enabled)
+    {
+        return;
+    }
+
+    if (timeSeriesSettings.io)
+    {
+        assign(TIME_SERIES_IO_VOLTAGE);
+        assign(TIME_SERIES_IO_CURRENT);
+    }
+
+    timeSeriesParsePoints(timeSeriesSettings.points, [&](int point) {
+        assign(TIME_SERIES_MODBUS + point - 1);
+    });
+    if (count == TIME_SERIES_SLOTS)
+    {
+        monitorOneLog.warn("Recording the first %u series only", (unsigned int)TIME_SERIES_SLOTS);
+    }
+}
+
+/**
+ * @brief Record a sample of a series if the series is being recorded
+ *
+ * @details Safe to call from any thread.  Samples closer together than the configured
+ *          interval are skipped, as are missing values.
+ *
+ * @param series Series number, see TIME_SERIES_IO_VOLTAGE and friends
+ * @param ms Millisecond timestamp of the sample
+ * @param value Sample value
+ */
+void timeSeriesRecord(int series, uint32_t ms, float value)
+{
+    if (!timeSeriesSettings.enabled || std::isnan(value))
+    {
+        return;
+    }
+
+    const std::lock_guard<RecursiveMutex> lock(timeSeriesMutex);
+
+    for (auto& slot: timeSeriesSlots)
+    {
+        if (slot.series != series)
+        {
+            continue;
+        }
+        if ((TIME_SERIES_NO_BLOCK != slot.block) && ((ms - slot.lastMs) < (uint32_t)timeSeriesSettings.interval))
+        {
+            return;
+        }
+
+        if ((TIME_SERIES_NO_BLOCK == slot.block) && !timeSeriesStart(slot, ms))
+        {
+            return;
+        }
+        if (!slot.encoder.append(ms, value))
+        {
+            timeSeriesSeal(slot);
+            if (!timeSeriesStart(slot, ms))
+            {
+                return;
+            }
+            slot.encoder.append(ms, value);
+        }
+        slot.lastMs = ms;
+        return;
+    }
+}
+
+/**
+ * @brief Take the oldest block waiting for upload, spilled blocks first
+ *
+ * @param block Copy of the block
+ * @param spilled Block came from the spill file
+ * @return true Block available
+ */
+static bool timeSeriesPeek(TimeSeriesBlock& block, bool& spilled)
+{
+    // The Modbus thread appends to the spill file when it runs out of blocks
+    const std::lock_guard<RecursiveMutex> lock(timeSeriesMutex);
+
+    spilled = false;
+    if (timeSeriesSpillRead < timeSeriesSpillSize)
+    {
+        auto fd = open(TIME_SERIES_SPILL_PATH, O_RDONLY);
+        if (fd >= 0)
+        {
+            auto got = (lseek(fd, timeSeriesSpillRead, SEEK_SET) == timeSeriesSpillRead) ? read(fd, &block, sizeof(block)) : -1;
+            close(fd);
+            if (got == (ssize_t)sizeof(block))
+            {
+                spilled = true;
+                return true;
+            }
+        }
+        // Unreadable, start over
+        unlink(TIME_SERIES_SPILL_PATH);
+        timeSeriesSpillRead = 0;
+        timeSeriesSpillSize = 0;
+    }
+
+    if (timeSeriesSealed.empty())
+    {
+        return false;
+    }
+    block = timeSeriesBlocks[timeSeriesSealed.front()];
+
+    return true;
+}
+
+/**
+ * @brief Remove the block returned by timeSeriesPeek once it is uploaded
+ *
+ * @param block Block that was uploaded
+ * @param spilled Block came from the spill file
+ */
+static void timeSeriesPop(const TimeSeriesBlock& block, bool spilled)
+{
+    const std::lock_guard<RecursiveMutex> lock(timeSeriesMutex);
+
+    if (spilled)
+    {
+        timeSeriesSpillRead += sizeof(block);
+        if (timeSeriesSpillRead >= timeSeriesSpillSize)
+        {
+            unlink(TIME_SERIES_SPILL_PATH);
+            timeSeriesSpillRead = 0;
+            timeSeriesSpillSize = 0;
+        }
+        return;
+    }
+
+    if (timeSeriesSealed.empty())
+    {
+        return;
+    }
+    // The block may have been dropped to make room while it was being uploaded
+    auto index = timeSeriesSealed.front();
+    auto& front = timeSeriesBlocks[index];
+    if ((front.series == block.series) && (front.startMs == block.startMs))
+    {
+        timeSeriesSealed.pop();
+        timeSeriesFree[timeSeriesFreeCount++] = index;
+    }
+}
+
+/**
+ * @brief Upload recorded blocks on the configured cadence
+ *
+ * @details Every upload period the active blocks are sealed and all sealed blocks are sent,
+ *          one io_ts event a second.  Each event carries one base64 encoded block.
+ *
+ * @return int Zero always
+ */
+int timeSeriesLoop()
+{
+    if (timeSeriesSettings.enabled && ((System.uptime() - timeSeriesUploadTick) >= (unsigned int)timeSeriesSettings.upload))
+    {
+        timeSeriesUploadTick = System.uptime();
+        const std::lock_guard<RecursiveMutex> lock(timeSeriesMutex);
+        for (auto& slot: timeSeriesSlots)
+        {
+            timeSeriesSeal(slot);
+        }
+        timeSeriesUploading = true;
+    }
+
+    if (!timeSeriesUploading || !Particle.connected() || ((millis() - timeSeriesChunkTick) < TIME_SERIES_CHUNK_MS))
+    {
+        return 0;
+    }
+    timeSeriesChunkTick = millis();
+
+    static TimeSeriesBlock block;
+    bool spilled;
+    if (!timeSeriesPeek(block, spilled))
+    {
+        timeSeriesUploading = false;
+        return 0;
+    }
+
+    static char encoded[base64Length(TIME_SERIES_BLOCK_BYTES) + 1];
+    static char publishBuffer[base64Length(TIME_SERIES_BLOCK_BYTES) + 128];
+    base64Encode(block.data, block.bytes, encoded, sizeof(encoded));
+
+    char name[16];
+    if (block.series >= TIME_SERIES_MODBUS)
+    {
+        snprintf(name, sizeof(name), "modbus%u", (unsigned int)(block.series - TIME_SERIES_MODBUS + 1));
+    }
+    else
+    {
+        snprintf(name, sizeof(name), "%s", (TIME_SERIES_IO_VOLTAGE == block.series) ? "io_v" : "io_a");
+    }
+
+    memset(publishBuffer, 0, sizeof(publishBuffer));
+    JSONBufferWriter writer(publishBuffer, sizeof(publishBuffer) - 1);
+    writer.beginObject();
+    writer.name("s").value(name);
+    writer.name("t").value((unsigned long)block.unixTime);
+    writer.name("ms").value((unsigned long)block.startMs);
+    writer.name("n").value((unsigned int)block.count);
+    uint32_t dropped;
+    {
+        const std::lock_guard<RecursiveMutex> lock(timeSeriesMutex);
+        dropped = timeSeriesDropped;
+    }
+    if (dropped)
+    {
+        writer.name("drop").value((unsigned long)dropped);
+    }
+    writer.name("d").value(encoded);
+    writer.endObject();
+
+    if (publishSubmit(PublishArbiter::Priority::Bulk, "io_ts", publishBuffer, false))
+    {
+        // Blocks dropped while this one was being sent go with the next one
+        const std::lock_guard<RecursiveMutex> lock(timeSeriesMutex);
+        timeSeriesPop(block, spilled);
+        timeSeriesDropped -= dropped;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Register the time series configuration and prepare the block pool
+ *
+ * @return int Zero (success) always
+ */
+int timeSeriesInit()
+{
+    for (size_t i = 0; i < TIME_SERIES_BLOCKS; i++)
+    {
+        timeSeriesFree[i] = (uint8_t)(TIME_SERIES_BLOCKS - 1 - i);
+    }
+    timeSeriesFreeCount = TIME_SERIES_BLOCKS;
+    for (auto& slot: timeSeriesSlots)
+    {
+        slot.series = -1;
+        slot.block = TIME_SERIES_NO_BLOCK;
+    }
+
+    // Blocks spilled before a reset are uploaded first
+    struct stat info {};
+    if (0 == stat(TIME_SERIES_SPILL_PATH, &info))
+    {
+        timeSeriesSpillSize = info.st_size - (info.st_size % (off_t)sizeof(TimeSeriesBlock));
+        timeSeriesUploading = (timeSeriesSpillSize > 0);
+    }
+
+    static ConfigObject timeSeriesConfig("timeseries", {
+        ConfigBool("enable",
+            config_get_bool_cb, config_set_bool_cb,
+            &timeSeriesSettings.enabled, &timeSeriesSettingsShadow.enabled),
+        ConfigBool("io",
+            config_get_bool_cb, config_set_bool_cb,
+            &timeSeriesSettings.io, &timeSeriesSettingsShadow.io),
+        ConfigString("points",
+            [](const char * &value, const void *context) {
+                value = timeSeriesSettings.points;
+                return 0;
+            },
+            [](const char * value, const void *context) {
+                if ((strlen(value) > TIME_SERIES_POINTS_LENGTH) || !timeSeriesParsePoints(value, [](int) {})) {
+                    return (int)SYSTEM_ERROR_INVALID_ARGUMENT;
+                }
+                strcpy(timeSeriesSettingsShadow.points, value);
+                return 0;
+            }),
+        ConfigInt("interval",
+            config_get_int32_cb, config_set_int32_cb,
+            &timeSeriesSettings.interval, &timeSeriesSettingsShadow.interval,
+            100, 3600000),
+        ConfigInt("upload",
+            config_get_int32_cb, config_set_int32_cb,
+            &timeSeriesSettings.upload, &timeSeriesSettingsShadow.upload,
+            10, 86400),
+        ConfigBool("flash",
+            config_get_bool_cb, config_set_bool_cb,
+            &timeSeriesSettings.flash, &timeSeriesSettingsShadow.flash),
+    },
+    [](bool write, const void *context) {
+        if (write) {
+            timeSeriesSettingsShadow = timeSeriesSettings;
+        }
+        return 0;
+    },
+    [](bool write, int status, const void *context) {
+        if (write && (0 == status)) {
+            timeSeriesSettings = timeSeriesSettingsShadow;
+            applyTimeSeriesSettings();
+        }
+        return status;
+    });
+    ConfigService::instance().registerModule(timeSeriesConfig);
+
+    applyTimeSeriesSettings();
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+/**
+ * @brief Minimal checks for the host tests
+ *
+ * @details Failures are reported with their location and counted rather than aborting so
+ *          that one run shows every broken case.  Each test returns hostTestResult() from
+ *          main so that make stops on the first failing program.
+ */
+static int hostTestFailures {0};
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            hostTestFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) \
+    do { \
+        auto _a = (a); \
+        auto _b = (b); \
+        if (!(_a == _b)) { \
+            std::printf("%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, \
+                (long long)_a, (long long)_b); \
+            hostTestFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tol) \
+    do { \
+        double _a = (a); \
+        double _b = (b); \
+        if (!(std::fabs(_a - _b) <= (tol))) { \
+            std::printf("%s:%d: CHECK_NEAR(%s, %s) failed: %g vs %g\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+            hostTestFailures++; \
+        } \
+    } while (0)
+
+static inline int hostTestResult(const char* name) {
+    std::printf("%s: %s\n", name, hostTestFailures ? "FAILED" : "passed");
+    return hostTestFailures ? 1 : 0;
+}
+
+/**
+ * @brief Monotonic time for the benchmarks
+ *
+ * @return double Seconds since an arbitrary epoch
+ */
+static inline double hostSeconds() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
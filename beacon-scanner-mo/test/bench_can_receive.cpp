@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Cost of the CAN receive path at full bus load.  Built with CAN_SOCKETCAN, the
+// module is included whole so the benchmark can set the signal table and call
+// the frame handler directly.
+#include "user_can.cpp"
+#include "HostTest.h"
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <time.h>
+
+static constexpr uint32_t BITRATE           {1000000};
+static constexpr size_t PGNS                {32};       // Parameter groups on the bus, half of them carry a signal
+static constexpr size_t FRAME_POOL          {4096};
+static constexpr double SOCKET_SECONDS      {5.0};
+static constexpr size_t SEND_BATCH          {64};
+
+void ioUpdateCanChannel(int, double) {}
+
+bool publishSubmit(PublishArbiter::Priority, const char*, const char*, bool) {
+    return true;
+}
+
+static double threadSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Sixteen J1939 style signals of mixed layout, each on its own parameter group from any source
+ *
+ */
+static void buildTable() {
+    auto table = canTable.edit([]() {});
+    *table = {};
+    table->settings = {true, CanBitrate::Kbps1000, true, 60};
+    for (size_t i = 0; i < CAN_SIGNAL_COUNT; i++) {
+        char text[CAN_SIGNAL_TEXT_LENGTH + 1];
+        snprintf(text, sizeof(text), "0x%lx,0x3ffff00,%u.%u,16,0.125,,x%s%s", (unsigned long)(0x18fe0000 + ((2 * i) << 8)),
+            (unsigned int)(i % 6), (i & 1) ? 7u : 0u, (i & 1) ? "m" : "", (i & 2) ? "s" : "n");
+        canParseSignal(text, table->signals[i]);
+    }
+    canTable.commit();
+}
+
+/**
+ * @brief Extended 8 byte frames spread over the parameter groups and source addresses
+ *
+ */
+static void buildFrames(std::vector<CanFrame>& frames) {
+    std::mt19937 rng(11);
+    for (size_t i = 0; i < FRAME_POOL; i++) {
+        CanFrame frame {(uint32_t)(0x18fe0000 + ((rng() % PGNS) << 8) + (rng() & 0xff)), true, 8, {}};
+        for (auto& byte : frame.data) {
+            byte = (uint8_t)rng();
+        }
+        frames.push_back(frame);
+    }
+}
+
+/**
+ * @brief Decode and aggregate a minute of frames at the full frame rate
+ *
+ */
+static void benchHandler(const std::vector<CanFrame>& frames, double frameRate) {
+    auto count = (size_t)(60.0 * frameRate);
+    const auto& table = *canTable.current();
+    canBusStats = {};
+    auto start = hostSeconds();
+    for (size_t i = 0; i < count; i++) {
+        canHandleFrame(table, frames[i % FRAME_POOL]);
+    }
+    auto seconds = hostSeconds() - start;
+
+    printf("  handler  %zu frames, %lu carry signals, %.1f ns per frame, %.2f%% of a core at full load\n", count,
+        (unsigned long)canBusStats.matched, seconds * 1e9 / count, 100.0 * seconds / 60.0);
+}
+
+/**
+ * @brief Send frames over vcan0 at the full frame rate while draining them the way the CAN thread does
+ *
+ */
+static void benchSocket(const std::vector<CanFrame>& frames, double frameRate) {
+    SocketCanTransport peer(CAN_SOCKET_INTERFACE);
+    CanFilterPlan everything;
+    canPlanFilters(nullptr, 0, everything);
+    if (!peer.begin(0, false, everything) || !canStart(*canTable.current())) {
+        printf("  socket   skipped, %s is not up\n", CAN_SOCKET_INTERFACE);
+        return;
+    }
+
+    std::atomic<bool> done {false};
+    size_t sent = 0;
+    std::thread bus([&]() {
+        using clock = std::chrono::steady_clock;
+        auto total = (size_t)(SOCKET_SECONDS * frameRate);
+        auto start = clock::now();
+        while (sent < total) {
+            for (size_t i = 0; (i < SEND_BATCH) && (sent < total); i++, sent++) {
+                peer.send(frames[sent % FRAME_POOL]);
+            }
+            std::this_thread::sleep_until(start + std::chrono::duration<double>(sent / frameRate));
+        }
+        done = true;
+    });
+
+    const auto& table = *canTable.current();
+    canBusStats = {};
+    canBus.takeOverruns();
+    auto cpu = threadSeconds();
+    CanFrame frame;
+    for (auto idle = false; !(done && idle); ) {
+        canBus.wait(10);
+        idle = true;
+        while (canBus.receive(frame)) {
+            canHandleFrame(table, frame);
+            idle = false;
+        }
+    }
+    cpu = threadSeconds() - cpu;
+    bus.join();
+
+    printf("  socket   %zu frames sent, %lu passed the filters, %lu dropped, receive thread %.2f%% of a core\n", sent,
+        (unsigned long)canBusStats.received, (unsigned long)canBus.takeOverruns(), 100.0 * cpu / SOCKET_SECONDS);
+}
+
+/**
+ * @brief Receive path cost with 16 signals at 1 Mbit/s, in memory and through vcan0 when it is up
+ *
+ */
+int main() {
+    std::vector<CanFrame> frames;
+    buildFrames(frames);
+    buildTable();
+    auto frameRate = (double)BITRATE / canFrameBits(frames[0]);
+
+    printf("bench_can_receive: %u signals, %.0f frames/s at %lu bit/s without stuff bits\n", (unsigned int)CAN_SIGNAL_COUNT,
+        frameRate, (unsigned long)BITRATE);
+    benchHandler(frames, frameRate);
+    benchSocket(frames, frameRate);
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FilterBank.h"
+#include "HostTest.h"
+
+#include <random>
+
+static constexpr float SAMPLE_HZ {100.0f};  // Matches ANALOG_SAMPLE_HZ in user_io.cpp
+static constexpr size_t INPUT_LENGTH {4096};
+static constexpr size_t SAMPLES {20000000};
+
+static float input[INPUT_LENGTH];
+
+/**
+ * @brief Time FilterBank::process over the same input for one set of settings
+ *
+ * @param label Name printed for the case
+ * @param settings Stages to enable, the rest are bypassed
+ */
+static void run(const char* label, const FilterBankSettings& settings) {
+    FilterBank filter;
+    filter.configure(SAMPLE_HZ, settings);
+
+    size_t outputs = 0;
+    double sum = 0.0;
+    auto start = hostSeconds();
+    for (size_t n = 0; n < SAMPLES; n++) {
+        float y;
+        if (filter.process(input[n % INPUT_LENGTH], y)) {
+            outputs++;
+            sum += (double)y;
+        }
+    }
+    auto elapsed = hostSeconds() - start;
+
+    std::printf("bench_filter_bank: %-10s %6.2f ns per sample, %zu outputs, checksum %g\n",
+        label, elapsed * 1e9 / SAMPLES, outputs, sum);
+}
+
+/**
+ * @brief Time each filter stage alone and the full chain at the 100 Hz sample rate
+ *
+ * @details The input is a slow ramp with mains pickup, noise and an occasional spike, close to
+ *          what the analog inputs see, so the median does real sorting work.
+ */
+int main() {
+    std::mt19937 random(3);
+    std::normal_distribution<float> noise(0.0f, 0.05f);
+    for (size_t n = 0; n < INPUT_LENGTH; n++) {
+        input[n] = 5.0f + 2.0f * (float)n / INPUT_LENGTH + 0.5f * (float)std::sin(2.0 * M_PI * 50.0 * n / SAMPLE_HZ + 0.3) +
+            noise(random) + ((0 == (random() % 97)) ? 10.0f : 0.0f);
+    }
+
+    FilterBankSettings bypass;
+    run("bypass", bypass);
+
+    auto median = bypass;
+    median.median = (int32_t)MedianFilter::MAX_WINDOW;
+    run("median", median);
+
+    auto notch = bypass;
+    notch.notchHz = 60.0;       // Folds to 40 Hz at this rate, 50 Hz would sit on Nyquist
+    notch.notchQ = 5.0;
+    run("notch", notch);
+
+    auto lowPass = bypass;
+    lowPass.lowPassHz = 5.0;
+    run("low-pass", lowPass);
+
+    auto cic = bypass;
+    cic.decimate = 10;
+    cic.cicOrder = (int32_t)CicDecimator::MAX_ORDER;
+    run("cic", cic);
+
+    FilterBankSettings chain;
+    chain.median = median.median;
+    chain.notchHz = notch.notchHz;
+    chain.notchQ = notch.notchQ;
+    chain.lowPassHz = lowPass.lowPassHz;
+    chain.decimate = cic.decimate;
+    chain.cicOrder = cic.cicOrder;
+    run("chain", chain);
+    return 0;
+}
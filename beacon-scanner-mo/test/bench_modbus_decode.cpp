@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "ModbusDecode.h"
+#include "HostTest.h"
+
+#include <random>
+
+static constexpr size_t POINTS {131};       // Matches MODBUS_POINT_COUNT in user_modbus.cpp
+static constexpr size_t PASSES {20000};
+
+enum class Kind : uint8_t {
+    Int16,
+    Uint32,
+    Float32,
+    Int64,
+    Float64,
+    Bcd32,
+};
+
+struct Point {
+    Kind kind;
+    ModbusDecoder decode;
+    ModbusDecoding decoding;
+    uint16_t first;                         // First register of the point in the read buffer
+};
+
+/**
+ * @brief The per poll switch on the point type that the decoder table replaced
+ *
+ */
+static bool decodeBySwitch(const Point& point, const uint16_t* words, double& value) {
+    switch (point.kind) {
+        case Kind::Int16:   return modbusDecodeInt16(words, point.decoding, value);
+        case Kind::Uint32:  return modbusDecodeUint32(words, point.decoding, value);
+        case Kind::Float32: return modbusDecodeFloat32(words, point.decoding, value);
+        case Kind::Int64:   return modbusDecodeInt64(words, point.decoding, value);
+        case Kind::Float64: return modbusDecodeFloat64(words, point.decoding, value);
+        case Kind::Bcd32:   return modbusDecodeBcd32(words, point.decoding, value);
+    }
+    return false;
+}
+
+/**
+ * @brief Decode a full point table of mixed types and byte orders from one block of registers
+ *
+ */
+int main() {
+    static constexpr ModbusDecoder decoders[] {
+        modbusDecodeInt16, modbusDecodeUint32, modbusDecodeFloat32, modbusDecodeInt64, modbusDecodeFloat64, modbusDecodeBcd32,
+    };
+    static constexpr uint16_t widths[] {1, 2, 2, 4, 4, 2};
+
+    std::mt19937 rng(3);
+    static Point points[POINTS];
+    uint16_t next = 0;
+    for (size_t i = 0; i < POINTS; i++) {
+        auto kind = rng() % 6;
+        points[i].kind = (Kind)kind;
+        points[i].decode = decoders[kind];
+        points[i].decoding.order = (ModbusByteOrder)(rng() % 4);
+        modbusDeriveSign(points[i].decoding);
+        points[i].first = next;
+        next += widths[kind];
+    }
+    static uint16_t registers[POINTS * 4];
+    for (auto& word : registers) {
+        word = (uint16_t)rng();
+    }
+
+    volatile double sink = 0.0;
+    size_t valid = 0;
+    auto start = hostSeconds();
+    for (size_t pass = 0; pass < PASSES; pass++) {
+        for (auto& point : points) {
+            double value;
+            if (point.decode(&registers[point.first], point.decoding, value)) {
+                sink = sink + value;
+                valid++;
+            }
+        }
+    }
+    auto table = hostSeconds() - start;
+
+    start = hostSeconds();
+    for (size_t pass = 0; pass < PASSES; pass++) {
+        for (auto& point : points) {
+            double value;
+            if (decodeBySwitch(point, &registers[point.first], value)) {
+                sink = sink + value;
+                valid++;
+            }
+        }
+    }
+    auto switched = hostSeconds() - start;
+
+    auto values = (double)(PASSES * POINTS);
+    std::printf("bench_modbus_decode: %zu points of mixed types, decoder table %.1f ns, type switch %.1f ns per value (%zu valid)\n",
+        POINTS, table * 1e9 / values, switched * 1e9 / values, valid);
+    return 0;
+}
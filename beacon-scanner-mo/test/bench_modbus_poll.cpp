@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Runs the real poll thread against the simulated RS-485 bus on a simulated
+// clock.  The module is included whole so the benchmark can set points and
+// read the bus counters that are private to it.
+#include "user_modbus.cpp"
+
+static constexpr uint64_t RUN_SECONDS           {60};
+static constexpr uint8_t SLAVES                 {4};
+static constexpr uint32_t TURNAROUND_US         {3000};
+static constexpr uint32_t TURNAROUND_JITTER_US  {2000};
+
+// Poll lateness summed over the bus statistics the thread publishes each second
+static uint64_t lateness[MODBUS_JITTER_BUCKETS];
+
+// Modules the poll thread reports to, not part of what is measured
+void ioUpdateModbusChannel(int, double) {}
+bool modbusSlaveOwnsRs485() {return false;}
+void modbusSlaveServeRs485(unsigned int, unsigned int) {}
+
+bool publishSubmit(PublishArbiter::Priority, const char* name, const char* data, bool) {
+    static constexpr char JITTER_KEY[] {"\"jit\":["};
+    auto jitter = strstr(data, JITTER_KEY);
+    if ((0 == strcmp(name, "modbus")) && jitter) {
+        auto cursor = jitter + strlen(JITTER_KEY);
+        for (auto& n : lateness) {
+            char* end;
+            n += strtoul(cursor, &end, 10);
+            cursor = end + 1;
+        }
+    }
+    return true;
+}
+
+struct BaudSetting {
+    uint32_t baud;
+    ModbusBaudRates setting;
+};
+
+/**
+ * @brief Poll a table of holding registers spread over four slaves for a simulated minute
+ *
+ * @details Every fourth point polls at 250 ms and the rest at 1 s.  Half of the
+ *          registers sit next to each other on their slave so block reads can merge them.
+ *
+ * @param baud Line speed
+ * @param count Number of points
+ */
+static void run(const BaudSetting& baud, size_t count) {
+    modbusSimulator = ModbusSimulator();
+    for (uint8_t id = 1; id <= SLAVES; id++) {
+        modbusSimulator.addSlave(id, TURNAROUND_US, TURNAROUND_JITTER_US);
+    }
+    modbusSimulator.setGenerator([](uint8_t id, ModbusSimulator::Table, uint16_t address) {
+        return (uint16_t)(address + id + millis() / 1000);
+    });
+    modbusRtuSettings = {baud.setting, ModbusParity::None};
+    modbusChangeInterfaceSettings(modbusRtuSettings);
+
+    busStats = {};
+    threadStats = {};
+    memset(modbusPointCounters, 0, sizeof(modbusPointCounters));
+    memset(lateness, 0, sizeof(lateness));
+    resultsToPublish.clear();
+
+    double target = 0.0;
+    for (size_t i = 0; i < MODBUS_POINT_COUNT - MODBUS_CLIENT_COUNT; i++) {
+        ModbusPoint point {};
+        if (i < count) {
+            auto pollMs = (0 == (i % 4)) ? 250u : 1000u;
+            auto spacing = ((i % 8) < 4) ? 1u : 10u;
+            char text[MODBUS_POINT_TEXT_LENGTH + 1];
+            snprintf(text, sizeof(text), "%u,hr,%u,uint16,%ums", (unsigned)(1 + i % SLAVES), (unsigned)(100 + (i / 4) * spacing), pollMs);
+            modbusParsePoint(text, point);
+            target += 1000.0 / pollMs;
+        }
+        modbusCommitPoints(MODBUS_CLIENT_COUNT + i, &point, 1);
+    }
+
+    auto busUs = modbusSimulator.getBusUs();
+    hostResetClock(RUN_SECONDS * 1000000);
+    try {
+        modbusThreadLoop(nullptr);
+    } catch (const HostDeadline&) {
+    }
+    busUs = modbusSimulator.getBusUs() - busUs;
+
+    uint64_t polls = 0;
+    uint32_t lagMaxMs = 0;
+    for (const auto& counters : modbusPointCounters) {
+        polls += counters.polls;
+        lagMaxMs = max(lagMaxMs, counters.lagMaxMs);
+    }
+    // Counts since the last bus statistics publish, all of them when results never drained
+    uint64_t late = 0;
+    for (size_t i = 0; i < MODBUS_JITTER_BUCKETS; i++) {
+        lateness[i] += busStats.jitter[i];
+        late += lateness[i];
+    }
+
+    printf("%7lu %5zu %9.1f %9.1f %6.1f %8lu ", (unsigned long)baud.baud, count, (double)polls / RUN_SECONDS, target,
+        100.0 * busUs / (RUN_SECONDS * 1000000), (unsigned long)lagMaxMs);
+    for (auto n : lateness) {
+        printf(" %5.1f%%", (late) ? 100.0 * n / late : 0.0);
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Poll rate, bus utilization and poll lateness across line speeds and table sizes
+ *
+ * @details The optional argument sets the inter-message delay in milliseconds.
+ */
+int main(int argc, char** argv) {
+    static constexpr BaudSetting bauds[] {
+        {9600, ModbusBaudRates::Baud9600},
+        {38400, ModbusBaudRates::Baud38400},
+        {115200, ModbusBaudRates::Baud115200},
+    };
+    static constexpr size_t counts[] {8, 32, 128};
+
+    modbusInterMessageDelay = (argc > 1) ? atoi(argv[1]) : 0;
+
+    printf("Simulated Modbus polling, %lu s per run, inter-message delay %ld ms\n", (unsigned long)RUN_SECONDS, (long)modbusInterMessageDelay);
+    printf("%7s %5s %9s %9s %6s %8s  late <5/20/50/100/250/1000/more ms\n", "baud", "points", "polls/s", "target/s", "util%", "lagmax");
+    for (const auto& baud : bauds) {
+        for (auto count : counts) {
+            run(baud, count);
+        }
+    }
+    return 0;
+}
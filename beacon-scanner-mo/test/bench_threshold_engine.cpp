@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "ThresholdEngine.h"
+#include "HostTest.h"
+
+static constexpr size_t RULE_COUNT {64};
+static constexpr size_t CHANNEL_COUNT {16};
+static constexpr size_t SAMPLES {2000000};
+
+static size_t changes {0};
+
+static void onRule(const ThresholdRule&, bool) {
+    changes++;
+}
+
+/**
+ * @brief Time the evaluation of 64 rules per sample
+ *
+ * @details Rules are spread over sixteen channels carrying slow ramps so that rules change
+ *          state now and then, the way they do on a real input, rather than on every sample.
+ */
+int main() {
+    static ThresholdRule rules[RULE_COUNT];
+    for (size_t i = 0; i < RULE_COUNT; i++) {
+        auto& rule = rules[i];
+        rule.active = true;
+        rule.enabled = true;
+        rule.reportClear = (i & 1);
+        rule.channel = (uint16_t)(i % CHANNEL_COUNT);
+        rule.direction = (i & 2) ? ThresholdDirection::Below : ThresholdDirection::Above;
+        rule.threshold = (float)(i % 7) * 10.0f + 5.0f;
+        rule.hysteresis = 1.0f;
+        rule.setEvent("bench");
+    }
+    ThresholdEngine engine(rules, RULE_COUNT, onRule);
+
+    float channels[CHANNEL_COUNT];
+    auto start = hostSeconds();
+    for (size_t n = 0; n < SAMPLES; n++) {
+        for (size_t c = 0; c < CHANNEL_COUNT; c++) {
+            channels[c] = (float)((n / 64 + c * 37) % 80);
+        }
+        engine.evaluate(channels, CHANNEL_COUNT);
+    }
+    auto elapsed = hostSeconds() - start;
+
+    std::printf("bench_threshold_engine: %zu rules, %.1f ns per sample, %.2f ns per rule, %zu state changes\n",
+        RULE_COUNT, elapsed * 1e9 / SAMPLES, elapsed * 1e9 / (SAMPLES * RULE_COUNT), changes);
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "TimeSeriesCodec.h"
+#include "HostTest.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+static constexpr size_t BLOCK_BYTES {240};      // Matches TIME_SERIES_BLOCK_BYTES in user_timeseries.cpp
+static constexpr size_t SAMPLES {20000};
+
+struct Sample {
+    uint32_t time;
+    float value;
+};
+
+/**
+ * @brief Report the compression ratio and coding cost of one series
+ *
+ * @details The ratio is against eight bytes per sample, a raw timestamp and float.
+ */
+static bool bench(const char* name, const std::vector<Sample>& samples) {
+    static uint8_t block[BLOCK_BYTES];
+    size_t bytes = 0, blocks = 0, mismatches = 0;
+    double encodeSeconds = 0.0, decodeSeconds = 0.0;
+
+    size_t i = 0;
+    while (i < samples.size()) {
+        TimeSeriesEncoder encoder;
+        auto first = i;
+        auto start = hostSeconds();
+        encoder.begin(block, sizeof(block));
+        while ((i < samples.size()) && encoder.append(samples[i].time, samples[i].value)) {
+            i++;
+        }
+        encodeSeconds += hostSeconds() - start;
+        bytes += encoder.getBytes();
+        blocks++;
+
+        TimeSeriesDecoder decoder;
+        uint32_t times[BLOCK_BYTES * 8];
+        float values[BLOCK_BYTES * 8];
+        size_t count = 0;
+        start = hostSeconds();
+        decoder.begin(block, encoder.getBytes(), encoder.getCount());
+        while (decoder.next(times[count], values[count])) {
+            count++;
+        }
+        decodeSeconds += hostSeconds() - start;
+
+        mismatches += (count != (i - first));
+        for (size_t k = 0; (k < count) && (first + k < i); k++) {
+            mismatches += (times[k] != samples[first + k].time) || (0 != memcmp(&values[k], &samples[first + k].value, sizeof(float)));
+        }
+    }
+
+    std::printf("  %-28s %5zu blocks  ratio %5.2fx  %5.2f bits/sample  encode %5.1f ns  decode %5.1f ns per sample%s\n",
+        name, blocks, (double)(samples.size() * 8) / bytes, bytes * 8.0 / samples.size(),
+        encodeSeconds * 1e9 / samples.size(), decodeSeconds * 1e9 / samples.size(),
+        mismatches ? "  MISMATCH" : "");
+    return 0 == mismatches;
+}
+
+/**
+ * @brief Series shaped like the readings the device records at one second intervals
+ *
+ */
+int main() {
+    std::mt19937 rng(1);
+    std::normal_distribution<float> jitter(0.0f, 3.0f), noise(0.0f, 0.02f);
+    std::uniform_real_distribution<float> uniform(0.0f, 100.0f);
+    std::vector<Sample> volts, amps, scaled, energy, random;
+
+    uint32_t time = 1000;
+    float voltage = 24.0f;
+    for (size_t k = 0; k < SAMPLES; k++) {
+        time += 1000 + (int)jitter(rng);
+        voltage += noise(rng) * 0.2f;
+        volts.push_back({time, std::round(voltage * 1000.0f) / 1000.0f});
+        amps.push_back({time, std::round((12.0f + noise(rng)) * 1000.0f) / 1000.0f});
+        scaled.push_back({time, (float)(int)(2300 + 5 * std::sin(k / 300.0)) * 0.1f});
+        energy.push_back({time, (float)(123456 + k / 36)});
+        random.push_back({time, uniform(rng)});
+    }
+
+    std::printf("bench_time_series_codec: %zu samples per series, %zu byte blocks\n", SAMPLES, BLOCK_BYTES);
+    auto ok = bench("io_v 24 V drift, 1 mV", volts);
+    ok &= bench("io_a 12 mA noise, 1 uA", amps);
+    ok &= bench("modbus 0.1 scaled voltage", scaled);
+    ok &= bench("modbus energy counter", energy);
+    ok &= bench("uniform random", random);
+    return ok ? 0 : 1;
+}
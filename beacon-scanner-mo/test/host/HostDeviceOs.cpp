@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "Particle.h"
+
+static uint64_t nowUs {0};
+static uint64_t deadlineUs {UINT64_MAX};
+
+// Time the poll thread is charged every time it yields the processor
+static constexpr uint64_t HOST_YIELD_US     {10};
+
+USARTSerial Serial1;
+USBSerial Serial;
+CloudClass Particle;
+SystemClass System;
+
+uint64_t hostNowUs() {
+    return nowUs;
+}
+
+void hostAdvanceUs(uint64_t us) {
+    nowUs += us;
+}
+
+void hostResetClock(uint64_t deadline) {
+    nowUs = 0;
+    deadlineUs = deadline;
+}
+
+static void hostCheckDeadline() {
+    if (nowUs > deadlineUs) {
+        throw HostDeadline {};
+    }
+}
+
+int os_semaphore_create(os_semaphore_t* semaphore, unsigned, unsigned) {
+    static int token;
+    *semaphore = &token;
+    return 0;
+}
+
+// Nothing else runs while the thread sleeps, so waiting always takes the full timeout
+int os_semaphore_take(os_semaphore_t, system_tick_t timeout, bool) {
+    if (CONCURRENT_WAIT_FOREVER == timeout) {
+        throw HostDeadline {};
+    }
+    hostAdvanceUs((uint64_t)timeout * 1000);
+    hostCheckDeadline();
+    return 0;
+}
+
+int os_semaphore_give(os_semaphore_t, bool) {
+    return 0;
+}
+
+void os_thread_yield() {
+    hostAdvanceUs(HOST_YIELD_US);
+    hostCheckDeadline();
+}
+
+os_thread_t os_thread_current(void*) {
+    return nullptr;
+}
+
+os_result_t os_thread_dump(os_thread_t, os_thread_dump_callback_t, void*) {
+    return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Thrown from the RTOS shims once the simulated clock passes the deadline
+ *
+ * Firmware thread loops never return, so a host run ends by unwinding out of them.
+ */
+struct HostDeadline {};
+
+/**
+ * @brief Current simulated time
+ *
+ * @return uint64_t Microseconds since the clock was last reset
+ */
+uint64_t hostNowUs();
+
+/**
+ * @brief Move the simulated clock forward
+ *
+ * @param us Microseconds to advance
+ */
+void hostAdvanceUs(uint64_t us);
+
+/**
+ * @brief Restart the simulated clock at zero and set when blocking calls give up
+ *
+ * @param deadlineUs Simulated time after which blocking RTOS calls throw HostDeadline
+ */
+void hostResetClock(uint64_t deadlineUs);
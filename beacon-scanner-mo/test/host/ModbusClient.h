@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+// Modbus RTU client with scripted answers. Every request gives the same result
+// and takes the set latency on the simulated clock, or the response timeout
+// when it times out, and the timeout it waited with is recorded.
+
+#include "Particle.h"
+#include "HostDeviceOs.h"
+
+#include <vector>
+
+struct ModbusClientContext {
+    uint16_t readBuffer[64];
+    uint16_t writeBuffer[64];
+};
+
+class ModbusClient {
+public:
+    static constexpr uint8_t ku8MBSuccess               {0x00};
+    static constexpr uint8_t ku8MBIllegalFunction       {0x01};
+    static constexpr uint8_t ku8MBIllegalDataAddress    {0x02};
+    static constexpr uint8_t ku8MBIllegalDataValue      {0x03};
+    static constexpr uint8_t ku8MBSlaveDeviceFailure    {0x04};
+    static constexpr uint8_t ku8MBInvalidSlaveID        {0xE0};
+    static constexpr uint8_t ku8MBInvalidFunction       {0xE1};
+    static constexpr uint8_t ku8MBResponseTimedOut      {0xE2};
+    static constexpr uint8_t ku8MBInvalidCRC            {0xE3};
+
+    void begin(Stream&) {}
+    void preTransmission(void (*)()) {}
+    void postTransmission(void (*)()) {}
+    void idle(void (*)()) {}
+    void setResponseTimeout(uint32_t timeout) {responseTimeout = timeout;}
+
+    uint8_t readCoils(uint8_t, uint16_t, uint16_t, ModbusClientContext&) {return answer();}
+    uint8_t readDiscreteInputs(uint8_t, uint16_t, uint16_t, ModbusClientContext&) {return answer();}
+    uint8_t readHoldingRegisters(uint8_t, uint16_t, uint16_t, ModbusClientContext&) {return answer();}
+    uint8_t readInputRegisters(uint8_t, uint16_t, uint16_t, ModbusClientContext&) {return answer();}
+    uint8_t writeSingleCoil(uint8_t, uint16_t, uint8_t, ModbusClientContext&) {return answer();}
+    uint8_t writeSingleRegister(uint8_t, uint16_t, uint16_t, ModbusClientContext&) {return answer();}
+    uint8_t writeMultipleCoils(uint8_t, uint16_t, uint16_t, ModbusClientContext&) {return answer();}
+    uint8_t writeMultipleRegisters(uint8_t, uint16_t, uint16_t, ModbusClientContext&) {return answer();}
+
+    uint32_t responseTimeout {2000};
+    uint8_t hostResult {ku8MBResponseTimedOut};
+    uint32_t hostLatencyUs {0};
+    std::vector<uint32_t> hostTimeouts;
+
+private:
+    uint8_t answer() {
+        hostTimeouts.push_back(responseTimeout);
+        hostAdvanceUs((ku8MBResponseTimedOut == hostResult) ? 1000ULL * responseTimeout : hostLatencyUs);
+        return hostResult;
+    }
+};
@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+// Just enough of the Device OS API to build the Modbus, CAN and Modbus slave
+// modules on a host. Time comes from the simulated clock in HostDeviceOs.h so
+// that polling runs faster than real time.
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+
+#include "HostDeviceOs.h"
+
+template <typename A, typename B>
+constexpr typename std::common_type<A, B>::type min(A a, B b) {return (a < b) ? a : b;}
+template <typename A, typename B>
+constexpr typename std::common_type<A, B>::type max(A a, B b) {return (a > b) ? a : b;}
+
+typedef uint32_t system_tick_t;
+typedef uint16_t pin_t;
+
+enum {
+    D0, D1, D2, D3, D4, D5, D6, D7,
+    A0, A1, A2, A3, A4, A5, A6, A7,
+};
+
+enum {
+    SYSTEM_ERROR_NONE               = 0,
+    SYSTEM_ERROR_BUSY               = -110,
+    SYSTEM_ERROR_NOT_SUPPORTED      = -120,
+    SYSTEM_ERROR_TIMEOUT            = -160,
+    SYSTEM_ERROR_INVALID_STATE      = -210,
+    SYSTEM_ERROR_NO_MEMORY          = -260,
+    SYSTEM_ERROR_NOT_FOUND          = -270,
+    SYSTEM_ERROR_LIMIT_EXCEEDED     = -280,
+    SYSTEM_ERROR_TOO_LARGE          = -290,
+    SYSTEM_ERROR_INVALID_ARGUMENT   = -300,
+};
+
+#define SERIAL_DATA_BITS_8      (0x0000)
+#define SERIAL_STOP_BITS_1      (0x0000)
+#define SERIAL_STOP_BITS_2      (0x0010)
+#define SERIAL_PARITY_NO        (0x0000)
+#define SERIAL_PARITY_EVEN      (0x0004)
+#define SERIAL_PARITY_ODD       (0x0008)
+
+inline uint32_t millis() {return (uint32_t)(hostNowUs() / 1000);}
+inline uint32_t micros() {return (uint32_t)hostNowUs();}
+inline void delay(uint32_t ms) {hostAdvanceUs((uint64_t)ms * 1000);}
+inline void delayMicroseconds(uint32_t us) {hostAdvanceUs(us);}
+inline void digitalWrite(pin_t, uint8_t) {}
+
+class String {
+public:
+    String(const char* s = "") : text_(s) {}
+    const char* c_str() const {return text_;}
+private:
+    const char* text_;
+};
+
+class Logger {
+public:
+    explicit Logger(const char*) {}
+    template <typename... Args> void trace(const char*, Args...) const {}
+    template <typename... Args> void info(const char*, Args...) const {}
+    template <typename... Args> void warn(const char*, Args...) const {}
+    template <typename... Args> void error(const char*, Args...) const {}
+};
+
+class Stream {
+public:
+    virtual ~Stream() = default;
+    virtual int available() {return 0;}
+    virtual int read() {return -1;}
+    virtual int peek() {return -1;}
+    virtual size_t write(uint8_t) {return 1;}
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while ((n < size) && write(buffer[n])) {
+            n++;
+        }
+        return n;
+    }
+    virtual void flush() {}
+};
+
+class USARTSerial : public Stream {
+public:
+    void begin(unsigned long, uint32_t = 0) {}
+    void end() {}
+    int availableForWrite() {return 64;}
+};
+
+class USBSerial : public Stream {
+public:
+    void begin(unsigned long = 0) {}
+    bool isConnected() {return true;}
+};
+
+extern USARTSerial Serial1;
+extern USBSerial Serial;
+
+class LogHandler {};
+
+class SerialLogHandler : public LogHandler {
+public:
+    template <typename... Args> SerialLogHandler(Args...) {}
+};
+
+class LogManager {
+public:
+    static LogManager* instance() {
+        static LogManager manager;
+        return &manager;
+    }
+    bool addHandler(LogHandler*) {return true;}
+    void removeHandler(LogHandler*) {}
+};
+
+class JSONWriter {
+public:
+    virtual ~JSONWriter() = default;
+
+    JSONWriter& beginObject() {return open('{');}
+    JSONWriter& endObject() {return close('}');}
+    JSONWriter& beginArray() {return open('[');}
+    JSONWriter& endArray() {return close(']');}
+
+    JSONWriter& name(const char* name) {
+        quoted(name);
+        write(':');
+        named_ = true;
+        return *this;
+    }
+
+    JSONWriter& nullValue() {return text("null");}
+    JSONWriter& value(bool value) {return text((value) ? "true" : "false");}
+    JSONWriter& value(int value) {return print("%d", value);}
+    JSONWriter& value(unsigned int value) {return print("%u", value);}
+    JSONWriter& value(long value) {return print("%ld", value);}
+    JSONWriter& value(unsigned long value) {return print("%lu", value);}
+    JSONWriter& value(long long value) {return print("%lld", value);}
+    JSONWriter& value(unsigned long long value) {return print("%llu", value);}
+    JSONWriter& value(double value) {return print("%g", value);}
+    JSONWriter& value(double value, int precision) {return print("%.*f", precision, value);}
+    JSONWriter& value(const char* value) {
+        quoted(value);
+        return *this;
+    }
+
+protected:
+    virtual void write(const char* data, size_t size) = 0;
+
+private:
+    static constexpr size_t DEPTH   {16};
+
+    void write(char c) {
+        write(&c, 1);
+    }
+
+    // Every element but the first in an object or array follows a comma
+    void separate() {
+        if (named_) {
+            named_ = false;
+        } else if (!first_[depth_]) {
+            write(',');
+        }
+        first_[depth_] = false;
+    }
+
+    JSONWriter& open(char c) {
+        separate();
+        write(c);
+        first_[++depth_] = true;
+        return *this;
+    }
+
+    JSONWriter& close(char c) {
+        depth_--;
+        write(c);
+        return *this;
+    }
+
+    JSONWriter& text(const char* text) {
+        separate();
+        write(text, strlen(text));
+        return *this;
+    }
+
+    template <typename... Args>
+    JSONWriter& print(const char* format, Args... args) {
+        char text[32];
+        snprintf(text, sizeof(text), format, args...);
+        return this->text(text);
+    }
+
+    void quoted(const char* text) {
+        separate();
+        write('"');
+        for (; *text; text++) {
+            if (('"' == *text) || ('\\' == *text)) {
+                write('\\');
+            }
+            write(*text);
+        }
+        write('"');
+    }
+
+    bool first_[DEPTH] {true};
+    size_t depth_ {0};
+    bool named_ {false};
+};
+
+// Writes as much as fits and keeps counting past the end, as Device OS does
+class JSONBufferWriter : public JSONWriter {
+public:
+    JSONBufferWriter(char* buffer, size_t size) : buffer_(buffer), size_(size) {}
+
+    char* buffer() const {return buffer_;}
+    size_t bufferSize() const {return size_;}
+    size_t dataSize() const {return count_;}
+
+protected:
+    void write(const char* data, size_t size) override {
+        for (size_t i = 0; i < size; i++, count_++) {
+            if (count_ < size_) {
+                buffer_[count_] = data[i];
+            }
+        }
+        if (count_ < size_) {
+            buffer_[count_] = '\0';
+        }
+    }
+
+private:
+    char* buffer_;
+    size_t size_;
+    size_t count_ {0};
+};
+
+class RecursiveMutex : public std::recursive_mutex {};
+class Mutex : public std::mutex {};
+
+class CloudClass {
+public:
+    template <typename... Args> bool variable(Args...) {return true;}
+    template <typename... Args> bool function(Args...) {return true;}
+    bool connected() {return true;}
+};
+
+extern CloudClass Particle;
+
+class SystemClass {
+public:
+    uint32_t uptime() {return millis() / 1000;}
+};
+
+extern SystemClass System;
+
+// The RTOS calls in the poll loop are where the simulated clock moves and
+// where a host run that passed its deadline unwinds
+typedef void* os_thread_t;
+typedef void* os_semaphore_t;
+typedef int os_result_t;
+
+constexpr int OS_THREAD_PRIORITY_DEFAULT            {2};
+constexpr system_tick_t CONCURRENT_WAIT_FOREVER     {(system_tick_t)-1};
+
+typedef struct {
+    size_t size;
+    os_thread_t thread;
+    const char* name;
+    size_t stack_high_watermark;
+} os_thread_dump_info_t;
+
+typedef os_result_t (*os_thread_dump_callback_t)(os_thread_dump_info_t*, void*);
+
+int os_semaphore_create(os_semaphore_t* semaphore, unsigned max, unsigned initial);
+int os_semaphore_take(os_semaphore_t semaphore, system_tick_t timeout, bool reserved);
+int os_semaphore_give(os_semaphore_t semaphore, bool reserved);
+void os_thread_yield();
+os_thread_t os_thread_current(void* reserved);
+os_result_t os_thread_dump(os_thread_t thread, os_thread_dump_callback_t callback, void* data);
+
+class Thread {
+public:
+    Thread(const char*, void (*)(void*), void*, int, size_t) {}
+};
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+// Configuration nodes that accept the firmware's schema and store nothing.
+// Host programs set module state directly rather than through the cloud schema.
+
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+
+class ConfigNode {};
+
+#define HOST_CONFIG_NODE(type) \
+    class type : public ConfigNode { \
+    public: \
+        template <typename... Args> type(const char*, Args&&...) {} \
+    }
+
+HOST_CONFIG_NODE(ConfigBool);
+HOST_CONFIG_NODE(ConfigInt);
+HOST_CONFIG_NODE(ConfigFloat);
+HOST_CONFIG_NODE(ConfigString);
+
+class ConfigStringEnum : public ConfigNode {
+public:
+    template <typename... Args>
+    ConfigStringEnum(const char*, std::initializer_list<std::pair<const char*, int32_t>>, Args&&...) {}
+};
+
+class ConfigObject : public ConfigNode {
+public:
+    template <typename... Args>
+    ConfigObject(const char*, std::initializer_list<ConfigNode>, Args&&...) {}
+};
+
+class ConfigService {
+public:
+    static ConfigService& instance() {
+        static ConfigService service;
+        return service;
+    }
+    int registerModule(ConfigObject&) {return 0;}
+};
+
+inline int config_get_bool_cb(bool&, const void*) {return 0;}
+inline int config_set_bool_cb(bool, const void*) {return 0;}
+inline int config_get_int32_cb(int32_t&, const void*) {return 0;}
+inline int config_set_int32_cb(int32_t, const void*) {return 0;}
+inline int config_get_float_cb(double&, const void*) {return 0;}
+inline int config_set_float_cb(double, const void*) {return 0;}
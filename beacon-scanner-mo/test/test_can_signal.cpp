@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include "CanSignal.h"
+#include "HostTest.h"
+
+#include <initializer_list>
+#include <random>
+
+static constexpr size_t CAN_FILTER_TRIAL_MAX    {16};   // Matches CAN_SIGNAL_COUNT in user_config.h
+
+/**
+ * @brief Whether an MCP2515 with the planned filters takes a frame into either receive buffer
+ *
+ */
+static bool controllerPasses(const CanFilterPlan& plan, const CanFrame& frame) {
+    auto layout = (frame.extended) ? frame.id : (frame.id << 18);
+    for (size_t i = 0; i < CanFilterPlan::FILTERS; i++) {
+        auto& filter = plan.filters[i];
+        auto mask = plan.masks[(i < 2) ? 0 : 1];
+        if ((filter.extended == frame.extended) && (0 == ((layout ^ filter.id) & mask))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool filterPasses(const CanFilter& filter, const CanFrame& frame) {
+    return (filter.extended == frame.extended) && (0 == ((frame.id ^ filter.id) & filter.mask));
+}
+
+static CanFrame frameOf(uint32_t id, bool extended, std::initializer_list<uint8_t> data = {}) {
+    CanFrame frame {id, extended, (uint8_t)data.size(), {}};
+    size_t i = 0;
+    for (auto byte : data) {
+        frame.data[i++] = byte;
+    }
+    return frame;
+}
+
+static CanSignal signalAt(uint8_t byte, uint8_t bit, uint8_t bits, bool motorola = false, bool isSigned = false) {
+    CanSignal signal;
+    signal.byte = byte;
+    signal.bit = bit;
+    signal.bits = bits;
+    signal.motorola = motorola;
+    signal.isSigned = isSigned;
+    return signal;
+}
+
+/**
+ * @brief Positions, frame lengths and value masks derived from the signal layout
+ *
+ */
+static void testDerive() {
+    auto intel = signalAt(1, 0, 16);
+    CHECK(canDeriveSignal(intel));
+    CHECK_EQ(intel.shift, 8);
+    CHECK_EQ(intel.length, 3);
+    CHECK_EQ(intel.valueMask, 0xffffull);
+
+    auto motorola = signalAt(0, 7, 16, true);
+    CHECK(canDeriveSignal(motorola));
+    CHECK_EQ(motorola.shift, 48);
+    CHECK_EQ(motorola.length, 2);
+
+    auto whole = signalAt(0, 0, 64);
+    CHECK(canDeriveSignal(whole));
+    CHECK_EQ(whole.length, 8);
+    CHECK(UINT64_MAX == whole.valueMask);
+
+    auto empty = signalAt(0, 0, 0);
+    CHECK(!canDeriveSignal(empty));
+    auto wide = signalAt(0, 0, 65);
+    CHECK(!canDeriveSignal(wide));
+    auto byte = signalAt(8, 0, 8);
+    CHECK(!canDeriveSignal(byte));
+    auto bit = signalAt(0, 8, 8);
+    CHECK(!canDeriveSignal(bit));
+    auto pastEnd = signalAt(7, 1, 8);
+    CHECK(!canDeriveSignal(pastEnd));
+    auto pastStart = signalAt(7, 0, 2, true);
+    CHECK(!canDeriveSignal(pastStart));
+}
+
+/**
+ * @brief Byte orders, sign extension, scaling and the not available value
+ *
+ */
+static void testDecode() {
+    double value;
+
+    // J1939 wheel based vehicle speed, 1/256 km/h per bit in bytes 1 and 2
+    auto speed = signalAt(1, 0, 16);
+    speed.scale = 1.0 / 256.0;
+    speed.notAvailable = true;
+    CHECK(canDeriveSignal(speed));
+    CHECK(canDecodeSignal(speed, frameOf(0x18fef100, true, {0xff, 0x00, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff}), value));
+    CHECK_NEAR(value, 25.0, 1e-9);
+    CHECK(!canDecodeSignal(speed, frameOf(0x18fef100, true, {0xff, 0xff, 0xff}), value));
+    CHECK(!canDecodeSignal(speed, frameOf(0x18fef100, true, {0xff, 0x00}), value));
+
+    auto nibble = signalAt(0, 4, 4);
+    CHECK(canDeriveSignal(nibble));
+    CHECK(canDecodeSignal(nibble, frameOf(0x100, false, {0xa5}), value));
+    CHECK_EQ(value, 10.0);
+
+    auto bigEndian = signalAt(0, 7, 16, true);
+    CHECK(canDeriveSignal(bigEndian));
+    CHECK(canDecodeSignal(bigEndian, frameOf(0x100, false, {0x12, 0x34}), value));
+    CHECK_EQ(value, 4660.0);
+
+    // Twelve bits from bit 3 of byte 2 down through byte 3, signed, scaled and offset
+    auto motorola = signalAt(2, 3, 12, true, true);
+    motorola.scale = 0.5;
+    motorola.offset = -10.0;
+    CHECK(canDeriveSignal(motorola));
+    CHECK(canDecodeSignal(motorola, frameOf(0x100, false, {0x00, 0x00, 0xaf, 0xfe}), value));
+    CHECK_EQ(value, -11.0);
+    CHECK(canDecodeSignal(motorola, frameOf(0x100, false, {0x00, 0x00, 0xa7, 0xff}), value));
+    CHECK_EQ(value, 1013.5);
+
+    auto signedByte = signalAt(3, 0, 8, false, true);
+    CHECK(canDeriveSignal(signedByte));
+    CHECK(canDecodeSignal(signedByte, frameOf(0x100, false, {0, 0, 0, 0x80}), value));
+    CHECK_EQ(value, -128.0);
+
+    auto whole = signalAt(0, 0, 64, false, true);
+    CHECK(canDeriveSignal(whole));
+    CHECK(canDecodeSignal(whole, frameOf(0x100, false, {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}), value));
+    CHECK_EQ(value, -1.0);
+}
+
+static void checkCovers(const CanFilter* wanted, size_t count, const CanFilterPlan& plan, std::mt19937& rng) {
+    for (size_t i = 0; i < count; i++) {
+        auto full = (wanted[i].extended) ? 0x1ffffffful : 0x7fful;
+        for (size_t n = 0; n < 16; n++) {
+            auto id = ((wanted[i].id & wanted[i].mask) | (rng() & ~wanted[i].mask)) & full;
+            CHECK(controllerPasses(plan, frameOf(id, wanted[i].extended)));
+        }
+    }
+}
+
+/**
+ * @brief Up to six filters with the same mask fit the controller exactly
+ *
+ */
+static void testPlanExact() {
+    CanFilter wanted[6];
+    for (size_t i = 0; i < 6; i++) {
+        wanted[i] = {(uint32_t)(0x100 + 0x10 * i), 0x7ff, false};
+    }
+    CanFilterPlan plan;
+    canPlanFilters(wanted, 6, plan);
+    for (uint32_t id = 0; id <= 0x7ff; id++) {
+        auto frame = frameOf(id, false);
+        auto expected = false;
+        for (auto& filter : wanted) {
+            expected = expected || filterPasses(filter, frame);
+        }
+        CHECK_EQ(controllerPasses(plan, frame), expected);
+    }
+    CHECK(!controllerPasses(plan, frameOf(0x100, true)));
+
+    // A J1939 parameter group from any source address next to an exact standard identifier
+    CanFilter mixed[2] {{0x18fef100, 0x03ffff00, true}, {0x123, 0x7ff, false}};
+    canPlanFilters(mixed, 2, plan);
+    CHECK(controllerPasses(plan, frameOf(0x18fef117, true)));
+    CHECK(controllerPasses(plan, frameOf(0x1cfef1fe, true)));
+    CHECK(!controllerPasses(plan, frameOf(0x18fef200, true)));
+    CHECK(controllerPasses(plan, frameOf(0x123, false)));
+    CHECK(!controllerPasses(plan, frameOf(0x124, false)));
+    CHECK(!controllerPasses(plan, frameOf(0x123, true)));
+}
+
+/**
+ * @brief With nothing wanted every frame gets through
+ *
+ */
+static void testPlanNone() {
+    CanFilterPlan plan;
+    canPlanFilters(nullptr, 0, plan);
+    std::mt19937 rng(5);
+    for (size_t n = 0; n < 1000; n++) {
+        CHECK(controllerPasses(plan, frameOf(rng() & 0x7ff, false)));
+        CHECK(controllerPasses(plan, frameOf(rng() & 0x1fffffff, true)));
+    }
+}
+
+/**
+ * @brief More filters than the controller has widen the closest ones and never lose a wanted frame
+ *
+ */
+static void testPlanMerge() {
+    // Seven parameter groups of one source, the two closest merge and the rest stay exact
+    CanFilter wanted[7];
+    static constexpr uint32_t pgns[7] {0xfef1, 0xfef2, 0xfee5, 0xfeee, 0xfeef, 0xf004, 0xfec1};
+    for (size_t i = 0; i < 7; i++) {
+        wanted[i] = {0x18000000u | (pgns[i] << 8), 0x1fffffff, true};
+    }
+    CanFilterPlan plan;
+    canPlanFilters(wanted, 7, plan);
+    std::mt19937 rng(7);
+    checkCovers(wanted, 7, plan, rng);
+
+    size_t passed = 0;
+    for (uint32_t pgn = 0xf000; pgn <= 0xffff; pgn++) {
+        passed += controllerPasses(plan, frameOf(0x18000000u | (pgn << 8), true)) ? 1 : 0;
+    }
+    CHECK_EQ(passed, 8u);
+    CHECK(!controllerPasses(plan, frameOf(0x18fef101, true)));
+
+    // Random tables of every size, frame types mixed, masks exact, wildcard source or sparse
+    for (size_t trial = 0; trial < 2000; trial++) {
+        CanFilter table[CAN_FILTER_TRIAL_MAX];
+        auto count = 1 + rng() % CAN_FILTER_TRIAL_MAX;
+        for (size_t i = 0; i < count; i++) {
+            auto extended = (0 == (rng() & 1));
+            auto full = (extended) ? 0x1ffffffful : 0x7fful;
+            uint32_t masks[3] {(uint32_t)full, (uint32_t)(full & ~0xffu), (uint32_t)(rng() & full)};
+            auto mask = masks[rng() % 3];
+            table[i] = {(uint32_t)(rng() & mask), mask, extended};
+        }
+        canPlanFilters(table, count, plan);
+        checkCovers(table, count, plan, rng);
+        for (size_t i = 0; i < CanFilterPlan::FILTERS; i++) {
+            CHECK_EQ(plan.filters[i].id & ~plan.masks[(i < 2) ? 0 : 1], 0u);
+        }
+    }
+}
+
+int main() {
+    testDerive();
+    testDecode();
+    testPlanExact();
+    testPlanNone();
+    testPlanMerge();
+    return hostTestResult("test_can_signal");
+}
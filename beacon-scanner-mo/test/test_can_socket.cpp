@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Runs the CAN thread built with CAN_SOCKETCAN against the vcan0 interface, which
+// must be up beforehand:
+//
+//   sudo modprobe vcan
+//   sudo ip link add dev vcan0 type vcan
+//   sudo ip link set up vcan0
+//
+// The module is included whole so the test can set the signal table and read the
+// statistics that are private to it.
+#include "user_can.cpp"
+#include "HostTest.h"
+
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+
+static constexpr int END_SIGNAL     {3};            // Signal carried only by the frame that ends the run
+static constexpr size_t FRAMES      {20};           // Frames sent for each signal
+
+// The thread loop never returns, the end frame unwinds it
+void ioUpdateCanChannel(int signal, double) {
+    if (END_SIGNAL == signal) {
+        throw HostDeadline {};
+    }
+}
+
+bool publishSubmit(PublishArbiter::Priority, const char*, const char*, bool) {
+    return true;
+}
+
+static bool send(SocketCanTransport& peer, uint32_t id, bool extended, std::initializer_list<uint8_t> data) {
+    CanFrame frame {id, extended, (uint8_t)data.size(), {}};
+    size_t i = 0;
+    for (auto byte : data) {
+        frame.data[i++] = byte;
+    }
+    return peer.send(frame);
+}
+
+int main() {
+    // A second socket on the interface stands in for the rest of the bus
+    SocketCanTransport peer(CAN_SOCKET_INTERFACE);
+    CanFilterPlan everything;
+    canPlanFilters(nullptr, 0, everything);
+    if (!peer.begin(0, false, everything)) {
+        printf("test_can_socket: skipped, %s is not up\n", CAN_SOCKET_INTERFACE);
+        return 0;
+    }
+    // A frame lost on the way would leave the thread waiting for the last one forever
+    alarm(10);
+
+    auto table = canTable.edit([]() {});
+    *table = {};
+    table->settings = {true, CanBitrate::Kbps250, false, 3600};
+    CHECK_EQ(canParseSignal("0x18fef100,0x3ffff00,1,16,0.00390625,,xn", table->signals[0]), 0);
+    CHECK_EQ(canParseSignal("0x123,,0,8", table->signals[1]), 0);
+    CHECK_EQ(canParseSignal("0x124,,2.3,12,0.5,-10,ms", table->signals[2]), 0);
+    CHECK_EQ(canParseSignal("0x7ff,,0,1", table->signals[END_SIGNAL]), 0);
+    CHECK_EQ(canParseRequest("0x18ea00fe,00ee00,60", table->requests[0]), 0);
+    canTable.commit();
+
+    // Open the socket with the planned kernel filters before anything is sent, the thread restarts it in place
+    CHECK(canStart(*canTable.current()));
+
+    for (size_t i = 0; i < FRAMES; i++) {
+        auto speed = (uint16_t)(i * 256);
+        CHECK(send(peer, 0x18fef100 | (uint32_t)i, true, {0xff, (uint8_t)speed, (uint8_t)(speed >> 8), 0xff, 0xff, 0xff, 0xff, 0xff}));
+        CHECK(send(peer, 0x123, false, {(uint8_t)i}));
+        CHECK(send(peer, 0x124, false, {0x00, 0x00, 0x00, (uint8_t)(20 + i)}));
+
+        // Neighbours of every wanted identifier, which the kernel filters must drop
+        CHECK(send(peer, 0x18fef200 | (uint32_t)i, true, {0x00, 0x00, 0x00}));
+        CHECK(send(peer, 0x122, false, {0x00}));
+        CHECK(send(peer, 0x123, true, {0x00}));
+        CHECK(send(peer, 0x7fe, false, {0x00}));
+    }
+
+    // The rest of the bus answers the scheduled request by ending the run
+    std::atomic<bool> requested {false};
+    std::thread bus([&peer, &requested]() {
+        CanFrame frame;
+        auto deadline = hostSeconds() + 5.0;
+        while (!requested && (hostSeconds() < deadline)) {
+            peer.wait(100);
+            while (peer.receive(frame)) {
+                if (frame.extended && (0x18ea00fe == frame.id) && (3 == frame.length) && (0xee == frame.data[1])) {
+                    requested = true;
+                }
+            }
+        }
+        send(peer, 0x7ff, false, {0x01});
+    });
+
+    try {
+        canThreadLoop(nullptr);
+    } catch (const HostDeadline&) {
+    }
+    bus.join();
+
+    // The end frame unwinds the thread before it is counted as matched
+    CHECK(requested);
+    CHECK_EQ(canBusStats.sent, 1u);
+    CHECK_EQ(canBusStats.received, 3 * FRAMES + 1);
+    CHECK_EQ(canBusStats.matched, 3 * FRAMES);
+    CHECK_EQ(canBusStats.overruns + canBus.takeOverruns(), 0u);
+
+    CHECK_EQ(canStats[0].count, FRAMES);
+    CHECK_NEAR(canStats[0].min, 0.0, 1e-9);
+    CHECK_NEAR(canStats[0].max, FRAMES - 1.0, 1e-9);
+    CHECK_EQ(canStats[1].count, FRAMES);
+    CHECK_NEAR(canStats[1].sum, FRAMES * (FRAMES - 1) / 2.0, 1e-9);
+    CHECK_EQ(canStats[2].count, FRAMES);
+    CHECK_NEAR(canStats[2].min, 0.0, 1e-9);
+    CHECK_NEAR(canStats[2].last, (20.0 + FRAMES - 1) / 2.0 - 10.0, 1e-9);
+
+    return hostTestResult("test_can_socket");
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "ConfigSnapshot.h"
+#include "HostTest.h"
+
+#include <mutex>
+#include <thread>
+
+// Same size as a Modbus point table entry, every field carries the version that wrote it
+struct Entry {
+    uint32_t version;
+    uint32_t fill[19];
+};
+
+static constexpr size_t ENTRIES {131};
+static constexpr size_t PASSES {1000000};
+static constexpr size_t WRITERS {2};
+
+/**
+ * @brief Check the ends of the table and one entry in full, as a poll pass reads a few points
+ *
+ */
+static bool sampled(const Entry* table, size_t n, uint32_t& version) {
+    version = table[0].version;
+    auto& entry = table[n % ENTRIES];
+    for (auto word : entry.fill) {
+        if (word != version) {
+            return false;
+        }
+    }
+    return (entry.version == version) && (table[ENTRIES - 1].version == version);
+}
+
+static bool consistent(const Entry* table, uint32_t& version) {
+    version = table[0].version;
+    for (size_t i = 0; i < ENTRIES; i++) {
+        if (table[i].version != version) {
+            return false;
+        }
+        for (auto word : table[i].fill) {
+            if (word != version) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief One reader against serialized writers, as the poll thread sees config changes
+ *
+ * @details Every table the reader takes must hold a single version throughout, versions
+ *          must never go backwards, and a table must not change while it is held.  The
+ *          writers run flat out so that they are nearly always waiting on the reader.
+ */
+static double stressSnapshot() {
+    static Entry first[ENTRIES], second[ENTRIES];
+    ConfigSnapshot<Entry> snapshot(first, second, ENTRIES);
+    std::mutex writeLock;
+    std::atomic<bool> stop {false};
+    std::atomic<uint32_t> nextVersion {0};
+
+    std::thread writers[WRITERS];
+    for (auto& writer : writers) {
+        writer = std::thread([&] {
+            while (!stop) {
+                std::lock_guard<std::mutex> lock(writeLock);
+                auto table = snapshot.edit([] { std::this_thread::yield(); });
+                auto version = ++nextVersion;
+                for (size_t i = 0; i < ENTRIES; i++) {
+                    table[i].version = version;
+                    for (auto& word : table[i].fill) {
+                        word = version;
+                    }
+                }
+                snapshot.commit();
+            }
+        });
+    }
+
+    size_t torn = 0, backwards = 0, changed = 0;
+    uint32_t last = 0;
+    auto start = hostSeconds();
+    for (size_t n = 0; n < PASSES; n++) {
+        auto table = snapshot.acquire();
+        uint32_t version;
+        torn += !sampled(table, n, version);
+        backwards += (version < last);
+        last = version;
+        if (0 == (n % 5000)) {
+            // Hold the table long enough for the writers to try to reuse it
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            uint32_t again;
+            changed += !consistent(table, again) || (again != version);
+        }
+        snapshot.release();
+    }
+    auto elapsed = hostSeconds() - start;
+    stop = true;
+    for (auto& writer : writers) {
+        writer.join();
+    }
+
+    CHECK_EQ(torn, 0u);
+    CHECK_EQ(backwards, 0u);
+    CHECK_EQ(changed, 0u);
+    CHECK(last > 0);
+    CHECK(snapshot.getEpoch() >= last);
+    std::printf("  snapshot: %u tables published, %zu torn, %zu out of order, %zu changed while held\n",
+        snapshot.getEpoch(), torn, backwards, changed);
+    return elapsed;
+}
+
+/**
+ * @brief The per pass lock and copy that the snapshot replaced, under the same load
+ *
+ */
+static double stressLockAndCopy() {
+    static Entry master[ENTRIES], copy[ENTRIES];
+    std::mutex lock;
+    std::atomic<bool> stop {false};
+    uint32_t nextVersion = 0;
+
+    std::thread writers[WRITERS];
+    for (auto& writer : writers) {
+        writer = std::thread([&] {
+            while (!stop) {
+                std::lock_guard<std::mutex> guard(lock);
+                auto version = ++nextVersion;
+                for (size_t i = 0; i < ENTRIES; i++) {
+                    master[i].version = version;
+                    for (auto& word : master[i].fill) {
+                        word = version;
+                    }
+                }
+            }
+        });
+    }
+
+    size_t torn = 0;
+    auto start = hostSeconds();
+    for (size_t n = 0; n < PASSES; n++) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            memcpy(copy, master, sizeof(copy));
+        }
+        uint32_t version;
+        torn += !sampled(copy, n, version);
+    }
+    auto elapsed = hostSeconds() - start;
+    stop = true;
+    for (auto& writer : writers) {
+        writer.join();
+    }
+
+    CHECK_EQ(torn, 0u);
+    return elapsed;
+}
+
+int main() {
+    auto snapshot = stressSnapshot();
+    auto locked = stressLockAndCopy();
+
+    // Timing depends on the host so it is reported rather than checked
+    std::printf("  %zu passes: snapshot %.0f ns, lock and copy %.0f ns per pass\n",
+        PASSES, snapshot * 1e9 / PASSES, locked * 1e9 / PASSES);
+    return hostTestResult("test_config_snapshot");
+}
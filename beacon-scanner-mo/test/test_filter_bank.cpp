@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FilterBank.h"
+#include "HostTest.h"
+
+#include <initializer_list>
+
+static constexpr float SAMPLE_HZ {100.0f};  // Matches ANALOG_SAMPLE_HZ in user_io.cpp
+
+/**
+ * @brief Drive a cosine through a filter and measure the output amplitude
+ *
+ * @details The filter is given ten seconds to settle and the amplitude is then taken from
+ *          the RMS of the next sixty seconds of output, which is exact for any tone with a
+ *          whole number of cycles in that window.
+ */
+template <typename Process>
+static double measureGain(float f, Process process) {
+    static constexpr size_t SETTLE {(size_t)(10 * SAMPLE_HZ)};
+    static constexpr size_t MEASURE {(size_t)(60 * SAMPLE_HZ)};
+
+    double sumSq = 0.0;
+    size_t outputs = 0;
+    for (size_t n = 0; n < SETTLE + MEASURE; n++) {
+        auto x = (float)std::cos(2.0 * M_PI * f * n / SAMPLE_HZ + 0.3);
+        float y;
+        if (process(x, y) && (n >= SETTLE)) {
+            sumSq += (double)y * y;
+            outputs++;
+        }
+    }
+    // A tone exactly at Nyquist carries cos(0.3) of its amplitude into the samples
+    auto rms = std::sqrt(sumSq / outputs);
+    return (2.0f * f == SAMPLE_HZ) ? rms / std::cos(0.3) : rms * std::sqrt(2.0);
+}
+
+static void testLowPass() {
+    BiquadFilter lpf;
+    lpf.setLowPass(SAMPLE_HZ, 10.0f);
+
+    CHECK_NEAR(lpf.magnitude(SAMPLE_HZ, 0.0f), 1.0, 1e-5);
+    CHECK_NEAR(lpf.magnitude(SAMPLE_HZ, 10.0f), M_SQRT1_2, 1e-3);
+    CHECK(lpf.magnitude(SAMPLE_HZ, 40.0f) < 0.03);
+
+    for (auto f : {1.0f, 5.0f, 10.0f, 20.0f, 40.0f}) {
+        lpf.setLowPass(SAMPLE_HZ, 10.0f);
+        auto measured = measureGain(f, [&](float x, float& y) { y = lpf.process(x); return true; });
+        CHECK_NEAR(measured, lpf.magnitude(SAMPLE_HZ, f), 0.01);
+    }
+
+    // Cutoffs past Nyquist are clamped rather than producing an unstable section
+    lpf.setLowPass(SAMPLE_HZ, 80.0f);
+    CHECK_NEAR(lpf.magnitude(SAMPLE_HZ, 0.0f), 1.0, 1e-5);
+    CHECK(lpf.magnitude(SAMPLE_HZ, 45.0f) < 0.8);
+}
+
+static void testNotch() {
+    BiquadFilter notch;
+
+    // 50 Hz mains sampled at 100 Hz sits exactly at Nyquist
+    notch.setNotch(SAMPLE_HZ, 50.0f, 5.0f);
+    CHECK_NEAR(notch.magnitude(SAMPLE_HZ, 0.0f), 1.0, 1e-5);
+    CHECK(notch.magnitude(SAMPLE_HZ, 50.0f) < 1e-3);
+    CHECK(notch.magnitude(SAMPLE_HZ, 5.0f) > 0.95);
+    auto measured = measureGain(50.0f, [&](float x, float& y) { y = notch.process(x); return true; });
+    CHECK(measured < 1e-3);
+
+    // 60 Hz mains folds down to 40 Hz
+    auto folded = FilterBank::foldFrequency(60.0f, SAMPLE_HZ);
+    CHECK_NEAR(folded, 40.0, 1e-4);
+    notch.setNotch(SAMPLE_HZ, folded, 5.0f);
+    CHECK_NEAR(notch.magnitude(SAMPLE_HZ, 0.0f), 1.0, 1e-5);
+    CHECK(notch.magnitude(SAMPLE_HZ, 40.0f) < 1e-3);
+    for (auto f : {2.0f, 20.0f, 35.0f, 40.0f, 45.0f}) {
+        notch.setNotch(SAMPLE_HZ, folded, 5.0f);
+        measured = measureGain(f, [&](float x, float& y) { y = notch.process(x); return true; });
+        CHECK_NEAR(measured, notch.magnitude(SAMPLE_HZ, f), 0.01);
+    }
+
+    // A primed section passes a constant straight through without a start-up transient
+    notch.prime(3.25f);
+    for (int i = 0; i < 10; i++) {
+        CHECK_NEAR(notch.process(3.25f), 3.25, 1e-4);
+    }
+}
+
+static void testCic() {
+    CicDecimator cic;
+
+    cic.configure(4, 2);
+    CHECK_NEAR(cic.magnitude(SAMPLE_HZ, 0.0f), 1.0, 1e-6);
+    CHECK(cic.magnitude(SAMPLE_HZ, 25.0f) < 1e-6);
+    CHECK(cic.magnitude(SAMPLE_HZ, 50.0f) < 1e-6);
+
+    // Tones that fall on a null are removed before decimation can alias them
+    for (auto f : {1.0f, 5.0f, 10.0f, 25.0f, 50.0f}) {
+        cic.configure(4, 2);
+        auto measured = measureGain(f, [&](float x, float& y) { return cic.process(x, y); });
+        CHECK_NEAR(measured, cic.magnitude(SAMPLE_HZ, f), 0.01);
+    }
+
+    // One output per ratio inputs, and a constant passes at unity gain from the first output
+    cic.configure(8, 3);
+    size_t outputs = 0;
+    for (int i = 0; i < 80; i++) {
+        float y;
+        if (cic.process(7.5f, y)) {
+            CHECK_NEAR(y, 7.5, 1e-5);
+            outputs++;
+        }
+    }
+    CHECK_EQ(outputs, 10u);
+
+    // Ratio and order are clamped to what the state arrays can hold
+    cic.configure(100, 10);
+    CHECK_EQ(cic.getRatio(), CicDecimator::MAX_RATIO);
+}
+
+static void testMedian() {
+    MedianFilter median;
+    median.setWindow(4);
+    CHECK_EQ(median.getWindow(), 5u);
+
+    median.setWindow(3);
+    float out[6];
+    float in[6] {1.0f, 1.0f, 100.0f, 1.0f, 1.0f, 1.0f};
+    for (size_t i = 0; i < 6; i++) {
+        out[i] = median.process(in[i]);
+    }
+    for (auto y : out) {
+        CHECK_NEAR(y, 1.0, 1e-6);
+    }
+}
+
+static void testBank() {
+    FilterBankSettings settings;
+    settings.median = 3;
+    settings.notchHz = 60.0;
+    settings.lowPassHz = 10.0;
+    settings.decimate = 4;
+    settings.cicOrder = 2;
+
+    FilterBank bank;
+    bank.configure(SAMPLE_HZ, settings);
+    CHECK_NEAR(bank.outputRate(), 25.0, 1e-6);
+    CHECK(bank.magnitude(60.0f) < 1e-3);
+    CHECK_NEAR(bank.magnitude(0.0f), 1.0, 1e-5);
+
+    // The whole chain matches the product of its stages for tones the median leaves alone
+    for (auto f : {0.5f, 2.0f, 8.0f}) {
+        bank.configure(SAMPLE_HZ, settings);
+        auto measured = measureGain(f, [&](float x, float& y) { return bank.process(x, y); });
+        CHECK_NEAR(measured, bank.magnitude(f), 0.02);
+    }
+
+    // The first sample primes the IIR stages so a DC input shows no settling
+    bank.configure(SAMPLE_HZ, settings);
+    for (int i = 0; i < 40; i++) {
+        float y;
+        if (bank.process(2.0f, y)) {
+            CHECK_NEAR(y, 2.0, 1e-4);
+        }
+    }
+}
+
+int main() {
+    testLowPass();
+    testNotch();
+    testCic();
+    testMedian();
+    testBank();
+    return hostTestResult("test_filter_bank");
+}
@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "ModbusDecode.h"
+#include "HostTest.h"
+
+#include <cstring>
+
+static constexpr ModbusByteOrder ORDERS[] {
+    ModbusByteOrder::ABCD, ModbusByteOrder::BADC, ModbusByteOrder::CDAB, ModbusByteOrder::DCBA,
+};
+static const char* ORDER_NAMES[] {"ABCD", "BADC", "CDAB", "DCBA"};
+
+/**
+ * @brief Registers as they arrive on the wire for bytes 01 02 .. 08 in each byte order
+ *
+ */
+static constexpr uint16_t WIRE64[4][4] {
+    {0x0102, 0x0304, 0x0506, 0x0708},
+    {0x0201, 0x0403, 0x0605, 0x0807},
+    {0x0708, 0x0506, 0x0304, 0x0102},
+    {0x0807, 0x0605, 0x0403, 0x0201},
+};
+static constexpr uint16_t WIRE32[4][2] {
+    {0x0102, 0x0304},
+    {0x0201, 0x0403},
+    {0x0304, 0x0102},
+    {0x0403, 0x0201},
+};
+
+/**
+ * @brief Lay out a big endian value in the given byte order
+ *
+ */
+static void toWire(uint64_t value, size_t count, ModbusByteOrder order, uint16_t* words) {
+    auto reverse = (ModbusByteOrder::CDAB == order) || (ModbusByteOrder::DCBA == order);
+    auto swap = (ModbusByteOrder::BADC == order) || (ModbusByteOrder::DCBA == order);
+    for (size_t i = 0; i < count; i++) {
+        auto word = (uint16_t)(value >> (16 * (count - 1 - i)));
+        if (swap) {
+            word = (uint16_t)((word << 8) | (word >> 8));
+        }
+        words[(reverse) ? (count - 1 - i) : i] = word;
+    }
+}
+
+static uint64_t bitsOf(double value) {
+    uint64_t raw;
+    memcpy(&raw, &value, sizeof(raw));
+    return raw;
+}
+
+static uint64_t bitsOf(float value) {
+    uint32_t raw;
+    memcpy(&raw, &value, sizeof(raw));
+    return raw;
+}
+
+struct Vector {
+    const char* name;
+    ModbusDecoder decode;
+    size_t registers;
+    uint64_t raw;                   // Big endian register contents
+    double expected;
+    bool valid;
+};
+
+static const Vector VECTORS[] {
+    {"uint32 max",          modbusDecodeUint32,  2, 0xffffffff,            4294967295.0,            true},
+    {"uint32",              modbusDecodeUint32,  2, 0x0001e240,            123456.0,                true},
+    {"int32 -70000",        modbusDecodeInt32,   2, 0xfffeee90,            -70000.0,                true},
+    {"int32 min",           modbusDecodeInt32,   2, 0x80000000,            -2147483648.0,           true},
+    {"float32 1.5",         modbusDecodeFloat32, 2, bitsOf(1.5f),          1.5,                     true},
+    {"float32 -230.25",     modbusDecodeFloat32, 2, bitsOf(-230.25f),      -230.25,                 true},
+    {"uint64 energy",       modbusDecodeUint64,  4, 9000000000ULL,         9000000000.0,            true},
+    {"uint64 2^53",         modbusDecodeUint64,  4, 1ULL << 53,            9007199254740992.0,      true},
+    {"int64 negative",      modbusDecodeInt64,   4, (uint64_t)-123456789012LL, -123456789012.0,     true},
+    {"int64 -1",            modbusDecodeInt64,   4, UINT64_MAX,            -1.0,                    true},
+    {"float64 pi",          modbusDecodeFloat64, 4, bitsOf(3.141592653589793), 3.141592653589793,   true},
+    {"float64 -1e300",      modbusDecodeFloat64, 4, bitsOf(-1e300),        -1e300,                  true},
+    {"bcd32",               modbusDecodeBcd32,   2, 0x98765432,            98765432.0,              true},
+    {"bcd32 zero",          modbusDecodeBcd32,   2, 0x00000000,            0.0,                     true},
+    {"bcd32 bad digit",     modbusDecodeBcd32,   2, 0x1234a678,            0.0,                     false},
+};
+
+/**
+ * @brief Every multi-register type decodes the same value in every byte order
+ *
+ */
+static void testVectors() {
+    for (auto& vector : VECTORS) {
+        for (size_t o = 0; o < 4; o++) {
+            ModbusDecoding decoding {};
+            decoding.order = ORDERS[o];
+            uint16_t words[4];
+            toWire(vector.raw, vector.registers, ORDERS[o], words);
+
+            double value = 0.0;
+            auto valid = vector.decode(words, decoding, value);
+            if ((valid != vector.valid) || (valid && (bitsOf(value) != bitsOf(vector.expected)))) {
+                std::printf("  %s in %s decoded %s %.17g\n", vector.name, ORDER_NAMES[o], valid ? "to" : "as invalid", value);
+                hostTestFailures++;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Byte orders match the documented wire layout, independently of toWire()
+ *
+ */
+static void testByteOrders() {
+    for (size_t o = 0; o < 4; o++) {
+        CHECK_EQ(modbusJoinWords(WIRE64[o], 4, ORDERS[o]), 0x0102030405060708ULL);
+        CHECK_EQ(modbusJoinWords(WIRE32[o], 2, ORDERS[o]), 0x01020304ULL);
+
+        uint16_t words[4];
+        toWire(0x0102030405060708ULL, 4, ORDERS[o], words);
+        CHECK(0 == memcmp(words, WIRE64[o], sizeof(words)));
+    }
+
+    // A float32 sent word swapped, the most common meter layout
+    uint16_t cdab[2] {0x0000, 0x3fc0};
+    ModbusDecoding decoding {};
+    decoding.order = ModbusByteOrder::CDAB;
+    double value;
+    CHECK(modbusDecodeFloat32(cdab, decoding, value));
+    CHECK_EQ(value, 1.5);
+}
+
+static void testSixteenBit() {
+    ModbusDecoding decoding {};
+    modbusDeriveSign(decoding);
+    uint16_t word = 0xffff;
+    double value;
+
+    // The byte order does not apply to single register values
+    for (auto order : ORDERS) {
+        decoding.order = order;
+        CHECK(modbusDecodeUint16(&word, decoding, value) && (65535.0 == value));
+        CHECK(modbusDecodeInt16(&word, decoding, value) && (-1.0 == value));
+    }
+
+    // Masked and shifted fields are sign extended from their own top bit
+    decoding = {};
+    decoding.mask = 0x0ff0;
+    decoding.shift = 4;
+    modbusDeriveSign(decoding);
+    CHECK_EQ(decoding.negativeTest, 0x80u);
+    word = 0x0ff0;
+    CHECK(modbusDecodeInt16(&word, decoding, value) && (-1.0 == value));
+    word = 0x87f5;
+    CHECK(modbusDecodeInt16(&word, decoding, value) && (127.0 == value));
+    CHECK(modbusDecodeUint16(&word, decoding, value) && (127.0 == value));
+
+    // A single bit field has no sign
+    decoding = {};
+    decoding.mask = 0x0100;
+    decoding.shift = 8;
+    modbusDeriveSign(decoding);
+    CHECK_EQ(decoding.negativeTest, 0u);
+    word = 0x0100;
+    CHECK(modbusDecodeInt16(&word, decoding, value) && (1.0 == value));
+
+    // BCD rejects any digit above nine
+    decoding = {};
+    word = 0x1234;
+    CHECK(modbusDecodeBcd16(&word, decoding, value) && (1234.0 == value));
+    word = 0x9999;
+    CHECK(modbusDecodeBcd16(&word, decoding, value) && (9999.0 == value));
+    word = 0x12f4;
+    CHECK(!modbusDecodeBcd16(&word, decoding, value));
+}
+
+static void testStrings() {
+    char text[33];
+    uint16_t serial[4] {('S' << 8) | 'N', ('1' << 8) | '2', (' ' << 8) | ' ', 0};
+
+    CHECK_EQ(modbusDecodeText(serial, 4, ModbusByteOrder::ABCD, text, sizeof(text)), 4u);
+    CHECK(0 == strcmp(text, "SN12"));
+    CHECK_EQ(modbusDecodeText(serial, 4, ModbusByteOrder::CDAB, text, sizeof(text)), 4u);
+    CHECK(0 == strcmp(text, "SN12"));
+    CHECK_EQ(modbusDecodeText(serial, 4, ModbusByteOrder::BADC, text, sizeof(text)), 4u);
+    CHECK(0 == strcmp(text, "NS21"));
+    CHECK_EQ(modbusDecodeText(serial, 4, ModbusByteOrder::DCBA, text, sizeof(text)), 4u);
+    CHECK(0 == strcmp(text, "NS21"));
+
+    // Unprintable characters are replaced, the string ends at the first NUL
+    uint16_t control[3] {('A' << 8) | 0x01, ('B' << 8) | 0, ('C' << 8) | 'D'};
+    CHECK_EQ(modbusDecodeText(control, 3, ModbusByteOrder::ABCD, text, sizeof(text)), 3u);
+    CHECK(0 == strcmp(text, "A?B"));
+
+    // Output is truncated to the buffer and always terminated
+    CHECK_EQ(modbusDecodeText(serial, 4, ModbusByteOrder::ABCD, text, 3), 2u);
+    CHECK(0 == strcmp(text, "SN"));
+    CHECK_EQ(modbusDecodeText(serial, 4, ModbusByteOrder::ABCD, text, 0), 0u);
+
+    // All spaces trims to nothing
+    uint16_t blank[2] {0x2020, 0x2020};
+    CHECK_EQ(modbusDecodeText(blank, 2, ModbusByteOrder::ABCD, text, sizeof(text)), 0u);
+    CHECK('\0' == text[0]);
+}
+
+/**
+ * @brief Register arrays decode each register with the element decoder, as the poll thread does
+ *
+ */
+static void testArrays() {
+    uint16_t words[6] {0x0000, 0x7fff, 0x8000, 0xffff, 0x0001, 0xfffe};
+    double expectedSigned[6] {0.0, 32767.0, -32768.0, -1.0, 1.0, -2.0};
+    double expectedUnsigned[6] {0.0, 32767.0, 32768.0, 65535.0, 1.0, 65534.0};
+
+    ModbusDecoding decoding {};
+    modbusDeriveSign(decoding);
+    for (size_t i = 0; i < 6; i++) {
+        double value;
+        CHECK(modbusDecodeInt16(&words[i], decoding, value) && (expectedSigned[i] == value));
+        CHECK(modbusDecodeUint16(&words[i], decoding, value) && (expectedUnsigned[i] == value));
+    }
+}
+
+int main() {
+    testVectors();
+    testByteOrders();
+    testSixteenBit();
+    testStrings();
+    testArrays();
+    return hostTestResult("test_modbus_decode");
+}
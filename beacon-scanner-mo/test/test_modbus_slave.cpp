@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// The slave module is included whole so the test can serve requests through the
+// register map it builds.
+#include "user_modbus_slave.cpp"
+#include "HostTest.h"
+
+#include <vector>
+
+static constexpr uint32_t GAP_US    {1750};         // Frame gap above 19200 baud
+
+// Defined in main.cpp on the device
+SerialLogHandler logHandler;
+
+/**
+ * @brief Serial port fed from a buffer that keeps whatever is written to it
+ *
+ */
+class TestStream : public Stream {
+public:
+    std::vector<uint8_t> input;
+    std::vector<uint8_t> output;
+
+    int available() override {
+        return (int)(input.size() - _next);
+    }
+
+    int read() override {
+        return (_next < input.size()) ? input[_next++] : -1;
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) override {
+        output.insert(output.end(), buffer, buffer + size);
+        return size;
+    }
+
+private:
+    size_t _next {0};
+};
+
+static std::vector<uint8_t> withCrc(std::vector<uint8_t> frame) {
+    auto crc = ModbusSlave::crc16(frame.data(), frame.size());
+    frame.push_back((uint8_t)crc);
+    frame.push_back((uint8_t)(crc >> 8));
+    return frame;
+}
+
+static std::vector<uint8_t> request(uint8_t id, uint8_t function, uint16_t address, uint16_t count) {
+    return withCrc({id, function, (uint8_t)(address >> 8), (uint8_t)address, (uint8_t)(count >> 8), (uint8_t)count});
+}
+
+/**
+ * @brief Deliver a frame, let the line go quiet and return the answer
+ *
+ */
+static std::vector<uint8_t> serve(ModbusSlave& slave, const std::vector<uint8_t>& frame) {
+    TestStream stream;
+    stream.input = frame;
+    slave.service(stream, GAP_US);
+    hostAdvanceUs(GAP_US);
+    slave.service(stream, GAP_US);
+    return stream.output;
+}
+
+static bool isException(const std::vector<uint8_t>& answer, uint8_t function, uint8_t code) {
+    return (answer == withCrc({answer.empty() ? (uint8_t)0 : answer[0], (uint8_t)(function | 0x80), code}));
+}
+
+static float floatAt(const std::vector<uint8_t>& answer, size_t index) {
+    uint32_t bits = 0;
+    for (size_t i = 0; i < 4; i++) {
+        bits = (bits << 8) | answer[3 + 2 * index + i];
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint16_t wordAt(const std::vector<uint8_t>& answer, size_t index) {
+    return (uint16_t)((answer[3 + 2 * index] << 8) | answer[4 + 2 * index]);
+}
+
+// Reader for the frame handling tests, every register holds its own address
+static uint8_t readerCode {0};
+static uint8_t readAddresses(uint8_t, uint16_t address, uint16_t count, uint16_t* values) {
+    for (size_t i = 0; i < count; i++) {
+        values[i] = (uint16_t)(address + i);
+    }
+    return readerCode;
+}
+
+static std::vector<bool> directions;
+static void recordDirection(bool transmit) {
+    directions.push_back(transmit);
+}
+
+static void testCrc() {
+    // Example from the Modbus over serial line specification
+    uint8_t frame[] {0x01, 0x03, 0x00, 0x00, 0x00, 0x0a};
+    CHECK_EQ(ModbusSlave::crc16(frame, sizeof(frame)), 0xcdc5);
+}
+
+/**
+ * @brief Well formed reads are answered, the transceiver driven only around the answer
+ *
+ */
+static void testRead() {
+    ModbusSlave slave(readAddresses, recordDirection);
+    slave.setId(7);
+
+    auto answer = serve(slave, request(7, 0x03, 0x1234, 3));
+    CHECK(answer == withCrc({7, 0x03, 6, 0x12, 0x34, 0x12, 0x35, 0x12, 0x36}));
+    CHECK((std::vector<bool> {true, false}) == directions);
+
+    answer = serve(slave, request(7, 0x04, 0, ModbusSlave::READ_LIMIT));
+    CHECK_EQ(answer.size(), 5u + 2 * ModbusSlave::READ_LIMIT);
+    CHECK_EQ(answer[2], 2 * ModbusSlave::READ_LIMIT);
+    CHECK_EQ(wordAt(answer, ModbusSlave::READ_LIMIT - 1), ModbusSlave::READ_LIMIT - 1);
+
+    answer = serve(slave, request(7, 0x03, 0xfffe, 2));
+    CHECK_EQ(wordAt(answer, 1), 0xffff);
+    CHECK_EQ(slave.getStats().requests, 3u);
+    CHECK_EQ(slave.getStats().exceptions, 0u);
+}
+
+/**
+ * @brief Frames not meant for this slave or damaged on the line get no answer
+ *
+ */
+static void testIgnored() {
+    ModbusSlave slave(readAddresses);
+    slave.setId(7);
+
+    CHECK(serve(slave, request(8, 0x03, 0, 1)).empty());
+    CHECK(serve(slave, request(0, 0x03, 0, 1)).empty());
+    CHECK_EQ(slave.getStats().requests, 0u);
+
+    auto damaged = request(7, 0x03, 0, 1);
+    damaged[3] ^= 0x01;
+    CHECK(serve(slave, damaged).empty());
+    CHECK(serve(slave, {7, 0x03}).empty());
+    CHECK_EQ(slave.getStats().crcErrors, 1u);
+
+    std::vector<uint8_t> flood(ModbusSlave::FRAME_SIZE + 1, 0x55);
+    CHECK(serve(slave, flood).empty());
+    CHECK_EQ(slave.getStats().overruns, 1u);
+
+    // The slave answers again once the line has recovered
+    CHECK(!serve(slave, request(7, 0x03, 0, 1)).empty());
+}
+
+/**
+ * @brief A frame is only complete once the line has been quiet for the whole gap
+ *
+ */
+static void testFraming() {
+    ModbusSlave slave(readAddresses);
+    slave.setId(7);
+    auto frame = request(7, 0x03, 10, 1);
+
+    TestStream stream;
+    stream.input.assign(frame.begin(), frame.begin() + 3);
+    slave.service(stream, GAP_US);
+    hostAdvanceUs(GAP_US - 1);
+    slave.service(stream, GAP_US);
+    CHECK(stream.output.empty());
+
+    stream.input.insert(stream.input.end(), frame.begin() + 3, frame.end());
+    slave.service(stream, GAP_US);
+    hostAdvanceUs(GAP_US);
+    slave.service(stream, GAP_US);
+    CHECK(stream.output == withCrc({7, 0x03, 2, 0x00, 0x0a}));
+}
+
+/**
+ * @brief Malformed requests and reader failures are answered with the matching exception
+ *
+ */
+static void testExceptions() {
+    ModbusSlave slave(readAddresses);
+    slave.setId(7);
+
+    CHECK(isException(serve(slave, request(7, 0x06, 0, 1)), 0x06, ModbusSlave::ILLEGAL_FUNCTION));
+    CHECK(isException(serve(slave, request(7, 0x10, 0, 1)), 0x10, ModbusSlave::ILLEGAL_FUNCTION));
+    CHECK(isException(serve(slave, request(7, 0x03, 0, 0)), 0x03, ModbusSlave::ILLEGAL_DATA_VALUE));
+    CHECK(isException(serve(slave, request(7, 0x04, 0, ModbusSlave::READ_LIMIT + 1)), 0x04, ModbusSlave::ILLEGAL_DATA_VALUE));
+    CHECK(isException(serve(slave, withCrc({7, 0x03, 0x00, 0x00, 0x00, 0x01, 0x00})), 0x03, ModbusSlave::ILLEGAL_DATA_VALUE));
+    CHECK(isException(serve(slave, request(7, 0x03, 0xffff, 2)), 0x03, ModbusSlave::ILLEGAL_DATA_ADDRESS));
+
+    readerCode = ModbusSlave::SLAVE_DEVICE_BUSY;
+    CHECK(isException(serve(slave, request(7, 0x03, 0, 1)), 0x03, ModbusSlave::SLAVE_DEVICE_BUSY));
+    readerCode = 0;
+
+    CHECK_EQ(slave.getStats().requests, 7u);
+    CHECK_EQ(slave.getStats().exceptions, 7u);
+}
+
+/**
+ * @brief Inputs, polled points and CAN signals appear at their documented registers
+ *
+ */
+static void testRegisterMap() {
+    slaveUsb.setId(1);
+    modbusSlaveSetInputs(24.5f, 0.012f, true, false, 70000, 1.5f);
+    modbusSlaveSetPoint(3, 42.0f);
+    modbusSlaveSetPoint(MODBUS_POINT_COUNT - 1, -7.25f);
+    modbusSlaveSetSignal(CAN_SIGNAL_COUNT - 1, -1.5f);
+
+    for (uint8_t function : {0x03, 0x04}) {
+        auto answer = serve(slaveUsb, request(1, function, SLAVE_IO_FIRST, SLAVE_IO_COUNT));
+        CHECK_EQ(answer.size(), 5u + 2 * SLAVE_IO_COUNT);
+        CHECK_EQ(floatAt(answer, SLAVE_IO_VOLTAGE), 24.5f);
+        CHECK_EQ(floatAt(answer, SLAVE_IO_CURRENT), 0.012f);
+        CHECK_EQ(wordAt(answer, SLAVE_IO_DIGITAL_IN), 1);
+        CHECK_EQ(wordAt(answer, SLAVE_IO_RELAY), 0);
+        CHECK_EQ(((uint32_t)wordAt(answer, SLAVE_IO_PULSE_COUNT) << 16) | wordAt(answer, SLAVE_IO_PULSE_COUNT + 1), 70000u);
+        CHECK_EQ(floatAt(answer, SLAVE_IO_PULSE_RATE), 1.5f);
+    }
+
+    auto answer = serve(slaveUsb, request(1, 0x04, SLAVE_MODBUS_FIRST + 2 * 3, 2));
+    CHECK_EQ(floatAt(answer, 0), 42.0f);
+    answer = serve(slaveUsb, request(1, 0x04, SLAVE_MODBUS_FIRST + 2 * (MODBUS_POINT_COUNT - 1), 2));
+    CHECK_EQ(floatAt(answer, 0), -7.25f);
+    answer = serve(slaveUsb, request(1, 0x04, SLAVE_CAN_FIRST + 2 * (CAN_SIGNAL_COUNT - 1), 2));
+    CHECK_EQ(floatAt(answer, 0), -1.5f);
+
+    // Reads must stay within one block so that every value comes from one update
+    CHECK(isException(serve(slaveUsb, request(1, 0x04, SLAVE_IO_COUNT - 2, 4)), 0x04, ModbusSlave::ILLEGAL_DATA_ADDRESS));
+    CHECK(isException(serve(slaveUsb, request(1, 0x04, 50, 1)), 0x04, ModbusSlave::ILLEGAL_DATA_ADDRESS));
+    CHECK(isException(serve(slaveUsb, request(1, 0x04, SLAVE_MODBUS_FIRST + SLAVE_MODBUS_COUNT, 1)), 0x04, ModbusSlave::ILLEGAL_DATA_ADDRESS));
+    CHECK(isException(serve(slaveUsb, request(1, 0x04, SLAVE_CAN_FIRST + SLAVE_CAN_COUNT - 1, 2)), 0x04, ModbusSlave::ILLEGAL_DATA_ADDRESS));
+
+    // A block whose writer stopped partway through an update reads as busy
+    slaveIoRegisters.beginWrite();
+    CHECK(isException(serve(slaveUsb, request(1, 0x04, SLAVE_IO_FIRST, 2)), 0x04, ModbusSlave::SLAVE_DEVICE_BUSY));
+    slaveIoRegisters.endWrite();
+    CHECK_EQ(serve(slaveUsb, request(1, 0x04, SLAVE_IO_FIRST, 2)).size(), 9u);
+}
+
+int main() {
+    testCrc();
+    testRead();
+    testIgnored();
+    testFraming();
+    testExceptions();
+    testRegisterMap();
+    return hostTestResult("test_modbus_slave");
+}
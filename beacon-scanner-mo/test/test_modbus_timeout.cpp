@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs the poll thread over the RS-485 transport against a client with scripted
+// answers, to follow the response timeout from the slave health to the client.
+#include "user_modbus.cpp"
+#include "HostTest.h"
+
+static constexpr uint32_t LATENCY_US    {40000};
+static constexpr uint32_t LEARNED_MS    {2 * LATENCY_US / 1000 + SlaveHealth::TIMEOUT_MARGIN_MS};
+
+// Modules the poll thread reports to
+SerialLogHandler logHandler;
+void ioUpdateModbusChannel(int, double) {}
+bool modbusSlaveOwnsRs485() {return false;}
+void modbusSlaveServeRs485(unsigned int, unsigned int) {}
+bool publishSubmit(PublishArbiter::Priority, const char*, const char*, bool) {return true;}
+
+/**
+ * @brief Poll until the simulated clock reaches the deadline
+ *
+ * @param seconds Simulated time to run
+ */
+static void runFor(uint64_t seconds) {
+    hostResetClock(seconds * 1000000);
+    try {
+        modbusThreadLoop(nullptr);
+    } catch (const HostDeadline&) {
+    }
+}
+
+/**
+ * @brief A slave that answers in 40 ms gets a 100 ms timeout, until it stops answering
+ *
+ */
+static void testAdaptiveTimeout() {
+    ModbusPoint point {};
+    CHECK_EQ(modbusParsePoint("1,hr,100,uint16,200ms", point), SYSTEM_ERROR_NONE);
+    modbusCommitPoints(MODBUS_CLIENT_COUNT, &point, 1);
+
+    modbusRtu.hostResult = ModbusClient::ku8MBSuccess;
+    modbusRtu.hostLatencyUs = LATENCY_US;
+    runFor(10);
+
+    // The configured timeout holds until enough responses were timed
+    auto& timeouts = modbusRtu.hostTimeouts;
+    CHECK(timeouts.size() > 2 * SlaveHealth::MIN_SAMPLES);
+    for (size_t i = 0; (i < SlaveHealth::MIN_SAMPLES) && (i < timeouts.size()); i++) {
+        CHECK_EQ(timeouts[i], MODBUS_TIMEOUT_DEFAULT_MS);
+    }
+    auto slave = modbusFindSlave(1);
+    CHECK(slave);
+    if (!slave) {
+        return;
+    }
+    CHECK_EQ(slave->health.getTimeout(), LEARNED_MS);
+    CHECK_EQ(timeouts.back(), LEARNED_MS);
+    CHECK_EQ(modbusRtu.responseTimeout, LEARNED_MS);
+
+    // A dead slave costs the learned timeout for each attempt of one poll, then the configured
+    // one once it is suspect
+    timeouts.clear();
+    modbusRtu.hostResult = ModbusClient::ku8MBResponseTimedOut;
+    runFor(3);
+    CHECK(timeouts.size() > MODBUS_RETRY_LIMIT + 1);
+    for (size_t i = 0; i < timeouts.size(); i++) {
+        CHECK_EQ(timeouts[i], (i <= MODBUS_RETRY_LIMIT) ? LEARNED_MS : MODBUS_TIMEOUT_DEFAULT_MS);
+    }
+    CHECK(SlaveHealth::State::Healthy != slave->health.getState());
+}
+
+int main() {
+    testAdaptiveTimeout();
+    return hostTestResult("test_modbus_timeout");
+}
@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PublishArbiter.h"
+#include "HostTest.h"
+
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+
+using Priority = PublishArbiter::Priority;
+
+/**
+ * @brief An arbiter with its own queue storage
+ */
+struct TestArbiter {
+    uint8_t alarm[512];
+    uint8_t data[512];
+    uint8_t bulk[512];
+    uint8_t* const storage[PublishArbiter::PRIORITY_COUNT] {alarm, data, bulk};
+    PublishArbiter arbiter;
+
+    explicit TestArbiter(size_t size = sizeof(alarm))
+        : arbiter(storage, sizesOf(size)) {
+    }
+
+    static const size_t* sizesOf(size_t size) {
+        static size_t sizes[PublishArbiter::PRIORITY_COUNT];
+        for (auto& s : sizes) {
+            s = size;
+        }
+        return sizes;
+    }
+};
+
+static char eventName[PublishArbiter::NAME_LENGTH + 1];
+static char eventData[PublishArbiter::EVENT_SIZE + 1];
+
+/**
+ * @brief Take the next event and check its name and data
+ *
+ * @return bool An event was ready
+ */
+static bool expectEvent(PublishArbiter& arbiter, uint32_t now, const char* name, const char* data, int line) {
+    if (!arbiter.next(now, eventName, eventData)) {
+        std::printf("line %d: no event at %u ms, expected %s\n", line, (unsigned)now, name);
+        hostTestFailures++;
+        return false;
+    }
+    if ((0 != strcmp(eventName, name)) || (0 != strcmp(eventData, data))) {
+        std::printf("line %d: got %s %s, expected %s %s\n", line, eventName, eventData, name, data);
+        hostTestFailures++;
+    }
+    return true;
+}
+
+#define EXPECT_EVENT(arbiter, now, name, data) expectEvent(arbiter, now, name, data, __LINE__)
+
+static void testTokenBucket() {
+    TestArbiter test;
+    auto& arbiter = test.arbiter;
+    arbiter.setRate(1000, 3, 0);
+    for (int i = 0; i < 20; i++) {
+        CHECK(arbiter.submit(Priority::Data, "BEACON-DIST", "{}", false));
+    }
+
+    // The full bucket lets a burst out back to back, one event at a time
+    for (int i = 0; i < 3; i++) {
+        CHECK(arbiter.next(0, eventName, eventData));
+        CHECK(!arbiter.next(0, eventName, eventData));
+        arbiter.complete(0, true);
+    }
+    CHECK(!arbiter.next(0, eventName, eventData));
+
+    // Then one event per period
+    CHECK(!arbiter.next(999, eventName, eventData));
+    CHECK(arbiter.next(1000, eventName, eventData));
+    arbiter.complete(1000, true);
+    CHECK(!arbiter.next(1999, eventName, eventData));
+    CHECK(arbiter.next(2000, eventName, eventData));
+    arbiter.complete(2000, true);
+
+    // A long idle spell earns no more than the burst
+    for (int i = 0; i < 3; i++) {
+        CHECK(arbiter.next(60000, eventName, eventData));
+        arbiter.complete(60000, true);
+    }
+    CHECK(!arbiter.next(60000, eventName, eventData));
+
+    // Events published elsewhere use the same budget
+    arbiter.charge(63000);
+    arbiter.charge(63000);
+    CHECK(arbiter.next(63000, eventName, eventData));
+    arbiter.complete(63000, true);
+    CHECK(!arbiter.next(63000, eventName, eventData));
+
+    // Time wraps without a stall
+    arbiter.setRate(1000, 1, UINT32_MAX - 500);
+    CHECK(arbiter.next(UINT32_MAX - 500, eventName, eventData));
+    arbiter.complete(UINT32_MAX - 500, true);
+    CHECK(!arbiter.next(UINT32_MAX, eventName, eventData));
+    CHECK(arbiter.next(499, eventName, eventData));
+    arbiter.complete(499, true);
+
+    auto& stats = arbiter.getStats();
+    CHECK_EQ(stats.submitted[(size_t)Priority::Data], 20u);
+    CHECK_EQ(stats.events, 11u);
+    CHECK_EQ(stats.external, 2u);
+    CHECK_EQ(stats.packed, 0u);
+}
+
+static void testBackoff() {
+    TestArbiter test;
+    auto& arbiter = test.arbiter;
+    arbiter.setRate(1000, 4, 0);
+    CHECK(arbiter.submit(Priority::Data, "modbus", "{\"a\":1}"));
+    CHECK(arbiter.submit(Priority::Data, "modbus", "{\"a\":2}"));
+    CHECK(arbiter.submit(Priority::Data, "BEACON-DIST", "{\"d\":1}", false));
+
+    // A failed publish holds off a period, then doubles, and always resends the same records
+    uint32_t now = 0;
+    uint32_t backoff = 1000;
+    for (int i = 0; i < 7; i++) {
+        CHECK(EXPECT_EVENT(arbiter, now, "pack", "{\"modbus\":[{\"a\":1},{\"a\":2}]}"));
+        arbiter.complete(now, false);
+        CHECK(!arbiter.next(now + backoff - 1, eventName, eventData));
+        now += backoff;
+        backoff = (backoff < 16000) ? 2 * backoff : backoff;
+    }
+    CHECK(EXPECT_EVENT(arbiter, now, "pack", "{\"modbus\":[{\"a\":1},{\"a\":2}]}"));
+    arbiter.complete(now, true);
+
+    // Success clears the backoff
+    CHECK(EXPECT_EVENT(arbiter, now, "BEACON-DIST", "{\"d\":1}"));
+    arbiter.complete(now, true);
+    CHECK(arbiter.empty());
+
+    // An outcome without an event changes nothing
+    arbiter.complete(now, false);
+    CHECK(arbiter.submit(Priority::Data, "modbus", "{\"a\":3}"));
+    CHECK(EXPECT_EVENT(arbiter, now + 1000, "modbus", "{\"a\":3}"));
+
+    auto& stats = arbiter.getStats();
+    CHECK_EQ(stats.failures, 7u);
+    CHECK_EQ(stats.events, 2u);
+    CHECK_EQ(stats.packed, 2u);
+}
+
+static void testPacking() {
+    TestArbiter test;
+    auto& arbiter = test.arbiter;
+    arbiter.setRate(1000, 100, 0);
+
+    // Higher priority first, each name once in the order it first appears
+    CHECK(arbiter.submit(Priority::Bulk, "modbus_diag", "{\"g\":1}"));
+    CHECK(arbiter.submit(Priority::Data, "modbus", "{\"a\":1}"));
+    CHECK(arbiter.submit(Priority::Data, "can", "{\"c\":1}"));
+    CHECK(arbiter.submit(Priority::Alarm, "modbus_fault", "{\"f\":1}"));
+    CHECK(arbiter.submit(Priority::Data, "modbus", "{\"a\":2}"));
+    CHECK(EXPECT_EVENT(arbiter, 0, "pack",
+        "{\"modbus_fault\":[{\"f\":1}],\"modbus\":[{\"a\":1},{\"a\":2}],\"can\":[{\"c\":1}],\"modbus_diag\":[{\"g\":1}]}"));
+    arbiter.complete(0, true);
+    CHECK(arbiter.empty());
+    CHECK_EQ(arbiter.getStats().packed, 5u);
+
+    // A record waiting alone keeps its own name
+    CHECK(arbiter.submit(Priority::Data, "modbus", "{\"a\":3}"));
+    CHECK(EXPECT_EVENT(arbiter, 0, "modbus", "{\"a\":3}"));
+    arbiter.complete(0, true);
+
+    // Records that may not be packed go alone without overtaking or being overtaken
+    CHECK(arbiter.submit(Priority::Data, "modbus", "{\"a\":4}"));
+    CHECK(arbiter.submit(Priority::Data, "BEACON-DIST", "{\"d\":1}", false));
+    CHECK(arbiter.submit(Priority::Data, "modbus", "{\"a\":5}"));
+    CHECK(arbiter.submit(Priority::Bulk, "modbus_diag", "{\"g\":2}"));
+    CHECK(EXPECT_EVENT(arbiter, 0, "pack", "{\"modbus\":[{\"a\":4}],\"modbus_diag\":[{\"g\":2}]}"));
+    arbiter.complete(0, true);
+    CHECK(EXPECT_EVENT(arbiter, 0, "BEACON-DIST", "{\"d\":1}"));
+    arbiter.complete(0, true);
+    CHECK(EXPECT_EVENT(arbiter, 0, "modbus", "{\"a\":5}"));
+    arbiter.complete(0, true);
+
+    CHECK(arbiter.submit(Priority::Alarm, "INVENTORY-SCAN", "{\"s\":1}", false));
+    CHECK(arbiter.submit(Priority::Data, "modbus", "{\"a\":6}"));
+    CHECK(EXPECT_EVENT(arbiter, 0, "INVENTORY-SCAN", "{\"s\":1}"));
+    arbiter.complete(0, true);
+    CHECK(EXPECT_EVENT(arbiter, 0, "modbus", "{\"a\":6}"));
+    arbiter.complete(0, true);
+
+    // So do records over the pack limit
+    std::string large = "{\"v\":\"" + std::string(PublishArbiter::PACK_LIMIT, 'x') + "\"}";
+    CHECK(arbiter.submit(Priority::Data, "modbus", "{\"a\":7}"));
+    CHECK(arbiter.submit(Priority::Data, "can", large.c_str()));
+    CHECK(EXPECT_EVENT(arbiter, 0, "modbus", "{\"a\":7}"));
+    arbiter.complete(0, true);
+    CHECK(EXPECT_EVENT(arbiter, 0, "can", large.c_str()));
+    arbiter.complete(0, true);
+    CHECK(arbiter.empty());
+}
+
+static void testPackLimits() {
+    static uint8_t storage[PublishArbiter::PRIORITY_COUNT][8192];
+    uint8_t* const queues[PublishArbiter::PRIORITY_COUNT] {storage[0], storage[1], storage[2]};
+    const size_t sizes[PublishArbiter::PRIORITY_COUNT] {sizeof(storage[0]), sizeof(storage[1]), sizeof(storage[2])};
+    PublishArbiter arbiter(queues, sizes);
+    arbiter.setRate(1, 1000, 0);
+
+    // No more than PACK_RECORDS records in one event
+    for (size_t i = 0; i < PublishArbiter::PACK_RECORDS + 8; i++) {
+        CHECK(arbiter.submit(Priority::Data, "m", "{}"));
+    }
+    CHECK(arbiter.next(0, eventName, eventData));
+    arbiter.complete(0, true);
+    CHECK_EQ(arbiter.getStats().packed, PublishArbiter::PACK_RECORDS);
+    std::string rest = "{\"m\":[{}";
+    for (int i = 1; i < 8; i++) {
+        rest += ",{}";
+    }
+    rest += "]}";
+    CHECK(EXPECT_EVENT(arbiter, 0, "pack", rest.c_str()));
+    arbiter.complete(0, true);
+
+    // Packed events never outgrow EVENT_SIZE and carry every record once, in order
+    std::mt19937 random(7);
+    std::deque<std::string> expected;
+    for (int i = 0; i < 50; i++) {
+        auto record = "{\"i\":" + std::to_string(i) + ",\"p\":\"" +
+            std::string(random() % (PublishArbiter::PACK_LIMIT - 20), 'y') + "\"}";
+        CHECK(arbiter.submit(Priority::Data, (i % 3) ? "modbus" : "can", record.c_str()));
+        expected.push_back(record);
+    }
+    size_t events = 0;
+    while (!arbiter.empty() && arbiter.next(0, eventName, eventData)) {
+        events++;
+        CHECK(strlen(eventData) <= PublishArbiter::EVENT_SIZE);
+        std::string data(eventData);
+        // Each event carries the oldest records still queued
+        size_t found = 0;
+        for (auto& record : expected) {
+            auto at = data.find(record);
+            if (std::string::npos == at) {
+                break;
+            }
+            found++;
+        }
+        CHECK(found > 0);
+        expected.erase(expected.begin(), expected.begin() + found);
+        arbiter.complete(0, true);
+    }
+    CHECK(expected.empty());
+    CHECK(events < 50);
+}
+
+static void testDrops() {
+    TestArbiter test(64);
+    auto& arbiter = test.arbiter;
+    arbiter.setRate(1, 1000, 0);
+
+    // Each record takes a three byte header and the terminated name and data, 13 bytes here
+    for (int i = 0; i < 4; i++) {
+        CHECK(arbiter.submit(Priority::Data, "m", "{\"a\":1}"));
+    }
+    CHECK(!arbiter.submit(Priority::Data, "m", "{\"a\":1}"));
+    CHECK(arbiter.submit(Priority::Alarm, "m", "{\"a\":1}"));
+
+    // Too large for any queue, or beyond the event limits
+    std::string data(100, 'x');
+    CHECK(!arbiter.submit(Priority::Bulk, "modbus", data.c_str()));
+    std::string name(PublishArbiter::NAME_LENGTH + 1, 'n');
+    CHECK(!arbiter.submit(Priority::Bulk, name.c_str(), "{}"));
+
+    auto& stats = arbiter.getStats();
+    CHECK_EQ(stats.submitted[(size_t)Priority::Data], 5u);
+    CHECK_EQ(stats.dropped[(size_t)Priority::Data], 1u);
+    CHECK_EQ(stats.dropped[(size_t)Priority::Alarm], 0u);
+    CHECK_EQ(stats.dropped[(size_t)Priority::Bulk], 2u);
+
+    // Space comes back once an event is published, not when it is only handed out
+    CHECK(arbiter.next(0, eventName, eventData));
+    CHECK(!arbiter.submit(Priority::Data, "m", "{\"a\":1}"));
+    arbiter.complete(0, true);
+    CHECK(arbiter.submit(Priority::Data, "m", "{\"a\":1}"));
+}
+
+static void testRing() {
+    // Records of random sizes come out in order as the queue wraps
+    TestArbiter test(200);
+    auto& arbiter = test.arbiter;
+    arbiter.setRate(1, 1000, 0);
+    std::mt19937 random(11);
+    std::deque<std::string> queued;
+    uint32_t now = 0;
+    size_t accepted = 0;
+    for (int i = 0; i < 20000; i++) {
+        if (random() % 2) {
+            auto data = std::to_string(i) + std::string(random() % 60, 'z');
+            auto ok = arbiter.submit(Priority::Bulk, "r", data.c_str(), false);
+            CHECK(ok || !queued.empty());
+            if (ok) {
+                queued.push_back(data);
+                accepted++;
+            }
+        }
+        else if (!queued.empty()) {
+            now++;
+            if (!EXPECT_EVENT(arbiter, now, "r", queued.front().c_str())) {
+                break;
+            }
+            arbiter.complete(now, true);
+            queued.pop_front();
+        }
+        CHECK_EQ(arbiter.empty(), queued.empty());
+    }
+    CHECK(accepted > 5000);
+}
+
+int main() {
+    testTokenBucket();
+    testBackoff();
+    testPacking();
+    testPackLimits();
+    testDrops();
+    testRing();
+    return hostTestResult("test_publish_arbiter");
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "ThresholdEngine.h"
+#include "RelayController.h"
+#include "HostTest.h"
+
+#include <cstring>
+
+struct Report {
+    const ThresholdRule* rule;
+    bool raised;
+};
+
+static Report reports[16];
+static size_t reportCount {0};
+
+static void onRule(const ThresholdRule& rule, bool raised) {
+    if (reportCount < sizeof(reports) / sizeof(reports[0])) {
+        reports[reportCount++] = {&rule, raised};
+    }
+}
+
+static void setRule(ThresholdRule& rule, uint16_t channel, ThresholdDirection direction, float threshold,
+    float hysteresis, bool reportClear, const char* event) {
+    rule.active = true;
+    rule.enabled = true;
+    rule.reportClear = reportClear;
+    rule.channel = channel;
+    rule.direction = direction;
+    rule.threshold = threshold;
+    rule.hysteresis = hysteresis;
+    rule.setEvent(event);
+    rule.resetState();
+}
+
+static void testHysteresis() {
+    ThresholdRule rules[2];
+    setRule(rules[0], 0, ThresholdDirection::Above, 10.0f, 1.0f, true, "hot");
+    setRule(rules[1], 0, ThresholdDirection::Below, 2.0f, 0.5f, false, "cold");
+    ThresholdEngine engine(rules, 2, onRule);
+
+    CHECK(0 == strcmp(rules[0].raiseEvent, "hot_raise"));
+    CHECK(0 == strcmp(rules[0].clearEvent, "hot_clr"));
+    CHECK(0 == strcmp(rules[1].raiseEvent, "cold"));
+    CHECK('\0' == rules[1].clearEvent[0]);
+
+    // Nothing is reported for a rule that starts out clear
+    reportCount = 0;
+    float value = 5.0f;
+    engine.evaluate(&value, 1);
+    CHECK_EQ(reportCount, 0u);
+
+    value = 10.5f;
+    engine.evaluate(&value, 1);
+    CHECK_EQ(reportCount, 1u);
+    CHECK(reports[0].rule == &rules[0] && reports[0].raised);
+
+    // Inside the hysteresis band the rule stays raised
+    value = 9.2f;
+    engine.evaluate(&value, 1);
+    CHECK_EQ(reportCount, 1u);
+    CHECK(rules[0].raised);
+
+    value = 8.9f;
+    engine.evaluate(&value, 1);
+    CHECK_EQ(reportCount, 2u);
+    CHECK(reports[1].rule == &rules[0] && !reports[1].raised);
+
+    // Below rule without clear reporting only reports raising
+    value = 1.5f;
+    engine.evaluate(&value, 1);
+    value = 2.2f;
+    engine.evaluate(&value, 1);
+    CHECK(rules[1].raised);
+    value = 2.6f;
+    engine.evaluate(&value, 1);
+    CHECK(!rules[1].raised);
+    CHECK_EQ(reportCount, 3u);
+    CHECK(reports[2].rule == &rules[1] && reports[2].raised);
+}
+
+static void testChannels() {
+    ThresholdRule rules[4];
+    setRule(rules[0], 0, ThresholdDirection::Above, 1.0f, 0.0f, false, "a");
+    setRule(rules[1], 1, ThresholdDirection::Above, 1.0f, 0.0f, false, "b");
+    setRule(rules[2], 7, ThresholdDirection::Above, 1.0f, 0.0f, false, "c");   // Channel out of range
+    setRule(rules[3], 0, ThresholdDirection::Above, 1.0f, 0.0f, false, "d");
+    rules[3].enabled = false;
+    ThresholdEngine engine(rules, 4, onRule);
+
+    // A rule that starts out raised is reported on the first evaluation, disabled rules never are
+    reportCount = 0;
+    float values[2] {2.0f, NAN};
+    engine.evaluate(values, 2);
+    CHECK_EQ(reportCount, 1u);
+    CHECK(reports[0].rule == &rules[0]);
+    CHECK(rules[3].raised);
+    CHECK_EQ(engine.raisedMask(), 0x9u);
+    CHECK_EQ(engine.raisedMask(3), 0x1u);
+
+    // Missing values keep the previous state
+    values[0] = NAN;
+    values[1] = 3.0f;
+    engine.evaluate(values, 2);
+    CHECK(rules[0].raised);
+    CHECK(rules[1].raised);
+    CHECK(!rules[2].evaluated);
+    CHECK_EQ(engine.raisedMask(), 0xbu);
+}
+
+static void testStale() {
+    ThresholdRule rules[3];
+    setRule(rules[0], 0, ThresholdDirection::Above, 1.0f, 0.0f, true, "hold");
+    setRule(rules[1], 0, ThresholdDirection::Above, 1.0f, 0.0f, true, "clear");
+    setRule(rules[2], 0, ThresholdDirection::Above, 1.0f, 0.0f, true, "raise");
+    rules[1].stale = ThresholdStale::Clear;
+    rules[2].stale = ThresholdStale::Raise;
+    ThresholdEngine engine(rules, 3, onRule);
+
+    float value = 2.0f;
+    engine.evaluate(&value, 1);
+    CHECK_EQ(engine.raisedMask(), 0x7u);
+
+    // No value holds, clears or raises each rule, and reports the change
+    reportCount = 0;
+    value = NAN;
+    engine.evaluate(&value, 1);
+    CHECK_EQ(engine.raisedMask(), 0x5u);
+    CHECK_EQ(reportCount, 1u);
+    CHECK(reports[0].rule == &rules[1]);
+    CHECK(!reports[0].raised);
+
+    value = 0.0f;
+    engine.evaluate(&value, 1);
+    CHECK_EQ(engine.raisedMask(), 0x0u);
+    value = NAN;
+    engine.evaluate(&value, 1);
+    CHECK_EQ(engine.raisedMask(), 0x4u);
+}
+
+static void testRelayReleasesWithoutValue() {
+    // The relay rule of the IO module, energized above 10 and released without a value
+    ThresholdRule rule;
+    setRule(rule, 0, ThresholdDirection::Above, 10.0f, 1.0f, false, "io_relay");
+    rule.enabled = false;
+    rule.stale = ThresholdStale::Clear;
+    ThresholdEngine engine(&rule, 1, onRule);
+    RelayController relay;
+    relay.setMinTimes(0, 5000);
+
+    uint32_t now = 0;
+    float value = 12.0f;
+    engine.evaluate(&value, 1);
+    CHECK(RelayController::Action::On == relay.update(rule.raised, false, now));
+
+    // A failed poll releases the relay and it stays released while the value is missing
+    value = NAN;
+    engine.evaluate(&value, 1);
+    CHECK(RelayController::Action::Off == relay.update(rule.raised, false, now += 100));
+    for (int i = 0; i < 100; i++) {
+        engine.evaluate(&value, 1);
+        CHECK(RelayController::Action::None == relay.update(rule.raised, false, now += 100));
+    }
+    CHECK(!relay.isOn());
+
+    // The value coming back energizes it again once the minimum off time is over
+    value = 12.0f;
+    engine.evaluate(&value, 1);
+    CHECK(RelayController::Action::On == relay.update(rule.raised, false, now += 100));
+}
+
+int main() {
+    testHysteresis();
+    testChannels();
+    testStale();
+    testRelayReleasesWithoutValue();
+    return hostTestResult("test_threshold_engine");
+}
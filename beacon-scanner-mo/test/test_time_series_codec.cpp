@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "TimeSeriesCodec.h"
+#include "HostTest.h"
+
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+struct Sample {
+    uint32_t time;
+    float value;
+};
+
+/**
+ * @brief Encode samples into blocks and check that every block decodes to the same bits
+ *
+ * @return size_t Total encoded bytes
+ */
+static size_t roundTrip(const std::vector<Sample>& samples, size_t blockSize, size_t* blockCount = nullptr) {
+    std::vector<uint8_t> block(blockSize);
+    size_t bytes = 0, blocks = 0, mismatches = 0;
+
+    size_t i = 0;
+    while (i < samples.size()) {
+        TimeSeriesEncoder encoder;
+        encoder.begin(block.data(), block.size());
+        auto first = i;
+        while ((i < samples.size()) && encoder.append(samples[i].time, samples[i].value)) {
+            i++;
+        }
+        CHECK(i > first);
+        if (i == first) {
+            break;
+        }
+        CHECK(encoder.getBytes() <= blockSize);
+        CHECK_EQ(encoder.getCount(), i - first);
+        bytes += encoder.getBytes();
+        blocks++;
+
+        TimeSeriesDecoder decoder;
+        decoder.begin(block.data(), encoder.getBytes(), encoder.getCount());
+        for (auto k = first; k < i; k++) {
+            uint32_t time;
+            float value;
+            if (!decoder.next(time, value) || (time != samples[k].time) ||
+                (0 != memcmp(&value, &samples[k].value, sizeof(value)))) {
+                mismatches++;
+            }
+        }
+        uint32_t time;
+        float value;
+        CHECK(!decoder.next(time, value));
+    }
+    CHECK_EQ(mismatches, 0u);
+
+    if (blockCount) {
+        *blockCount = blocks;
+    }
+    return bytes;
+}
+
+static void testSpecialValues() {
+    auto nan = std::numeric_limits<float>::quiet_NaN();
+    auto inf = std::numeric_limits<float>::infinity();
+    std::vector<Sample> samples {
+        {0, 0.0f}, {1000, -0.0f}, {2000, nan}, {3000, inf}, {4000, -inf},
+        {5000, std::numeric_limits<float>::denorm_min()}, {6000, std::numeric_limits<float>::max()},
+        {7000, -std::numeric_limits<float>::max()}, {8000, 1.0f}, {9000, 1.0f},
+    };
+    roundTrip(samples, 256);
+}
+
+static void testTimestamps() {
+    // Regular, jittered, long gaps, repeated and out of order times, and the millis() rollover
+    std::vector<Sample> samples;
+    uint32_t time = 0xffff0000;
+    int32_t steps[] {1000, 1000, 1003, 997, 1000, 0, 0, 60000, 1, -5, 3600000, 1000, -3600000, 1000, 70000, 1000};
+    for (int repeat = 0; repeat < 8; repeat++) {
+        for (auto step : steps) {
+            time += (uint32_t)step;
+            samples.push_back({time, (float)repeat});
+        }
+    }
+    samples.push_back({0, 1.0f});
+    samples.push_back({0xffffffff, 2.0f});
+    samples.push_back({0, 3.0f});
+    roundTrip(samples, 128);
+}
+
+static void testBlocks() {
+    // A full block refuses samples rather than overrunning, and every block stands alone
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> noise(-1e6f, 1e6f);
+    std::vector<Sample> samples;
+    for (uint32_t i = 0; i < 2000; i++) {
+        samples.push_back({i * 977u, noise(rng)});
+    }
+    size_t blocks;
+    roundTrip(samples, 64, &blocks);
+    CHECK(blocks > 100);
+
+    // The first sample always fits a block sized for the worst case
+    uint8_t small[(TimeSeriesEncoder::MAX_SAMPLE_BITS + 7) / 8];
+    TimeSeriesEncoder encoder;
+    encoder.begin(small, sizeof(small));
+    CHECK(encoder.append(123, 4.5f));
+    CHECK(!encoder.append(1123, 7.25f));
+    CHECK_EQ(encoder.getCount(), 1u);
+
+    // A decoder told of more samples than the data holds stops instead of reading past the end
+    TimeSeriesDecoder decoder;
+    decoder.begin(small, encoder.getBytes(), 50);
+    uint32_t time;
+    float value;
+    CHECK(decoder.next(time, value));
+    CHECK_EQ(time, 123u);
+    size_t extra = 0;
+    while (decoder.next(time, value) && (extra < 100)) {
+        extra++;
+    }
+    CHECK(extra < 50);
+}
+
+static void testRatio() {
+    // Regular one second samples of a slowly changing reading, as io_v is stored
+    std::mt19937 rng(1);
+    std::normal_distribution<float> drift(0.0f, 0.004f);
+    std::vector<Sample> samples;
+    float volts = 24.0f;
+    for (uint32_t i = 0; i < 5000; i++) {
+        volts += drift(rng);
+        samples.push_back({1000 + i * 1000, std::round(volts * 1000.0f) / 1000.0f});
+    }
+    auto bytes = roundTrip(samples, 256);
+    auto ratio = (double)(samples.size() * sizeof(Sample)) / bytes;
+    CHECK(ratio > 2.0);
+
+    // A constant reading costs about two bits per sample
+    for (auto& sample : samples) {
+        sample.value = 230.0f;
+    }
+    bytes = roundTrip(samples, 256);
+    CHECK(bytes * 8 < samples.size() * 3);
+}
+
+int main() {
+    testSpecialValues();
+    testTimestamps();
+    testBlocks();
+    testRatio();
+    return hostTestResult("test_time_series_codec");
+}
@@ -17,6 +17,15 @@ constexpr int16_t TagIdToWrite = 1;
 
 constexpr uint32_t BeaconScanDelayMs = 5000;
 
+// Publishing, the cloud allows one event a second with bursts of four
+namespace PublishConstants {
+  constexpr uint32_t PeriodMs = 1000;
+  constexpr uint32_t Burst = 4;
+  constexpr size_t AlarmBytes = 1024;
+  constexpr size_t DataBytes = 4096;
+  constexpr size_t BulkBytes = 512;
+}
+
 // LCD
 namespace LCDConstants {
   constexpr uint8_t I2CAddress = 0x20;
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2023 Particle Industries, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+// beacon-scanner-p2/src holds a copy of this class and its source, since each Particle project
+// builds only the files under its own directory.  Change this copy, then copy both files over;
+// make -C beacon-scanner-mo/test fails while the two differ.
+
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief Queues cloud events by priority and releases them at the rate the cloud accepts
+ *
+ * @details Producers submit records, an event name and its JSON data, into one of three
+ *          queues held in caller supplied storage.  The sender takes the next event with
+ *          next(), publishes it without holding anything the producers need, and reports the
+ *          outcome with complete().  Events are paced by a token bucket that holds up to burst
+ *          events and regains one every period, and a failed publish backs off before the same
+ *          records are tried again.
+ *
+ *          Small records are packed together when more than one is waiting.  A packed event is
+ *          named "pack" and its data holds an array of record data under each event name, as
+ *          in {"modbus":[{...}],"can":[{...},{...}]}.  Higher priority records go first
+ *          and each queue keeps its order.  A record waiting alone goes out unchanged under its
+ *          own name.  Records that a consumer parses on their own, by event name, must be
+ *          submitted as not packable.  Not thread safe, the owner serializes access.
+ */
+class PublishArbiter {
+public:
+    enum class Priority : uint8_t {
+        Alarm,                                  ///< Faults, notices and user actions, ahead of everything
+        Data,                                   ///< Periodic readings
+        Bulk,                                   ///< Uploads and diagnostics that can wait
+    };
+
+    static constexpr size_t PRIORITY_COUNT      {3};
+    static constexpr size_t EVENT_SIZE          {1024};     // Largest event data
+    static constexpr size_t NAME_LENGTH         {63};       // Longest event name
+    static constexpr size_t PACK_LIMIT          {256};      // Largest record packed with others
+    static constexpr size_t PACK_RECORDS        {32};       // Most records in one packed event
+    static constexpr char PACK_NAME[]           {"pack"};
+
+    struct Stats {
+        uint32_t submitted[PRIORITY_COUNT];
+        uint32_t dropped[PRIORITY_COUNT];       ///< Records refused because their queue was full
+        uint32_t events;                        ///< Events published
+        uint32_t packed;                        ///< Records that went out inside packed events
+        uint32_t failures;                      ///< Publish attempts that failed
+        uint32_t external;                      ///< Events published by others and charged to the budget
+    };
+
+    /**
+     * @brief Construct a new arbiter over caller supplied queue storage
+     *
+     * @param storage Byte storage for each priority queue
+     * @param sizes Size of each storage
+     */
+    PublishArbiter(uint8_t* const storage[PRIORITY_COUNT], const size_t sizes[PRIORITY_COUNT]);
+
+    /**
+     * @brief Set the publish budget, the bucket starts out full
+     *
+     * @param periodMs Time to earn one event
+     * @param burst Events that may go out back to back
+     * @param now Current millisecond timestamp
+     */
+    void setRate(uint32_t periodMs, uint32_t burst, uint32_t now);
+
+    /**
+     * @brief Queue a record for publishing
+     *
+     * @param priority Queue to use
+     * @param name Event name
+     * @param data Event data, JSON when the record may be packed
+     * @param packable Record may share an event with others
+     * @return true Record queued
+     * @return false Queue full or record too large, the record was dropped
+     */
+    bool submit(Priority priority, const char* name, const char* data, bool packable = true);
+
+    /**
+     * @brief Charge an event published outside of the arbiter to the budget
+     *
+     */
+    void charge(uint32_t now);
+
+    /**
+     * @brief Build the next event if the budget allows one, must be followed by complete()
+     *
+     * @param now Current millisecond timestamp
+     * @param name Receives the event name, NAME_LENGTH + 1 bytes
+     * @param data Receives the event data, EVENT_SIZE + 1 bytes
+     * @return true An event is ready
+     * @return false Nothing queued, or the budget or a backoff holds it back
+     */
+    bool next(uint32_t now, char* name, char* data);
+
+    /**
+     * @brief Report the outcome of publishing the event from next()
+     *
+     * @param now Current millisecond timestamp
+     * @param published The cloud accepted the event, otherwise its records are tried again
+     */
+    void complete(uint32_t now, bool published);
+
+    bool empty() const;
+
+    const Stats& getStats() const {
+        return _stats;
+    }
+
+private:
+    struct Queue {
+        uint8_t* storage;
+        size_t size;
+        size_t head;                            ///< Offset of the oldest record
+        size_t tail;                            ///< Offset where the next record goes
+        size_t count;
+        size_t taken;                           ///< Records handed out by next()
+    };
+
+    struct Record {
+        const char* name;
+        const char* data;
+        size_t dataLength;
+        bool packable;
+        size_t bytes;                           ///< Space taken in the queue
+    };
+
+    static size_t start(const Queue& queue, size_t offset);
+    static void read(const Queue& queue, size_t offset, Record& record);
+    void refill(uint32_t now);
+    void pack(char* data);
+
+    Queue _queues[PRIORITY_COUNT];
+    uint32_t _periodMs {1000};
+    uint32_t _burst {4};
+    uint32_t _credit {0};                       ///< Milliseconds of budget, periodMs per event
+    uint32_t _updated {0};
+    uint32_t _backoffMs {0};
+    uint32_t _failedAt {0};
+    bool _busy {false};
+    Record _pack[PACK_RECORDS] {};              ///< Records of the event handed out by next()
+    size_t _packCount {0};
+    Stats _stats {};
+};
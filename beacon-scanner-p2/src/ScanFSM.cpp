@@ -1,7 +1,7 @@
 #include "ScanFSM.h"
 
-ScanFSM::ScanFSM(TagScanner& scanner, LiquidCrystal_I2C& lcd)
-  : _currentState{SystemState::Idle}, _scanner{scanner}, _lcd{lcd} {}
+ScanFSM::ScanFSM(TagScanner& scanner, LiquidCrystal_I2C& lcd, PublishArbiter& publisher)
+  : _currentState{SystemState::Idle}, _scanner{scanner}, _lcd{lcd}, _publisher{publisher} {}
 
 SystemState ScanFSM::update() {
   switch (_currentState) {
@@ -97,7 +97,8 @@ SystemState ScanFSM::handleConfirmedScan() {
   writer.name("quantity").value(_quantity);
   writer.name("tagId").value(_tagId);
   writer.endObject();
-  Particle.publish("scan_event_raw", jsonBuf);
+  // Read field by field by the reformatRawInventoryEvent logic function
+  _publisher.submit(PublishArbiter::Priority::Alarm, "scan_event_raw", jsonBuf, false);
 
   resetLcd();
   _lcd.print("Change quantity or\nwrite an ID");
@@ -3,6 +3,7 @@
 #include <LiquidCrystal_I2C.h>
 
 #include "Constants.h"
+#include "PublishArbiter.h"
 #include "TagScanner.h"
 
 enum class SystemState {
@@ -16,7 +17,7 @@ enum class SystemState {
 
 class ScanFSM {
   public:
-    ScanFSM(TagScanner& scanner, LiquidCrystal_I2C& lcd);
+    ScanFSM(TagScanner& scanner, LiquidCrystal_I2C& lcd, PublishArbiter& publisher);
     SystemState update();
 
   private:
@@ -38,4 +39,5 @@ class ScanFSM {
     SystemState _currentState;
     TagScanner& _scanner;
     LiquidCrystal_I2C& _lcd;
+    PublishArbiter& _publisher;
 };
\ No newline at end of file
@@ -14,6 +14,7 @@
 #include <LiquidCrystal_I2C.h>
 
 #include "Constants.h"
+#include "PublishArbiter.h"
 #include "ScanFSM.h"
 #include "TagScanner.h"
 
@@ -29,13 +30,22 @@ SerialLogHandler logHandler(LOG_LEVEL_INFO);
 
 #ifndef TEST_MODE
 
+// Every producer queues its events here and loop() sends them as the rate limit allows
+uint8_t publishAlarmQueue[PublishConstants::AlarmBytes];
+uint8_t publishDataQueue[PublishConstants::DataBytes];
+uint8_t publishBulkQueue[PublishConstants::BulkBytes];
+uint8_t* const publishQueues[PublishArbiter::PRIORITY_COUNT] = {publishAlarmQueue, publishDataQueue, publishBulkQueue};
+const size_t publishQueueSizes[PublishArbiter::PRIORITY_COUNT] = {PublishConstants::AlarmBytes, PublishConstants::DataBytes, PublishConstants::BulkBytes};
+PublishArbiter publisher{publishQueues, publishQueueSizes};
+
 TagScanner tagScanner{&SPI1, Pins::RC522Rst, Pins::RC522Cs};
 LiquidCrystal_I2C lcd{LCDConstants::I2CAddress};
-ScanFSM fsm{tagScanner, lcd};
+ScanFSM fsm{tagScanner, lcd, publisher};
 
 void scanCb(Beacon& beacon, callback_type type);
 double rssiToDistance(int8_t rssi, int txPower);
 void getBeacons(void);
+void sendPublishes(void);
 
 static char jsonBuf[512];
 static uint32_t lastBeaconScan = 0;
@@ -56,6 +66,7 @@ void setup() {
   Scanner.startContinuous(SCAN_IBEACON);
 
   tagScanner.init();
+  publisher.setRate(PublishConstants::PeriodMs, PublishConstants::Burst, millis());
   // lcd.begin(LCDConstants::ColumnCount, LCDConstants::RowCount);
 }
 
@@ -91,7 +102,8 @@ void loop() {
     writer.name("id").value(0);
     writer.name("timestamp").value(Time.format(time, TIME_FORMAT_ISO8601_FULL));
     writer.endObject();
-    Particle.publish("INVENTORY-SCAN", jsonBuf);
+    // The web app parses the event data as a single scan
+    publisher.submit(PublishArbiter::Priority::Alarm, "INVENTORY-SCAN", jsonBuf, false);
 
     delay(1000);
   }
@@ -102,6 +114,18 @@ void loop() {
     getBeacons();
     lastBeaconScan = millis();
   }
+
+  sendPublishes();
+}
+
+void sendPublishes() {
+  static char name[PublishArbiter::NAME_LENGTH + 1];
+  static char data[PublishArbiter::EVENT_SIZE + 1];
+
+  if (Particle.connected() && publisher.next(millis(), name, data)) {
+    bool published = Particle.publish(name, data);
+    publisher.complete(millis(), published);
+  }
 }
 
 void getBeacons() {
@@ -118,7 +142,8 @@ void getBeacons() {
     writer.name("beacon_minor").value(ibeacon.getMinor());
     writer.name("distance_m").value(estDistance);
     writer.endObject();
-    Particle.publish("BEACON-DIST", jsonBuf);
+    // The web app takes one reading per BEACON-DIST event, so it never goes out packed
+    publisher.submit(PublishArbiter::Priority::Data, "BEACON-DIST", jsonBuf, false);
   }
 }
 